@@ -44,7 +44,7 @@ namespace crt
 		int height;
 		int frameDelayMs;
 		CharMatrix<WIDTH,HEIGHT> charMatrix;
-		Pool<TwoNumbers> poolBallPosition;
+		Pool<TwoNumbers, PoolSeqLock> poolBallPosition;	// Written by BallControl only, read every frame.
 		Pool<int> poolPaddlePosition;
 		Flag flagEnable;
 		Flag flagDisable;
@@ -62,7 +62,7 @@ namespace crt
 		int height;
 		int frameDelayMs;
 
-		Pool<TwoNumbers> poolBallPosition;
+		Pool<TwoNumbers, PoolSeqLock> poolBallPosition;	// Written by BallControl only, read every frame.
 		Pool<int> poolPaddlePosition;
 		Flag flagEnable;
 		Flag flagDisable;
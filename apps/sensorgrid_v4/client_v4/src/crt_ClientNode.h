@@ -130,20 +130,24 @@ namespace crt
 			bool hasId = body.indexOf("\"id\"") >= 0;
 			bool hasSeen = body.indexOf("\"seen\"") >= 0;
 			bool hasValue = body.indexOf("\"value\"") >= 0;
+			bool hasHops = body.indexOf("\"hops\"") >= 0;
+			bool hasSamples = body.indexOf("\"samples\"") >= 0;
 
-			if (hasNow && hasSensors && hasId && hasSeen && hasValue)
+			if (hasNow && hasSensors && hasId && hasSeen && hasValue && hasHops && hasSamples)
 			{
-				logResult(TEST_NAME, true, "JSON structure OK: now, sensors[], id, seen, value fields present");
+				logResult(TEST_NAME, true, "JSON structure OK: now, sensors[], id, seen, value, hops, samples fields present");
 			}
 			else
 			{
 				char msg[128];
-				snprintf(msg, sizeof(msg), "Missing: %s%s%s%s%s",
+				snprintf(msg, sizeof(msg), "Missing: %s%s%s%s%s%s%s",
 					hasNow ? "" : "now ",
 					hasSensors ? "" : "sensors ",
 					hasId ? "" : "id ",
 					hasSeen ? "" : "seen ",
-					hasValue ? "" : "value ");
+					hasValue ? "" : "value ",
+					hasHops ? "" : "hops ",
+					hasSamples ? "" : "samples ");
 				logResult(TEST_NAME, false, msg);
 			}
 		}
@@ -227,14 +231,17 @@ namespace crt
 
 			bool hasButton = body.indexOf("id=\"downloadBtn\"") >= 0;
 			bool hasDownloadLabel = body.indexOf(">Download<") >= 0;
-			bool hasCsvGeneration = body.indexOf("text/csv") >= 0;
-			bool hasCsvHeaders = body.indexOf("Sensor id,Meetwaarde") >= 0;
+			bool hasExportLink = body.indexOf("/api/export.csv") >= 0;
 			bool hasFilename = body.indexOf("sensors.csv") >= 0;
 
-			if (hasButton && hasDownloadLabel && hasCsvGeneration && hasCsvHeaders && hasFilename)
+			// The CSV itself is streamed by the server.
+			bool hasCsvHeader = httpGet("/api/export.csv?current=1", code, body) && code == 200 &&
+								body.startsWith("time,sensor,values\r\n");
+
+			if (hasButton && hasDownloadLabel && hasExportLink && hasFilename && hasCsvHeader)
 			{
 				logResult(TEST_NAME, true,
-					"Download button present, CSV generation JS verified (button, text/csv, headers, filename)");
+					"Download button present, streamed CSV from /api/export.csv verified (button, link, filename, header)");
 			}
 			else
 			{
@@ -242,9 +249,9 @@ namespace crt
 				snprintf(msg, sizeof(msg), "Missing: %s%s%s%s%s",
 					hasButton ? "" : "button ",
 					hasDownloadLabel ? "" : "label ",
-					hasCsvGeneration ? "" : "csv-type ",
-					hasCsvHeaders ? "" : "csv-headers ",
-					hasFilename ? "" : "filename ");
+					hasExportLink ? "" : "export-link ",
+					hasFilename ? "" : "filename ",
+					hasCsvHeader ? "" : "csv-header ");
 				logResult(TEST_NAME, false, msg);
 			}
 		}
@@ -271,9 +278,8 @@ namespace crt
 
 			bool hasTitle = body.indexOf("Grid View") >= 0;
 			bool hasNav = body.indexOf("<nav") >= 0;
-			bool hasGridContainer = body.indexOf("grid-container") >= 0;
-			bool hasSensor1 = body.indexOf("Sensor 1") >= 0;
-			bool hasSensor4 = body.indexOf("Sensor 4") >= 0;
+			bool hasGridContainer = body.indexOf("grid-canvas") >= 0;
+			bool hasLayoutApi = body.indexOf("/api/layout") >= 0;
 			bool hasAllApi = body.indexOf("allmeasurements") >= 0;
 			bool hasHistogram = body.indexOf("histogram") >= 0;
 			bool hasStatsTable = body.indexOf("stats-table") >= 0;
@@ -281,20 +287,19 @@ namespace crt
 			bool hasColorize = body.indexOf("Colorize") >= 0;
 			bool hasLayout = body.indexOf("sensor-layout") >= 0;
 
-			if (hasTitle && hasNav && hasGridContainer && hasSensor1 && hasSensor4 &&
+			if (hasTitle && hasNav && hasGridContainer && hasLayoutApi &&
 				hasAllApi && hasHistogram && hasStatsTable && hasNormalize && hasColorize && hasLayout)
 			{
-				logResult(TEST_NAME, true, "Grid page OK: title, nav, grid, sensors 1-4, allapi, histogram, stats, buttons, layout");
+				logResult(TEST_NAME, true, "Grid page OK: title, nav, grid, layout api, allapi, histogram, stats, buttons, layout");
 			}
 			else
 			{
 				char msg[180];
-				snprintf(msg, sizeof(msg), "Missing: %s%s%s%s%s%s%s%s%s%s%s",
+				snprintf(msg, sizeof(msg), "Missing: %s%s%s%s%s%s%s%s%s%s",
 					hasTitle ? "" : "title ",
 					hasNav ? "" : "nav ",
 					hasGridContainer ? "" : "grid ",
-					hasSensor1 ? "" : "s1 ",
-					hasSensor4 ? "" : "s4 ",
+					hasLayoutApi ? "" : "layoutapi ",
 					hasAllApi ? "" : "allapi ",
 					hasHistogram ? "" : "histogram ",
 					hasStatsTable ? "" : "stats ",
@@ -344,6 +349,32 @@ namespace crt
 			}
 		}
 
+		void testApiMeasurementsUnknownId()
+		{
+			const char* TEST_NAME = "GET /api/measurements/{99,abc} (unknown id)";
+			int codeUnknown = 0;
+			int codeNotNumeric = 0;
+			String body;
+
+			if (!httpGet("/api/measurements/99", codeUnknown, body) ||
+				!httpGet("/api/measurements/abc", codeNotNumeric, body))
+			{
+				logResult(TEST_NAME, false, "HTTP request failed");
+				return;
+			}
+
+			if (codeUnknown == 404 && codeNotNumeric == 404)
+			{
+				logResult(TEST_NAME, true, "Unknown and non-numeric sensor ids return HTTP 404");
+			}
+			else
+			{
+				char msg[64];
+				snprintf(msg, sizeof(msg), "Expected HTTP 404/404, got %d/%d", codeUnknown, codeNotNumeric);
+				logResult(TEST_NAME, false, msg);
+			}
+		}
+
 		void testApiAllMeasurements()
 		{
 			const char* TEST_NAME = "GET /api/allmeasurements (all sensors)";
@@ -387,6 +418,184 @@ namespace crt
 			}
 		}
 
+		// Extracts the value of "generation" from an /api/allmeasurements response.
+		static long parseGeneration(const String& body)
+		{
+			int pos = body.indexOf("\"generation\":");
+			if (pos < 0) return -1;
+			return body.substring(pos + 13).toInt();
+		}
+
+		// Extracts the value of "epoch" (a random 32-bit number) from an /api/allmeasurements response.
+		static unsigned long parseEpoch(const String& body)
+		{
+			int pos = body.indexOf("\"epoch\":");
+			if (pos < 0) return 0;
+			return strtoul(body.c_str() + pos + 8, nullptr, 10);
+		}
+
+		void testApiAllMeasurementsDelta()
+		{
+			const char* TEST_NAME = "GET /api/allmeasurements?since= (delta)";
+			int codeFull = 0, codeDelta = 0, codeAhead = 0, codeEpoch = 0;
+			String bodyFull, bodyDelta, bodyAhead, bodyEpoch;
+
+			unsigned long startMs = millis();
+			if (!httpGet("/api/allmeasurements", codeFull, bodyFull))
+			{
+				logResult(TEST_NAME, false, "Full HTTP request failed");
+				return;
+			}
+			unsigned long fullMs = millis() - startMs;
+
+			long generation = parseGeneration(bodyFull);
+			if (codeFull != 200 || generation < 0)
+			{
+				logResult(TEST_NAME, false, "Full response lacks generation");
+				return;
+			}
+
+			unsigned long epoch = parseEpoch(bodyFull);
+			char path[80];
+			snprintf(path, sizeof(path), "/api/allmeasurements?since=%ld&epoch=%lu", generation, epoch);
+			startMs = millis();
+			if (!httpGet(path, codeDelta, bodyDelta))
+			{
+				logResult(TEST_NAME, false, "Delta HTTP request failed");
+				return;
+			}
+			unsigned long deltaMs = millis() - startMs;
+
+			// A generation from the future (as after a server restart) must yield a full response.
+			snprintf(path, sizeof(path), "/api/allmeasurements?since=%ld", generation + 1000000L);
+			if (!httpGet(path, codeAhead, bodyAhead))
+			{
+				logResult(TEST_NAME, false, "Resync HTTP request failed");
+				return;
+			}
+
+			// So must the generation of another boot of the server, even if it is not ahead.
+			snprintf(path, sizeof(path), "/api/allmeasurements?since=%ld&epoch=%lu", generation, epoch + 1);
+			if (!httpGet(path, codeEpoch, bodyEpoch))
+			{
+				logResult(TEST_NAME, false, "Epoch HTTP request failed");
+				return;
+			}
+
+			// Bandwidth comparison: only sensors that changed in between are in the delta.
+			ESP_LOGI("ClientNode", "allmeasurements full: %u bytes in %lu ms, delta: %u bytes in %lu ms",
+				bodyFull.length(), fullMs, bodyDelta.length(), deltaMs);
+
+			bool deltaOk = codeDelta == 200 && bodyDelta.indexOf("\"delta\":true") >= 0 &&
+						   parseGeneration(bodyDelta) >= generation &&
+						   bodyDelta.length() <= bodyFull.length();
+			bool resyncOk = codeAhead == 200 && bodyAhead.indexOf("\"delta\":false") >= 0 &&
+							codeEpoch == 200 && bodyEpoch.indexOf("\"delta\":false") >= 0;
+
+			if (deltaOk && resyncOk)
+			{
+				char msg[96];
+				snprintf(msg, sizeof(msg), "Delta OK: %u of %u bytes, future generation or other epoch yields full response",
+					bodyDelta.length(), bodyFull.length());
+				logResult(TEST_NAME, true, msg);
+			}
+			else
+			{
+				char msg[64];
+				snprintf(msg, sizeof(msg), "Failed: %s%s",
+					deltaOk ? "" : "delta ",
+					resyncOk ? "" : "resync ");
+				logResult(TEST_NAME, false, msg);
+			}
+		}
+
+		// Extracts the value of an unsigned "key": from a JSON body.
+		static long parseCounter(const String& body, const char* key)
+		{
+			String pattern = String("\"") + key + "\":";
+			int pos = body.indexOf(pattern);
+			if (pos < 0) return -1;
+			return body.substring(pos + pattern.length()).toInt();
+		}
+
+		void testApiStatsCacheHits()
+		{
+			const char* TEST_NAME = "GET /api/stats (json cache hits)";
+			int code = 0;
+			String body, unused;
+
+			if (!httpGet("/api/stats", code, body) || code != 200)
+			{
+				logResult(TEST_NAME, false, "First /api/stats request failed");
+				return;
+			}
+			long hitsBefore = parseCounter(body, "hits");
+			long missesBefore = parseCounter(body, "misses");
+
+			// Two reads in a row: the second one finds the fragment serialised already,
+			// unless new data for sensor 1 arrived in between.
+			httpGet("/api/measurements/1", code, unused);
+			httpGet("/api/measurements/1", code, unused);
+
+			if (!httpGet("/api/stats", code, body) || code != 200)
+			{
+				logResult(TEST_NAME, false, "Second /api/stats request failed");
+				return;
+			}
+			long hits = parseCounter(body, "hits") - hitsBefore;
+			long misses = parseCounter(body, "misses") - missesBefore;
+
+			char msg[96];
+			snprintf(msg, sizeof(msg), "2 reads -> %ld hits, %ld misses", hits, misses);
+			logResult(TEST_NAME, hitsBefore >= 0 && missesBefore >= 0 && hits >= 1 && hits + misses == 2, msg);
+		}
+
+		void testApiLayout()
+		{
+			const char* TEST_NAME = "GET /api/layout";
+			int code = 0, codeAll = 0;
+			String body, bodyAll;
+
+			if (!httpGet("/api/layout", code, body) || !httpGet("/api/allmeasurements", codeAll, bodyAll))
+			{
+				logResult(TEST_NAME, false, "HTTP request failed");
+				return;
+			}
+
+			if (code != 200)
+			{
+				char msg[64];
+				snprintf(msg, sizeof(msg), "Expected HTTP 200, got %d", code);
+				logResult(TEST_NAME, false, msg);
+				return;
+			}
+
+			// The grid page fetches the layout again when /api/allmeasurements reports another one.
+			long layout = parseCounter(body, "layout");
+			bool hasColumns = parseCounter(body, "columns") > 0;
+			bool hasSensor1 = body.indexOf("{\"id\":1,\"name\":\"Sensor 1\"") >= 0;
+			bool hasFields = body.indexOf("\"unit\"") >= 0 && body.indexOf("\"position\"") >= 0 &&
+							 body.indexOf("\"count\"") >= 0 && body.indexOf("\"width\"") >= 0;
+			bool sameLayout = layout >= 0 && parseCounter(bodyAll, "layout") == layout;
+
+			if (hasColumns && hasSensor1 && hasFields && sameLayout)
+			{
+				char msg[96];
+				snprintf(msg, sizeof(msg), "Layout %ld OK: columns, sensor 1, unit/position/count/width, as in allmeasurements", layout);
+				logResult(TEST_NAME, true, msg);
+			}
+			else
+			{
+				char msg[128];
+				snprintf(msg, sizeof(msg), "Missing: %s%s%s%s",
+					hasColumns ? "" : "columns ",
+					hasSensor1 ? "" : "sensor1 ",
+					hasFields ? "" : "fields ",
+					sameLayout ? "" : "same-layout ");
+				logResult(TEST_NAME, false, msg);
+			}
+		}
+
 		void testNotFound()
 		{
 			const char* TEST_NAME = "GET /nonexistent (404)";
@@ -472,7 +681,11 @@ namespace crt
 			testGridPage();
 			testApiSensorsStructure();
 			testApiMeasurements();
+			testApiMeasurementsUnknownId();
 			testApiAllMeasurements();
+			testApiAllMeasurementsDelta();
+			testApiStatsCacheHits();
+			testApiLayout();
 			testSensorDataPresent();
 			testSensorValuesUpdating();
 			testDownloadButton();
@@ -0,0 +1,16 @@
+// by Marius Versteegen, 2025
+
+// Runs one of the sensorgrid tests on a Linux host. The tests do all their work
+// in setup(); their loop() only waits, so it is not run here.
+//
+// The .ino of the test is chosen by CMakeLists.txt, via SENSORGRID_HOST_INO.
+// Usage: <test>
+
+#include SENSORGRID_HOST_INO
+
+int main()
+{
+	setup();
+	fflush(stdout);
+	return 0;
+}
@@ -0,0 +1,54 @@
+// by Marius Versteegen, 2025
+// The part of Arduino.h (arduino-esp32) that the sensorgrid tests use, for a
+// Linux host: micros(), millis(), delay(), ESP_LOGx and String.
+// The rest of the Arduino API is left out on purpose: a test that needs more
+// than this is not a host test.
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <thread>
+
+inline unsigned long micros()
+{
+	static const auto startTime = std::chrono::steady_clock::now();
+	return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+inline unsigned long millis()
+{
+	return micros() / 1000;
+}
+
+inline void delay(unsigned long ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// Without the timestamps and colours of the ESP-IDF log.
+#define ESP_LOGE(tag, format, ...) printf("E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) printf("W %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) printf("I %s: " format "\n", tag, ##__VA_ARGS__)
+
+// Arduino's String, as far as the tests use it.
+class String : public std::string
+{
+public:
+	String() {}
+	String(const char* text) : std::string(text) {}
+	String(const std::string& text) : std::string(text) {}
+	String(int value) : std::string(std::to_string(value)) {}
+	String(unsigned int value) : std::string(std::to_string(value)) {}
+	String(long value) : std::string(std::to_string(value)) {}
+	String(unsigned long value) : std::string(std::to_string(value)) {}
+	String(unsigned char value) : std::string(std::to_string(value)) {}
+
+	unsigned int length() const { return (unsigned int)size(); }
+
+	friend String operator+(const String& a, const String& b) { return String((const std::string&)a + (const std::string&)b); }
+	friend String operator+(const char* a, const String& b) { return String(a + (const std::string&)b); }
+	friend String operator+(const String& a, const char* b) { return String((const std::string&)a + b); }
+};
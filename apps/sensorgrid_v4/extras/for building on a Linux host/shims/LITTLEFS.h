@@ -0,0 +1,24 @@
+// by Marius Versteegen, 2025
+// LITTLEFS (lorol/LITTLEFS) for a Linux host. The tests reach the files
+// through stdio under LITTLEFS_ROOT, like the server does on the ESP32, so
+// "mounting" only has to make sure that LITTLEFS_ROOT exists.
+// CMakeLists.txt sets LITTLEFS_ROOT to a directory in the build folder.
+
+#pragma once
+#include <sys/stat.h>
+
+#ifndef LITTLEFS_ROOT
+#define LITTLEFS_ROOT "/littlefs"
+#endif
+
+class LittleFsHost
+{
+public:
+	bool begin(bool formatOnFail = false)
+	{
+		struct stat st;
+		return stat(LITTLEFS_ROOT, &st) == 0 || mkdir(LITTLEFS_ROOT, 0755) == 0;
+	}
+};
+
+static LittleFsHost LITTLEFS;
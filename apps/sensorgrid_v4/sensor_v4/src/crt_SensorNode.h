@@ -5,27 +5,93 @@
 #include <WiFi.h>
 #include <esp_now.h>
 #include <esp_wifi.h>
+#include <esp_sleep.h>
 #include <crt_SensorGridPacket.h>
+#include <crt_SensorCapabilities.h>
+#include <crt_PacketCodec.h>
+#include <crt_PacketView.h>
+#include <crt_RelayRouting.h>
+#include <crt_FragmentReassembler.h>
 
 namespace crt
 {
-	class SensorNode
+	// SAMPLE_COUNT samples of type Sample (uint8_t, uint16_t or uint32_t) are sent per POLL.
+	// The server allocates storage for them when the sensor registers, so sensors
+	// with different sample counts can share one grid.
+	template<uint16_t SAMPLE_COUNT = MEASUREMENT_COUNT, typename Sample = uint16_t> class SensorNode
 	{
 	private:
+		static_assert(sizeof(Sample) == 1 || sizeof(Sample) == 2 || sizeof(Sample) == 4, "Sample must be 1, 2 or 4 bytes");
+		static_assert(Sample(-1) > Sample(0), "Sample must be unsigned");
+
+		static const uint32_t FRAME_BYTES = (uint32_t)SAMPLE_COUNT * sizeof(Sample);
+		static const uint8_t MAX_FRAGMENT = DATA_PAYLOAD_MAX_SIZE;
+		static const uint16_t TOTAL_PACKETS = (FRAME_BYTES + MAX_FRAGMENT - 1) / MAX_FRAGMENT;
+		static_assert(TOTAL_PACKETS <= MAX_PACKETS_PER_REPLY, "reply does not fit in 255 DataPackets");
+
+		// Large replies are sent from update(), a few DataPackets at a time,
+		// such that they do not overflow the ESP-NOW transmit queue.
+		static const uint8_t MAX_PACKETS_IN_FLIGHT = 4;
+
+		// Duty cycling: after a reply, the sensor sleeps until WAKE_AHEAD_MS plus a
+		// measurement before the window the POLL announced, takes the measurement, and
+		// listens for the POLL. Sleeps shorter than MIN_SLEEP_MS are not worth it.
+		static const unsigned long SAMPLE_DURATION_MS = 20;
+		static const unsigned long WAKE_AHEAD_MS = 5;
+		static const unsigned long MIN_SLEEP_MS = 10;
+		static const unsigned long MAX_SEND_WAIT_MS = 20;	// for the send callbacks of a reply, before sleeping
+		static const unsigned long DUTY_TRACE_INTERVAL_MS = 10000;
+
 		uint8_t sensorId;
-		int channel;
+		int channel;			// the server's AP channel, where the sensor registers
+		uint8_t currentChannel;	// differs from channel after the server moved the sensor
+		bool relayEnabled;
+		bool dutyCycleEnabled;
 		unsigned long sampleIntervalMs;
 		unsigned long lastSampleMs;
 		uint16_t counter;
 
 		// Double-buffered measurements: update() writes to one buffer,
 		// handlePoll() reads from the other. No race condition.
-		uint16_t measurements[2][MEASUREMENT_COUNT];
+		Sample measurements[2][SAMPLE_COUNT];
 		volatile uint8_t readyIndex;
 
+		// POLL reply. pollReceived and pollMac/pollFlags are set by the ESP-NOW callback;
+		// the rest belongs to update(). In flight = packetsSent - packetsConfirmed.
+		volatile bool pollReceived;
+		uint8_t pollMac[6];
+		uint8_t pollFlags;
+		uint16_t pollNextPollMs;
+		uint8_t pollChannel;
+		unsigned long pollReceivedMs;
+		volatile bool sendingReply;
+		uint8_t replyIndex;	// measurements buffer being sent; not sampled into meanwhile
+		uint16_t nextPacket;
+		uint16_t packetsSent;
+		volatile uint16_t packetsConfirmed;
+
+		// Parent selection and child routes. Written by the ESP-NOW receive callback
+		// and by update() (parent timeout), hence guarded by routingMux.
+		RelayRouting routing;
+		portMUX_TYPE routingMux = portMUX_INITIALIZER_UNLOCKED;
+
+		// Channel switch after a reply, once its DataPackets are out.
+		bool hopPending;
+		unsigned long hopPendingSinceMs;
+
+		// Duty cycling. The trace is logged every DUTY_TRACE_INTERVAL_MS, to compare
+		// with the DutyCycleSimulation.
+		bool sleepPending;
+		unsigned long sleepPendingSinceMs;
+		unsigned long wakeAtMs;
+		unsigned long traceStartMs;
+		unsigned long traceSleptMs;
+		uint32_t traceSleeps;
+		uint32_t tracePolls;
+
 		static SensorNode* instance;
-		static bool serverPeerAdded;
-		static uint8_t serverMac[6];
+
+		static constexpr uint8_t BROADCAST_ADDRESS[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
 		static void onDataRecv(const esp_now_recv_info_t* info,
 							   const uint8_t* incomingData, int len)
@@ -36,17 +102,43 @@ namespace crt
 			switch (msgType)
 			{
 				case MessageType::DISCOVER:
-					instance->handleDiscover(info->src_addr);
+				{
+					DiscoverPacketView pkt(incomingData, len);
+					if (pkt.isValid())
+					{
+						instance->handleDiscover(info->src_addr, pkt, info->rx_ctrl->rssi);
+					}
+					break;
+				}
+				case MessageType::REGISTER:
+				{
+					RegisterPacketView pkt(incomingData, len);
+					if (pkt.isValid() && instance->relayEnabled && pkt.getSensorId() != instance->sensorId)
+					{
+						instance->relayRegister(info->src_addr, pkt);
+					}
 					break;
+				}
 				case MessageType::POLL:
-					if (len >= (int)sizeof(PollPacket))
+				{
+					PollPacketView pkt(incomingData, len);
+					if (!pkt.isValid()) break;
+					if (pkt.getSensorId() == instance->sensorId)
+					{
+						instance->handlePoll(info->src_addr, pkt.getFlags(), pkt.getNextPollMs(), pkt.getChannel());
+					}
+					else if (instance->relayEnabled)
 					{
-						PollPacket pkt;
-						memcpy(&pkt, incomingData, sizeof(pkt));
-						if (pkt.sensorId == instance->sensorId)
-						{
-							instance->handlePoll(info->src_addr);
-						}
+						instance->relayPoll(info->src_addr, pkt);
+					}
+					break;
+				}
+				case MessageType::DATA:
+				case MessageType::DATA_PARITY:
+					// DATA of our own id never arrives here; anything else is a child's.
+					if (len >= 2 && instance->relayEnabled && incomingData[1] != instance->sensorId)
+					{
+						instance->relayData(incomingData, len);
 					}
 					break;
 				default:
@@ -60,74 +152,306 @@ namespace crt
 			{
 				ESP_LOGW("SensorNode", "Send failed");
 			}
+			// Also counts the last packets of a reply after it was handed over, so that
+			// the sensor does not go to sleep before they are out.
+			if (instance != nullptr && instance->packetsConfirmed != instance->packetsSent)
+			{
+				instance->packetsConfirmed = instance->packetsConfirmed + 1;
+			}
 		}
 
-		void ensureServerPeer(const uint8_t* mac)
+		void ensurePeer(const uint8_t* mac)
 		{
-			if (!serverPeerAdded)
+			if (!esp_now_is_peer_exist(mac))
 			{
 				esp_now_peer_info_t peer = {};
 				memcpy(peer.peer_addr, mac, 6);
-				peer.channel = channel;
+				peer.channel = 0; // the current one, which the server may change
 				peer.encrypt = false;
 				if (esp_now_add_peer(&peer) == ESP_OK)
 				{
-					memcpy(serverMac, mac, 6);
-					serverPeerAdded = true;
-					ESP_LOGI("SensorNode", "Added server peer %02X:%02X:%02X:%02X:%02X:%02X",
+					ESP_LOGI("SensorNode", "Added peer %02X:%02X:%02X:%02X:%02X:%02X",
 						mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 				}
 			}
 		}
 
-		void handleDiscover(const uint8_t* mac)
+		// Copies the parent mac out of the routing table. Returns false if there is no parent.
+		bool getParent(uint8_t* parentMac, uint8_t& hopCount)
+		{
+			portENTER_CRITICAL(&routingMux);
+			bool hasParent = routing.hasParent();
+			memcpy(parentMac, routing.getParentMac(), 6);
+			hopCount = routing.getHopCount();
+			portEXIT_CRITICAL(&routingMux);
+			return hasParent;
+		}
+
+		void handleDiscover(const uint8_t* mac, const DiscoverPacketView& pkt, int8_t rssi)
 		{
+			bool parentChanged = false;
+			portENTER_CRITICAL(&routingMux);
+			bool rebroadcast = routing.onDiscover(mac, pkt.getHopCount(), pkt.getPathCost(), pkt.getSequence(),
+												  rssi, millis(), parentChanged);
+			bool fromParent = routing.hasParent() && memcmp(mac, routing.getParentMac(), 6) == 0;
+			uint8_t hopCount = routing.getHopCount();
+			uint8_t pathCost = routing.getPathCost();
+			portEXIT_CRITICAL(&routingMux);
+
+			if (!fromParent) return;
+
+			if (parentChanged)
+			{
+				ESP_LOGI("SensorNode", "New parent %02X:%02X:%02X:%02X:%02X:%02X, hop %u, cost %u",
+						 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], hopCount, pathCost);
+			}
+
 			ESP_LOGI("SensorNode", "Received DISCOVER, sending REGISTER id=%u", sensorId);
-			ensureServerPeer(mac);
+			ensurePeer(mac);
 
 			RegisterPacket reg;
 			reg.messageType = MessageType::REGISTER;
 			reg.sensorId = sensorId;
-			esp_now_send(mac, (uint8_t*)&reg, sizeof(reg));
+			reg.hopCount = hopCount;
+			reg.features = getFeatures();
+			reg.capabilities = makeCapabilities(SAMPLE_COUNT, sizeof(Sample), MAX_FRAGMENT);
+			uint8_t frame[RegisterCodec::MAX_SIZE];
+			esp_now_send(mac, frame, RegisterCodec::encode(reg, frame));
+
+			if (relayEnabled && rebroadcast)
+			{
+				DiscoverPacket disc;
+				disc.messageType = MessageType::DISCOVER;
+				disc.sequence = pkt.getSequence();
+				disc.hopCount = hopCount;
+				disc.pathCost = pathCost;
+				uint8_t discFrame[DiscoverCodec::MAX_SIZE];
+				esp_now_send(BROADCAST_ADDRESS, discFrame, DiscoverCodec::encode(disc, discFrame));
+			}
+		}
+
+		// --- Relay role: forward frames of children ---
+
+		void relayRegister(const uint8_t* childMac, const RegisterPacketView& pkt)
+		{
+			uint8_t parentMac[6];
+			uint8_t hopCount;
+			if (!getParent(parentMac, hopCount)) return;
+
+			portENTER_CRITICAL(&routingMux);
+			bool learned = routing.learnRoute(pkt.getSensorId(), childMac);
+			portEXIT_CRITICAL(&routingMux);
+			if (!learned)
+			{
+				ESP_LOGW("SensorNode", "Route table full, cannot relay sensor %u", pkt.getSensorId());
+				return;
+			}
+
+			ensurePeer(childMac);
+			esp_now_send(parentMac, pkt.getFrame(), pkt.getLength());
+			ESP_LOGI("SensorNode", "Relayed REGISTER of sensor %u (hop %u)", pkt.getSensorId(), pkt.getHopCount());
+		}
+
+		void relayPoll(const uint8_t* mac, const PollPacketView& pkt)
+		{
+			uint8_t childMac[6];
+			portENTER_CRITICAL(&routingMux);
+			routing.onParentHeard(mac, millis());
+			const uint8_t* route = routing.findRoute(pkt.getSensorId());
+			if (route != nullptr) memcpy(childMac, route, 6);
+			portEXIT_CRITICAL(&routingMux);
+
+			if (route != nullptr)
+			{
+				esp_now_send(childMac, pkt.getFrame(), pkt.getLength());
+			}
+		}
+
+		void relayData(const uint8_t* data, int len)
+		{
+			uint8_t parentMac[6];
+			uint8_t hopCount;
+			if (getParent(parentMac, hopCount))
+			{
+				esp_now_send(parentMac, data, len);
+			}
+		}
+
+		// Optional protocol features this sensor offers in its REGISTER.
+		// A relay has to stay awake for its children, and on their channel, so it neither
+		// sleeps nor moves to another channel.
+		uint8_t getFeatures() const
+		{
+			return FEATURE_XOR_PARITY |
+				   (relayEnabled ? 0 : FEATURE_CHANNEL_HOP | (dutyCycleEnabled ? FEATURE_DUTY_CYCLE : 0));
+		}
+
+		void tuneTo(uint8_t newChannel)
+		{
+			esp_wifi_set_promiscuous(true);
+			esp_wifi_set_channel(newChannel, WIFI_SECOND_CHAN_NONE);
+			esp_wifi_set_promiscuous(false);
+			currentChannel = newChannel;
+		}
+
+		// ESP-NOW callback context: only records the POLL, update() sends the reply.
+		void handlePoll(const uint8_t* mac, uint8_t flags, uint16_t nextPollMs, uint8_t newChannel)
+		{
+			unsigned long now = millis();
+			portENTER_CRITICAL(&routingMux);
+			routing.onParentHeard(mac, now);
+			portEXIT_CRITICAL(&routingMux);
+
+			if (pollReceived) return; // a re-POLL while still answering the previous one
+			memcpy(pollMac, mac, 6);
+			pollFlags = flags;
+			pollNextPollMs = nextPollMs;
+			pollChannel = newChannel;
+			pollReceivedMs = now;
+			pollReceived = true;
 		}
 
-		void handlePoll(const uint8_t* mac)
+		// Sends (the next DataPackets of) the reply to a received POLL.
+		void updateReply()
 		{
-			ensureServerPeer(mac);
+			if (!sendingReply)
+			{
+				if (!pollReceived) return;
+				ensurePeer(pollMac);
+				replyIndex = readyIndex;
+				nextPacket = 0;
+				packetsSent = 0;
+				packetsConfirmed = 0;
+				sendingReply = true;
+			}
 
-			const uint16_t totalBytes = MEASUREMENT_COUNT * sizeof(uint16_t);
-			const uint8_t maxPerPacket = DATA_PAYLOAD_MAX_SIZE;
-			const uint8_t totalPackets = (totalBytes + maxPerPacket - 1) / maxPerPacket;
-			const uint8_t* src = (const uint8_t*)measurements[readyIndex];
+			const uint8_t* src = (const uint8_t*)measurements[replyIndex];
+			bool withParity = (pollFlags & POLL_FLAG_PARITY) != 0;
+			uint16_t packetsToSend = TOTAL_PACKETS + (withParity ? 1 : 0);
 
-			uint16_t offset = 0;
-			for (uint8_t i = 0; i < totalPackets; i++)
+			while (nextPacket < packetsToSend && (uint16_t)(packetsSent - packetsConfirmed) < MAX_PACKETS_IN_FLIGHT)
 			{
-				uint16_t remaining = totalBytes - offset;
-				uint8_t chunk = (remaining > maxPerPacket) ? maxPerPacket : (uint8_t)remaining;
+				esp_err_t result;
+				if (nextPacket < TOTAL_PACKETS)
+				{
+					uint32_t offset = (uint32_t)nextPacket * MAX_FRAGMENT;
+					uint32_t remaining = FRAME_BYTES - offset;
+					uint8_t chunk = (remaining > MAX_FRAGMENT) ? MAX_FRAGMENT : (uint8_t)remaining;
+
+					// Header fields only; the samples go straight into the frame.
+					DataPacket header;
+					header.messageType = MessageType::DATA;
+					header.sensorId = sensorId;
+					header.packetIndex = (uint8_t)nextPacket;
+					header.totalPackets = (uint8_t)TOTAL_PACKETS;
+					header.payloadSize = chunk;
+
+					uint8_t frame[DataCodec::MAX_SIZE];
+					DataCodec::encodeHeader(header, frame);
+					memcpy(frame + DataCodec::HEADER_SIZE, src + offset, chunk);
+					result = esp_now_send(pollMac, frame, DataCodec::HEADER_SIZE + chunk);
+				}
+				else
+				{
+					// Lets the server rebuild one lost DataPacket without polling again.
+					DataParityPacket parity;
+					buildParityPacket(sensorId, src, FRAME_BYTES, MAX_FRAGMENT, parity);
+					uint8_t frame[DataParityCodec::MAX_SIZE];
+					result = esp_now_send(pollMac, frame, DataParityCodec::encode(parity, frame));
+				}
+				if (result != ESP_OK) break; // transmit queue full: try again on the next update()
+				packetsSent++;
+				nextPacket++;
+			}
 
-				DataPacket data = {};
-				data.messageType = MessageType::DATA;
-				data.sensorId = sensorId;
-				data.packetIndex = i;
-				data.totalPackets = totalPackets;
-				data.payloadSize = chunk;
-				memcpy(data.payload, src + offset, chunk);
+			if (nextPacket == packetsToSend)
+			{
+				sendingReply = false;
+				pollReceived = false;
+				tracePolls++;
+				ESP_LOGI("SensorNode", "Received POLL, sent %u pkt(s)%s id=%u val=%lu (%u measurements)",
+						 TOTAL_PACKETS, withParity ? " + parity" : "",
+						 sensorId, (unsigned long)measurements[replyIndex][0], SAMPLE_COUNT);
 
-				size_t sendSize = sizeof(DataPacket) - DATA_PAYLOAD_MAX_SIZE + chunk;
-				esp_now_send(mac, (uint8_t*)&data, sendSize);
-				offset += chunk;
+				if ((getFeatures() & FEATURE_CHANNEL_HOP) && pollChannel != 0 && pollChannel != currentChannel)
+				{
+					hopPending = true;
+					hopPendingSinceMs = millis();
+				}
+				if ((getFeatures() & FEATURE_DUTY_CYCLE) && pollNextPollMs != 0)
+				{
+					sleepPending = true;
+					sleepPendingSinceMs = millis();
+					wakeAtMs = pollReceivedMs + pollNextPollMs - WAKE_AHEAD_MS - SAMPLE_DURATION_MS;
+				}
 			}
+		}
+
+		// Moves to the channel the POLL asked for, once the reply is out. The server
+		// expects it there from the next POLL on.
+		void updateHop()
+		{
+			if (!hopPending) return;
+			if (packetsConfirmed != packetsSent && millis() - hopPendingSinceMs < MAX_SEND_WAIT_MS) return;
+			hopPending = false;
+			ESP_LOGI("SensorNode", "Moving from channel %u to %u", currentChannel, pollChannel);
+			tuneTo(pollChannel);
+		}
+
+		// Sleeps until wakeAtMs once the reply is out. The radio is powered down
+		// meanwhile; ESP-NOW (peers included) is usable again after the wake-up,
+		// and millis() keeps counting.
+		void updateSleep()
+		{
+			if (!sleepPending) return;
+			unsigned long now = millis();
+			if (packetsConfirmed != packetsSent && now - sleepPendingSinceMs < MAX_SEND_WAIT_MS) return;
+			sleepPending = false;
+
+			long sleepMs = (long)(wakeAtMs - now);
+			if (sleepMs < (long)MIN_SLEEP_MS) return;
+			esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000);
+			esp_light_sleep_start();
+			traceSleptMs += millis() - now;
+			traceSleeps++;
+
+			// Measure right away, such that the reply in the coming window is fresh.
+			lastSampleMs = millis() - sampleIntervalMs;
+		}
 
-			ESP_LOGI("SensorNode", "Received POLL, sent %u pkt(s) id=%u val=%u (%u measurements)",
-					 totalPackets, sensorId, measurements[readyIndex][0], MEASUREMENT_COUNT);
+		// The millis() trace of duty cycling: how much of the time the sensor was awake.
+		void updateTrace(unsigned long now)
+		{
+			if (now - traceStartMs < DUTY_TRACE_INTERVAL_MS) return;
+			unsigned long elapsedMs = now - traceStartMs;
+			unsigned long awakeMs = elapsedMs - traceSleptMs;
+			if (getFeatures() & FEATURE_DUTY_CYCLE)
+			{
+				ESP_LOGI("SensorNode", "Duty cycle: awake %lu of %lu ms (%lu.%lu%%), %lu polls, %lu sleeps, awake per poll %lu ms",
+						 awakeMs, elapsedMs, awakeMs * 100 / elapsedMs, (awakeMs * 1000 / elapsedMs) % 10,
+						 (unsigned long)tracePolls, (unsigned long)traceSleeps,
+						 tracePolls > 0 ? awakeMs / tracePolls : awakeMs);
+			}
+			traceStartMs = now;
+			traceSleptMs = 0;
+			traceSleeps = 0;
+			tracePolls = 0;
 		}
 
 	public:
-		SensorNode(uint8_t sensorId, int channel, unsigned long sampleIntervalMs)
-			: sensorId(sensorId), channel(channel),
+		// With relayEnabled, the node also forwards DISCOVER, REGISTER, POLL and DATA
+		// frames for sensors that are out of the server's range.
+		// With dutyCycleEnabled (and not relayEnabled), it sleeps between the poll windows
+		// that a server with a poll cycle announces, and measures once per window.
+		SensorNode(uint8_t sensorId, int channel, unsigned long sampleIntervalMs, bool relayEnabled = false,
+				   bool dutyCycleEnabled = false)
+			: sensorId(sensorId), channel(channel), currentChannel((uint8_t)channel), relayEnabled(relayEnabled), dutyCycleEnabled(dutyCycleEnabled),
 			  sampleIntervalMs(sampleIntervalMs),
-			  lastSampleMs(0), counter(0), readyIndex(0)
+			  lastSampleMs(0), counter(0), readyIndex(0),
+			  pollReceived(false), pollFlags(0), pollNextPollMs(0), pollChannel(0), pollReceivedMs(0), sendingReply(false), replyIndex(0),
+			  nextPacket(0), packetsSent(0), packetsConfirmed(0),
+			  hopPending(false), hopPendingSinceMs(0), sleepPending(false), sleepPendingSinceMs(0), wakeAtMs(0),
+			  traceStartMs(0), traceSleptMs(0), traceSleeps(0), tracePolls(0)
 		{
 			memset(measurements, 0, sizeof(measurements));
 			instance = this;
@@ -135,16 +459,14 @@ namespace crt
 
 		void init()
 		{
-			ESP_LOGI("SensorNode", "Sensor node v4 starting, id=%u, channel=%d",
-					 sensorId, channel);
+			ESP_LOGI("SensorNode", "Sensor node v4 starting, id=%u, channel=%d, %u samples of %u bytes",
+					 sensorId, channel, SAMPLE_COUNT, (unsigned)sizeof(Sample));
 
 			neopixelWrite(RGB_BUILTIN, 0, 0, 0);
 
 			WiFi.mode(WIFI_STA);
 
-			esp_wifi_set_promiscuous(true);
-			esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
-			esp_wifi_set_promiscuous(false);
+			tuneTo((uint8_t)channel);
 
 			if (esp_now_init() != ESP_OK)
 			{
@@ -154,14 +476,49 @@ namespace crt
 			esp_now_register_recv_cb(onDataRecv);
 			esp_now_register_send_cb(onDataSent);
 
-			ESP_LOGI("SensorNode", "ESP-NOW ready, STA MAC: %s",
-					 WiFi.macAddress().c_str());
+			if (relayEnabled)
+			{
+				// Needed to re-broadcast DISCOVER
+				ensurePeer(BROADCAST_ADDRESS);
+			}
+
+			if (dutyCycleEnabled && relayEnabled)
+			{
+				ESP_LOGW("SensorNode", "A relay stays awake: duty cycling disabled");
+			}
+			ESP_LOGI("SensorNode", "ESP-NOW ready, STA MAC: %s%s, wire format %08lX",
+					 WiFi.macAddress().c_str(),
+					 relayEnabled ? " (relay)" : ((getFeatures() & FEATURE_DUTY_CYCLE) ? " (duty cycled)" : ""),
+					 (unsigned long)WIRE_FORMAT_TAG);
+			traceStartMs = millis();
 		}
 
 		void update()
 		{
 			unsigned long now = millis();
-			if (now - lastSampleMs >= sampleIntervalMs)
+
+			portENTER_CRITICAL(&routingMux);
+			bool parentLost = routing.checkParentTimeout(now);
+			portEXIT_CRITICAL(&routingMux);
+			if (parentLost)
+			{
+				ESP_LOGW("SensorNode", "Parent lost, waiting for DISCOVER");
+				if (currentChannel != channel)
+				{
+					// The server stopped visiting this channel: register again on the AP channel.
+					hopPending = false;
+					tuneTo((uint8_t)channel);
+				}
+			}
+
+			updateReply();
+			updateHop();
+			updateSleep();
+			now = millis(); // possibly after a sleep
+			updateTrace(now);
+
+			// The buffer of a reply that is still being sent must not be written.
+			if (!sendingReply && !sleepPending && now - lastSampleMs >= sampleIntervalMs)
 			{
 				lastSampleMs = now;
 
@@ -169,13 +526,13 @@ namespace crt
 				uint8_t writeIdx = 1 - readyIndex;
 
 				// Simulate 20ms I2C measurement processing time
-				delay(20);
+				delay(SAMPLE_DURATION_MS);
 
 				counter += 10 * sensorId;
-				measurements[writeIdx][0] = counter % 1024;
-				for (uint8_t i = 1; i < MEASUREMENT_COUNT; i++)
+				measurements[writeIdx][0] = (Sample)(counter % 1024);
+				for (uint16_t i = 1; i < SAMPLE_COUNT; i++)
 				{
-					measurements[writeIdx][i] = (counter + i) % 1024;
+					measurements[writeIdx][i] = (Sample)((counter + i) % 1024);
 				}
 
 				// Atomic swap: single byte write = atomic on ESP32-S3
@@ -184,8 +541,9 @@ namespace crt
 		}
 	}; // end class SensorNode
 
-	SensorNode* SensorNode::instance = nullptr;
-	bool SensorNode::serverPeerAdded = false;
-	uint8_t SensorNode::serverMac[6] = {};
+	template<uint16_t SAMPLE_COUNT, typename Sample>
+	SensorNode<SAMPLE_COUNT, Sample>* SensorNode<SAMPLE_COUNT, Sample>::instance = nullptr;
+	template<uint16_t SAMPLE_COUNT, typename Sample>
+	constexpr uint8_t SensorNode<SAMPLE_COUNT, Sample>::BROADCAST_ADDRESS[6];
 
 } // end namespace crt
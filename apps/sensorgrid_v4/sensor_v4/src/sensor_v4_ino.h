@@ -11,9 +11,21 @@ static const uint8_t SENSOR_ID = 1;
 static const int FIXED_CHANNEL = 1;
 static const unsigned long SAMPLE_INTERVAL_MS = 100;
 
+// Set to true on sensors that should forward the traffic of sensors
+// which are out of the server's range.
+static const bool RELAY_ENABLED = false;
+
+// Set to true on battery-powered sensors: between the poll windows that the server
+// announces (POLL_CYCLE_MS in server_v4_ino.h), the sensor sleeps. Not on relays.
+static const bool DUTY_CYCLE_ENABLED = false;
+
+// Samples sent per POLL, e.g. 16, 64 or 2048. The server sizes its storage
+// for this sensor when it registers, so sensors may differ in this respect.
+static const uint16_t SAMPLE_COUNT = crt::MEASUREMENT_COUNT;
+
 namespace crt
 {
-	SensorNode sensorNode(SENSOR_ID, FIXED_CHANNEL, SAMPLE_INTERVAL_MS);
+	SensorNode<SAMPLE_COUNT, uint16_t> sensorNode(SENSOR_ID, FIXED_CHANNEL, SAMPLE_INTERVAL_MS, RELAY_ENABLED, DUTY_CYCLE_ENABLED);
 }
 
 void setup()
@@ -0,0 +1,6 @@
+// by Marius Versteegen, 2025
+// The ino code has been moved to a header file such that it
+// can be inspected in non-Arduino IDE environments with
+// proper code highlighting and intellisense too.
+
+#include "DutyCycleSimulation_ino.h"
@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_DutyCycleSimulation.h"
+
+namespace crt
+{
+	DutyCycleSimulation dutyCycleSimulation;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== DUTY CYCLE SIMULATION ===");
+	crt::dutyCycleSimulation.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
@@ -0,0 +1,345 @@
+// by Marius Versteegen, 2025
+// DutyCycleSimulation: estimates the energy a sensor spends per reported
+// sample, with and without duty cycling, without any radio.
+// Does not use ESP-NOW, so it can run on any ESP32 (or on a PC, with the
+// ESP_LOGI calls mapped to printf).
+//
+// A server polls 8 sensors (64, 200, 16 and 1024 samples) over a lossy
+// channel for 10 minutes. The server side uses PollSchedule, as ServerNode
+// does; the sensor side follows SensorNode: after its reply it sleeps until
+// WAKE_AHEAD_MS plus a measurement before the window the POLL announced, and
+// then listens until it is polled. A sensor whose POLL got lost stays awake
+// until the next one. Compared:
+//   always on, continuous   the server polls round-robin, sensors never sleep
+//   always on, 1 s cycle    polled once per cycle, sensors never sleep
+//   duty, separate samples  sleeps between windows, but wakes every 100 ms to measure
+//   duty, worst-case slots  windows as long as the server's data timeout
+//   duty                    windows from the measured replies, measures on waking
+//
+// The power model (ESP32-S3, typical values at 3.3 V) is an assumption; the
+// "Duty cycle: awake ..." line that SensorNode logs every 10 s is the trace to
+// check it against on hardware. The simulation prints the line it expects.
+
+#pragma once
+#include <Arduino.h>
+#include <crt_SensorGridPacket.h>
+#include <crt_PacketCodec.h>
+#include <crt_PollSchedule.h>
+
+namespace crt
+{
+	class DutyCycleSimulation
+	{
+	private:
+		static const uint8_t SENSORS = 8;
+		static const uint32_t DURATION_MS = 600000;
+		static const uint32_t CYCLE_MS = 1000;
+
+		// Power model, in mW
+		static constexpr float RX_MW = 330.0f;		// radio on and listening (100 mA)
+		static constexpr float TX_MW = 990.0f;		// transmitting at 20 dBm (300 mA)
+		static constexpr float CPU_MW = 132.0f;		// radio off, CPU running (40 mA)
+		static constexpr float SLEEP_MW = 0.8f;		// light sleep (240 uA)
+		static const uint32_t RADIO_WAKE_US = 2000;	// leaving light sleep with the radio, at RX_MW
+		static const uint32_t CPU_WAKE_US = 500;	// leaving light sleep without the radio, at CPU_MW
+		static constexpr float BATTERY_MWH = 7400.0f;	// 2000 mAh at 3.7 V
+
+		// The channel
+		static const uint16_t LOSS_PER_MILLE = 10;	// per frame
+		static const uint32_t PROCESSING_US = 300;	// per frame: receive callback to esp_now_send
+		static const uint32_t BACKOFF_MAX_US = 500;	// random channel access delay per frame
+		static const uint16_t BUSY_PER_MILLE = 10;	// frames delayed by a busy channel
+		static const uint32_t BUSY_US = 5000;
+		static const uint32_t SERVER_LOOP_MAX_US = 2000;	// until ServerNode::update() notices a reply
+
+		// As in ServerNode and SensorNode
+		static const uint32_t DATA_TIMEOUT_MS = 200;
+		static const uint32_t DATA_TIMEOUT_PER_PACKET_MS = 4;
+		static const uint8_t MAX_POLL_RETRIES = 5;
+		static const uint32_t SAMPLE_DURATION_MS = 20;
+		static const uint32_t SAMPLE_INTERVAL_MS = 100;
+		static const uint32_t WAKE_AHEAD_MS = 5;
+		static const uint32_t MIN_SLEEP_MS = 10;
+		static const uint32_t TRACE_INTERVAL_MS = 10000;
+
+		enum class Mode : uint8_t
+		{
+			ALWAYS_ON_CONTINUOUS,
+			ALWAYS_ON_CYCLE,
+			DUTY_SEPARATE_SAMPLES,
+			DUTY_WORST_CASE_SLOTS,
+			DUTY
+		};
+
+		struct Sensor
+		{
+			uint8_t id;
+			uint16_t sampleCount;
+			uint8_t sampleWidth;
+
+			bool sleeping;
+			uint64_t awakeSinceUs;	// when awake
+			uint64_t sleepSinceUs;	// when sleeping
+			uint64_t wakeAtUs;		// when sleeping
+
+			uint64_t awakeUs;		// radio on
+			uint64_t txUs;			// of which transmitting
+			uint64_t sleepUs;
+			uint64_t cpuUs;			// measurements with the radio off
+			uint32_t wakes;
+			uint32_t polls;			// POLLs received
+			uint32_t replies;		// complete replies at the server
+			uint64_t waitUs;		// from the window to the POLL
+			uint64_t maxWaitUs;
+		};
+
+		typedef PollSchedule<SENSORS> Schedule;
+
+		Sensor sensors[SENSORS];
+		uint32_t randomState;
+		uint32_t timeouts;
+
+		uint32_t random32()
+		{
+			randomState ^= randomState << 13;
+			randomState ^= randomState >> 17;
+			randomState ^= randomState << 5;
+			return randomState;
+		}
+
+		bool chance(uint16_t perMille)
+		{
+			return random32() % 1000 < perMille;
+		}
+
+		// As in RelaySimulation: 1 Mbps, long preamble, 43 bytes of overhead, plus the ACK.
+		static uint32_t frameAirtimeUs(uint32_t payloadBytes)
+		{
+			return 192 + (43 + payloadBytes) * 8 + 304;
+		}
+
+		static uint32_t frameBytesOf(const Sensor& s)
+		{
+			return (uint32_t)s.sampleCount * s.sampleWidth;
+		}
+
+		static uint16_t packetsOf(const Sensor& s)
+		{
+			return (uint16_t)((frameBytesOf(s) + DATA_PAYLOAD_MAX_SIZE - 1) / DATA_PAYLOAD_MAX_SIZE);
+		}
+
+		static uint32_t dataTimeoutMs(const Sensor& s)
+		{
+			return DATA_TIMEOUT_MS + packetsOf(s) * DATA_TIMEOUT_PER_PACKET_MS;
+		}
+
+		static bool isDuty(Mode mode)
+		{
+			return mode == Mode::DUTY_SEPARATE_SAMPLES || mode == Mode::DUTY_WORST_CASE_SLOTS || mode == Mode::DUTY;
+		}
+
+		void reset()
+		{
+			static const uint16_t COUNTS[SENSORS] = {64, 64, 64, 64, 64, 200, 16, 1024};
+			static const uint8_t WIDTHS[SENSORS] = {2, 2, 2, 2, 2, 1, 4, 2};
+			for (uint8_t i = 0; i < SENSORS; i++)
+			{
+				sensors[i] = Sensor{};
+				sensors[i].id = (uint8_t)(i + 1);
+				sensors[i].sampleCount = COUNTS[i];
+				sensors[i].sampleWidth = WIDTHS[i];
+			}
+			randomState = 0x2545F491;
+			timeouts = 0;
+		}
+
+		// Brings the sensor's accounting up to nowUs: it is awake from then on.
+		void wakeUp(Sensor& s, uint64_t nowUs, Mode mode)
+		{
+			if (!s.sleeping) return;
+			uint64_t wakeAtUs = (s.wakeAtUs < nowUs) ? s.wakeAtUs : nowUs;
+			uint64_t sleptUs = wakeAtUs - s.sleepSinceUs;
+			if (mode == Mode::DUTY_SEPARATE_SAMPLES)
+			{
+				// Woken up by the sample timer meanwhile, to measure with the radio off.
+				uint64_t measurements = sleptUs / (SAMPLE_INTERVAL_MS * 1000);
+				uint64_t cpuUs = measurements * (SAMPLE_DURATION_MS * 1000 + CPU_WAKE_US);
+				if (cpuUs > sleptUs) cpuUs = sleptUs;
+				s.cpuUs += cpuUs;
+				sleptUs -= cpuUs;
+			}
+			s.sleepUs += sleptUs;
+			s.awakeUs += RADIO_WAKE_US;
+			s.wakes++;
+			s.sleeping = false;
+			s.awakeSinceUs = wakeAtUs;
+		}
+
+		// After a reply: sleeps until the next window, if there is time for it.
+		void goToSleep(Sensor& s, uint64_t nowUs, uint64_t pollUs, uint16_t nextPollMs, Mode mode)
+		{
+			if (!isDuty(mode) || nextPollMs == 0) return;
+			uint64_t aheadUs = (WAKE_AHEAD_MS + (mode == Mode::DUTY_SEPARATE_SAMPLES ? 0 : SAMPLE_DURATION_MS)) * 1000;
+			uint64_t wakeAtUs = pollUs + (uint64_t)nextPollMs * 1000 - aheadUs;
+			if (wakeAtUs < nowUs + MIN_SLEEP_MS * 1000) return;
+			s.awakeUs += nowUs - s.awakeSinceUs;
+			s.sleeping = true;
+			s.sleepSinceUs = nowUs;
+			s.wakeAtUs = wakeAtUs;
+		}
+
+		// One POLL and its reply, starting at pollUs. Returns when the server is done with it.
+		uint64_t exchange(Schedule& schedule, Sensor& s, uint64_t pollUs, bool scheduled, uint32_t windowMs, Mode mode,
+						  bool& complete)
+		{
+			complete = false;
+			uint32_t timeoutUs = dataTimeoutMs(s) * 1000; // as ServerNode::replyTimeoutMs()
+			if (isDuty(mode) && schedule.getSlotMs(s.id) * 1000 < timeoutUs) timeoutUs = schedule.getSlotMs(s.id) * 1000;
+			if (chance(LOSS_PER_MILLE)) return pollUs + timeoutUs; // POLL lost: the sensor keeps listening
+
+			uint64_t t = pollUs + frameAirtimeUs(PollCodec::HEADER_SIZE);
+			wakeUp(s, t, mode);
+			if (scheduled && t > (uint64_t)windowMs * 1000)
+			{
+				uint64_t waitUs = t - (uint64_t)windowMs * 1000;
+				s.waitUs += waitUs;
+				if (waitUs > s.maxWaitUs) s.maxWaitUs = waitUs;
+			}
+			s.polls++;
+			uint16_t nextPollMs = (mode == Mode::ALWAYS_ON_CONTINUOUS) ? 0 : schedule.nextPollMs(s.id, (uint32_t)(pollUs / 1000));
+
+			uint16_t packets = packetsOf(s);
+			uint32_t frameBytes = frameBytesOf(s);
+			uint8_t lost = 0;
+			for (uint16_t p = 0; p <= packets; p++) // the last one is the parity packet
+			{
+				uint32_t payload = (p + 1 < packets) ? DATA_PAYLOAD_MAX_SIZE
+								 : (p + 1 == packets) ? frameBytes - (uint32_t)(packets - 1) * DATA_PAYLOAD_MAX_SIZE
+								 : (packets > 1 ? DATA_PAYLOAD_MAX_SIZE : frameBytes);
+				uint32_t airtimeUs = frameAirtimeUs(DataCodec::HEADER_SIZE + payload);
+				t += PROCESSING_US + random32() % BACKOFF_MAX_US + (chance(BUSY_PER_MILLE) ? BUSY_US : 0);
+				t += airtimeUs;
+				s.txUs += airtimeUs;
+				if (chance(LOSS_PER_MILLE)) lost++;
+			}
+			goToSleep(s, t, pollUs, nextPollMs, mode);
+
+			// A single lost packet is rebuilt from the parity packet.
+			uint64_t doneUs = t + random32() % SERVER_LOOP_MAX_US;
+			complete = (lost <= 1 && doneUs - pollUs < timeoutUs);
+			if (!complete) return pollUs + timeoutUs;
+			s.replies++;
+			schedule.onReply(s.id, (mode == Mode::DUTY_WORST_CASE_SLOTS) ? timeoutUs : (uint32_t)(doneUs - pollUs));
+			return doneUs;
+		}
+
+		void run(Mode mode, const char* name)
+		{
+			reset();
+			Schedule schedule((mode == Mode::ALWAYS_ON_CONTINUOUS) ? 0 : CYCLE_MS);
+			uint8_t ids[SENSORS];
+			for (uint8_t i = 0; i < SENSORS; i++)
+			{
+				ids[i] = sensors[i].id;
+				uint32_t estimateUs = (mode == Mode::DUTY_WORST_CASE_SLOTS) ? dataTimeoutMs(sensors[i]) * 1000
+									: Schedule::estimateReplyUs(frameBytesOf(sensors[i]), DATA_PAYLOAD_MAX_SIZE, true);
+				schedule.setEstimate(ids[i], estimateUs);
+			}
+
+			uint64_t t = 0;
+			uint64_t burstMsSum = 0;
+			while (t < (uint64_t)DURATION_MS * 1000)
+			{
+				if (schedule.isEnabled()) schedule.beginCycle((uint32_t)(t / 1000), ids, SENSORS);
+				burstMsSum += schedule.getBurstMs();
+				for (uint8_t i = 0; i < SENSORS; i++)
+				{
+					Sensor& s = sensors[i];
+					uint32_t windowMs = 0;
+					bool scheduled = schedule.isEnabled() && schedule.getWindow(s.id, windowMs);
+					if (scheduled && t < (uint64_t)windowMs * 1000) t = (uint64_t)windowMs * 1000;
+
+					// A sensor that stays awake is re-polled at once; a duty-cycled one in its next window.
+					bool complete = false;
+					for (uint8_t attempt = 0; attempt <= MAX_POLL_RETRIES; attempt++)
+					{
+						t = exchange(schedule, s, t, scheduled && attempt == 0, windowMs, mode, complete);
+						if (complete) break;
+						timeouts++;
+						if (!isDuty(mode)) continue;
+						if (mode != Mode::DUTY_WORST_CASE_SLOTS) schedule.onMissedWindow(s.id);
+						break;
+					}
+				}
+			}
+
+			report(mode, name, t, schedule.getNofCycles() > 0 ? (uint32_t)(burstMsSum / schedule.getNofCycles()) : 0);
+		}
+
+		void report(Mode mode, const char* name, uint64_t endUs, uint32_t burstMs)
+		{
+			float energyMj = 0.0f, totalMw = 0.0f;
+			uint64_t samples = 0, awakeUs = 0, polls = 0, replies = 0, waitUs = 0, maxWaitUs = 0;
+			for (uint8_t i = 0; i < SENSORS; i++)
+			{
+				Sensor& s = sensors[i];
+				if (s.sleeping)
+				{
+					s.wakeAtUs = (s.wakeAtUs < endUs) ? s.wakeAtUs : endUs;
+					wakeUp(s, s.wakeAtUs, mode);
+				}
+				s.awakeUs += endUs - s.awakeSinceUs;
+				s.awakeSinceUs = endUs;
+				float mj = (RX_MW * (s.awakeUs - s.txUs) + TX_MW * s.txUs + CPU_MW * s.cpuUs + SLEEP_MW * s.sleepUs) / 1e6f;
+				energyMj += mj;
+				totalMw += mj * 1000.0f / (endUs / 1000.0f);
+				samples += (uint64_t)s.replies * s.sampleCount;
+				awakeUs += s.awakeUs;
+				polls += s.polls;
+				replies += s.replies;
+				waitUs += s.waitUs;
+				if (s.maxWaitUs > maxWaitUs) maxWaitUs = s.maxWaitUs;
+			}
+			float meanMw = totalMw / SENSORS;
+			ESP_LOGI("DutyCycleSimulation", "%-24s | %6.1f mW %6.1f days | %7.1f uJ/sample | awake %5.1f%% %6.1f ms/poll | "
+					 "%5.2f replies/s | late %4.1f ms (max %5.1f) | burst %4lu ms | %lu timeouts",
+					 name, meanMw, BATTERY_MWH / meanMw / 24.0f, energyMj * 1000.0f / samples,
+					 100.0f * awakeUs / (endUs * SENSORS), polls > 0 ? awakeUs / 1000.0f / polls : 0.0f,
+					 replies * 1e6f / endUs / SENSORS, polls > 0 ? waitUs / 1000.0f / polls : 0.0f,
+					 maxWaitUs / 1000.0f, (unsigned long)burstMs, (unsigned long)timeouts);
+
+			if (mode != Mode::DUTY) return;
+			for (uint8_t i = 0; i < SENSORS; i++)
+			{
+				const Sensor& s = sensors[i];
+				float mj = (RX_MW * (s.awakeUs - s.txUs) + TX_MW * s.txUs + CPU_MW * s.cpuUs + SLEEP_MW * s.sleepUs) / 1e6f;
+				float awakeFraction = (float)s.awakeUs / endUs;
+				float pollsPerTrace = (float)s.polls * TRACE_INTERVAL_MS * 1000 / endUs;
+				ESP_LOGI("DutyCycleSimulation", "  sensor %u (%4u x %u bytes): %5.1f mW, %6.1f uJ/sample; expected trace: "
+						 "\"Duty cycle: awake %lu of %lu ms, %.0f polls, awake per poll %.0f ms\"",
+						 s.id, s.sampleCount, s.sampleWidth, mj * 1000.0f / (endUs / 1000.0f),
+						 mj * 1000.0f / ((float)s.replies * s.sampleCount),
+						 (unsigned long)(awakeFraction * TRACE_INTERVAL_MS), (unsigned long)TRACE_INTERVAL_MS,
+						 pollsPerTrace, awakeFraction * TRACE_INTERVAL_MS / pollsPerTrace);
+			}
+		}
+
+	public:
+		DutyCycleSimulation() : randomState(1), timeouts(0)
+		{
+		}
+
+		void run()
+		{
+			ESP_LOGI("DutyCycleSimulation", "8 sensors, %lu s, %u/1000 frames lost, cycle %lu ms; mean per sensor:",
+					 (unsigned long)(DURATION_MS / 1000), LOSS_PER_MILLE, (unsigned long)CYCLE_MS);
+			run(Mode::ALWAYS_ON_CONTINUOUS, "always on, continuous");
+			run(Mode::ALWAYS_ON_CYCLE, "always on, 1 s cycle");
+			run(Mode::DUTY_SEPARATE_SAMPLES, "duty, separate samples");
+			run(Mode::DUTY_WORST_CASE_SLOTS, "duty, worst-case slots");
+			run(Mode::DUTY, "duty");
+			ESP_LOGI("DutyCycleSimulation", "DutyCycleSimulation done");
+		}
+	}; // end class DutyCycleSimulation
+
+} // end namespace crt
@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_RelaySimulation.h"
+
+namespace crt
+{
+	RelaySimulation relaySimulation;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== RELAY SIMULATION ===");
+	crt::relaySimulation.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
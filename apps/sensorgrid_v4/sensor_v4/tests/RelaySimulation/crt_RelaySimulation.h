@@ -0,0 +1,465 @@
+// by Marius Versteegen, 2025
+// RelaySimulation: runs the RelayRouting logic of a number of simulated
+// sensors that are spread out along a building, without any radio.
+// Does not use ESP-NOW, so it can run on any ESP32 (or on a PC, with the
+// ESP_LOGI calls mapped to printf).
+//
+// The simulated frames follow the same rules as SensorNode and ServerNode:
+// DISCOVER flooding via relays, REGISTER forwarding with route learning,
+// POLL forwarding to children and DATA forwarding to parents.
+// Reported:
+//   1) route formation: DISCOVER rounds needed until every sensor is registered,
+//      and the resulting hop count, path cost and parent of each sensor.
+//   2) latency and airtime of a POLL/DATA exchange per hop count.
+//   3) recovery after the loss of a relay: time until every sensor that is
+//      still reachable is polled successfully again.
+
+#pragma once
+#include <Arduino.h>
+#include <math.h>
+#include <crt_SensorGridPacket.h>
+#include <crt_PacketCodec.h>
+#include <crt_RelayRouting.h>
+
+namespace crt
+{
+	class RelaySimulation
+	{
+	private:
+		static const uint8_t NOF_NODES = 8;            // node 0 is the server
+		static const uint8_t SERVER = 0;
+		static const uint8_t BROADCAST = 0xFF;
+		static const uint8_t MAX_FRAMES = 64;
+		static const int8_t MIN_RSSI = -90;            // weaker frames are lost
+
+		// Timing of the server's state machine (see ServerNode)
+		static const unsigned long DISCOVER_INTERVAL_MS = 500;
+		static const unsigned long DATA_TIMEOUT_MS = 200;
+		static const uint8_t MAX_POLL_RETRIES = 5;
+		static const uint16_t PROCESSING_US = 300;     // per hop: receive callback to esp_now_send
+
+		struct Frame
+		{
+			uint8_t from;
+			uint8_t to;
+			MessageType type;
+			uint8_t sensorId;
+			uint8_t hopCount;
+			uint8_t pathCost;
+			uint8_t sequence;
+		};
+
+		struct Node
+		{
+			float x;
+			float y;
+			bool alive;
+			bool relay;
+			RelayRouting routing;
+		};
+
+		struct ServerEntry
+		{
+			bool registered;
+			uint8_t nextHop;
+			uint8_t hopCount;
+			uint8_t failures;
+		};
+
+		Node nodes[NOF_NODES];
+		ServerEntry server[NOF_NODES];
+		Frame frames[MAX_FRAMES];
+		uint8_t frameHead;
+		uint8_t frameTail;
+		uint8_t discoverSequence;
+		unsigned long nowMs;
+		uint32_t airtimeUs;                            // accumulated airtime of all transmissions
+
+		static void macOf(uint8_t node, uint8_t* mac)
+		{
+			const uint8_t base[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x00};
+			memcpy(mac, base, 6);
+			mac[5] = node;
+		}
+
+		static uint8_t nodeOf(const uint8_t* mac)
+		{
+			return mac[5];
+		}
+
+		// Indoor log-distance path loss, including a wall every 10 m.
+		int8_t rssiBetween(uint8_t a, uint8_t b) const
+		{
+			float dx = nodes[a].x - nodes[b].x;
+			float dy = nodes[a].y - nodes[b].y;
+			float d = sqrtf(dx * dx + dy * dy);
+			if (d < 1.0f) d = 1.0f;
+			float rssi = -40.0f - 30.0f * log10f(d) - 3.0f * floorf(fabsf(dx) / 10.0f);
+			return (rssi < -127.0f) ? -127 : (int8_t)rssi;
+		}
+
+		bool canHear(uint8_t from, uint8_t to) const
+		{
+			return nodes[from].alive && nodes[to].alive && rssiBetween(from, to) >= MIN_RSSI;
+		}
+
+		// 1 Mbps with long preamble (ESP-NOW default), 43 bytes of 802.11 action frame
+		// overhead, plus an ACK for unicast frames.
+		static uint32_t frameAirtimeUs(uint8_t payloadBytes, bool unicast)
+		{
+			return 192 + (43 + payloadBytes) * 8 + (unicast ? 304 : 0);
+		}
+
+		static uint8_t payloadSize(MessageType type)
+		{
+			switch (type)
+			{
+				case MessageType::DISCOVER: return DiscoverCodec::HEADER_SIZE;
+				case MessageType::REGISTER: return RegisterCodec::HEADER_SIZE;
+				case MessageType::POLL: return PollCodec::HEADER_SIZE;
+				default: return (uint8_t)(DataCodec::HEADER_SIZE + MEASUREMENT_COUNT * sizeof(uint16_t));
+			}
+		}
+
+		void send(const Frame& frame)
+		{
+			airtimeUs += frameAirtimeUs(payloadSize(frame.type), frame.to != BROADCAST);
+			uint8_t next = (frameTail + 1) % MAX_FRAMES;
+			if (next == frameHead) return; // queue full: frame lost
+			frames[frameTail] = frame;
+			frameTail = next;
+		}
+
+		// --- The sensor side, as in SensorNode ---
+
+		void sensorReceive(uint8_t self, const Frame& frame)
+		{
+			Node& node = nodes[self];
+			uint8_t fromMac[6];
+			macOf(frame.from, fromMac);
+
+			switch (frame.type)
+			{
+				case MessageType::DISCOVER:
+				{
+					bool parentChanged = false;
+					bool rebroadcast = node.routing.onDiscover(fromMac, frame.hopCount, frame.pathCost,
+															   frame.sequence, rssiBetween(frame.from, self),
+															   nowMs, parentChanged);
+					if (!node.routing.hasParent() || nodeOf(node.routing.getParentMac()) != frame.from) break;
+
+					send({self, frame.from, MessageType::REGISTER, self, node.routing.getHopCount(), 0, 0});
+					if (node.relay && rebroadcast)
+					{
+						send({self, BROADCAST, MessageType::DISCOVER, 0,
+							  node.routing.getHopCount(), node.routing.getPathCost(), frame.sequence});
+					}
+					break;
+				}
+				case MessageType::REGISTER:
+					if (node.relay && node.routing.hasParent() && node.routing.learnRoute(frame.sensorId, fromMac))
+					{
+						send({self, nodeOf(node.routing.getParentMac()), MessageType::REGISTER,
+							  frame.sensorId, frame.hopCount, 0, 0});
+					}
+					break;
+				case MessageType::POLL:
+				{
+					node.routing.onParentHeard(fromMac, nowMs);
+					if (frame.sensorId == self)
+					{
+						send({self, frame.from, MessageType::DATA, self, 0, 0, 0});
+					}
+					else if (node.relay)
+					{
+						const uint8_t* route = node.routing.findRoute(frame.sensorId);
+						if (route != nullptr)
+						{
+							send({self, nodeOf(route), MessageType::POLL, frame.sensorId, 0, 0, 0});
+						}
+					}
+					break;
+				}
+				case MessageType::DATA:
+					if (node.relay && frame.sensorId != self && node.routing.hasParent())
+					{
+						send({self, nodeOf(node.routing.getParentMac()), MessageType::DATA, frame.sensorId, 0, 0, 0});
+					}
+					break;
+				default:
+					break; // The simulation only sends the frames above.
+			}
+		}
+
+		// --- The server side, as in ServerNode ---
+
+		bool serverReceive(const Frame& frame)
+		{
+			if (frame.type == MessageType::REGISTER && frame.sensorId < NOF_NODES)
+			{
+				ServerEntry& entry = server[frame.sensorId];
+				entry.registered = true;
+				entry.nextHop = frame.from;
+				entry.hopCount = frame.hopCount;
+				entry.failures = 0;
+			}
+			return frame.type == MessageType::DATA;
+		}
+
+		// Delivers queued frames until the queue is empty. Returns the id of a sensor
+		// whose DATA reached the server, or 0. hops counts the number of transmissions.
+		uint8_t deliverFrames(uint8_t& hops)
+		{
+			uint8_t dataFrom = 0;
+			hops = 0;
+			while (frameHead != frameTail)
+			{
+				Frame frame = frames[frameHead];
+				frameHead = (frameHead + 1) % MAX_FRAMES;
+				hops++;
+
+				for (uint8_t n = 0; n < NOF_NODES; n++)
+				{
+					if (n == frame.from || !canHear(frame.from, n)) continue;
+					if (frame.to != BROADCAST && frame.to != n) continue;
+
+					if (n == SERVER)
+					{
+						if (serverReceive(frame)) dataFrom = frame.sensorId;
+					}
+					else
+					{
+						sensorReceive(n, frame);
+					}
+				}
+			}
+			return dataFrom;
+		}
+
+		void broadcastDiscover()
+		{
+			send({SERVER, BROADCAST, MessageType::DISCOVER, 0, 0, 0, discoverSequence++});
+			uint8_t hops;
+			deliverFrames(hops);
+		}
+
+		uint8_t nofRegistered() const
+		{
+			uint8_t count = 0;
+			for (uint8_t id = 1; id < NOF_NODES; id++)
+			{
+				if (server[id].registered) count++;
+			}
+			return count;
+		}
+
+		// Polls one sensor. Returns true on success; latencyUs is the end-to-end time.
+		bool poll(uint8_t id, uint32_t& latencyUs, uint32_t& pollAirtimeUs, uint8_t& hops)
+		{
+			uint32_t airtimeBefore = airtimeUs;
+			send({SERVER, server[id].nextHop, MessageType::POLL, id, 0, 0, 0});
+			bool ok = (deliverFrames(hops) == id);
+			pollAirtimeUs = airtimeUs - airtimeBefore;
+			latencyUs = pollAirtimeUs + hops * PROCESSING_US;
+			return ok;
+		}
+
+		void updateParentTimeouts()
+		{
+			for (uint8_t n = 1; n < NOF_NODES; n++)
+			{
+				if (nodes[n].alive) nodes[n].routing.checkParentTimeout(nowMs);
+			}
+		}
+
+		// One cycle of the server's POLLING state: every registered sensor is polled once,
+		// unresponsive sensors are retried and finally unregistered; missing sensors
+		// trigger a DISCOVER broadcast.
+		void pollCycle()
+		{
+			for (uint8_t id = 1; id < NOF_NODES; id++)
+			{
+				if (!server[id].registered) continue;
+				uint32_t latencyUs, pollAirtimeUs;
+				uint8_t hops;
+				if (poll(id, latencyUs, pollAirtimeUs, hops))
+				{
+					server[id].failures = 0;
+					nowMs += latencyUs / 1000 + 1;
+				}
+				else
+				{
+					nowMs += DATA_TIMEOUT_MS;
+					if (++server[id].failures > MAX_POLL_RETRIES)
+					{
+						server[id].registered = false;
+					}
+				}
+				updateParentTimeouts();
+			}
+			if (nofRegistered() < NOF_NODES - 1)
+			{
+				broadcastDiscover();
+				nowMs += DISCOVER_INTERVAL_MS / 10;
+			}
+		}
+
+		void reset()
+		{
+			// A corridor of rooms, 0..60 m away from the server. Sensors 6 and 7 are leaves.
+			const float xs[NOF_NODES] = {0, 6, 14, 21, 29, 37, 45, 52};
+			const float ys[NOF_NODES] = {0, 3, -2, 4, 0, -3, 2, -1};
+			for (uint8_t n = 0; n < NOF_NODES; n++)
+			{
+				nodes[n].x = xs[n];
+				nodes[n].y = ys[n];
+				nodes[n].alive = true;
+				nodes[n].relay = (n >= 1 && n <= 5);
+				nodes[n].routing = RelayRouting();
+				server[n] = {false, 0, 0, 0};
+			}
+			frameHead = frameTail = 0;
+			discoverSequence = 0;
+			nowMs = 0;
+			airtimeUs = 0;
+		}
+
+		void logTree()
+		{
+			for (uint8_t id = 1; id < NOF_NODES; id++)
+			{
+				Node& node = nodes[id];
+				ESP_LOGI("RelaySimulation", "  sensor %u: %s, hop %u, cost %u, parent %u, rssi to server %d dBm",
+						 id, !node.alive ? "off       " : (server[id].registered ? "registered" : "missing   "),
+						 node.routing.getHopCount(), node.routing.getPathCost(),
+						 node.routing.hasParent() ? nodeOf(node.routing.getParentMac()) : 0xFF,
+						 rssiBetween(id, SERVER));
+			}
+		}
+
+		void simulateRouteFormation()
+		{
+			ESP_LOGI("RelaySimulation", "--- 1) Route formation ---");
+			reset();
+			uint8_t rounds = 0;
+			while (nofRegistered() < NOF_NODES - 1 && rounds < 20)
+			{
+				broadcastDiscover();
+				nowMs += DISCOVER_INTERVAL_MS;
+				rounds++;
+			}
+			ESP_LOGI("RelaySimulation", "%u/%u sensors registered after %u DISCOVER round(s), airtime %lu us",
+					 nofRegistered(), NOF_NODES - 1, rounds, (unsigned long)airtimeUs);
+			logTree();
+		}
+
+		void simulateLatencyPerHop()
+		{
+			ESP_LOGI("RelaySimulation", "--- 2) POLL/DATA latency and airtime per hop count ---");
+			const uint8_t MAX_HOP_STATS = RelayRouting::MAX_HOPS + 1;
+			uint32_t latencySum[MAX_HOP_STATS] = {};
+			uint32_t airtimeSum[MAX_HOP_STATS] = {};
+			uint16_t count[MAX_HOP_STATS] = {};
+
+			for (uint8_t id = 1; id < NOF_NODES; id++)
+			{
+				uint32_t latencyUs, pollAirtimeUs;
+				uint8_t hops;
+				uint8_t hopCount = server[id].hopCount;
+				if (!server[id].registered || hopCount >= MAX_HOP_STATS) continue;
+				if (poll(id, latencyUs, pollAirtimeUs, hops))
+				{
+					latencySum[hopCount] += latencyUs;
+					airtimeSum[hopCount] += pollAirtimeUs;
+					count[hopCount]++;
+				}
+			}
+
+			uint32_t singleHopAirtime = (count[1] > 0) ? airtimeSum[1] / count[1] : 0;
+			for (uint8_t h = 1; h < MAX_HOP_STATS; h++)
+			{
+				if (count[h] == 0) continue;
+				uint32_t latency = latencySum[h] / count[h];
+				uint32_t airtime = airtimeSum[h] / count[h];
+				uint32_t percentOfSingleHop = singleHopAirtime ? airtime * 100 / singleHopAirtime : 0;
+				ESP_LOGI("RelaySimulation", "  %u hop(s): %u sensor(s), latency %lu us, airtime %lu us (%lu%% of a single hop)",
+						 h, count[h], (unsigned long)latency, (unsigned long)airtime,
+						 (unsigned long)percentOfSingleHop);
+			}
+		}
+
+		void simulateRecovery()
+		{
+			ESP_LOGI("RelaySimulation", "--- 3) Recovery after the loss of a relay ---");
+
+			// Kill the relay that carries the most sensors.
+			uint8_t victim = 0;
+			uint8_t mostChildren = 0;
+			for (uint8_t r = 1; r < NOF_NODES; r++)
+			{
+				uint8_t children = 0;
+				for (uint8_t id = 1; id < NOF_NODES; id++)
+				{
+					if (id != r && nodes[r].routing.findRoute(id) != nullptr) children++;
+				}
+				if (children > mostChildren)
+				{
+					mostChildren = children;
+					victim = r;
+				}
+			}
+			if (victim == 0)
+			{
+				ESP_LOGI("RelaySimulation", "No relay in use, nothing to recover");
+				return;
+			}
+
+			nodes[victim].alive = false;
+			ESP_LOGI("RelaySimulation", "Relay %u (carrying %u sensor(s)) switched off at t=%lu ms",
+					 victim, mostChildren, nowMs);
+
+			unsigned long lossMs = nowMs;
+			unsigned long recoveredMs = 0;
+			while (nowMs - lossMs < 60000)
+			{
+				pollCycle();
+
+				bool allBack = true;
+				for (uint8_t id = 1; id < NOF_NODES; id++)
+				{
+					if (id != victim && !server[id].registered) allBack = false;
+				}
+				if (allBack && server[victim].registered == false)
+				{
+					recoveredMs = nowMs;
+					break;
+				}
+			}
+
+			if (recoveredMs != 0)
+			{
+				ESP_LOGI("RelaySimulation", "All %u remaining sensors polled again after %lu ms",
+						 NOF_NODES - 2, recoveredMs - lossMs);
+			}
+			else
+			{
+				ESP_LOGW("RelaySimulation", "Not all remaining sensors recovered within 60 s");
+			}
+			logTree();
+		}
+
+	public:
+		RelaySimulation() : frameHead(0), frameTail(0), discoverSequence(0), nowMs(0), airtimeUs(0)
+		{
+		}
+
+		void run()
+		{
+			simulateRouteFormation();
+			simulateLatencyPerHop();
+			simulateRecovery();
+			ESP_LOGI("RelaySimulation", "RelaySimulation done");
+		}
+	}; // end class RelaySimulation
+
+} // end namespace crt
@@ -0,0 +1,217 @@
+// by Marius Versteegen, 2025
+// FragmentReassembler: puts the DataPackets of one POLL reply back together,
+// in any order, and rebuilds a single lost DataPacket from a DataParityPacket.
+//
+// Every DataPacket but the last carries the sensor's maxFragment bytes (see
+// SensorCapabilities), so the position of a fragment follows from its
+// packetIndex alone. Payloads are copied straight from the received frames
+// (see crt_PacketView.h) into a buffer provided by the caller, which is sized
+// for the sensor's frame.
+// buildParityPacket() is the sensor-side counterpart.
+//
+// Free of ESP-NOW calls, such that the FecLossSweep test can run it as well.
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <crt_SensorGridPacket.h>
+#include <crt_PacketView.h>
+
+namespace crt
+{
+	// Fills parity for the totalBytes of data that are sent as DataPackets of
+	// fragmentSize bytes (the last one possibly shorter). Returns the number of bytes to send.
+	inline size_t buildParityPacket(uint8_t sensorId, const uint8_t* data, uint32_t totalBytes,
+									uint8_t fragmentSize, DataParityPacket& parity)
+	{
+		uint8_t totalPackets = (uint8_t)((totalBytes + fragmentSize - 1) / fragmentSize);
+
+		parity.messageType = MessageType::DATA_PARITY;
+		parity.sensorId = sensorId;
+		parity.totalPackets = totalPackets;
+		parity.lastPayloadSize = (uint8_t)(totalBytes - (uint32_t)(totalPackets - 1) * fragmentSize);
+		parity.payloadSize = (totalPackets > 1) ? fragmentSize : parity.lastPayloadSize;
+		memset(parity.payload, 0, sizeof(parity.payload));
+
+		uint8_t position = 0;
+		for (uint32_t offset = 0; offset < totalBytes; offset++)
+		{
+			parity.payload[position] ^= data[offset];
+			if (++position == fragmentSize) position = 0;
+		}
+		return DataParityCodec::size(parity);
+	}
+
+	class FragmentReassembler
+	{
+	public:
+		static const uint16_t MAX_PACKETS = 256; // DataPacket::packetIndex is a single byte
+
+	private:
+		uint8_t* buffer;
+		uint32_t capacity;
+		uint8_t fragmentSize;
+		uint8_t parity[DATA_PAYLOAD_MAX_SIZE];
+		uint32_t receivedMask[MAX_PACKETS / 32];
+		uint8_t sensorId;
+		uint16_t totalPackets;     // 0: not known yet
+		uint16_t nofReceived;
+		uint8_t lastPayloadSize;
+		bool parityReceived;
+		bool complete;
+		bool repaired;
+
+		bool isReceived(uint16_t index) const
+		{
+			return (receivedMask[index / 32] >> (index % 32)) & 1u;
+		}
+
+		void markReceived(uint16_t index)
+		{
+			receivedMask[index / 32] |= 1u << (index % 32);
+		}
+
+		uint8_t packetSize(uint16_t index) const
+		{
+			return (index + 1 < totalPackets) ? fragmentSize : lastPayloadSize;
+		}
+
+		// A packet that would not fit in the buffer, or contradicts earlier packets, is dropped.
+		bool setTotalPackets(uint8_t packets)
+		{
+			if (packets == 0 || (uint32_t)(packets - 1) * fragmentSize >= capacity) return false;
+			if (totalPackets == 0) totalPackets = packets;
+			return totalPackets == packets;
+		}
+
+		// Rebuilds the only missing DataPacket: parity XOR all received packets.
+		void repair()
+		{
+			uint16_t missing = 0;
+			while (isReceived(missing)) missing++;
+
+			uint8_t* target = buffer + (uint32_t)missing * fragmentSize;
+			uint8_t size = packetSize(missing);
+			memcpy(target, parity, size);
+			for (uint16_t i = 0; i < totalPackets; i++)
+			{
+				if (i == missing) continue;
+				const uint8_t* src = buffer + (uint32_t)i * fragmentSize;
+				uint8_t n = (size < packetSize(i)) ? size : packetSize(i);
+				for (uint8_t b = 0; b < n; b++)
+				{
+					target[b] ^= src[b];
+				}
+			}
+			markReceived(missing);
+			nofReceived++;
+			repaired = true;
+		}
+
+		void checkComplete()
+		{
+			if (complete || totalPackets == 0) return;
+
+			if (nofReceived == totalPackets)
+			{
+				complete = true;
+			}
+			else if (parityReceived && nofReceived + 1 == totalPackets && lastPayloadSize != 0)
+			{
+				repair();
+				complete = true;
+			}
+		}
+
+	public:
+		FragmentReassembler() : buffer(nullptr), capacity(0), fragmentSize(DATA_PAYLOAD_MAX_SIZE)
+		{
+			start(0, nullptr, 0, DATA_PAYLOAD_MAX_SIZE);
+		}
+
+		// Call before sending a POLL to sensorId. The reply is written into buffer, which
+		// holds the sensor's complete frame. Packets of other sensors are ignored.
+		void start(uint8_t expectedSensorId, uint8_t* replyBuffer, uint32_t replyCapacity, uint8_t maxFragment)
+		{
+			buffer = replyBuffer;
+			capacity = replyCapacity;
+			fragmentSize = maxFragment;
+			sensorId = expectedSensorId;
+			totalPackets = 0;
+			nofReceived = 0;
+			lastPayloadSize = 0;
+			memset(receivedMask, 0, sizeof(receivedMask));
+			parityReceived = false;
+			complete = false;
+			repaired = false;
+		}
+
+		// Stops writing into the buffer of start(), e.g. before that buffer is freed.
+		// Packets are ignored until the next start().
+		void stop()
+		{
+			buffer = nullptr;
+			capacity = 0;
+			complete = false;
+		}
+
+		// Returns true if this packet completed the reassembly. pkt must be valid.
+		bool addData(const DataPacketView& pkt)
+		{
+			uint8_t index = pkt.getPacketIndex();
+			uint8_t payloadSize = pkt.getPayloadSize();
+			if (complete || buffer == nullptr || pkt.getSensorId() != sensorId || !setTotalPackets(pkt.getTotalPackets())) return false;
+			if (index >= totalPackets || payloadSize > fragmentSize) return false;
+
+			if (index + 1 == totalPackets)
+			{
+				lastPayloadSize = payloadSize;
+			}
+			else if (payloadSize != fragmentSize)
+			{
+				return false;
+			}
+			uint32_t offset = (uint32_t)index * fragmentSize;
+			if (offset + payloadSize > capacity) return false;
+
+			memcpy(buffer + offset, pkt.getPayload(), payloadSize);
+			if (!isReceived(index))
+			{
+				markReceived(index);
+				nofReceived++;
+			}
+			checkComplete();
+			return complete;
+		}
+
+		// Returns true if this packet completed the reassembly (by repairing a lost DataPacket).
+		// pkt must be valid.
+		bool addParity(const DataParityPacketView& pkt)
+		{
+			uint8_t payloadSize = pkt.getPayloadSize();
+			uint8_t lastSize = pkt.getLastPayloadSize();
+			if (complete || buffer == nullptr || pkt.getSensorId() != sensorId || !setTotalPackets(pkt.getTotalPackets())) return false;
+			// The parity covers fragmentSize bytes of every packet; a shorter one would leave stale bytes in parity.
+			if (lastSize > fragmentSize || payloadSize != ((totalPackets > 1) ? fragmentSize : lastSize)) return false;
+			if (isReceived(totalPackets - 1) && lastSize != lastPayloadSize) return false;
+			if ((uint32_t)(totalPackets - 1) * fragmentSize + lastSize > capacity) return false;
+
+			lastPayloadSize = lastSize;
+			memcpy(parity, pkt.getPayload(), payloadSize);
+			parityReceived = true;
+			checkComplete();
+			return complete;
+		}
+
+		bool isComplete() const { return complete; }
+		bool wasRepaired() const { return repaired; }
+		uint8_t getSensorId() const { return sensorId; }
+		const uint8_t* getData() const { return buffer; }
+
+		uint32_t getLength() const
+		{
+			return complete ? (uint32_t)(totalPackets - 1) * fragmentSize + lastPayloadSize : 0;
+		}
+	};
+
+} // end namespace crt
@@ -0,0 +1,367 @@
+// by Marius Versteegen, 2025
+// PacketCodec: each message declares its wire fields once, as a list of
+// pointers to the members of its packet struct. From that list the compiler
+// derives, without any runtime reflection:
+//   - HEADER_SIZE / MAX_SIZE and the offset of every field,
+//   - encode() / decode(): field by field, multi-byte fields little-endian,
+//     so the wire format does not depend on the struct layout or the CPU,
+//   - isValid(): message type, frame length and payload length checks,
+//   - TAG: a version tag of the layout (PROTOCOL_VERSION, message type and
+//     field widths), logged at startup so mismatching firmware shows up.
+//
+// Field<&Packet::member>   an unsigned integer (or MessageType) member
+// Group<&Packet::member, Layout<...>>  a struct member with its own fields
+// Bytes<&Packet::array, &Packet::lengthMember>  variable length, last field
+//
+// The packet structs in crt_SensorGridPacket.h stay the in-memory form.
+// The views in crt_PacketView.h read single fields through get<>().
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <crt_SensorGridPacket.h>
+
+namespace crt
+{
+	namespace codec
+	{
+		template<typename T> struct MemberTraits;
+		template<typename C, typename T> struct MemberTraits<T C::*>
+		{
+			using Class = C;
+			using Type = T;
+		};
+
+		// Unsigned integers and enums of them, little-endian on the wire.
+		template<typename T>
+		struct Scalar
+		{
+			using Raw = typename std::conditional<std::is_enum<T>::value, std::underlying_type<T>, std::enable_if<true, T>>::type::type;
+			static_assert(std::is_unsigned<Raw>::value, "wire fields are unsigned");
+			static constexpr size_t SIZE = sizeof(Raw);
+
+			static void store(uint8_t* out, T value)
+			{
+				Raw raw = (Raw)value;
+				for (size_t i = 0; i < SIZE; i++)
+				{
+					out[i] = (uint8_t)(raw >> (8 * i));
+				}
+			}
+
+			static T load(const uint8_t* in)
+			{
+				Raw raw = 0;
+				for (size_t i = 0; i < SIZE; i++)
+				{
+					raw |= (Raw)((Raw)in[i] << (8 * i));
+				}
+				return (T)raw;
+			}
+		};
+
+		// FNV-1a, for TAG.
+		constexpr uint32_t mix(uint32_t hash, uint32_t value)
+		{
+			return (hash ^ value) * 16777619u;
+		}
+	}
+
+	template<auto MEMBER_>
+	struct Field
+	{
+		static constexpr auto MEMBER = MEMBER_;
+		using Packet = typename codec::MemberTraits<decltype(MEMBER_)>::Class;
+		using Type = typename codec::MemberTraits<decltype(MEMBER_)>::Type;
+		static constexpr size_t SIZE = codec::Scalar<Type>::SIZE;
+		static constexpr size_t MAX_EXTRA = 0;
+		static constexpr uint32_t TAG = SIZE;
+
+		static void encode(const Packet& p, uint8_t* out) { codec::Scalar<Type>::store(out, p.*MEMBER); }
+		static void decode(const uint8_t* in, Packet& p) { p.*MEMBER = codec::Scalar<Type>::load(in); }
+		static Type get(const uint8_t* in) { return codec::Scalar<Type>::load(in); }
+	};
+
+	// Fixed-size fields, in wire order. Bytes only take part in PacketCodec.
+	template<typename... Fields>
+	struct Layout
+	{
+	private:
+		template<auto M, typename F>
+		static constexpr bool isMember()
+		{
+			if constexpr (std::is_same<decltype(M), typename std::remove_const<decltype(F::MEMBER)>::type>::value) return M == F::MEMBER;
+			else return false;
+		}
+
+		template<auto M>
+		static constexpr size_t indexOf()
+		{
+			size_t index = 0;
+			bool found = false;
+			((found = found || isMember<M, Fields>(), index += found ? 0 : 1), ...);
+			return index;
+		}
+
+	public:
+		static constexpr size_t SIZE = (Fields::SIZE + ... + 0);
+		static constexpr uint32_t TAG = [] {
+			uint32_t hash = 2166136261u;
+			((hash = codec::mix(hash, Fields::TAG)), ...);
+			return hash;
+		}();
+
+		template<typename Packet>
+		static void encode(const Packet& p, uint8_t* out)
+		{
+			((Fields::encode(p, out), out += Fields::SIZE), ...);
+		}
+
+		template<typename Packet>
+		static void decode(const uint8_t* in, Packet& p)
+		{
+			((Fields::decode(in, p), in += Fields::SIZE), ...);
+		}
+
+		// Offset of the field for member M; fails to compile if M is not in the layout.
+		template<auto M>
+		static constexpr size_t offsetOf()
+		{
+			size_t offset = 0;
+			bool found = false;
+			((found = found || isMember<M, Fields>(), offset += found ? 0 : Fields::SIZE), ...);
+			return found ? offset : throw "member is not a field of this layout";
+		}
+
+		template<auto M>
+		using FieldOf = typename std::tuple_element<indexOf<M>(), std::tuple<Fields...>>::type;
+	};
+
+	// A struct member that is encoded with its own Layout.
+	template<auto MEMBER_, typename Inner>
+	struct Group
+	{
+		static constexpr auto MEMBER = MEMBER_;
+		using Packet = typename codec::MemberTraits<decltype(MEMBER_)>::Class;
+		using Type = typename codec::MemberTraits<decltype(MEMBER_)>::Type;
+		static constexpr size_t SIZE = Inner::SIZE;
+		static constexpr size_t MAX_EXTRA = 0;
+		static constexpr uint32_t TAG = Inner::TAG;
+
+		static void encode(const Packet& p, uint8_t* out)
+		{
+			Type inner = p.*MEMBER; // copy out of the (packed) struct
+			Inner::encode(inner, out);
+		}
+
+		static void decode(const uint8_t* in, Packet& p)
+		{
+			Type inner;
+			Inner::decode(in, inner);
+			p.*MEMBER = inner;
+		}
+
+		static Type get(const uint8_t* in)
+		{
+			Type inner;
+			Inner::decode(in, inner);
+			return inner;
+		}
+	};
+
+	// Variable-length byte array, as many bytes as the (earlier) length member says.
+	// SIZE is 0: it only follows the fixed fields.
+	template<auto ARRAY, auto LENGTH>
+	struct Bytes
+	{
+		static constexpr auto MEMBER = ARRAY;
+		using Packet = typename codec::MemberTraits<decltype(ARRAY)>::Class;
+		static constexpr size_t SIZE = 0;
+		static constexpr size_t MAX_EXTRA = std::extent<typename codec::MemberTraits<decltype(ARRAY)>::Type>::value;
+		static constexpr uint32_t TAG = 0x80000000u | (uint32_t)MAX_EXTRA;
+
+		// Not part of the fixed fields.
+		static void encode(const Packet&, uint8_t*) {}
+		static void decode(const uint8_t*, Packet&) {}
+
+		static void encodeBytes(const Packet& p, uint8_t* out) { memcpy(out, p.*ARRAY, length(p)); }
+		static void decodeBytes(const uint8_t* in, Packet& p) { memcpy(p.*ARRAY, in, length(p)); }
+		static size_t length(const Packet& p) { return p.*LENGTH; }
+	};
+
+	// A message: its MessageType and fields. The first field must be the messageType
+	// member, Bytes (if any) the last.
+	template<MessageType TYPE, typename... Fields>
+	class PacketCodec
+	{
+	private:
+		using Fixed = Layout<Fields...>;
+		using First = typename std::tuple_element<0, std::tuple<Fields...>>::type;
+		using Last = typename std::tuple_element<sizeof...(Fields) - 1, std::tuple<Fields...>>::type;
+		static constexpr bool HAS_BYTES = Last::MAX_EXTRA > 0;
+
+		static_assert(std::is_same<typename First::Type, MessageType>::value, "the first field is the message type");
+
+	public:
+		using Packet = typename First::Packet;
+
+		static constexpr MessageType MESSAGE_TYPE = TYPE;
+		static constexpr size_t HEADER_SIZE = Fixed::SIZE;
+		static constexpr size_t MAX_SIZE = HEADER_SIZE + Last::MAX_EXTRA;
+		static constexpr uint32_t TAG = codec::mix(codec::mix(Fixed::TAG, PROTOCOL_VERSION), (uint32_t)TYPE);
+
+		template<auto M>
+		static constexpr size_t offsetOf() { return Fixed::template offsetOf<M>(); }
+
+		// Reads one field from a frame for which isValid() returned true.
+		template<auto M>
+		static auto get(const uint8_t* frame)
+		{
+			constexpr size_t OFFSET = offsetOf<M>();
+			return Fixed::template FieldOf<M>::get(frame + OFFSET);
+		}
+
+		// Number of bytes the frame of p takes.
+		static size_t size(const Packet& p)
+		{
+			if constexpr (HAS_BYTES) return HEADER_SIZE + Last::length(p);
+			else return HEADER_SIZE;
+		}
+
+		// Frames longer than MAX_SIZE are rejected as well: ESP-NOW v2 delivers up to
+		// 1470 bytes, and receivers copy valid frames into buffers of MAX_SIZE.
+		static bool isValid(const uint8_t* frame, int length)
+		{
+			if (frame == nullptr || length < (int)HEADER_SIZE || length > (int)MAX_SIZE || frame[0] != (uint8_t)TYPE) return false;
+			if constexpr (HAS_BYTES)
+			{
+				size_t extra = get<lengthMember()>(frame);
+				return extra <= Last::MAX_EXTRA && (int)(HEADER_SIZE + extra) <= length;
+			}
+			return true;
+		}
+
+		// Writes the fixed fields only; the caller puts the payload at HEADER_SIZE.
+		static void encodeHeader(const Packet& p, uint8_t* out)
+		{
+			Fixed::encode(p, out);
+			out[0] = (uint8_t)TYPE;
+		}
+
+		// Writes the frame of p to out (at least size(p) bytes). Returns size(p).
+		static size_t encode(const Packet& p, uint8_t* out)
+		{
+			encodeHeader(p, out);
+			if constexpr (HAS_BYTES) Last::encodeBytes(p, out + HEADER_SIZE);
+			return size(p);
+		}
+
+		// Returns false (and leaves p undefined) if the frame is not valid.
+		static bool decode(const uint8_t* frame, int length, Packet& p)
+		{
+			if (!isValid(frame, length)) return false;
+			Fixed::decode(frame, p);
+			if constexpr (HAS_BYTES) Last::decodeBytes(frame + HEADER_SIZE, p);
+			return true;
+		}
+
+	private:
+		static constexpr auto lengthMember()
+		{
+			if constexpr (HAS_BYTES) return lengthOf(Last{});
+			else return 0;
+		}
+
+		template<auto ARRAY, auto LENGTH>
+		static constexpr auto lengthOf(Bytes<ARRAY, LENGTH>) { return LENGTH; }
+	};
+
+	// --- The v4 messages ---
+
+	using CapabilitiesLayout = Layout<
+		Field<&SensorCapabilities::protocolVersion>,
+		Field<&SensorCapabilities::sampleCount>,
+		Field<&SensorCapabilities::sampleWidth>,
+		Field<&SensorCapabilities::codecs>,
+		Field<&SensorCapabilities::maxFragment>>;
+
+	using DiscoverCodec = PacketCodec<MessageType::DISCOVER,
+		Field<&DiscoverPacket::messageType>,
+		Field<&DiscoverPacket::sequence>,
+		Field<&DiscoverPacket::hopCount>,
+		Field<&DiscoverPacket::pathCost>>;
+
+	using RegisterCodec = PacketCodec<MessageType::REGISTER,
+		Field<&RegisterPacket::messageType>,
+		Field<&RegisterPacket::sensorId>,
+		Field<&RegisterPacket::hopCount>,
+		Field<&RegisterPacket::features>,
+		Group<&RegisterPacket::capabilities, CapabilitiesLayout>>;
+
+	using PollCodec = PacketCodec<MessageType::POLL,
+		Field<&PollPacket::messageType>,
+		Field<&PollPacket::sensorId>,
+		Field<&PollPacket::flags>,
+		Field<&PollPacket::nextPollMs>,
+		Field<&PollPacket::channel>>;
+
+	using DataCodec = PacketCodec<MessageType::DATA,
+		Field<&DataPacket::messageType>,
+		Field<&DataPacket::sensorId>,
+		Field<&DataPacket::packetIndex>,
+		Field<&DataPacket::totalPackets>,
+		Field<&DataPacket::payloadSize>,
+		Bytes<&DataPacket::payload, &DataPacket::payloadSize>>;
+
+	using DataParityCodec = PacketCodec<MessageType::DATA_PARITY,
+		Field<&DataParityPacket::messageType>,
+		Field<&DataParityPacket::sensorId>,
+		Field<&DataParityPacket::totalPackets>,
+		Field<&DataParityPacket::lastPayloadSize>,
+		Field<&DataParityPacket::payloadSize>,
+		Bytes<&DataParityPacket::payload, &DataParityPacket::payloadSize>>;
+
+	using ShardSummaryCodec = PacketCodec<MessageType::SHARD_SUMMARY,
+		Field<&ShardSummaryPacket::messageType>,
+		Field<&ShardSummaryPacket::shardId>,
+		Field<&ShardSummaryPacket::cycle>,
+		Field<&ShardSummaryPacket::firstSensorId>,
+		Field<&ShardSummaryPacket::lastSensorId>,
+		Field<&ShardSummaryPacket::registeredMask>>;
+
+	using ShardDeltaCodec = PacketCodec<MessageType::SHARD_DELTA,
+		Field<&ShardDeltaPacket::messageType>,
+		Field<&ShardDeltaPacket::shardId>,
+		Field<&ShardDeltaPacket::sensorId>,
+		Field<&ShardDeltaPacket::hopCount>,
+		Field<&ShardDeltaPacket::sequence>,
+		Field<&ShardDeltaPacket::baseSequence>,
+		Field<&ShardDeltaPacket::flags>,
+		Field<&ShardDeltaPacket::frameIndex>,
+		Field<&ShardDeltaPacket::sampleWidth>,
+		Field<&ShardDeltaPacket::sampleCount>,
+		Field<&ShardDeltaPacket::payloadSize>,
+		Bytes<&ShardDeltaPacket::payload, &ShardDeltaPacket::payloadSize>>;
+
+	// Tag of the whole v4 wire format, logged by server and sensors at startup.
+	static constexpr uint32_t WIRE_FORMAT_TAG = codec::mix(codec::mix(codec::mix(codec::mix(
+		DiscoverCodec::TAG, RegisterCodec::TAG), PollCodec::TAG), DataCodec::TAG), DataParityCodec::TAG);
+
+	// Tag of the messages between shard and root servers, logged by servers that use them.
+	// Kept apart from WIRE_FORMAT_TAG, as the sensors do not take part.
+	static constexpr uint32_t SHARD_FORMAT_TAG = codec::mix(ShardSummaryCodec::TAG, ShardDeltaCodec::TAG);
+
+	// The wire sizes are part of the protocol (ESP-NOW frame limit, v3 compatibility);
+	// the packed structs happen to match them.
+	static_assert(DiscoverCodec::HEADER_SIZE == 4, "DISCOVER layout changed");
+	static_assert(RegisterCodec::HEADER_SIZE == 10, "REGISTER layout changed");
+	static_assert(PollCodec::HEADER_SIZE == 6, "POLL layout changed");
+	static_assert(DataCodec::HEADER_SIZE == 5 && DataCodec::MAX_SIZE == 250, "DATA layout changed");
+	static_assert(DataParityCodec::MAX_SIZE == 250, "DATA_PARITY exceeds the ESP-NOW frame");
+	static_assert(ShardSummaryCodec::HEADER_SIZE == 10, "SHARD_SUMMARY layout changed");
+	static_assert(ShardDeltaCodec::HEADER_SIZE == 14 && ShardDeltaCodec::MAX_SIZE == 250, "SHARD_DELTA layout changed");
+
+} // end namespace crt
@@ -0,0 +1,105 @@
+// by Marius Versteegen, 2025
+// Packet views: typed read access to a received ESP-NOW frame, straight from
+// the buffer the ESP-NOW callback hands over, instead of copying the frame
+// into a packet struct first.
+//
+// A view only points into the frame, so it is valid for as long as that
+// buffer is (i.e. within the callback). isValid() checks the message type and
+// that the frame is long enough for every field, including the payloadSize
+// bytes of payload; the getters may only be used after it returned true.
+// Field offsets, decoding and validation come from the codecs in
+// crt_PacketCodec.h.
+
+#pragma once
+#include <cstdint>
+#include <crt_SensorGridPacket.h>
+#include <crt_PacketCodec.h>
+
+namespace crt
+{
+	// Codec: one of the PacketCodecs of crt_PacketCodec.h.
+	template<typename Codec>
+	class PacketView
+	{
+	protected:
+		const uint8_t* frame;
+		int length;
+
+		template<auto M>
+		auto get() const { return Codec::template get<M>(frame); }
+
+	public:
+		using Packet = typename Codec::Packet;
+
+		PacketView(const uint8_t* frame, int length) : frame(frame), length(length)
+		{
+		}
+
+		bool isValid() const { return Codec::isValid(frame, length); }
+
+		// The complete frame, e.g. for relays that forward it unchanged.
+		const uint8_t* getFrame() const { return frame; }
+		int getLength() const { return length; }
+	};
+
+	class DiscoverPacketView : public PacketView<DiscoverCodec>
+	{
+	public:
+		using PacketView::PacketView;
+
+		uint8_t getSequence() const { return get<&Packet::sequence>(); }
+		uint8_t getHopCount() const { return get<&Packet::hopCount>(); }
+		uint8_t getPathCost() const { return get<&Packet::pathCost>(); }
+	};
+
+	class RegisterPacketView : public PacketView<RegisterCodec>
+	{
+	public:
+		using PacketView::PacketView;
+
+		uint8_t getSensorId() const { return get<&Packet::sensorId>(); }
+		uint8_t getHopCount() const { return get<&Packet::hopCount>(); }
+		uint8_t getFeatures() const { return get<&Packet::features>(); }
+		SensorCapabilities getCapabilities() const { return get<&Packet::capabilities>(); }
+	};
+
+	class PollPacketView : public PacketView<PollCodec>
+	{
+	public:
+		using PacketView::PacketView;
+
+		uint8_t getSensorId() const { return get<&Packet::sensorId>(); }
+		uint8_t getFlags() const { return get<&Packet::flags>(); }
+		uint16_t getNextPollMs() const { return get<&Packet::nextPollMs>(); }
+		uint8_t getChannel() const { return get<&Packet::channel>(); }
+	};
+
+	class DataPacketView : public PacketView<DataCodec>
+	{
+	public:
+		static const size_t HEADER_SIZE = DataCodec::HEADER_SIZE;
+
+		using PacketView::PacketView;
+
+		uint8_t getSensorId() const { return get<&Packet::sensorId>(); }
+		uint8_t getPacketIndex() const { return get<&Packet::packetIndex>(); }
+		uint8_t getTotalPackets() const { return get<&Packet::totalPackets>(); }
+		uint8_t getPayloadSize() const { return get<&Packet::payloadSize>(); }
+		const uint8_t* getPayload() const { return frame + HEADER_SIZE; }
+	};
+
+	class DataParityPacketView : public PacketView<DataParityCodec>
+	{
+	public:
+		static const size_t HEADER_SIZE = DataParityCodec::HEADER_SIZE;
+
+		using PacketView::PacketView;
+
+		uint8_t getSensorId() const { return get<&Packet::sensorId>(); }
+		uint8_t getTotalPackets() const { return get<&Packet::totalPackets>(); }
+		uint8_t getLastPayloadSize() const { return get<&Packet::lastPayloadSize>(); }
+		uint8_t getPayloadSize() const { return get<&Packet::payloadSize>(); }
+		const uint8_t* getPayload() const { return frame + HEADER_SIZE; }
+	};
+
+} // end namespace crt
@@ -0,0 +1,193 @@
+// by Marius Versteegen, 2025
+// PollSchedule: the poll windows of duty-cycled sensors.
+//
+// The server polls every sensor once per cycle of cycleMs. The windows of a
+// cycle are packed back to back at its start, in registration order, and each
+// one is as long as the reply of that sensor is expected to take. That
+// expectation starts from the airtime of the reply (estimateReplyUs()) and
+// follows the measured replies (onReply(): mean plus four times the mean
+// deviation, as a TCP retransmission timer does). The window is also how long
+// the server waits for the reply, so a lost POLL does not make the sensors
+// after it late; a missed window widens it (onMissedWindow()). A sensor only has to be
+// awake from just before its window until its reply is sent; packing the
+// windows keeps the cycle short, so that sensors are hardly ever polled late.
+//
+// Each POLL tells the sensor when its window of the next cycle opens
+// (nextPollMs()), so the windows of the next cycle are planned when the
+// current cycle begins, and do not change after that. A sensor that joins
+// later is polled as soon as the scheduled ones are done, and gets its window
+// from the plan after that.
+//
+// Free of ESP-NOW calls, such that the DutyCycleSimulation test can run it as well.
+
+#pragma once
+#include <cstdint>
+#include <crt_SensorGridPacket.h>
+#include <crt_PacketCodec.h>
+
+namespace crt
+{
+	template<uint8_t MAX_SENSORS> class PollSchedule
+	{
+	public:
+		// A sensor must hear its parent within RelayRouting::PARENT_TIMEOUT_MS (3 s).
+		static const uint32_t MAX_CYCLE_MS = 2000;
+		static const uint8_t SLOT_MARGIN_MS = 1;	// added to every window
+
+	private:
+		static const uint16_t NO_WINDOW = 0xFFFF;
+
+		struct Estimate
+		{
+			uint32_t meanUs;	// 0: unknown
+			uint32_t devUs;
+		};
+
+		uint32_t cycleMs;	// 0: not duty cycling, poll continuously
+		Estimate estimates[MAX_SENSORS + 1];	// indexed 1..MAX_SENSORS
+		uint16_t currentOffsetMs[MAX_SENSORS + 1];	// window in the current cycle, from its start
+		uint16_t nextOffsetMs[MAX_SENSORS + 1];		// window in the next cycle
+		bool started;
+		uint32_t cycleStartMs;
+		uint32_t nextCycleStartMs;
+		uint32_t burstMs;		// length of the windows of the current cycle together
+		uint32_t nofCycles;
+		uint32_t nofOverruns;	// cycles whose windows did not fit in cycleMs
+
+		// 1 Mbps with long preamble (ESP-NOW default), 43 bytes of 802.11 action frame
+		// overhead and the ACK of a unicast frame.
+		static uint32_t frameAirtimeUs(uint32_t payloadBytes)
+		{
+			return 192 + (43 + payloadBytes) * 8 + 304;
+		}
+
+	public:
+		PollSchedule(uint32_t cycleMs)
+			: cycleMs(cycleMs > MAX_CYCLE_MS ? MAX_CYCLE_MS : cycleMs), started(false),
+			  cycleStartMs(0), nextCycleStartMs(0), burstMs(0), nofCycles(0), nofOverruns(0)
+		{
+			for (uint8_t id = 0; id <= MAX_SENSORS; id++)
+			{
+				estimates[id] = {0, 0};
+				currentOffsetMs[id] = NO_WINDOW;
+				nextOffsetMs[id] = NO_WINDOW;
+			}
+		}
+
+		// Expected duration of a POLL and its reply of frameBytes in DataPackets of
+		// maxFragment bytes, plus a parity packet, with processingUs per frame.
+		static uint32_t estimateReplyUs(uint32_t frameBytes, uint8_t maxFragment, bool withParity,
+										uint32_t processingUs = 300)
+		{
+			uint32_t packets = (frameBytes + maxFragment - 1) / maxFragment;
+			uint32_t us = frameAirtimeUs(PollCodec::HEADER_SIZE) + processingUs;
+			us += (packets - 1) * frameAirtimeUs(DataCodec::HEADER_SIZE + maxFragment);
+			us += frameAirtimeUs(DataCodec::HEADER_SIZE + frameBytes - (packets - 1) * maxFragment);
+			if (withParity) us += frameAirtimeUs(DataParityCodec::HEADER_SIZE + (packets > 1 ? maxFragment : frameBytes));
+			return us + (packets + (withParity ? 1 : 0)) * processingUs;
+		}
+
+		bool isEnabled() const { return cycleMs > 0; }
+
+		// Starts the estimate of sensorId's reply over, e.g. when it (re-)registers.
+		void setEstimate(uint8_t sensorId, uint32_t replyUs)
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS) return;
+			estimates[sensorId].meanUs = replyUs;
+			estimates[sensorId].devUs = replyUs / 2;
+		}
+
+		// A reply of sensorId took replyUs, from sending the POLL to its last packet.
+		void onReply(uint8_t sensorId, uint32_t replyUs)
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS) return;
+			Estimate& e = estimates[sensorId];
+			if (e.meanUs == 0)
+			{
+				setEstimate(sensorId, replyUs);
+				return;
+			}
+			int32_t error = (int32_t)(replyUs - e.meanUs);
+			uint32_t absError = (uint32_t)(error < 0 ? -error : error);
+			e.meanUs = (uint32_t)((int32_t)e.meanUs + error / 8);
+			e.devUs = (uint32_t)((int32_t)e.devUs + ((int32_t)absError - (int32_t)e.devUs) / 4);
+		}
+
+		// No reply of sensorId came within its window: widen it, as TCP backs off its
+		// retransmission timer. Replies that do come in shrink it again.
+		void onMissedWindow(uint8_t sensorId)
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS) return;
+			Estimate& e = estimates[sensorId];
+			e.devUs = e.devUs * 2 + SLOT_MARGIN_MS * 1000;
+			if (e.devUs > MAX_CYCLE_MS * 1000 / 8) e.devUs = MAX_CYCLE_MS * 1000 / 8;
+		}
+
+		// Length of sensorId's window; the server waits no longer than that for its reply.
+		uint32_t getSlotMs(uint8_t sensorId) const
+		{
+			const Estimate& e = estimates[sensorId];
+			return (e.meanUs + 4 * e.devUs + 999) / 1000 + SLOT_MARGIN_MS;
+		}
+
+		// Begins the next cycle: the windows planned one cycle ago become the current
+		// ones, and those of the next cycle are planned for the sensorIds (in that order).
+		// The cycle starts when it was planned to, also if the server is late for it.
+		void beginCycle(uint32_t nowMs, const uint8_t* sensorIds, uint8_t count)
+		{
+			if (!started)
+			{
+				started = true;
+				nextCycleStartMs = nowMs;
+			}
+			cycleStartMs = nextCycleStartMs;
+
+			burstMs = 0;
+			for (uint8_t id = 1; id <= MAX_SENSORS; id++)
+			{
+				currentOffsetMs[id] = nextOffsetMs[id];
+				nextOffsetMs[id] = NO_WINDOW;
+				if (currentOffsetMs[id] != NO_WINDOW && currentOffsetMs[id] + getSlotMs(id) > burstMs)
+				{
+					burstMs = currentOffsetMs[id] + getSlotMs(id);
+				}
+			}
+			nextCycleStartMs = cycleStartMs + (burstMs > cycleMs ? burstMs : cycleMs);
+
+			uint32_t offset = 0;
+			for (uint8_t i = 0; i < count; i++)
+			{
+				uint8_t id = sensorIds[i];
+				if (id < 1 || id > MAX_SENSORS || offset >= NO_WINDOW) continue;
+				nextOffsetMs[id] = (uint16_t)offset;
+				offset += getSlotMs(id);
+			}
+			if (offset > cycleMs) nofOverruns++;
+			nofCycles++;
+		}
+
+		// Start of sensorId's window in the current cycle. Returns false if it has none.
+		bool getWindow(uint8_t sensorId, uint32_t& windowMs) const
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS || currentOffsetMs[sensorId] == NO_WINDOW) return false;
+			windowMs = cycleStartMs + currentOffsetMs[sensorId];
+			return true;
+		}
+
+		// Time from nowMs until sensorId's window in the next cycle, as sent in its POLL.
+		// 0 (stay awake) if it has none yet, or if it has already passed.
+		uint16_t nextPollMs(uint8_t sensorId, uint32_t nowMs) const
+		{
+			if (!isEnabled() || sensorId < 1 || sensorId > MAX_SENSORS || nextOffsetMs[sensorId] == NO_WINDOW) return 0;
+			int32_t ms = (int32_t)(nextCycleStartMs + nextOffsetMs[sensorId] - nowMs);
+			if (ms <= 0) return 0;
+			return (ms > 0xFFFF) ? 0xFFFF : (uint16_t)ms;
+		}
+
+		uint32_t getCycleMs() const { return cycleMs; }
+		uint32_t getBurstMs() const { return burstMs; }
+		uint32_t getNofCycles() const { return nofCycles; }
+		uint32_t getNofOverruns() const { return nofOverruns; }
+	}; // end class PollSchedule
+
+} // end namespace crt
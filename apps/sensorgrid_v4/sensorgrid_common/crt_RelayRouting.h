@@ -0,0 +1,167 @@
+// by Marius Versteegen, 2025
+// RelayRouting: parent selection and child routes of a sensor in a multi-hop
+// sensor grid. Free of ESP-NOW calls (and of millis()), such that the same
+// logic runs in SensorNode and in the host-side RelaySimulation.
+//
+// The server broadcasts DISCOVER with hopCount 0 and pathCost 0. A node
+// adds the cost of the link the DISCOVER arrived over (derived from its
+// RSSI) and picks the neighbour with the lowest resulting path cost as its
+// parent. Relay nodes re-broadcast the DISCOVERs of their parent with their
+// own hopCount and pathCost, so the tree grows outwards one hop at a time.
+//
+// Routes to children are learned from the REGISTER packets that relays
+// forward towards the server.
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace crt
+{
+	class RelayRouting
+	{
+	public:
+		static const uint8_t MAX_HOPS = 4;
+		static const uint8_t MAX_CHILD_ROUTES = 8;
+		static const uint8_t NO_COST = 0xFF;
+		// A better parent must be cheaper by more than this, to avoid flapping between
+		// two parents of about equal quality.
+		static const uint8_t PARENT_HYSTERESIS = 1;
+		// Without POLLs or DISCOVERs from the parent for this long, it is considered lost.
+		static const unsigned long PARENT_TIMEOUT_MS = 3000;
+
+	private:
+		struct ChildRoute
+		{
+			bool used;
+			uint8_t sensorId;
+			uint8_t mac[6];
+		};
+
+		bool parentValid;
+		uint8_t parentMac[6];
+		uint8_t hopCount;      // number of hops between server and this node
+		uint8_t pathCost;      // sum of link costs between server and this node
+		unsigned long lastParentHeardMs;
+		bool discoverSeqValid;
+		uint8_t lastDiscoverSeq;
+		ChildRoute routes[MAX_CHILD_ROUTES];
+
+	public:
+		RelayRouting()
+			: parentValid(false), hopCount(0), pathCost(NO_COST),
+			  lastParentHeardMs(0), discoverSeqValid(false), lastDiscoverSeq(0)
+		{
+			memset(parentMac, 0, sizeof(parentMac));
+			memset(routes, 0, sizeof(routes));
+		}
+
+		// Expected number of transmissions over a link, approximated from its RSSI.
+		static uint8_t linkCostFromRssi(int8_t rssi)
+		{
+			if (rssi >= -65) return 1;
+			if (rssi >= -75) return 2;
+			if (rssi >= -85) return 4;
+			return 8;
+		}
+
+		// Handles a DISCOVER heard from mac. Returns true if a relay should re-broadcast it
+		// (a new sequence number from its parent). parentChanged reports a new parent,
+		// after which the node has to REGISTER again through that parent.
+		bool onDiscover(const uint8_t* mac, uint8_t senderHopCount, uint8_t senderPathCost,
+						uint8_t sequence, int8_t rssi, unsigned long nowMs, bool& parentChanged)
+		{
+			parentChanged = false;
+			if (senderHopCount >= MAX_HOPS || senderPathCost == NO_COST) return false;
+
+			uint16_t cost = (uint16_t)senderPathCost + linkCostFromRssi(rssi);
+			if (cost >= NO_COST) cost = NO_COST - 1;
+
+			bool fromParent = parentValid && memcmp(mac, parentMac, 6) == 0;
+			if (!fromParent)
+			{
+				if (parentValid && (uint16_t)cost + PARENT_HYSTERESIS >= pathCost) return false;
+
+				memcpy(parentMac, mac, 6);
+				parentValid = true;
+				parentChanged = true;
+			}
+
+			hopCount = senderHopCount + 1;
+			pathCost = (uint8_t)cost;
+			lastParentHeardMs = nowMs;
+
+			bool isNewSequence = !discoverSeqValid || sequence != lastDiscoverSeq;
+			discoverSeqValid = true;
+			lastDiscoverSeq = sequence;
+			return isNewSequence && hopCount < MAX_HOPS;
+		}
+
+		// Call on every frame received from the parent (e.g. a POLL).
+		void onParentHeard(const uint8_t* mac, unsigned long nowMs)
+		{
+			if (parentValid && memcmp(mac, parentMac, 6) == 0)
+			{
+				lastParentHeardMs = nowMs;
+			}
+		}
+
+		// Drops the parent if it has been silent for too long. Returns true if it did.
+		bool checkParentTimeout(unsigned long nowMs)
+		{
+			if (parentValid && (nowMs - lastParentHeardMs >= PARENT_TIMEOUT_MS))
+			{
+				parentValid = false;
+				pathCost = NO_COST;
+				hopCount = 0;
+				discoverSeqValid = false;
+				return true;
+			}
+			return false;
+		}
+
+		// Remembers that sensorId is reached via the neighbour mac. Returns false if the table is full.
+		bool learnRoute(uint8_t sensorId, const uint8_t* mac)
+		{
+			ChildRoute* freeRoute = nullptr;
+			for (uint8_t i = 0; i < MAX_CHILD_ROUTES; i++)
+			{
+				if (routes[i].used && routes[i].sensorId == sensorId)
+				{
+					memcpy(routes[i].mac, mac, 6);
+					return true;
+				}
+				if (!routes[i].used && freeRoute == nullptr) freeRoute = &routes[i];
+			}
+			if (freeRoute == nullptr) return false;
+			freeRoute->used = true;
+			freeRoute->sensorId = sensorId;
+			memcpy(freeRoute->mac, mac, 6);
+			return true;
+		}
+
+		// Returns the neighbour mac via which sensorId is reached, or nullptr.
+		const uint8_t* findRoute(uint8_t sensorId) const
+		{
+			for (uint8_t i = 0; i < MAX_CHILD_ROUTES; i++)
+			{
+				if (routes[i].used && routes[i].sensorId == sensorId) return routes[i].mac;
+			}
+			return nullptr;
+		}
+
+		void forgetRoute(uint8_t sensorId)
+		{
+			for (uint8_t i = 0; i < MAX_CHILD_ROUTES; i++)
+			{
+				if (routes[i].used && routes[i].sensorId == sensorId) routes[i].used = false;
+			}
+		}
+
+		bool hasParent() const { return parentValid; }
+		const uint8_t* getParentMac() const { return parentMac; }
+		uint8_t getHopCount() const { return hopCount; }
+		uint8_t getPathCost() const { return pathCost; }
+	};
+
+} // end namespace crt
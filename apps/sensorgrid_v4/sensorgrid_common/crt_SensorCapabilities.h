@@ -0,0 +1,78 @@
+// by Marius Versteegen, 2025
+// Helpers around SensorCapabilities: building them on the sensor side,
+// checking them and deriving frame sizes on the server side, and reading
+// samples of any supported width from a raw (CODEC_RAW) frame.
+
+#pragma once
+#include <cstdint>
+#include <crt_SensorGridPacket.h>
+
+namespace crt
+{
+	// Smallest maxFragment accepted. Keeps the number of DataPackets per reply
+	// (and thereby the per-packet overhead) within reason.
+	static const uint8_t MIN_FRAGMENT_SIZE = 16;
+
+	// DataPacket::packetIndex and ::totalPackets are single bytes.
+	static const uint8_t MAX_PACKETS_PER_REPLY = 255;
+
+	inline SensorCapabilities makeCapabilities(uint16_t sampleCount, uint8_t sampleWidth,
+											   uint8_t maxFragment = DATA_PAYLOAD_MAX_SIZE)
+	{
+		SensorCapabilities caps;
+		caps.protocolVersion = PROTOCOL_VERSION;
+		caps.sampleCount = sampleCount;
+		caps.sampleWidth = sampleWidth;
+		caps.codecs = CODEC_RAW;
+		caps.maxFragment = maxFragment;
+		return caps;
+	}
+
+	inline uint32_t frameBytes(const SensorCapabilities& caps)
+	{
+		return (uint32_t)caps.sampleCount * caps.sampleWidth;
+	}
+
+	inline uint16_t packetsPerReply(const SensorCapabilities& caps)
+	{
+		return (uint16_t)((frameBytes(caps) + caps.maxFragment - 1) / caps.maxFragment);
+	}
+
+	// Returns nullptr if the server can handle a sensor with these capabilities,
+	// or else the reason why not.
+	inline const char* checkCapabilities(const SensorCapabilities& caps, uint32_t maxFrameBytes)
+	{
+		if (caps.protocolVersion != PROTOCOL_VERSION) return "protocol version";
+		if ((caps.codecs & CODEC_RAW) == 0) return "no common codec";
+		if (caps.sampleCount == 0) return "no samples";
+		if (caps.sampleWidth != 1 && caps.sampleWidth != 2 && caps.sampleWidth != 4) return "sample width";
+		if (caps.maxFragment < MIN_FRAGMENT_SIZE || caps.maxFragment > DATA_PAYLOAD_MAX_SIZE) return "fragment size";
+		if (frameBytes(caps) > maxFrameBytes) return "frame too large";
+		if (packetsPerReply(caps) > MAX_PACKETS_PER_REPLY) return "too many packets";
+		return nullptr;
+	}
+
+	inline bool operator==(const SensorCapabilities& a, const SensorCapabilities& b)
+	{
+		return a.protocolVersion == b.protocolVersion && a.sampleCount == b.sampleCount &&
+			   a.sampleWidth == b.sampleWidth && a.codecs == b.codecs && a.maxFragment == b.maxFragment;
+	}
+
+	inline bool operator!=(const SensorCapabilities& a, const SensorCapabilities& b)
+	{
+		return !(a == b);
+	}
+
+	// Sample index of a CODEC_RAW frame (little-endian, like the ESP32 itself).
+	inline uint32_t readSample(const uint8_t* frame, uint16_t index, uint8_t sampleWidth)
+	{
+		const uint8_t* p = frame + (uint32_t)index * sampleWidth;
+		switch (sampleWidth)
+		{
+			case 1: return p[0];
+			case 2: return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+			default: return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+		}
+	}
+
+} // end namespace crt
@@ -9,35 +9,80 @@ namespace crt
 	{
 		DISCOVER = 0x01,
 		REGISTER = 0x02,
-		POLL     = 0x03,
-		DATA     = 0x04
+		POLL        = 0x03,
+		DATA        = 0x04,
+		DATA_PARITY = 0x05,
+		SHARD_SUMMARY = 0x06,
+		SHARD_DELTA   = 0x07
 	};
 
+	// RegisterPacket::features: optional protocol features the sensor supports.
+	static const uint8_t FEATURE_XOR_PARITY = 0x01;
+	static const uint8_t FEATURE_DUTY_CYCLE = 0x02;	// sleeps between polls, see PollPacket::nextPollMs
+	static const uint8_t FEATURE_CHANNEL_HOP = 0x04;	// can be moved to another channel, see PollPacket::channel
+
+	// PollPacket::flags: features the server wants the sensor to use in its reply.
+	static const uint8_t POLL_FLAG_PARITY = 0x01;
+
 	// Server -> broadcast. Tells sensors to register.
+	// Relay sensors re-broadcast it with their own hopCount and pathCost
+	// (see crt_RelayRouting.h). The server sends hopCount 0 and pathCost 0.
 	struct DiscoverPacket
 	{
 		MessageType messageType;
+		uint8_t sequence;	// incremented per server broadcast; relays forward each one once
+		uint8_t hopCount;	// hops between the server and the sender of this packet
+		uint8_t pathCost;	// sum of link costs between the server and the sender
+	} __attribute__((packed));
+
+	// Version of the v4 packet layout, announced in SensorCapabilities.
+	static const uint8_t PROTOCOL_VERSION = 4;
+
+	// SensorCapabilities::codecs: payload encodings the sensor can send.
+	static const uint8_t CODEC_RAW = 0x01;	// sampleWidth bytes per sample, little-endian
+
+	// What a sensor sends per POLL. The server sizes its storage for the sensor
+	// from this (see crt_SensorCapabilities.h), so sensors with different
+	// sample counts can share one grid.
+	struct SensorCapabilities
+	{
+		uint8_t protocolVersion;	// PROTOCOL_VERSION
+		uint16_t sampleCount;		// samples per reply
+		uint8_t sampleWidth;		// bytes per sample: 1, 2 or 4
+		uint8_t codecs;				// CODEC_* bits
+		uint8_t maxFragment;		// payload bytes per DataPacket (all but the last)
 	} __attribute__((packed));
 
-	// Sensor -> server. Reply to DISCOVER.
+	// Sensor -> server. Reply to DISCOVER, sent to the sensor's parent.
+	// Relays forward it towards the server and learn the route to sensorId on the way.
 	struct RegisterPacket
 	{
 		MessageType messageType;
 		uint8_t sensorId;
+		uint8_t hopCount;	// hops between the server and sensorId
+		uint8_t features;	// FEATURE_* bits
+		SensorCapabilities capabilities;
 	} __attribute__((packed));
 
-	// Server -> sensor (unicast). Requests sensor data.
+	// Server -> sensor (unicast to the next hop). Requests sensor data.
+	// Relays forward POLLs for other sensor ids to the child they learned it from,
+	// and DATA packets of their children to their parent, unchanged.
 	struct PollPacket
 	{
 		MessageType messageType;
 		uint8_t sensorId;
+		uint8_t flags;		// POLL_FLAG_* bits
+		uint16_t nextPollMs;	// the sensor's next poll window opens this long after this POLL; 0: stay awake
+		uint8_t channel;		// after its reply, the sensor moves to this Wi-Fi channel; 0: stay
 	} __attribute__((packed));
 
-	// Number of uint16_t measurements per sensor sample cycle.
+	// Default number of uint16_t measurements per sensor sample cycle.
+	// Sensors announce their actual sample count in SensorCapabilities.
 	static const uint8_t MEASUREMENT_COUNT = 64;
 
 	// Sensor -> server. Response to POLL.
 	// Supports multi-packet payloads via packetIndex/totalPackets.
+	// Every DataPacket but the last carries SensorCapabilities::maxFragment bytes.
 	// 245 = ESP-NOW max frame (250) minus DataPacket header (5 bytes).
 	static const uint8_t DATA_PAYLOAD_MAX_SIZE = 245;
 
@@ -51,4 +96,60 @@ namespace crt
 		uint8_t payload[DATA_PAYLOAD_MAX_SIZE];
 	} __attribute__((packed));
 
+	// Sensor -> server, after the DataPackets of a POLL with POLL_FLAG_PARITY.
+	// payload is the XOR of all DataPacket payloads (shorter ones zero-padded),
+	// from which the server rebuilds a single lost DataPacket without re-polling.
+	// Every DataPacket but the last carries maxFragment bytes, so
+	// lastPayloadSize completes the layout.
+	struct DataParityPacket
+	{
+		MessageType messageType;
+		uint8_t sensorId;
+		uint8_t totalPackets;		// number of DataPackets covered
+		uint8_t lastPayloadSize;	// payloadSize of the last DataPacket
+		uint8_t payloadSize;
+		uint8_t payload[DATA_PAYLOAD_MAX_SIZE];
+	} __attribute__((packed));
+
+	// --- Between servers: a shard server forwards its sensors to a root server ---
+
+	// Shard server -> root server, at the start of every uplink.
+	// The shard owns the sensor ids firstSensorId..lastSensorId (at most 32).
+	struct ShardSummaryPacket
+	{
+		MessageType messageType;
+		uint8_t shardId;		// 1..
+		uint16_t cycle;			// incremented per uplink; a repeated one is a duplicate
+		uint8_t firstSensorId;
+		uint8_t lastSensorId;
+		uint32_t registeredMask;	// bit i: sensor firstSensorId + i is registered
+	} __attribute__((packed));
+
+	// ShardDeltaPacket::flags
+	static const uint8_t SHARD_FLAG_KEYFRAME = 0x01;	// all samples; not relative to baseSequence
+	static const uint8_t SHARD_FLAG_LAST = 0x02;		// last frame of this sequence
+
+	// 236 = ESP-NOW max frame (250) minus ShardDeltaPacket header (14 bytes).
+	static const uint8_t SHARD_PAYLOAD_MAX_SIZE = 236;
+
+	// Shard server -> root server, after the summary: the measurement array of sensorId,
+	// or only the samples that changed since sequence baseSequence, in one or more frames.
+	// The payload is a list of runs: first sample (uint16_t), number of samples (uint8_t)
+	// and their sampleWidth bytes each, little-endian (see crt_ShardDeltaEncoder.h).
+	struct ShardDeltaPacket
+	{
+		MessageType messageType;
+		uint8_t shardId;
+		uint8_t sensorId;
+		uint8_t hopCount;		// between the shard server and the sensor
+		uint16_t sequence;		// of the measurement array at the shard server
+		uint16_t baseSequence;	// the runs change this one into sequence
+		uint8_t flags;			// SHARD_FLAG_* bits
+		uint8_t frameIndex;		// 0.. within this sequence
+		uint8_t sampleWidth;
+		uint16_t sampleCount;	// of the whole array
+		uint8_t payloadSize;
+		uint8_t payload[SHARD_PAYLOAD_MAX_SIZE];
+	} __attribute__((packed));
+
 } // end namespace crt
@@ -0,0 +1,125 @@
+// by Marius Versteegen, 2025
+// AllMeasurementsResponse: the body of /api/allmeasurements, full or delta:
+//   {"generation":1745,"epoch":2854210187,"delta":true,"layout":3,
+//    "sensors":[<fragment>,<fragment>],"offline":[5],"removed":[9]}
+//
+// The fragments come from the MeasurementJsonCache. The body is never built in
+// one buffer: after end() has given the content length for the HTTP header,
+// send() hands the head, the fragments and the tail to the sink one by one.
+// The sink is any callable taking (const char* data, size_t length); ServerNode
+// passes server.sendContent(), and the DeltaSyncBench checks the body instead.
+//
+// A response is a delta response if the request has a since=<generation> of
+// the current boot (its epoch=<epoch> is the current one, or absent), which is
+// not newer than the current generation. It then only holds the sensors that
+// changed after since. Otherwise it is a full response, with every sensor.
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+
+namespace crt
+{
+	template<uint8_t MAX_SENSORS> class AllMeasurementsResponse
+	{
+	private:
+		static const uint16_t MAX_ID_LIST = 4 * MAX_SENSORS + 1; // ids, comma-separated
+
+		const char* fragments[MAX_SENSORS];
+		uint16_t lengths[MAX_SENSORS];
+		uint8_t nofFragments;
+		char offline[MAX_ID_LIST];
+		char removed[MAX_ID_LIST];
+		int offlineLength;
+		int removedLength;
+		char head[112];
+		int headLength;
+		char tail[2 * MAX_ID_LIST + 32];
+		int tailLength;
+		bool delta;
+		uint32_t since;
+
+		static int appendId(char* list, int length, uint8_t id)
+		{
+			return length + sprintf(list + length, length > 0 ? ",%u" : "%u", (unsigned)id);
+		}
+
+	public:
+		AllMeasurementsResponse() : nofFragments(0), offlineLength(0), removedLength(0),
+									headLength(0), tailLength(0), delta(false), since(0)
+		{
+			offline[0] = '\0';
+			removed[0] = '\0';
+		}
+
+		// hasSince/requestedSince: the since argument of the request. sameBoot: the request
+		// has no epoch argument, or the current epoch.
+		void begin(bool hasSince, uint32_t requestedSince, bool sameBoot,
+				   uint32_t generation, uint32_t epoch, uint32_t layout)
+		{
+			delta = hasSince && sameBoot && requestedSince <= generation;
+			since = delta ? requestedSince : 0;
+			nofFragments = 0;
+			offlineLength = 0;
+			removedLength = 0;
+			offline[0] = '\0';
+			removed[0] = '\0';
+			headLength = snprintf(head, sizeof(head), "{\"generation\":%lu,\"epoch\":%lu,\"delta\":%s,\"layout\":%lu,\"sensors\":[",
+								  (unsigned long)generation, (unsigned long)epoch, delta ? "true" : "false",
+								  (unsigned long)layout);
+		}
+
+		bool isDelta() const
+		{
+			return delta;
+		}
+
+		// Whether a sensor that last changed at sensorGeneration is in the response.
+		// Only for those, the caller needs to get the fragment from the cache.
+		bool includes(uint32_t sensorGeneration) const
+		{
+			return sensorGeneration > since;
+		}
+
+		// Adds a sensor that includes() accepted, in the order of the ids. fragment is
+		// nullptr if the sensor has no values (any more): a delta response then lists it
+		// in "removed", a full response leaves it out. A sensor with values that is not
+		// registered (any more) is listed in "offline" as well.
+		void add(uint8_t id, const char* fragment, uint16_t length, bool registered)
+		{
+			if (fragment == nullptr)
+			{
+				if (delta) removedLength = appendId(removed, removedLength, id);
+				return;
+			}
+			if (!registered) offlineLength = appendId(offline, offlineLength, id);
+			fragments[nofFragments] = fragment;
+			lengths[nofFragments] = length;
+			nofFragments++;
+		}
+
+		// Completes the response. Returns its content length.
+		size_t end()
+		{
+			tailLength = snprintf(tail, sizeof(tail), "],\"offline\":[%s],\"removed\":[%s]}", offline, removed);
+			size_t contentLength = headLength + tailLength;
+			for (uint8_t i = 0; i < nofFragments; i++)
+			{
+				contentLength += lengths[i] + (i > 0 ? 1 : 0);
+			}
+			return contentLength;
+		}
+
+		template<typename Sink> void send(Sink& sink)
+		{
+			sink(head, (size_t)headLength);
+			for (uint8_t i = 0; i < nofFragments; i++)
+			{
+				if (i > 0) sink(",", (size_t)1);
+				sink(fragments[i], (size_t)lengths[i]);
+			}
+			sink(tail, (size_t)tailLength);
+		}
+	}; // end class AllMeasurementsResponse
+
+} // end namespace crt
@@ -0,0 +1,329 @@
+// by Marius Versteegen, 2025
+// ApiRouter: compact, allocation-free request router for the /api/* surface.
+//
+// Routes are compiled once at startup into a trie of path segments. The edges
+// of that trie live in a small open-addressing hash table keyed by
+// (parent node, segment hash), so dispatching a path costs one hash probe per
+// segment - independent of how many routes are registered.
+//
+// A segment written as {name:uint} or {name:text} matches any segment and is
+// handed to the handler as a typed path parameter (by position). Literal
+// segments take precedence over parameter segments.
+//
+// Note: route patterns are not copied. Pass string literals (or other strings
+// that outlive the router).
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace crt
+{
+	enum class ParamType : uint8_t
+	{
+		UINT,
+		TEXT
+	};
+
+	class RouteParams
+	{
+	public:
+		static const uint8_t MAX_PARAMS = 4;
+
+	private:
+		const char* texts[MAX_PARAMS];
+		uint8_t lengths[MAX_PARAMS];
+		uint32_t values[MAX_PARAMS];
+		uint8_t nofParams;
+
+	public:
+		RouteParams() : nofParams(0) {}
+
+		void clear() { nofParams = 0; }
+
+		bool add(const char* text, uint8_t length, uint32_t value)
+		{
+			if (nofParams >= MAX_PARAMS) return false;
+			texts[nofParams] = text;
+			lengths[nofParams] = length;
+			values[nofParams] = value;
+			nofParams++;
+			return true;
+		}
+
+		uint8_t count() const { return nofParams; }
+
+		// Value of a {name:uint} parameter.
+		uint32_t getUint(uint8_t index) const
+		{
+			return (index < nofParams) ? values[index] : 0;
+		}
+
+		// Points into the request path: not zero-terminated, use length.
+		const char* getText(uint8_t index, uint8_t& length) const
+		{
+			if (index >= nofParams)
+			{
+				length = 0;
+				return "";
+			}
+			length = lengths[index];
+			return texts[index];
+		}
+	};
+
+	// Default number of trie nodes: 4 per route, but never NO_NODE (255) or more.
+	constexpr uint8_t apiRouterNodes(uint8_t nofRoutes)
+	{
+		return (4u * nofRoutes < 0xFFu) ? (uint8_t)(4u * nofRoutes) : (uint8_t)0xFE;
+	}
+
+	// Edge table size: a power of two with a load factor of at most 0.5.
+	constexpr uint16_t apiRouterEdgeSlots(uint16_t nofNodes)
+	{
+		uint16_t slots = 16;
+		while (slots < 2 * nofNodes) slots <<= 1;
+		return slots;
+	}
+
+	template<typename TARGET, uint8_t MAX_ROUTES, uint8_t MAX_NODES = apiRouterNodes(MAX_ROUTES)> class ApiRouter
+	{
+	public:
+		typedef void (TARGET::*Handler)(const RouteParams& params);
+
+	private:
+		static const uint8_t NO_NODE = 0xFF;
+		static const uint16_t EDGE_SLOTS = apiRouterEdgeSlots(MAX_NODES);
+		static const uint32_t MAX_SEGMENT_LENGTH = 0xFF;
+
+		static_assert(MAX_NODES < NO_NODE, "MAX_NODES must be below 255: node 255 marks an empty slot");
+
+		struct Node
+		{
+			Handler handler;
+			uint8_t paramChild;
+			ParamType paramType;
+		};
+
+		struct Edge
+		{
+			uint8_t parent;		// NO_NODE means: empty slot
+			uint8_t child;
+			uint8_t segmentLength;
+			uint32_t hash;
+			const char* segment;
+		};
+
+		Node nodes[MAX_NODES];
+		uint8_t nofNodes;
+		Edge edges[EDGE_SLOTS];
+		uint8_t nofRoutes;
+
+		static uint32_t hashSegment(uint8_t parent, const char* segment, uint8_t length)
+		{
+			// FNV-1a, seeded with the parent node such that equal segments
+			// below different parents land in different slots.
+			uint32_t hash = 2166136261u ^ parent;
+			for (uint8_t i = 0; i < length; i++)
+			{
+				hash ^= (uint8_t)segment[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+		// Returns the length of the segment starting at path, which ends at '/', '?' or '\0'.
+		// Stops counting past MAX_SEGMENT_LENGTH: such a segment is rejected by the caller.
+		static uint32_t segmentLength(const char* path)
+		{
+			uint32_t length = 0;
+			while (path[length] != '\0' && path[length] != '/' && path[length] != '?' && length <= MAX_SEGMENT_LENGTH)
+			{
+				length++;
+			}
+			return length;
+		}
+
+		uint8_t findLiteralChild(uint8_t parent, const char* segment, uint8_t length) const
+		{
+			uint32_t hash = hashSegment(parent, segment, length);
+			uint16_t slot = hash & (EDGE_SLOTS - 1);
+			for (uint16_t probe = 0; probe < EDGE_SLOTS; probe++)
+			{
+				const Edge& edge = edges[slot];
+				if (edge.parent == NO_NODE)
+				{
+					return NO_NODE;
+				}
+				if (edge.parent == parent && edge.hash == hash && edge.segmentLength == length &&
+					memcmp(edge.segment, segment, length) == 0)
+				{
+					return edge.child;
+				}
+				slot = (slot + 1) & (EDGE_SLOTS - 1);
+			}
+			return NO_NODE;
+		}
+
+		bool insertLiteralChild(uint8_t parent, const char* segment, uint8_t length, uint8_t child)
+		{
+			uint32_t hash = hashSegment(parent, segment, length);
+			uint16_t slot = hash & (EDGE_SLOTS - 1);
+			for (uint16_t probe = 0; probe < EDGE_SLOTS; probe++)
+			{
+				Edge& edge = edges[slot];
+				if (edge.parent == NO_NODE)
+				{
+					edge.parent = parent;
+					edge.child = child;
+					edge.segmentLength = length;
+					edge.hash = hash;
+					edge.segment = segment;
+					return true;
+				}
+				slot = (slot + 1) & (EDGE_SLOTS - 1);
+			}
+			return false;
+		}
+
+		uint8_t newNode()
+		{
+			if (nofNodes >= MAX_NODES) return NO_NODE;
+			nodes[nofNodes] = {nullptr, NO_NODE, ParamType::UINT};
+			return nofNodes++;
+		}
+
+		static bool parseParamPattern(const char* segment, uint8_t length, ParamType& type)
+		{
+			// {name:uint} or {name:text}. A bare {name} is a uint.
+			if (length < 3 || segment[0] != '{' || segment[length - 1] != '}') return false;
+			type = ParamType::UINT;
+			const char* colon = (const char*)memchr(segment, ':', length);
+			if (colon != nullptr)
+			{
+				uint8_t typeLength = (uint8_t)(segment + length - 1 - (colon + 1));
+				if (typeLength == 4 && memcmp(colon + 1, "text", 4) == 0)
+				{
+					type = ParamType::TEXT;
+				}
+			}
+			return true;
+		}
+
+	public:
+		ApiRouter() : nofNodes(0), nofRoutes(0)
+		{
+			for (uint16_t i = 0; i < EDGE_SLOTS; i++)
+			{
+				edges[i].parent = NO_NODE;
+			}
+			newNode(); // root
+		}
+
+		// Parses a decimal unsigned integer of exactly length characters.
+		static bool parseUint(const char* text, uint8_t length, uint32_t& value)
+		{
+			if (length == 0 || length > 10) return false;
+			uint64_t result = 0;
+			for (uint8_t i = 0; i < length; i++)
+			{
+				char c = text[i];
+				if (c < '0' || c > '9') return false;
+				result = result * 10 + (uint64_t)(c - '0');
+			}
+			if (result > 0xFFFFFFFFu) return false;
+			value = (uint32_t)result;
+			return true;
+		}
+
+		// Call during initialisation only. Returns false if the router is full, if the
+		// pattern has more than RouteParams::MAX_PARAMS parameters or a segment longer than
+		// MAX_SEGMENT_LENGTH, or if a parameter has another type than the parameter that an
+		// earlier route has at the same position.
+		bool addRoute(const char* pattern, Handler handler)
+		{
+			if (nofRoutes >= MAX_ROUTES) return false;
+
+			uint8_t node = 0;
+			uint8_t nofParams = 0;
+			const char* p = pattern;
+			while (*p != '\0')
+			{
+				if (*p == '/') { p++; continue; }
+				uint32_t fullLength = segmentLength(p);
+				if (fullLength > MAX_SEGMENT_LENGTH) return false;
+				uint8_t length = (uint8_t)fullLength;
+
+				ParamType type;
+				uint8_t child;
+				if (parseParamPattern(p, length, type))
+				{
+					if (++nofParams > RouteParams::MAX_PARAMS) return false;
+					child = nodes[node].paramChild;
+					if (child == NO_NODE)
+					{
+						child = newNode();
+						if (child == NO_NODE) return false;
+						nodes[node].paramChild = child;
+						nodes[node].paramType = type;
+					}
+					else if (nodes[node].paramType != type)
+					{
+						return false;
+					}
+				}
+				else
+				{
+					child = findLiteralChild(node, p, length);
+					if (child == NO_NODE)
+					{
+						child = newNode();
+						if (child == NO_NODE || !insertLiteralChild(node, p, length, child)) return false;
+					}
+				}
+				node = child;
+				p += length;
+			}
+
+			nodes[node].handler = handler;
+			nofRoutes++;
+			return true;
+		}
+
+		// Matches a request path (an optional query string is ignored).
+		// On success, handler and params are filled in.
+		bool match(const char* path, Handler& handler, RouteParams& params) const
+		{
+			params.clear();
+			uint8_t node = 0;
+			const char* p = path;
+			while (*p != '\0' && *p != '?')
+			{
+				if (*p == '/') { p++; continue; }
+				uint32_t fullLength = segmentLength(p);
+				if (fullLength > MAX_SEGMENT_LENGTH) return false;
+				uint8_t length = (uint8_t)fullLength;
+
+				uint8_t child = findLiteralChild(node, p, length);
+				if (child == NO_NODE)
+				{
+					child = nodes[node].paramChild;
+					if (child == NO_NODE) return false;
+
+					uint32_t value = 0;
+					if (nodes[node].paramType == ParamType::UINT && !parseUint(p, length, value)) return false;
+					if (!params.add(p, length, value)) return false;
+				}
+				node = child;
+				p += length;
+			}
+
+			if (nodes[node].handler == nullptr) return false;
+			handler = nodes[node].handler;
+			return true;
+		}
+
+		uint8_t getNofRoutes() const { return nofRoutes; }
+	};
+
+} // end namespace crt
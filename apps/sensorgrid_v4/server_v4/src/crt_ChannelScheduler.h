@@ -0,0 +1,223 @@
+// by Marius Versteegen, 2025
+// ChannelScheduler: spreads the sensors over channel groups, one group per Wi-Fi channel.
+//
+// Frames on different (non-overlapping) channels do not compete for airtime.
+// A server with one radio visits the groups in turn. That does not add airtime,
+// but it moves sensors away from a channel that is busy with other traffic.
+// With several radios (as in the ChannelScaleSimulation), every radio serves
+// its own groups at the same time (group g on radio g % nofRadios), so the
+// sample throughput grows with the number of radios.
+//
+// Every sensor starts in group 0, the home channel on which it registered.
+// findMove() proposes one sensor to move when that makes the busiest radio
+// markedly less busy. The load of a group is the expected reply time of its
+// sensors, times the congestion of its channel: how much longer than
+// expected the replies on it take (measured with onReply()). A radio that
+// visits more than one group also spends switchUs per group per round.
+// Only sensors that can move (direct, FEATURE_CHANNEL_HOP) are moved.
+//
+// Free of ESP-NOW calls, such that the ChannelScaleSimulation test can run it as well.
+
+#pragma once
+#include <cstdint>
+
+namespace crt
+{
+	template<uint8_t MAX_SENSORS, uint8_t MAX_CHANNELS> class ChannelScheduler
+	{
+	public:
+		static const uint8_t NO_GROUP = 0xFF;
+		static const uint32_t UNIT = 256;	// congestion 1.0: replies take as long as expected
+		static const uint32_t MAX_CONGESTION = 4 * UNIT;	// a timeout counts as a reply that took 4 times as long
+		static const uint8_t HOLD_ROUNDS = 32;	// a sensor that moved stays for this many calls of findMove()
+
+	private:
+		struct Member
+		{
+			uint8_t group;		// NO_GROUP: not a member
+			bool movable;
+			uint8_t holdRounds;
+			uint32_t replyUs;	// expected duration of a POLL and its reply
+		};
+
+		uint8_t channels[MAX_CHANNELS];	// group -> channel; group 0 is the home channel
+		uint8_t nofChannels;
+		uint8_t nofRadios;
+		uint32_t switchUs;
+		Member members[MAX_SENSORS + 1];	// indexed 1..MAX_SENSORS
+		uint32_t congestion[MAX_CHANNELS];	// in UNITs
+		uint32_t nofMoves;
+
+		uint32_t costOf(uint8_t sensorId, uint8_t group) const
+		{
+			return (uint32_t)((uint64_t)members[sensorId].replyUs * congestion[group] / UNIT);
+		}
+
+		// The load of every radio (its groups plus switching between them), as it is
+		// or after moving sensorId to toGroup.
+		void radioLoads(uint32_t* loadUs, uint8_t sensorId, uint8_t toGroup) const
+		{
+			uint8_t occupied[MAX_CHANNELS] = {};
+			for (uint8_t r = 0; r < nofRadios; r++) loadUs[r] = 0;
+			for (uint8_t id = 1; id <= MAX_SENSORS; id++)
+			{
+				uint8_t g = (id == sensorId && toGroup != NO_GROUP) ? toGroup : members[id].group;
+				if (g == NO_GROUP) continue;
+				loadUs[getRadio(g)] += costOf(id, g);
+				occupied[g] = 1;
+			}
+			uint8_t groupsOf[MAX_CHANNELS] = {};
+			for (uint8_t g = 0; g < nofChannels; g++) groupsOf[getRadio(g)] += occupied[g];
+			for (uint8_t r = 0; r < nofRadios; r++)
+			{
+				if (groupsOf[r] > 1) loadUs[r] += groupsOf[r] * switchUs;
+			}
+		}
+
+		uint32_t maxOf(const uint32_t* loadUs) const
+		{
+			uint32_t max = 0;
+			for (uint8_t r = 0; r < nofRadios; r++)
+			{
+				if (loadUs[r] > max) max = loadUs[r];
+			}
+			return max;
+		}
+
+	public:
+		// switchUs: the time it takes a radio to change channels.
+		ChannelScheduler(uint8_t homeChannel, uint32_t switchUs, uint8_t nofRadios = 1)
+			: nofChannels(1), nofRadios(nofRadios < 1 ? 1 : (nofRadios > MAX_CHANNELS ? MAX_CHANNELS : nofRadios)),
+			  switchUs(switchUs), nofMoves(0)
+		{
+			channels[0] = homeChannel;
+			for (uint8_t g = 0; g < MAX_CHANNELS; g++) congestion[g] = UNIT;
+			for (uint8_t id = 0; id <= MAX_SENSORS; id++) members[id] = {NO_GROUP, false, 0, 0};
+		}
+
+		// Adds a channel group. Returns false if there is no room, or if it has that channel already.
+		bool addChannel(uint8_t channel)
+		{
+			if (nofChannels >= MAX_CHANNELS || channel == 0) return false;
+			for (uint8_t g = 0; g < nofChannels; g++)
+			{
+				if (channels[g] == channel) return false;
+			}
+			channels[nofChannels++] = channel;
+			return true;
+		}
+
+		bool isEnabled() const { return nofChannels > 1; }
+		uint8_t getNofGroups() const { return nofChannels; }
+		uint8_t getChannel(uint8_t group) const { return channels[group]; }
+		uint8_t getRadio(uint8_t group) const { return group % nofRadios; }
+		uint8_t getNofRadios() const { return nofRadios; }
+
+		// sensorId (re-)registered on the home channel.
+		void add(uint8_t sensorId, uint32_t replyUs, bool movable)
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS) return;
+			members[sensorId] = {0, movable, 0, replyUs};
+		}
+
+		void remove(uint8_t sensorId)
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS) return;
+			members[sensorId].group = NO_GROUP;
+		}
+
+		uint8_t getGroup(uint8_t sensorId) const
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS) return NO_GROUP;
+			return members[sensorId].group;
+		}
+
+		// sensorId has moved (its reply came in on the channel of group).
+		void setGroup(uint8_t sensorId, uint8_t group)
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS || members[sensorId].group == NO_GROUP || group >= nofChannels) return;
+			if (members[sensorId].group == group) return;
+			members[sensorId].group = group;
+			members[sensorId].holdRounds = HOLD_ROUNDS;
+			nofMoves++;
+		}
+
+		// A reply of sensorId, in its group, took measuredUs (from its first POLL, so
+		// timeouts and re-POLLs count as well). Averaged over about 16 replies.
+		void onReply(uint8_t sensorId, uint32_t measuredUs)
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS) return;
+			const Member& m = members[sensorId];
+			if (m.group == NO_GROUP || m.replyUs == 0) return;
+			uint64_t ratio = (uint64_t)measuredUs * UNIT / m.replyUs;
+			if (ratio > MAX_CONGESTION) ratio = MAX_CONGESTION;
+			int32_t error = (int32_t)ratio - (int32_t)congestion[m.group];
+			congestion[m.group] = (uint32_t)((int32_t)congestion[m.group] + error / 16);
+		}
+
+		// Time one round of polling group takes: the expected replies of its members, times its congestion.
+		uint32_t getLoadUs(uint8_t group) const
+		{
+			uint32_t load = 0;
+			for (uint8_t id = 1; id <= MAX_SENSORS; id++)
+			{
+				if (members[id].group == group) load += costOf(id, group);
+			}
+			return load;
+		}
+
+		uint32_t getCongestion(uint8_t group) const { return congestion[group]; }
+
+		uint8_t getNofMembers(uint8_t group) const
+		{
+			uint8_t n = 0;
+			for (uint8_t id = 1; id <= MAX_SENSORS; id++)
+			{
+				if (members[id].group == group) n++;
+			}
+			return n;
+		}
+
+		// Proposes the move that lowers the load of the busiest radio the most, if that
+		// gains at least a quarter of the moved sensor's cost. Returns false if no move
+		// does. Called once per round; sensors that moved in the last HOLD_ROUNDS rounds
+		// are left alone, so they do not move back and forth on noise in the congestion.
+		bool findMove(uint8_t& sensorId, uint8_t& group)
+		{
+			if (!isEnabled()) return false;
+			for (uint8_t id = 1; id <= MAX_SENSORS; id++)
+			{
+				if (members[id].holdRounds > 0) members[id].holdRounds--;
+			}
+			uint32_t loadUs[MAX_CHANNELS];
+			radioLoads(loadUs, 0, NO_GROUP);
+			uint32_t maxLoad = maxOf(loadUs);
+
+			uint32_t bestGain = 0;
+			for (uint8_t id = 1; id <= MAX_SENSORS; id++)
+			{
+				const Member& m = members[id];
+				if (m.group == NO_GROUP || !m.movable || m.holdRounds > 0) continue;
+				uint32_t fromCost = costOf(id, m.group);
+				for (uint8_t g = 0; g < nofChannels; g++)
+				{
+					if (g == m.group) continue;
+					radioLoads(loadUs, id, g);
+					uint32_t newMax = maxOf(loadUs);
+					if (newMax >= maxLoad) continue;
+					uint32_t gain = maxLoad - newMax;
+					if (gain * 4 > fromCost && gain > bestGain)
+					{
+						bestGain = gain;
+						sensorId = id;
+						group = g;
+					}
+				}
+			}
+			return bestGain > 0;
+		}
+
+		uint32_t getNofMoves() const { return nofMoves; }
+	}; // end class ChannelScheduler
+
+} // end namespace crt
@@ -0,0 +1,158 @@
+// by Marius Versteegen, 2025
+// FileLogStorage: ILogStorage with one file per segment in a directory,
+// through stdio. On the server the directory is on LittleFS (mounted by
+// LITTLEFS.begin() under LITTLEFS_ROOT); on a PC any directory will do, which is
+// how the MeasurementLogBench runs the log format and its recovery on the host.
+//
+// Keeps the file of the segment that is appended to, and the one that was
+// read last, open between calls.
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "crt_ILogStorage.h"
+
+// Where LITTLEFS.begin() mounts the file system. The host build of the tests
+// points it at a directory of its own.
+#ifndef LITTLEFS_ROOT
+#define LITTLEFS_ROOT "/littlefs"
+#endif
+
+namespace crt
+{
+	class FileLogStorage : public ILogStorage
+	{
+	private:
+		static const uint32_t NO_SEGMENT = 0xFFFFFFFF;
+
+		char directory[48];
+		FILE* appendFile;
+		uint32_t appendSegment;
+		FILE* readFile;
+		uint32_t readSegment;
+
+		void makePath(char* path, size_t size, uint32_t segment) const
+		{
+			snprintf(path, size, "%s/%08lx.seg", directory, (unsigned long)segment);
+		}
+
+		void closeAppendFile()
+		{
+			if (appendFile != nullptr) fclose(appendFile);
+			appendFile = nullptr;
+			appendSegment = NO_SEGMENT;
+		}
+
+		void closeReadFile()
+		{
+			if (readFile != nullptr) fclose(readFile);
+			readFile = nullptr;
+			readSegment = NO_SEGMENT;
+		}
+
+	public:
+		FileLogStorage(const char* dir) : appendFile(nullptr), appendSegment(NO_SEGMENT),
+										  readFile(nullptr), readSegment(NO_SEGMENT)
+		{
+			snprintf(directory, sizeof(directory), "%s", dir);
+		}
+
+		~FileLogStorage()
+		{
+			closeAppendFile();
+			closeReadFile();
+		}
+
+		// Creates the directory if needed. The file system must be mounted.
+		bool begin()
+		{
+			struct stat st;
+			return stat(directory, &st) == 0 || mkdir(directory, 0755) == 0;
+		}
+
+		bool create(uint32_t segment) /*override*/
+		{
+			char path[64];
+			makePath(path, sizeof(path), segment);
+			FILE* f = fopen(path, "wb");
+			if (f == nullptr) return false;
+			fclose(f);
+			return true;
+		}
+
+		bool append(uint32_t segment, const uint8_t* data, uint32_t length) /*override*/
+		{
+			if (appendSegment != segment)
+			{
+				closeAppendFile();
+				char path[64];
+				makePath(path, sizeof(path), segment);
+				appendFile = fopen(path, "ab");
+				if (appendFile == nullptr) return false;
+				appendSegment = segment;
+			}
+			if (readSegment == segment) closeReadFile(); // would not see the new bytes
+
+			bool ok = fwrite(data, 1, length, appendFile) == length && fflush(appendFile) == 0 &&
+					  fsync(fileno(appendFile)) == 0;
+			if (!ok) closeAppendFile();
+			return ok;
+		}
+
+		bool read(uint32_t segment, uint32_t offset, uint8_t* data, uint32_t length) /*override*/
+		{
+			if (readSegment != segment)
+			{
+				closeReadFile();
+				char path[64];
+				makePath(path, sizeof(path), segment);
+				readFile = fopen(path, "rb");
+				if (readFile == nullptr) return false;
+				readSegment = segment;
+			}
+			return fseek(readFile, (long)offset, SEEK_SET) == 0 && fread(data, 1, length, readFile) == length;
+		}
+
+		uint32_t getSize(uint32_t segment) /*override*/
+		{
+			char path[64];
+			makePath(path, sizeof(path), segment);
+			struct stat st;
+			return (stat(path, &st) == 0) ? (uint32_t)st.st_size : 0;
+		}
+
+		bool remove(uint32_t segment) /*override*/
+		{
+			if (appendSegment == segment) closeAppendFile();
+			if (readSegment == segment) closeReadFile();
+			char path[64];
+			makePath(path, sizeof(path), segment);
+			return unlink(path) == 0;
+		}
+
+		uint16_t list(uint32_t* segments, uint16_t maxSegments) /*override*/
+		{
+			DIR* dir = opendir(directory);
+			if (dir == nullptr) return 0;
+
+			uint16_t count = 0;
+			struct dirent* entry;
+			while ((entry = readdir(dir)) != nullptr)
+			{
+				char* end;
+				unsigned long segment = strtoul(entry->d_name, &end, 16);
+				if (end != entry->d_name + 8 || strcmp(end, ".seg") != 0) continue;
+				if (count < maxSegments) segments[count] = (uint32_t)segment;
+				count++;
+			}
+			closedir(dir);
+			return count;
+		}
+	};
+
+} // end namespace crt
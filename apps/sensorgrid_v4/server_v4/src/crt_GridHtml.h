@@ -1,6 +1,17 @@
 // by Marius Versteegen, 2025
-// Grid visualization page: shows sensors 1-4 measurements as circles
+// Grid visualization page: shows the measurements of every sensor as circles
 // arranged in diamond patterns, with histograms and statistics tables.
+//
+// Which sensors there are, their names, units and order come from /api/layout.
+// The page fetches it once, and again when /api/allmeasurements reports
+// another layout generation.
+//
+// The diamonds and histograms are drawn on a <canvas> per sensor. Colours come
+// from lookup tables of 256 levels, and only the circles whose value or colour
+// level changed are painted again, in the next animation frame, and only for
+// sensors that are on screen. /grid?bench=<sensors> replaces the server by
+// synthetic data for that many sensors and reports the time per frame
+// (tools/grid_render_bench.py runs it in a headless browser).
 
 #pragma once
 
@@ -63,7 +74,7 @@ namespace crt
     }
     .sensor-layout {
       display: grid;
-      grid-template-columns: 1fr 1fr 1fr 1fr;
+      grid-template-columns: repeat(4, minmax(0, 1fr)); /* the columns of /api/layout */
       gap: 0.5rem;
     }
     .sensor-widget {
@@ -77,54 +88,22 @@ namespace crt
       margin: 0 0 0.3rem;
       font-size: 0.8rem;
     }
+    .sensor-widget h3 .unit {
+      font-weight: normal;
+      color: #888;
+    }
+    .sensor-widget.offline {
+      opacity: 0.5;
+    }
     .sensor-widget .no-data {
       text-align: center;
       color: #999;
       padding: 2rem 0;
     }
-    .grid-container {
-      display: flex;
-      flex-direction: column;
-      align-items: center;
-      gap: 0;
+    .grid-canvas {
+      display: block;
       margin: 0 auto;
     }
-    .row {
-      display: flex;
-      gap: 2px;
-      justify-content: center;
-      margin-top: -1px;
-    }
-    .row:first-child {
-      margin-top: 0;
-    }
-    .cell {
-      width: 22px;
-      height: 22px;
-      border-radius: 50%;
-      border: 1px solid #ccc;
-      display: flex;
-      align-items: center;
-      justify-content: center;
-      font-size: 0.4rem;
-      color: #888;
-      transition: background 0.2s ease-out;
-    }
-    .histogram {
-      max-width: 100%;
-      margin: 0.3rem auto 0;
-      display: flex;
-      align-items: flex-end;
-      gap: 1px;
-      height: 40px;
-    }
-    .hist-bar {
-      flex: 1;
-      background: #555;
-      border-radius: 1px 1px 0 0;
-      transition: height 0.2s ease-out;
-      min-height: 1px;
-    }
     .hist-axis {
       margin: 2px auto 0;
       display: flex;
@@ -165,36 +144,7 @@ namespace crt
       <button class="toggle-btn" id="btnNormalize" onclick="toggleNormalize()">Normalize</button>
       <button class="toggle-btn" id="btnColorize" onclick="toggleColorize()">Colorize</button>
     </div>
-    <div class="sensor-layout">
-      <div class="sensor-widget" id="sw1">
-        <h3>Sensor 1</h3>
-        <div class="grid-container" id="grid1"></div>
-        <div class="histogram" id="hist1"></div>
-        <div class="hist-axis"><span>0</span><span>512</span><span>1023</span></div>
-        <table class="stats-table"><tr><th>max</th><th>average</th><th>sqrt(var)</th></tr><tr><td id="max1">-</td><td id="avg1">-</td><td id="std1">-</td></tr></table>
-      </div>
-      <div class="sensor-widget" id="sw2">
-        <h3>Sensor 2</h3>
-        <div class="grid-container" id="grid2"></div>
-        <div class="histogram" id="hist2"></div>
-        <div class="hist-axis"><span>0</span><span>512</span><span>1023</span></div>
-        <table class="stats-table"><tr><th>max</th><th>average</th><th>sqrt(var)</th></tr><tr><td id="max2">-</td><td id="avg2">-</td><td id="std2">-</td></tr></table>
-      </div>
-      <div class="sensor-widget" id="sw3">
-        <h3>Sensor 3</h3>
-        <div class="grid-container" id="grid3"></div>
-        <div class="histogram" id="hist3"></div>
-        <div class="hist-axis"><span>0</span><span>512</span><span>1023</span></div>
-        <table class="stats-table"><tr><th>max</th><th>average</th><th>sqrt(var)</th></tr><tr><td id="max3">-</td><td id="avg3">-</td><td id="std3">-</td></tr></table>
-      </div>
-      <div class="sensor-widget" id="sw4">
-        <h3>Sensor 4</h3>
-        <div class="grid-container" id="grid4"></div>
-        <div class="histogram" id="hist4"></div>
-        <div class="hist-axis"><span>0</span><span>512</span><span>1023</span></div>
-        <table class="stats-table"><tr><th>max</th><th>average</th><th>sqrt(var)</th></tr><tr><td id="max4">-</td><td id="avg4">-</td><td id="std4">-</td></tr></table>
-      </div>
-    </div>
+    <div class="sensor-layout" id="layout"></div>
     <div id="status">...</div>
   </div>
 
@@ -202,37 +152,64 @@ namespace crt
     const MAX_VALUE = 1023;
     const POLL_MS = 100;
     const NUM_BINS = 50;
-    const SENSOR_IDS = [1, 2, 3, 4];
+    const LEVELS = 256;
+    const CELL = 24;      // circle diameter, including its 1px border
+    const GAP = 2;        // between the circles of a row
+    const ROW_PITCH = 23; // rows overlap by 1px (hex packing)
+    const HIST_GAP = 5, HIST_HEIGHT = 40;
+    const BENCH_FRAMES = 300;
 
     let normalized = false;
     let colorized = false;
+    let generation = -1; // last generation received; -1: ask for a full update
+    let epoch = 0;       // of the server boot that generation is from
+    let layoutVersion = -1; // "layout" of the /api/layout response the widgets were built from
+    let columns = 0;
 
-    // Per-sensor state
-    const sensors = {};
-    SENSOR_IDS.forEach(id => {
-      sensors[id] = {
-        gridEl: document.getElementById("grid" + id),
-        histEl: document.getElementById("hist" + id),
-        maxEl: document.getElementById("max" + id),
-        avgEl: document.getElementById("avg" + id),
-        stdEl: document.getElementById("std" + id),
-        cells: [],
-        histBars: [],
-        currentCount: 0,
-        lastValues: []
-      };
-    });
+    const layoutEl = document.getElementById("layout");
     const statusEl = document.getElementById("status");
+    const sensors = new Map(); // id -> per-sensor state, see createSensor()
+    let drawScheduled = false;
+
+    // Fill and text colour of every level, in gray-scale and in colour.
+    function buildLut(color) {
+      const fill = new Array(LEVELS), text = new Array(LEVELS);
+      for (let i = 0; i < LEVELS; i++) {
+        const t = i / (LEVELS - 1);
+        let cr, cg, cb;
+        if (!color) {
+          cr = cg = cb = Math.round(255 * t);
+        } else if (t < 0.25) { // black -> blue -> green -> yellow -> red
+          const p = t / 0.25;
+          cr = 0; cg = 0; cb = Math.round(255 * p);
+        } else if (t < 0.5) {
+          const p = (t - 0.25) / 0.25;
+          cr = 0; cg = Math.round(255 * p); cb = Math.round(255 * (1 - p));
+        } else if (t < 0.75) {
+          const p = (t - 0.5) / 0.25;
+          cr = Math.round(255 * p); cg = 255; cb = 0;
+        } else {
+          const p = (t - 0.75) / 0.25;
+          cr = 255; cg = Math.round(255 * (1 - p)); cb = 0;
+        }
+        const lum = 0.299 * cr + 0.587 * cg + 0.114 * cb;
+        fill[i] = `rgb(${cr},${cg},${cb})`;
+        text[i] = lum < 128 ? "#ddd" : "#444";
+      }
+      return { fill, text };
+    }
+    const GRAY_LUT = buildLut(false);
+    const COLOR_LUT = buildLut(true);
 
     function toggleNormalize() {
       normalized = !normalized;
       document.getElementById("btnNormalize").classList.toggle("active", normalized);
-      recolorAll();
+      markAllDirty();
     }
     function toggleColorize() {
       colorized = !colorized;
       document.getElementById("btnColorize").classList.toggle("active", colorized);
-      recolorAll();
+      markAllDirty();
     }
 
     function computeRowSizes(n) {
@@ -253,176 +230,429 @@ namespace crt
       return rows;
     }
 
-    function createGrid(s, count) {
-      s.gridEl.innerHTML = "";
-      s.cells = [];
-      s.currentCount = count;
-      const rowSizes = computeRowSizes(count);
-      for (const size of rowSizes) {
-        const rowEl = document.createElement("div");
-        rowEl.className = "row";
-        for (let i = 0; i < size; i++) {
-          const cell = document.createElement("div");
-          cell.className = "cell";
-          cell.textContent = "?";
-          rowEl.appendChild(cell);
-          s.cells.push(cell);
-        }
-        s.gridEl.appendChild(rowEl);
+    const visibility = new IntersectionObserver(entries => {
+      for (const e of entries) {
+        const s = sensors.get(+e.target.dataset.id);
+        if (!s) continue; // removed from the layout
+        s.visible = e.isIntersecting;
+        if (s.visible && s.dirty) scheduleDraw();
       }
+    }, { rootMargin: "200px" });
+
+    function createSensor(id) {
+      const widget = document.createElement("div");
+      widget.className = "sensor-widget";
+      widget.dataset.id = id;
+      widget.innerHTML = `<h3><span class="name"></span> <span class="unit"></span></h3>
+        <div class="no-data" hidden>No data</div>
+        <canvas class="grid-canvas"></canvas>
+        <div class="hist-axis"><span>0</span><span>512</span><span>1023</span></div>
+        <table class="stats-table"><tr><th>max</th><th>average</th><th>sqrt(var)</th></tr><tr><td>-</td><td>-</td><td>-</td></tr></table>`;
+      layoutEl.appendChild(widget); // placed by its CSS order, see applyLayout()
+
+      const canvas = widget.querySelector(".grid-canvas"); // the diamond, and the histogram below it
+      const cells = widget.querySelectorAll("td");
+      const s = {
+        id, widget, canvas, ctx: canvas.getContext("2d"),
+        nameEl: widget.querySelector(".name"), unitEl: widget.querySelector(".unit"),
+        noDataEl: widget.querySelector(".no-data"),
+        maxEl: cells[0], avgEl: cells[1], stdEl: cells[2],
+        count: 0,
+        values: new Int32Array(0),
+        drawnValues: new Int32Array(0), // what each circle shows now
+        drawnLevels: new Int16Array(0), // -1: not drawn
+        cellX: null, cellY: null, cellPx: 0, fontPx: 0,
+        histY: 0, // top of the histogram, in device pixels
+        min: 0, max: 0,
+        histCounts: new Int32Array(NUM_BINS),
+        dirty: false, statsDirty: false, visible: true
+      };
+      sensors.set(id, s);
+      visibility.observe(widget);
+      return s;
     }
 
-    function createHistogram(s) {
-      s.histEl.innerHTML = "";
-      s.histBars = [];
-      for (let i = 0; i < NUM_BINS; i++) {
-        const bar = document.createElement("div");
-        bar.className = "hist-bar";
-        bar.style.height = "1px";
-        s.histEl.appendChild(bar);
-        s.histBars.push(bar);
+    // Builds the widgets from an /api/layout response: one per sensor in it, in the order
+    // of their positions, and removes those of sensors that are no longer in it.
+    function applyLayout(layout) {
+      const ids = new Set();
+      for (const d of layout.sensors) {
+        ids.add(d.id);
+        const s = sensors.get(d.id) || createSensor(d.id);
+        setText(s.nameEl, d.name);
+        setText(s.unitEl, d.unit ? "[" + d.unit + "]" : "");
+        s.widget.style.order = d.position;
+        if (s.count === 0) showNoData(s);
       }
+      for (const s of sensors.values()) {
+        if (ids.has(s.id)) continue;
+        visibility.unobserve(s.widget);
+        s.widget.remove();
+        sensors.delete(s.id);
+      }
+      if (layout.columns !== columns) {
+        columns = layout.columns;
+        layoutEl.style.gridTemplateColumns = "repeat(" + columns + ", minmax(0, 1fr))";
+        relayoutAll(); // the widgets changed width
+      }
+      layoutVersion = layout.layout;
     }
 
-    function updateHistogram(s, values) {
-      const binWidth = Math.ceil((MAX_VALUE + 1) / NUM_BINS);
-      const counts = new Array(NUM_BINS).fill(0);
-      for (const v of values) {
-        const bin = Math.min(Math.floor(v / binWidth), NUM_BINS - 1);
-        counts[bin]++;
+    // Positions the circles for count values, scaled down if the widest row does not fit, and
+    // the histogram below them. The canvas and the circle positions are in device pixels,
+    // rounded, such that the sprites of the atlas are copied without resampling.
+    function layoutGrid(s, count) {
+      const rowSizes = computeRowSizes(count);
+      const widest = rowSizes.reduce((a, b) => Math.max(a, b), 0);
+      const available = Math.max(40, s.widget.clientWidth - 14);
+      const scale = Math.min(1, available / Math.max(1, widest * (CELL + GAP) - GAP));
+      const dpr = window.devicePixelRatio || 1;
+      const cellPx = Math.max(4, Math.round(CELL * scale * dpr));
+      const pitch = (CELL + GAP) * scale * dpr, rowPitch = ROW_PITCH * scale * dpr;
+      const width = Math.round(available * dpr);
+      const gridHeight = Math.ceil((rowSizes.length - 1) * rowPitch) + cellPx + 2;
+      const height = gridHeight + Math.round((HIST_GAP + HIST_HEIGHT) * dpr);
+
+      s.canvas.width = width;
+      s.canvas.height = height;
+      s.canvas.style.width = (width / dpr) + "px";
+      s.canvas.style.height = (height / dpr) + "px";
+
+      s.cellX = new Float32Array(count);
+      s.cellY = new Float32Array(count);
+      let i = 0;
+      rowSizes.forEach((size, r) => {
+        const x0 = (width - (size - 1) * pitch) / 2;
+        for (let c = 0; c < size; c++, i++) {
+          s.cellX[i] = Math.round(x0 + c * pitch - 0.5 * (cellPx % 2)) + 0.5 * (cellPx % 2);
+          s.cellY[i] = Math.round(r * rowPitch + 1 + cellPx / 2 - 0.5 * (cellPx % 2)) + 0.5 * (cellPx % 2);
+        }
+      });
+      s.cellPx = cellPx;
+      s.fontPx = scale * CELL >= 16 ? Math.round(6.4 * scale * dpr) : 0; // no numbers when the circles get too small
+      s.count = count;
+      s.drawnValues = new Int32Array(count);
+      s.drawnLevels = new Int16Array(count).fill(-1);
+      s.histY = gridHeight + Math.round(HIST_GAP * dpr);
+    }
+
+    // Circles of every level (gray and colour) and the numbers 0..MAX_VALUE (in both text
+    // colours), pre-rendered per circle size, such that painting a circle takes two drawImage() calls.
+    const atlases = new Map(); // "<circle px>/<font px>" -> atlas
+    const ATLAS_COLUMNS = 64;
+
+    function makeCanvas(width, height) {
+      if (typeof OffscreenCanvas !== "undefined") return new OffscreenCanvas(width, height);
+      const canvas = document.createElement("canvas");
+      canvas.width = width;
+      canvas.height = height;
+      return canvas;
+    }
+
+    // An ImageBitmap is drawn without taking a snapshot of the source canvas every frame.
+    function toBitmap(canvas) {
+      return canvas.transferToImageBitmap ? canvas.transferToImageBitmap() : canvas;
+    }
+
+    function getAtlas(cellPx, fontPx) {
+      const key = cellPx + "/" + fontPx;
+      let atlas = atlases.get(key);
+      if (atlas) return atlas;
+
+      const size = cellPx + 2, r = cellPx / 2, c = size / 2;
+      const circles = makeCanvas(ATLAS_COLUMNS * size, Math.ceil(2 * LEVELS / ATLAS_COLUMNS) * size);
+      const cctx = circles.getContext("2d");
+      [GRAY_LUT, COLOR_LUT].forEach((lut, m) => {
+        for (let level = 0; level < LEVELS; level++) {
+          const n = m * LEVELS + level;
+          const x = (n % ATLAS_COLUMNS) * size + c, y = Math.floor(n / ATLAS_COLUMNS) * size + c;
+          cctx.beginPath(); cctx.arc(x, y, r + 0.5, 0, 2 * Math.PI); // erases the previous circle
+          cctx.fillStyle = "#fafafa"; cctx.fill();
+          cctx.beginPath(); cctx.arc(x, y, r - 1, 0, 2 * Math.PI);
+          cctx.fillStyle = lut.fill[level]; cctx.fill();
+          cctx.beginPath(); cctx.arc(x, y, r - 0.5, 0, 2 * Math.PI);
+          cctx.strokeStyle = "#ccc"; cctx.lineWidth = 1; cctx.stroke();
+        }
+      });
+
+      let numbers = null, numberW = 0, numberH = 0;
+      if (fontPx > 0) {
+        const font = fontPx + "px system-ui, sans-serif";
+        const measure = makeCanvas(1, 1).getContext("2d");
+        measure.font = font;
+        numberW = Math.ceil(measure.measureText(String(MAX_VALUE)).width) + 2;
+        numberH = fontPx + 4;
+        numberW += (numberW + size) % 2; // same parity as the circles: both land on whole pixels
+        numberH += (numberH + size) % 2;
+        numbers = makeCanvas(ATLAS_COLUMNS * numberW, Math.ceil(2 * (MAX_VALUE + 1) / ATLAS_COLUMNS) * numberH);
+        const nctx = numbers.getContext("2d");
+        nctx.font = font;
+        nctx.textAlign = "center";
+        nctx.textBaseline = "middle";
+        ["#444", "#ddd"].forEach((color, dark) => {
+          nctx.fillStyle = color;
+          for (let v = 0; v <= MAX_VALUE; v++) {
+            const n = dark * (MAX_VALUE + 1) + v;
+            nctx.fillText(v, (n % ATLAS_COLUMNS) * numberW + numberW / 2, Math.floor(n / ATLAS_COLUMNS) * numberH + numberH / 2);
+          }
+        });
       }
-      const maxCount = Math.max(1, ...counts);
-      for (let i = 0; i < NUM_BINS; i++) {
-        const pct = (counts[i] / maxCount) * 100;
-        s.histBars[i].style.height = Math.max(1, pct) + "%";
+      atlas = { circles: toBitmap(circles), size, numbers: numbers && toBitmap(numbers), numberW, numberH };
+      atlases.set(key, atlas);
+      return atlas;
+    }
+
+    // Paints the circles whose value or colour level changed since they were last painted.
+    function drawGrid(s) {
+      const ctx = s.ctx, lut = colorized ? COLOR_LUT : GRAY_LUT, lutOffset = colorized ? LEVELS : 0;
+      const lo = normalized ? s.min : 0, hi = normalized ? s.max : MAX_VALUE;
+      const scale = (LEVELS - 1) / ((hi > lo) ? (hi - lo) : 1);
+      const dpr = window.devicePixelRatio || 1;
+      const atlas = getAtlas(s.cellPx, s.fontPx);
+      const size = atlas.size, sizeCss = size / dpr, half = size / 2;
+      const numberW = atlas.numberW, numberH = atlas.numberH;
+
+      ctx.setTransform(1, 0, 0, 1, 0, 0); // sprites are drawn 1:1 in device pixels
+      for (let i = 0; i < s.count; i++) {
+        const v = s.values[i];
+        let level = Math.round((v - lo) * scale);
+        level = level < 0 ? 0 : level > LEVELS - 1 ? LEVELS - 1 : level;
+        if (v === s.drawnValues[i] && level === s.drawnLevels[i]) continue;
+        s.drawnValues[i] = v;
+        s.drawnLevels[i] = level;
+
+        const x = s.cellX[i], y = s.cellY[i]; // centre, in device pixels
+        const n = lutOffset + level;
+        ctx.drawImage(atlas.circles, (n % ATLAS_COLUMNS) * size, Math.floor(n / ATLAS_COLUMNS) * size, size, size,
+                      x - half, y - half, size, size);
+        if (atlas.numbers === null) continue;
+        const dark = lut.text[level] === "#ddd" ? 1 : 0;
+        if (v >= 0 && v <= MAX_VALUE) {
+          const t = dark * (MAX_VALUE + 1) + v;
+          ctx.drawImage(atlas.numbers, (t % ATLAS_COLUMNS) * numberW, Math.floor(t / ATLAS_COLUMNS) * numberH, numberW, numberH,
+                        x - numberW / 2, y - numberH / 2, numberW, numberH);
+        } else { // wider samples: not in the atlas
+          ctx.font = s.fontPx + "px system-ui, sans-serif";
+          ctx.textAlign = "center";
+          ctx.textBaseline = "middle";
+          ctx.fillStyle = lut.text[level];
+          ctx.fillText(v, x, y);
+        }
       }
     }
 
-    function updateStats(s, values) {
-      if (values.length === 0) return;
-      let max = values[0], sum = 0;
-      for (const v of values) {
-        if (v > max) max = v;
+    function drawStats(s) {
+      const binWidth = Math.ceil((MAX_VALUE + 1) / NUM_BINS);
+      const counts = s.histCounts;
+      counts.fill(0);
+      let sum = 0;
+      for (let i = 0; i < s.count; i++) {
+        const v = s.values[i];
         sum += v;
+        counts[Math.min(Math.floor(v / binWidth), NUM_BINS - 1)]++;
       }
-      const avg = sum / values.length;
+      const avg = sum / s.count;
       let sumSqDiff = 0;
-      for (const v of values) {
-        const d = v - avg;
+      for (let i = 0; i < s.count; i++) {
+        const d = s.values[i] - avg;
         sumSqDiff += d * d;
       }
-      const std = Math.sqrt(sumSqDiff / values.length);
-      s.maxEl.textContent = max;
-      s.avgEl.textContent = avg.toFixed(1);
-      s.stdEl.textContent = std.toFixed(1);
+      setText(s.maxEl, String(s.max));
+      setText(s.avgEl, avg.toFixed(1));
+      setText(s.stdEl, Math.sqrt(sumSqDiff / s.count).toFixed(1));
+
+      const ctx = s.ctx, width = s.canvas.width, height = s.canvas.height - s.histY;
+      let maxCount = 1;
+      for (let b = 0; b < NUM_BINS; b++) if (counts[b] > maxCount) maxCount = counts[b];
+      const barPitch = width / NUM_BINS;
+      ctx.setTransform(1, 0, 0, 1, 0, 0);
+      ctx.clearRect(0, s.histY, width, height);
+      ctx.fillStyle = "#555";
+      for (let b = 0; b < NUM_BINS; b++) {
+        const h = Math.max(1, Math.round(height * counts[b] / maxCount));
+        ctx.fillRect(Math.round(b * barPitch), s.canvas.height - h, Math.max(1, Math.round(barPitch) - 1), h);
+      }
     }
 
-    function colorForValue(v, minV, maxV) {
-      const lo = normalized ? minV : 0;
-      const hi = normalized ? maxV : MAX_VALUE;
-      const r = (hi > lo) ? (hi - lo) : 1;
-      const t = Math.max(0, Math.min(1, (v - lo) / r));
+    function setText(el, text) {
+      if (el.textContent !== text) el.textContent = text;
+    }
 
-      if (!colorized) {
-        const gray = Math.round(255 * t);
-        return { bg: `rgb(${gray},${gray},${gray})`, dark: gray < 128 };
-      }
-      // Color gradient: black -> blue -> green -> yellow -> red
-      let cr, cg, cb;
-      if (t < 0.25) {
-        const p = t / 0.25;
-        cr = 0; cg = 0; cb = Math.round(255 * p);
-      } else if (t < 0.5) {
-        const p = (t - 0.25) / 0.25;
-        cr = 0; cg = Math.round(255 * p); cb = Math.round(255 * (1 - p));
-      } else if (t < 0.75) {
-        const p = (t - 0.5) / 0.25;
-        cr = Math.round(255 * p); cg = 255; cb = 0;
-      } else {
-        const p = (t - 0.75) / 0.25;
-        cr = 255; cg = Math.round(255 * (1 - p)); cb = 0;
-      }
-      const lum = 0.299 * cr + 0.587 * cg + 0.114 * cb;
-      return { bg: `rgb(${cr},${cg},${cb})`, dark: lum < 128 };
+    function showNoData(s) {
+      s.count = 0;
+      s.values = new Int32Array(0);
+      s.canvas.hidden = true;
+      s.noDataEl.hidden = false;
+      setText(s.maxEl, "-"); setText(s.avgEl, "-"); setText(s.stdEl, "-");
     }
 
-    function minMax(values) {
-      let mn = values[0], mx = values[0];
-      for (const v of values) {
+    function updateSensor(id, data) {
+      const s = sensors.get(id);
+      if (!s) return; // not in the layout (yet)
+      if (data.count === 0) {
+        showNoData(s);
+        return;
+      }
+      s.canvas.hidden = false;
+      s.noDataEl.hidden = true;
+      if (s.count !== data.count) {
+        s.values = new Int32Array(data.count);
+        layoutGrid(s, data.count);
+      }
+      let mn = data.values[0], mx = data.values[0];
+      for (let i = 0; i < s.count; i++) {
+        const v = data.values[i];
+        s.values[i] = v;
         if (v < mn) mn = v;
         if (v > mx) mx = v;
       }
-      return [mn, mx];
+      s.min = mn;
+      s.max = mx;
+      s.dirty = true;
+      s.statsDirty = true;
+      scheduleDraw();
     }
 
-    function colorCells(s) {
-      if (s.lastValues.length === 0) return;
-      const [mn, mx] = minMax(s.lastValues);
-      s.lastValues.forEach((v, i) => {
-        if (i < s.cells.length) {
-          const c = colorForValue(v, mn, mx);
-          s.cells[i].style.background = c.bg;
-          s.cells[i].style.color = c.dark ? "#ddd" : "#444";
-        }
-      });
+    function markAllDirty() {
+      for (const s of sensors.values()) if (s.count > 0) s.dirty = true;
+      scheduleDraw();
     }
 
-    function recolorAll() {
-      SENSOR_IDS.forEach(id => colorCells(sensors[id]));
+    function drawDirty() {
+      drawScheduled = false;
+      for (const s of sensors.values()) {
+        if (!s.dirty || !s.visible) continue;
+        drawGrid(s);
+        if (s.statsDirty) drawStats(s);
+        s.dirty = false;
+        s.statsDirty = false;
+      }
     }
 
-    function updateSensor(id, data) {
-      const s = sensors[id];
-      if (data.count === 0) {
-        s.gridEl.innerHTML = '<div class="no-data">No data</div>';
-        s.cells = [];
-        s.currentCount = 0;
-        s.lastValues = [];
-        return;
-      }
-      if (s.currentCount !== data.count) {
-        createGrid(s, data.count);
+    function scheduleDraw() {
+      if (drawScheduled) return;
+      drawScheduled = true;
+      requestAnimationFrame(drawDirty);
+    }
+
+    // Applies an /api/allmeasurements response.
+    function applyResponse(all) {
+      const reported = new Set();
+      const offline = new Set(all.offline || []);
+      for (const data of all.sensors) {
+        reported.add(data.id);
+        updateSensor(data.id, data);
+        const s = sensors.get(data.id);
+        if (s) s.widget.classList.toggle("offline", offline.has(data.id));
       }
-      s.lastValues = data.values;
-      const [mn, mx] = minMax(data.values);
-      data.values.forEach((v, i) => {
-        if (i < s.cells.length) {
-          const c = colorForValue(v, mn, mx);
-          s.cells[i].style.background = c.bg;
-          s.cells[i].textContent = v;
-          s.cells[i].style.color = c.dark ? "#ddd" : "#444";
+      if (!all.delta) {
+        for (const s of sensors.values()) {
+          if (!reported.has(s.id)) updateSensor(s.id, { count: 0, values: [] });
         }
-      });
-      updateHistogram(s, data.values);
-      updateStats(s, data.values);
+      }
+      for (const id of all.removed || []) updateSensor(id, { count: 0, values: [] });
+      generation = all.generation;
+      epoch = all.epoch;
+    }
+
+    async function fetchLayout() {
+      const res = await fetch("/api/layout");
+      if (res.ok) applyLayout(await res.json());
     }
 
     async function fetchAll() {
       try {
-        const res = await fetch("/api/allmeasurements");
+        // Only sensors that changed since our last generation are sent. After a server
+        // restart, the epoch differs, and the server sends everything again.
+        const url = (generation < 0) ? "/api/allmeasurements"
+          : "/api/allmeasurements?since=" + generation + "&epoch=" + epoch;
+        const res = await fetch(url);
         if (!res.ok) return;
         const all = await res.json();
-        for (const data of all.sensors) {
-          updateSensor(data.id, data);
-        }
+        if (all.layout !== layoutVersion) await fetchLayout();
+        applyResponse(all);
       } catch (e) {
-        // leave as-is on error
+        // leave as-is on error; the server may have restarted, so resync completely
+        generation = -1;
       }
       statusEl.textContent = "Laatste update: " + new Date().toLocaleTimeString();
     }
 
+    function relayoutAll() {
+      for (const s of sensors.values()) {
+        if (s.count > 0) { layoutGrid(s, s.count); s.dirty = true; }
+      }
+      scheduleDraw();
+    }
+
+    window.addEventListener("resize", relayoutAll);
+
+    // /grid?bench=<sensors>[&change=<percent of values that change per frame>][&all=1]: feeds
+    // synthetic responses, one per animation frame, and measures applying and drawing them.
+    // all=1 draws off-screen sensors as well.
+    function runBench(nofSensors, changePercent, drawAll) {
+      const COUNT = 64;
+      const values = [];
+      for (let id = 1; id <= nofSensors; id++) {
+        values.push(Array.from({ length: COUNT }, () => Math.floor(Math.random() * (MAX_VALUE + 1))));
+      }
+      applyLayout({
+        layout: 1, columns: 4,
+        sensors: values.map((v, i) => ({ id: i + 1, name: "Sensor " + (i + 1), unit: "raw", position: i, count: COUNT }))
+      });
+      const times = [], intervals = [];
+      let lastFrame = 0;
+      function frame(now) {
+        const sensorsData = [];
+        for (let id = 1; id <= nofSensors; id++) {
+          const v = values[id - 1];
+          for (let i = 0; i < COUNT; i++) {
+            if (Math.random() * 100 < changePercent) v[i] = Math.max(0, Math.min(MAX_VALUE, v[i] + Math.round((Math.random() - 0.5) * 64)));
+          }
+          sensorsData.push({ id, count: COUNT, values: v });
+        }
+        if (drawAll) for (const s of sensors.values()) s.visible = true;
+        const start = performance.now();
+        applyResponse({ generation: times.length + 1, delta: times.length > 0, layout: 1, sensors: sensorsData });
+        drawDirty();
+        times.push(performance.now() - start);
+        if (lastFrame > 0) intervals.push(now - lastFrame);
+        lastFrame = now;
+
+        if (times.length < BENCH_FRAMES) {
+          requestAnimationFrame(frame);
+          return;
+        }
+        const sorted = a => a.slice().sort((p, q) => p - q);
+        const t = sorted(times.slice(1)), f = sorted(intervals);
+        const mean = a => a.reduce((p, q) => p + q, 0) / a.length;
+        let visible = 0;
+        for (const s of sensors.values()) if (s.visible) visible++; // in the last frame
+        window.gridBench = {
+          sensors: nofSensors, values: COUNT, changePercent, frames: times.length, visible,
+          firstMs: times[0], meanMs: mean(t), p95Ms: t[Math.floor(t.length * 0.95)], maxMs: t[t.length - 1],
+          frameMeanMs: mean(f), frameP95Ms: f[Math.floor(f.length * 0.95)]
+        };
+        statusEl.textContent = "bench: " + JSON.stringify(window.gridBench);
+      }
+      requestAnimationFrame(frame);
+    }
+
     // Initialize
-    SENSOR_IDS.forEach(id => {
-      createGrid(sensors[id], 0);
-      createHistogram(sensors[id]);
-    });
-    async function pollLoop() {
-      const start = Date.now();
-      await fetchAll();
-      const remaining = Math.max(0, POLL_MS - (Date.now() - start));
-      setTimeout(pollLoop, remaining);
-    }
-    pollLoop();
+    const query = new URLSearchParams(location.search);
+    const benchSensors = parseInt(query.get("bench") || "0");
+    if (benchSensors > 0) {
+      runBench(benchSensors, parseFloat(query.get("change") || "100"), query.get("all") === "1");
+    } else {
+      async function pollLoop() {
+        if (layoutVersion < 0) await fetchLayout().catch(() => {});
+        const start = Date.now();
+        await fetchAll();
+        const remaining = Math.max(0, POLL_MS - (Date.now() - start));
+        setTimeout(pollLoop, remaining);
+      }
+      pollLoop();
+    }
   </script>
 </body>
 </html>)rawliteral";
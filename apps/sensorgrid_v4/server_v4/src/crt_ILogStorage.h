@@ -0,0 +1,26 @@
+// by Marius Versteegen, 2025
+// Where MeasurementLog keeps its segments: numbered, append-only byte files.
+// See crt_FileLogStorage.h for the LittleFS (and host) implementation.
+
+#pragma once
+#include <cstdint>
+
+namespace crt
+{
+	class ILogStorage
+	{
+	public:
+		// Creates an empty segment. Returns false on failure.
+		virtual bool create(uint32_t segment) = 0;
+		// Appends length bytes to the end of the segment and makes them durable.
+		virtual bool append(uint32_t segment, const uint8_t* data, uint32_t length) = 0;
+		virtual bool read(uint32_t segment, uint32_t offset, uint8_t* data, uint32_t length) = 0;
+		// Number of bytes in the segment (also after a write that was cut short).
+		virtual uint32_t getSize(uint32_t segment) = 0;
+		virtual bool remove(uint32_t segment) = 0;
+		// Writes the numbers of the existing segments, in any order, to segments.
+		// Returns how many there are (which may exceed maxSegments).
+		virtual uint16_t list(uint32_t* segments, uint16_t maxSegments) = 0;
+	};
+
+} // end namespace crt
@@ -229,26 +229,12 @@ namespace crt
     setInterval(fetchSensors, POLL_MS);
     fetchSensors();
 
+    // The server streams the CSV: every logged measurement array, or the current ones if its log is disabled.
     downloadBtn.addEventListener("click", () => {
-      let csv = "";
-      const nowStr = new Date().toLocaleString("nl-NL", { dateStyle: "short", timeStyle: "medium" });
-      csv += "Naam : , ...\r\n";
-      csv += "Tijdstip : , " + nowStr + "\r\n\r\n";
-      csv += "Sensor id,Meetwaarde\r\n";
-
-      SENSOR_IDS.forEach(id => {
-        const row = sensorEls[id];
-        const val = row.querySelector(".value").textContent;
-        csv += id + "," + val + "\r\n";
-      });
-
-      const blob = new Blob([csv], { type: "text/csv" });
-      const url = URL.createObjectURL(blob);
       const a = document.createElement("a");
-      a.href = url;
+      a.href = "/api/export.csv";
       a.download = "sensors.csv";
       a.click();
-      URL.revokeObjectURL(url);
     });
   </script>
 </body>
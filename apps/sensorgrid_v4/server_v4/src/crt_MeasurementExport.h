@@ -0,0 +1,206 @@
+// by Marius Versteegen, 2025
+// MeasurementExport: streams measurement arrays as CSV or NDJSON rows, one row
+// per sensor per second:
+//   CSV:    time,sensor,values              (header, then)
+//           7201,3,512,498,...
+//   NDJSON: {"time":7201,"sensor":3,"values":[512,498,...]}
+//
+// Rows are formatted into a fixed buffer, which is handed to a sink whenever it
+// is full, so the memory use does not depend on the amount of data. The sink
+// is any callable taking (const char* data, size_t length); ServerNode passes
+// server.sendContent(), which blocks while the client is slow to read, and the
+// ExportStreamTest counts and checks the bytes instead.
+//
+// exportLog() reads the MeasurementLog in slices and calls between() after every
+// slice. That is where the caller may service the radio: between() runs outside
+// MeasurementLog::query(), so it may append to the log. A slice is bounded by
+// time rather than by a number of seconds of the log, as the time it takes
+// depends on the size of the records and on how fast the client reads.
+// A record that the log split over two chunks is joined into one row again.
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <crt_SensorCapabilities.h>
+
+namespace crt
+{
+	enum class ExportFormat : uint8_t
+	{
+		CSV,
+		NDJSON
+	};
+
+	template<uint16_t BUFFER_SIZE = 1024> class MeasurementExport
+	{
+	private:
+		static const uint8_t MAX_ROW_START = 48; // {"time":4294967295,"sensor":255,"values":[
+
+		ExportFormat format;
+		char buffer[BUFFER_SIZE];
+		uint16_t used;
+		bool rowOpen;
+		bool rowEmpty;
+		uint32_t rowTime;
+		uint8_t rowSensor;
+		uint32_t rows;
+		uint32_t bytesSent;
+		uint32_t nofSends;
+
+		static char* appendText(char* p, const char* text)
+		{
+			while (*text != '\0') *p++ = *text++;
+			return p;
+		}
+
+		static char* appendUint(char* p, uint32_t value)
+		{
+			char digits[10];
+			uint8_t n = 0;
+			do
+			{
+				digits[n++] = (char)('0' + value % 10);
+				value /= 10;
+			} while (value != 0);
+			while (n > 0) *p++ = digits[--n];
+			return p;
+		}
+
+		// Makes sure that at least length more bytes fit in the buffer.
+		template<typename Sink> void reserve(uint16_t length, Sink& sink)
+		{
+			if (used + length > BUFFER_SIZE) flush(sink);
+		}
+
+		template<typename Sink> void flush(Sink& sink)
+		{
+			if (used == 0) return;
+			sink((const char*)buffer, (size_t)used);
+			bytesSent += used;
+			nofSends++;
+			used = 0;
+		}
+
+		template<typename Sink> void closeRow(Sink& sink)
+		{
+			if (!rowOpen) return;
+			reserve(3, sink);
+			char* p = appendText(buffer + used, (format == ExportFormat::CSV) ? "\r\n" : "]}\n");
+			used = (uint16_t)(p - buffer);
+			rowOpen = false;
+			rows++;
+		}
+
+		template<typename Sink> void openRow(uint32_t time, uint8_t sensorId, Sink& sink)
+		{
+			reserve(MAX_ROW_START, sink);
+			char* p = buffer + used;
+			if (format == ExportFormat::CSV)
+			{
+				p = appendUint(p, time);
+				*p++ = ',';
+				p = appendUint(p, sensorId);
+			}
+			else
+			{
+				p = appendText(p, "{\"time\":");
+				p = appendUint(p, time);
+				p = appendText(p, ",\"sensor\":");
+				p = appendUint(p, sensorId);
+				p = appendText(p, ",\"values\":[");
+			}
+			used = (uint16_t)(p - buffer);
+			rowOpen = true;
+			rowEmpty = true;
+			rowTime = time;
+			rowSensor = sensorId;
+		}
+
+	public:
+		MeasurementExport(ExportFormat format) : format(format), used(0), rowOpen(false), rowEmpty(true),
+												 rowTime(0), rowSensor(0), rows(0), bytesSent(0), nofSends(0)
+		{
+		}
+
+		const char* getContentType() const
+		{
+			return (format == ExportFormat::CSV) ? "text/csv" : "application/x-ndjson";
+		}
+
+		void begin()
+		{
+			if (format == ExportFormat::CSV)
+			{
+				char* p = appendText(buffer + used, "time,sensor,values\r\n");
+				used = (uint16_t)(p - buffer);
+			}
+		}
+
+		// Adds count samples of sampleWidth bytes, the first of which is sample
+		// firstSample of the sensor's array at that time. Continues the open row if
+		// it holds the preceding part of the same array.
+		template<typename Sink>
+		void addSamples(uint32_t time, uint8_t sensorId, uint16_t firstSample,
+						const uint8_t* samples, uint16_t count, uint8_t sampleWidth, Sink& sink)
+		{
+			if (!rowOpen || firstSample == 0 || time != rowTime || sensorId != rowSensor)
+			{
+				closeRow(sink);
+				openRow(time, sensorId, sink);
+			}
+			for (uint16_t i = 0; i < count; i++)
+			{
+				reserve(11, sink);
+				char* p = buffer + used;
+				if (format == ExportFormat::CSV || !rowEmpty) *p++ = ',';
+				p = appendUint(p, readSample(samples, i, sampleWidth));
+				used = (uint16_t)(p - buffer);
+				rowEmpty = false;
+			}
+		}
+
+		// Closes the last row and sends what is left in the buffer.
+		template<typename Sink> void end(Sink& sink)
+		{
+			closeRow(sink);
+			flush(sink);
+		}
+
+		// Streams the records of sensorId (0: all sensors) from fromTime to toTime
+		// (inclusive) out of the log. Does not call begin() or end().
+		// A slice covers as many seconds of the log as took maxSliceUs in the previous
+		// slice, as measured with nowUs(): at least 1, and at most twice as many as the
+		// previous slice. A single second of the log that takes longer is not split.
+		template<typename Log, typename Sink, typename Between, typename Clock>
+		void exportLog(Log& log, uint8_t sensorId, uint32_t fromTime, uint32_t toTime, Sink& sink,
+					   Between between, Clock nowUs, uint32_t maxSliceUs)
+		{
+			if (fromTime < log.getOldestTime()) fromTime = log.getOldestTime();
+			if (toTime > log.getLastTime()) toTime = log.getLastTime();
+
+			uint32_t sliceS = 1;
+			uint32_t t = fromTime;
+			while (t <= toTime)
+			{
+				uint32_t sliceEnd = (toTime - t < sliceS) ? toTime : t + sliceS - 1;
+				uint32_t startUs = nowUs();
+				log.query(sensorId, t, sliceEnd, [&](const auto& record, const uint8_t* samples) {
+					addSamples(record.time, record.sensorId, record.firstSample, samples,
+							   record.sampleCount, record.sampleWidth, sink);
+				});
+				uint32_t usPerSecond = (uint32_t)(nowUs() - startUs) / (sliceEnd - t + 1);
+				between();
+				if (sliceEnd == toTime) break;
+
+				t = sliceEnd + 1;
+				uint32_t fitting = (usPerSecond == 0) ? 2 * sliceS : maxSliceUs / usPerSecond;
+				sliceS = (fitting < 1) ? 1 : (fitting > 2 * sliceS) ? 2 * sliceS : fitting;
+			}
+		}
+
+		uint32_t getRows() const { return rows; }
+		uint32_t getBytesSent() const { return bytesSent; }
+		uint32_t getNofSends() const { return nofSends; }
+	}; // end class MeasurementExport
+
+} // end namespace crt
@@ -0,0 +1,163 @@
+// by Marius Versteegen, 2025
+// MeasurementJsonCache: keeps the JSON fragment of every sensor's measurement
+// array pre-serialised, such that HTTP requests only need to copy bytes.
+//
+// Each sensor owns a slab that is large enough for its worst case fragment:
+//   {"id":255,"count":65535,"values":[65535,65535,...]}
+// The slab memory is handed in with attach(), sized with slabSize() for the
+// sensor's sample count and width (ServerNode takes it from its
+// SampleStoragePool), so the footprint follows the sensors that registered.
+// A slab is invalidated when new data for its sensor arrives and is
+// serialised again on the first read after that (a miss). All further
+// reads until the next data arrival are hits.
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <crt_SensorCapabilities.h>
+
+namespace crt
+{
+	template<uint8_t MAX_SENSORS> class MeasurementJsonCache
+	{
+	private:
+		struct Slab
+		{
+			bool valid;
+			uint16_t length;
+			uint16_t capacity;
+			char* text;
+		};
+
+		Slab slabs[MAX_SENSORS + 1]; // indexed 1..MAX_SENSORS
+		uint32_t attachedBytes;
+		uint32_t hits;
+		uint32_t misses;
+
+		static uint8_t maxDigits(uint8_t sampleWidth)
+		{
+			return (sampleWidth == 1) ? 3 : (sampleWidth == 2) ? 5 : 10;
+		}
+
+		static char* appendText(char* p, const char* text)
+		{
+			while (*text != '\0') *p++ = *text++;
+			return p;
+		}
+
+		static char* appendUint(char* p, uint32_t value)
+		{
+			char digits[10];
+			uint8_t n = 0;
+			do
+			{
+				digits[n++] = (char)('0' + value % 10);
+				value /= 10;
+			} while (value != 0);
+			while (n > 0) *p++ = digits[--n];
+			return p;
+		}
+
+		void serialise(uint8_t id, const uint8_t* samples, uint16_t count, uint8_t sampleWidth)
+		{
+			Slab& slab = slabs[id];
+			uint16_t maxCount = (slab.capacity > 40) ? (slab.capacity - 40) / (maxDigits(sampleWidth) + 1) : 0;
+			if (count > maxCount) count = maxCount;
+
+			char* p = slab.text;
+			p = appendText(p, "{\"id\":");
+			p = appendUint(p, id);
+			p = appendText(p, ",\"count\":");
+			p = appendUint(p, count);
+			p = appendText(p, ",\"values\":[");
+			for (uint16_t i = 0; i < count; i++)
+			{
+				if (i > 0) *p++ = ',';
+				p = appendUint(p, readSample(samples, i, sampleWidth));
+			}
+			p = appendText(p, "]}");
+			*p = '\0';
+
+			slab.length = (uint16_t)(p - slab.text);
+			slab.valid = true;
+		}
+
+	public:
+		// Bytes of slab needed for sampleCount samples of sampleWidth bytes: 29 bytes of keys,
+		// punctuation and the zero terminator, 3+5 for id and count, and per value its
+		// maximum number of digits plus a comma, rounded up.
+		static uint32_t slabSize(uint16_t sampleCount, uint8_t sampleWidth)
+		{
+			return 40 + (uint32_t)(maxDigits(sampleWidth) + 1) * sampleCount;
+		}
+
+		MeasurementJsonCache() : attachedBytes(0), hits(0), misses(0)
+		{
+			for (uint8_t id = 0; id <= MAX_SENSORS; id++)
+			{
+				slabs[id] = {false, 0, 0, nullptr};
+			}
+		}
+
+		// Gives sensor id (1..MAX_SENSORS) a slab of capacity bytes (see slabSize()).
+		void attach(uint8_t id, char* text, uint16_t capacity)
+		{
+			if (id < 1 || id > MAX_SENSORS) return;
+			detach(id);
+			slabs[id] = {false, 0, capacity, text};
+			attachedBytes += capacity;
+		}
+
+		// Returns the slab of sensor id, or nullptr if it has none.
+		char* detach(uint8_t id)
+		{
+			if (id < 1 || id > MAX_SENSORS) return nullptr;
+			char* text = slabs[id].text;
+			attachedBytes -= slabs[id].capacity;
+			slabs[id] = {false, 0, 0, nullptr};
+			return text;
+		}
+
+		// Call whenever the measurements of sensor id change.
+		void invalidate(uint8_t id)
+		{
+			if (id <= MAX_SENSORS) slabs[id].valid = false;
+		}
+
+		// Returns the zero-terminated fragment of sensor id, serialising it from the
+		// CODEC_RAW samples first if the slab was invalidated. Returns nullptr for an
+		// id without a slab.
+		const char* get(uint8_t id, const uint8_t* samples, uint16_t count, uint8_t sampleWidth, uint16_t& length)
+		{
+			if (id < 1 || id > MAX_SENSORS || slabs[id].text == nullptr)
+			{
+				length = 0;
+				return nullptr;
+			}
+
+			Slab& slab = slabs[id];
+			if (slab.valid)
+			{
+				hits++;
+			}
+			else
+			{
+				misses++;
+				serialise(id, samples, count, sampleWidth);
+			}
+			length = slab.length;
+			return slab.text;
+		}
+
+		uint32_t getHits() const { return hits; }
+		uint32_t getMisses() const { return misses; }
+		uint32_t getFootprint() const { return sizeof(slabs) + attachedBytes; }
+
+		void resetStats()
+		{
+			hits = 0;
+			misses = 0;
+		}
+	};
+
+} // end namespace crt
@@ -0,0 +1,476 @@
+// by Marius Versteegen, 2025
+// MeasurementLog: persistent, append-only log of the measurement arrays the
+// server receives, in numbered segments of an ILogStorage (files on LittleFS).
+//
+// Layout: a segment is a sequence of CHUNK_SIZE chunks, written whole and
+// aligned (one LittleFS block each), so flash is programmed in large units
+// instead of per reply. A chunk is a ChunkHeader (time range, sensor mask,
+// CRC) followed by records: the fields of a LogRecord and sampleCount samples
+// of sampleWidth bytes. A measurement array that does not fit in the rest of a
+// chunk is split into records with consecutive firstSample.
+//
+// RAM: one chunk of write buffer, one of read buffer, and an index entry
+// (time range and sensor mask) per chunk of every retained segment. Range
+// queries use the index to read only the chunks that can hold matches.
+//
+// Durability: the write buffer is written out when it is full, or flushInterval
+// seconds after its first record. A crash loses at most that; a chunk that was
+// cut short is detected by its CRC on boot (begin()). Its segment is then
+// closed for appending and the log continues in a new one.
+//
+// Retention: at most MAX_SEGMENTS segments; the oldest one is deleted to make
+// room, or earlier if it is older than maxAge.
+//
+// Times are in seconds, chosen by the caller and non-decreasing.
+// Free of ESP-specific calls, such that the MeasurementLogBench runs it on a PC.
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <crt_PacketCodec.h>
+#include "crt_ILogStorage.h"
+
+namespace crt
+{
+	// A run of samples of one measurement array.
+	struct LogRecord
+	{
+		uint32_t time;
+		uint8_t sensorId;
+		uint8_t sampleWidth;
+		uint16_t firstSample;	// index in the measurement array of the first sample in this record
+		uint16_t sampleCount;
+	};
+
+	template<uint32_t CHUNK_SIZE = 4096, uint8_t CHUNKS_PER_SEGMENT = 16, uint8_t MAX_SEGMENTS = 16>
+	class MeasurementLog
+	{
+	private:
+		static const uint32_t CHUNK_MAGIC = 0x4B434753; // "SGCK"
+
+		struct ChunkHeader
+		{
+			uint32_t magic;
+			uint32_t segment;
+			uint32_t firstTime;
+			uint32_t lastTime;
+			uint32_t sensorMask;	// bit (sensorId % 32) per sensor with records in the chunk
+			uint32_t crc;			// CRC-32 of header (with crc 0) and records
+			uint16_t usedBytes;		// bytes of records after the header
+			uint16_t nofRecords;
+		};
+
+		using ChunkLayout = Layout<
+			Field<&ChunkHeader::magic>, Field<&ChunkHeader::segment>,
+			Field<&ChunkHeader::firstTime>, Field<&ChunkHeader::lastTime>,
+			Field<&ChunkHeader::sensorMask>, Field<&ChunkHeader::crc>,
+			Field<&ChunkHeader::usedBytes>, Field<&ChunkHeader::nofRecords>>;
+
+		using RecordLayout = Layout<
+			Field<&LogRecord::time>, Field<&LogRecord::sensorId>, Field<&LogRecord::sampleWidth>,
+			Field<&LogRecord::firstSample>, Field<&LogRecord::sampleCount>>;
+
+		static const uint32_t CRC_OFFSET = ChunkLayout::template offsetOf<&ChunkHeader::crc>();
+
+	public:
+		static const uint32_t CHUNK_HEADER_SIZE = ChunkLayout::SIZE;
+		static const uint32_t RECORD_HEADER_SIZE = RecordLayout::SIZE;
+		static const uint32_t SEGMENT_SIZE = CHUNK_SIZE * CHUNKS_PER_SEGMENT;
+
+	private:
+		static_assert(CHUNK_SIZE - CHUNK_HEADER_SIZE <= 0xFFFF, "usedBytes is 16 bits");
+
+		struct ChunkIndex
+		{
+			uint32_t firstTime;
+			uint32_t lastTime;
+			uint32_t sensorMask;
+		};
+
+		struct Segment
+		{
+			uint32_t number;
+			uint8_t nofChunks;
+			bool sealed;		// no more appends: full, damaged, or not the newest at boot
+			ChunkIndex chunks[CHUNKS_PER_SEGMENT];
+		};
+
+		ILogStorage& storage;
+		Segment segments[MAX_SEGMENTS];	// ring buffer, oldest at firstSegment
+		uint8_t firstSegment;
+		uint8_t nofSegments;
+		uint32_t nextSegmentNumber;
+
+		uint8_t writeBuffer[CHUNK_SIZE];
+		uint32_t writeUsed;		// bytes of records in writeBuffer
+		ChunkHeader pending;	// header of writeBuffer, crc and usedBytes filled when written
+		uint8_t readBuffer[CHUNK_SIZE];
+
+		uint32_t lastTime;
+		uint32_t flushIntervalS;
+		uint32_t maxAgeS;		// 0: keep segments until room is needed
+
+		uint32_t bytesAppended;
+		uint32_t chunksWritten;
+		uint32_t chunksRead;
+		uint32_t chunksDiscarded;	// damaged, found by begin() or a query
+		uint32_t segmentsRecycled;
+		uint32_t writeErrors;
+
+		static uint32_t crc32(uint32_t crc, const uint8_t* data, uint32_t length)
+		{
+			static const uint32_t TABLE[16] = {
+				0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+				0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+			crc = ~crc;
+			for (uint32_t i = 0; i < length; i++)
+			{
+				crc = TABLE[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+				crc = TABLE[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+			}
+			return ~crc;
+		}
+
+		static uint32_t sensorBit(uint8_t sensorId)
+		{
+			return 1u << (sensorId % 32);
+		}
+
+		Segment& segmentAt(uint8_t i)
+		{
+			return segments[(firstSegment + i) % MAX_SEGMENTS];
+		}
+
+		Segment& newest()
+		{
+			return segmentAt(nofSegments - 1);
+		}
+
+		void resetPending()
+		{
+			writeUsed = 0;
+			pending = {};
+			pending.magic = CHUNK_MAGIC;
+		}
+
+		// Checks magic, segment and CRC of a chunk in buffer; fills header.
+		static bool checkChunk(uint8_t* buffer, uint32_t segment, ChunkHeader& header)
+		{
+			ChunkLayout::decode(buffer, header);
+			if (header.magic != CHUNK_MAGIC || header.segment != segment ||
+				header.usedBytes > CHUNK_SIZE - CHUNK_HEADER_SIZE) return false;
+
+			uint8_t crcBytes[4];
+			memcpy(crcBytes, buffer + CRC_OFFSET, 4);
+			memset(buffer + CRC_OFFSET, 0, 4);
+			uint32_t crc = crc32(0, buffer, CHUNK_HEADER_SIZE + header.usedBytes);
+			memcpy(buffer + CRC_OFFSET, crcBytes, 4);
+			return crc == header.crc;
+		}
+
+		void removeOldest()
+		{
+			storage.remove(segmentAt(0).number);
+			firstSegment = (firstSegment + 1) % MAX_SEGMENTS;
+			nofSegments--;
+			segmentsRecycled++;
+		}
+
+		// The segment to append the next chunk to; starts a new one (making room) if needed.
+		Segment* openSegment()
+		{
+			if (nofSegments > 0 && !newest().sealed) return &newest();
+
+			if (nofSegments == MAX_SEGMENTS) removeOldest();
+			uint32_t number = nextSegmentNumber++;
+			if (!storage.create(number)) return nullptr;
+
+			nofSegments++;
+			Segment& seg = newest();
+			seg.number = number;
+			seg.nofChunks = 0;
+			seg.sealed = false;
+			return &seg;
+		}
+
+		// Reads the index of a segment from storage. Only the newest segment can be
+		// appended to afterwards, and only if all its chunks are intact.
+		void recoverSegment(uint32_t number, bool isNewest)
+		{
+			nofSegments++;
+			Segment& seg = newest();
+			seg.number = number;
+			seg.nofChunks = 0;
+
+			uint32_t size = storage.getSize(number);
+			uint32_t nofChunks = size / CHUNK_SIZE;
+			if (nofChunks > CHUNKS_PER_SEGMENT) nofChunks = CHUNKS_PER_SEGMENT;
+			bool intact = (size % CHUNK_SIZE == 0) && size <= SEGMENT_SIZE;
+
+			for (uint32_t c = 0; c < nofChunks; c++)
+			{
+				ChunkHeader header;
+				bool ok;
+				if (isNewest)
+				{
+					// The only segment that can have been cut short by a reset: check all of it.
+					ok = storage.read(number, c * CHUNK_SIZE, readBuffer, CHUNK_SIZE) &&
+						 checkChunk(readBuffer, number, header);
+				}
+				else
+				{
+					ok = storage.read(number, c * CHUNK_SIZE, readBuffer, CHUNK_HEADER_SIZE);
+					ChunkLayout::decode(readBuffer, header);
+					ok = ok && header.magic == CHUNK_MAGIC && header.segment == number;
+				}
+				if (!ok)
+				{
+					chunksDiscarded += nofChunks - c;
+					intact = false;
+					break;
+				}
+				seg.chunks[seg.nofChunks++] = {header.firstTime, header.lastTime, header.sensorMask};
+				if (header.lastTime > lastTime) lastTime = header.lastTime;
+			}
+			if (size % CHUNK_SIZE != 0) chunksDiscarded++;
+
+			seg.sealed = !isNewest || !intact || seg.nofChunks == CHUNKS_PER_SEGMENT;
+			if (seg.nofChunks == 0 && seg.sealed)
+			{
+				storage.remove(number); // nothing usable in it
+				nofSegments--;
+			}
+		}
+
+		// Calls onRecord for the records of the chunk in buffer that match.
+		template<typename Callback>
+		uint32_t scanChunk(const uint8_t* buffer, uint32_t usedBytes, uint8_t sensorId,
+						   uint32_t fromTime, uint32_t toTime, Callback& onRecord)
+		{
+			uint32_t matches = 0;
+			uint32_t offset = CHUNK_HEADER_SIZE;
+			uint32_t end = CHUNK_HEADER_SIZE + usedBytes;
+			while (offset + RECORD_HEADER_SIZE <= end)
+			{
+				LogRecord record;
+				RecordLayout::decode(buffer + offset, record);
+				uint32_t sampleBytes = (uint32_t)record.sampleCount * record.sampleWidth;
+				offset += RECORD_HEADER_SIZE;
+				if (offset + sampleBytes > end) break;
+
+				if ((sensorId == 0 || record.sensorId == sensorId) &&
+					record.time >= fromTime && record.time <= toTime)
+				{
+					onRecord(record, buffer + offset);
+					matches++;
+				}
+				offset += sampleBytes;
+			}
+			return matches;
+		}
+
+	public:
+		MeasurementLog(ILogStorage& storage, uint32_t flushIntervalS = 30, uint32_t maxAgeS = 0)
+			: storage(storage), firstSegment(0), nofSegments(0), nextSegmentNumber(0),
+			  lastTime(0), flushIntervalS(flushIntervalS), maxAgeS(maxAgeS),
+			  bytesAppended(0), chunksWritten(0), chunksRead(0), chunksDiscarded(0),
+			  segmentsRecycled(0), writeErrors(0)
+		{
+			resetPending();
+		}
+
+		// Recovers the index from the segments in storage. Call once, before anything else.
+		void begin()
+		{
+			static const uint16_t MAX_LISTED = 2 * MAX_SEGMENTS;
+			uint32_t numbers[MAX_LISTED];
+			uint16_t count = storage.list(numbers, MAX_LISTED);
+			if (count > MAX_LISTED) count = MAX_LISTED;
+
+			for (uint16_t i = 1; i < count; i++) // sort, oldest first
+			{
+				uint32_t number = numbers[i];
+				uint16_t j = i;
+				for (; j > 0 && numbers[j - 1] > number; j--) numbers[j] = numbers[j - 1];
+				numbers[j] = number;
+			}
+
+			uint16_t keepFrom = (count > MAX_SEGMENTS) ? count - MAX_SEGMENTS : 0;
+			for (uint16_t i = 0; i < keepFrom; i++)
+			{
+				storage.remove(numbers[i]);
+				segmentsRecycled++;
+			}
+
+			firstSegment = 0;
+			nofSegments = 0;
+			lastTime = 0;
+			for (uint16_t i = keepFrom; i < count; i++)
+			{
+				recoverSegment(numbers[i], i == count - 1);
+			}
+			nextSegmentNumber = (count > 0) ? numbers[count - 1] + 1 : 0;
+			resetPending();
+		}
+
+		// Adds a measurement array of count samples of width bytes. time must not be
+		// lower than that of the previous call (it is raised to it if it is).
+		void append(uint8_t sensorId, uint32_t time, const uint8_t* samples, uint16_t count, uint8_t width)
+		{
+			if (time < lastTime) time = lastTime;
+			lastTime = time;
+
+			uint16_t first = 0;
+			while (first < count)
+			{
+				uint32_t space = CHUNK_SIZE - CHUNK_HEADER_SIZE - writeUsed;
+				if (space < RECORD_HEADER_SIZE + width)
+				{
+					flush();
+					continue;
+				}
+				uint32_t fits = (space - RECORD_HEADER_SIZE) / width;
+				uint16_t n = ((uint32_t)(count - first) < fits) ? count - first : (uint16_t)fits;
+
+				LogRecord record = {time, sensorId, width, first, n};
+				uint8_t* out = writeBuffer + CHUNK_HEADER_SIZE + writeUsed;
+				RecordLayout::encode(record, out);
+				memcpy(out + RECORD_HEADER_SIZE, samples + (uint32_t)first * width, (uint32_t)n * width);
+				writeUsed += RECORD_HEADER_SIZE + (uint32_t)n * width;
+
+				if (pending.nofRecords == 0) pending.firstTime = time;
+				pending.lastTime = time;
+				pending.sensorMask |= sensorBit(sensorId);
+				pending.nofRecords++;
+				first += n;
+			}
+			bytesAppended += (uint32_t)count * width;
+		}
+
+		// Writes the write buffer out as a chunk, if it holds any records.
+		// Returns false if that failed; the records are then lost.
+		bool flush()
+		{
+			if (pending.nofRecords == 0) return true;
+
+			Segment* seg = openSegment();
+			bool ok = seg != nullptr;
+			if (ok)
+			{
+				pending.segment = seg->number;
+				pending.usedBytes = (uint16_t)writeUsed;
+				pending.crc = 0;
+				ChunkLayout::encode(pending, writeBuffer);
+				memset(writeBuffer + CHUNK_HEADER_SIZE + writeUsed, 0xFF, CHUNK_SIZE - CHUNK_HEADER_SIZE - writeUsed);
+				pending.crc = crc32(0, writeBuffer, CHUNK_HEADER_SIZE + writeUsed);
+				ChunkLayout::encode(pending, writeBuffer);
+
+				ok = storage.append(seg->number, writeBuffer, CHUNK_SIZE);
+				if (ok)
+				{
+					seg->chunks[seg->nofChunks++] = {pending.firstTime, pending.lastTime, pending.sensorMask};
+					if (seg->nofChunks == CHUNKS_PER_SEGMENT) seg->sealed = true;
+					chunksWritten++;
+				}
+				else
+				{
+					seg->sealed = true; // may end in a partial chunk now
+				}
+			}
+			if (!ok) writeErrors++;
+			resetPending();
+			return ok;
+		}
+
+		// Call regularly with the current time: flushes the write buffer after
+		// flushInterval, and drops segments older than maxAge.
+		void update(uint32_t now)
+		{
+			if (pending.nofRecords > 0 && now - pending.firstTime >= flushIntervalS)
+			{
+				flush();
+			}
+			while (maxAgeS != 0 && nofSegments > 1 && segmentAt(0).sealed)
+			{
+				Segment& oldest = segmentAt(0);
+				if (oldest.nofChunks > 0 && oldest.chunks[oldest.nofChunks - 1].lastTime + maxAgeS >= now) break;
+				removeOldest();
+			}
+		}
+
+		// Calls onRecord(const LogRecord&, const uint8_t* samples) for every record of
+		// sensorId (0: all sensors) with fromTime <= time <= toTime, oldest first,
+		// including those still in the write buffer. Only reads chunks whose time
+		// range and sensor mask can match. Returns the number of records.
+		template<typename Callback>
+		uint32_t query(uint8_t sensorId, uint32_t fromTime, uint32_t toTime, Callback onRecord)
+		{
+			uint32_t matches = 0;
+			for (uint8_t i = 0; i < nofSegments; i++)
+			{
+				Segment& seg = segmentAt(i);
+				if (seg.nofChunks == 0 || seg.chunks[seg.nofChunks - 1].lastTime < fromTime) continue;
+				if (seg.chunks[0].firstTime > toTime) break;
+
+				// First chunk that ends at or after fromTime.
+				uint8_t lo = 0;
+				uint8_t hi = seg.nofChunks;
+				while (lo < hi)
+				{
+					uint8_t mid = (lo + hi) / 2;
+					if (seg.chunks[mid].lastTime < fromTime) lo = mid + 1;
+					else hi = mid;
+				}
+
+				for (uint8_t c = lo; c < seg.nofChunks && seg.chunks[c].firstTime <= toTime; c++)
+				{
+					if (sensorId != 0 && (seg.chunks[c].sensorMask & sensorBit(sensorId)) == 0) continue;
+
+					ChunkHeader header;
+					chunksRead++;
+					if (!storage.read(seg.number, c * CHUNK_SIZE, readBuffer, CHUNK_SIZE) ||
+						!checkChunk(readBuffer, seg.number, header))
+					{
+						chunksDiscarded++;
+						continue;
+					}
+					matches += scanChunk(readBuffer, header.usedBytes, sensorId, fromTime, toTime, onRecord);
+				}
+			}
+
+			if (pending.nofRecords > 0 && pending.lastTime >= fromTime && pending.firstTime <= toTime)
+			{
+				matches += scanChunk(writeBuffer, writeUsed, sensorId, fromTime, toTime, onRecord);
+			}
+			return matches;
+		}
+
+		uint32_t getLastTime() const { return lastTime; }
+		uint8_t getNofSegments() const { return nofSegments; }
+
+		uint32_t getOldestTime()
+		{
+			for (uint8_t i = 0; i < nofSegments; i++)
+			{
+				if (segmentAt(i).nofChunks > 0) return segmentAt(i).chunks[0].firstTime;
+			}
+			return pending.nofRecords > 0 ? pending.firstTime : lastTime;
+		}
+
+		uint32_t getStoredChunks()
+		{
+			uint32_t chunks = 0;
+			for (uint8_t i = 0; i < nofSegments; i++) chunks += segmentAt(i).nofChunks;
+			return chunks;
+		}
+
+		uint32_t getBytesAppended() const { return bytesAppended; }		// sample bytes passed to append()
+		uint32_t getBytesWritten() const { return chunksWritten * CHUNK_SIZE; }
+		uint32_t getChunksWritten() const { return chunksWritten; }
+		uint32_t getChunksRead() const { return chunksRead; }
+		uint32_t getChunksDiscarded() const { return chunksDiscarded; }
+		uint32_t getSegmentsRecycled() const { return segmentsRecycled; }
+		uint32_t getWriteErrors() const { return writeErrors; }
+	};
+
+} // end namespace crt
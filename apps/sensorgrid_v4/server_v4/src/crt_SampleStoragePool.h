@@ -0,0 +1,105 @@
+// by Marius Versteegen, 2025
+// SampleStoragePool: a fixed arena from which ServerNode carves the storage of
+// each sensor (its samples and its JSON slab), sized by the capabilities the
+// sensor announced in its REGISTER.
+//
+// Blocks are kept in address order and placed first-fit, so a block that is
+// released (a sensor that re-registers with other capabilities) leaves a gap
+// that later allocations can reuse. No heap is involved: the footprint is
+// POOL_SIZE plus the block table, known at compile time.
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace crt
+{
+	template<uint32_t POOL_SIZE, uint8_t MAX_BLOCKS> class SampleStoragePool
+	{
+	public:
+		static const uint8_t ALIGNMENT = 4;
+
+	private:
+		struct Block
+		{
+			uint32_t offset;
+			uint32_t size;
+		};
+
+		alignas(ALIGNMENT) uint8_t arena[POOL_SIZE];
+		Block blocks[MAX_BLOCKS]; // sorted by offset
+		uint8_t nofBlocks;
+		uint32_t used;
+
+	public:
+		SampleStoragePool() : nofBlocks(0), used(0)
+		{
+		}
+
+		// Returns size bytes of zeroed storage, or nullptr if no gap is large enough.
+		uint8_t* allocate(uint32_t size)
+		{
+			if (size == 0 || nofBlocks >= MAX_BLOCKS) return nullptr;
+			size = allocationSize(size);
+
+			uint32_t offset = 0;
+			uint8_t index = 0;
+			for (; index < nofBlocks; index++)
+			{
+				if (blocks[index].offset - offset >= size) break;
+				offset = blocks[index].offset + blocks[index].size;
+			}
+			if (index == nofBlocks && POOL_SIZE - offset < size) return nullptr;
+
+			memmove(&blocks[index + 1], &blocks[index], (nofBlocks - index) * sizeof(Block));
+			blocks[index].offset = offset;
+			blocks[index].size = size;
+			nofBlocks++;
+			used += size;
+
+			memset(arena + offset, 0, size);
+			return arena + offset;
+		}
+
+		// Returns a block obtained from allocate() to the pool. Ignores nullptr.
+		void release(const uint8_t* block)
+		{
+			if (block == nullptr) return;
+			uint32_t offset = (uint32_t)(block - arena);
+			for (uint8_t i = 0; i < nofBlocks; i++)
+			{
+				if (blocks[i].offset == offset)
+				{
+					used -= blocks[i].size;
+					memmove(&blocks[i], &blocks[i + 1], (nofBlocks - i - 1) * sizeof(Block));
+					nofBlocks--;
+					return;
+				}
+			}
+		}
+
+		// Size of the largest block that allocate() could currently return.
+		uint32_t getLargestFree() const
+		{
+			uint32_t largest = 0;
+			uint32_t offset = 0;
+			for (uint8_t i = 0; i < nofBlocks; i++)
+			{
+				if (blocks[i].offset - offset > largest) largest = blocks[i].offset - offset;
+				offset = blocks[i].offset + blocks[i].size;
+			}
+			if (POOL_SIZE - offset > largest) largest = POOL_SIZE - offset;
+			return (nofBlocks < MAX_BLOCKS) ? largest : 0;
+		}
+
+		uint32_t getUsed() const { return used; }
+		static constexpr uint32_t getCapacity() { return POOL_SIZE; }
+
+		// Bytes of the pool that allocate(size) takes.
+		static constexpr uint32_t allocationSize(uint32_t size)
+		{
+			return (size + ALIGNMENT - 1) & ~(uint32_t)(ALIGNMENT - 1);
+		}
+	};
+
+} // end namespace crt
@@ -6,7 +6,23 @@
 #include <WebServer.h>
 #include <esp_now.h>
 #include <esp_wifi.h>
+#include <LITTLEFS.h>
 #include <crt_SensorGridPacket.h>
+#include <crt_SensorCapabilities.h>
+#include <crt_PacketCodec.h>
+#include <crt_PacketView.h>
+#include <crt_FragmentReassembler.h>
+#include <crt_PollSchedule.h>
+#include "crt_ApiRouter.h"
+#include "crt_ChannelScheduler.h"
+#include "crt_ShardDeltaEncoder.h"
+#include "crt_ShardAggregator.h"
+#include "crt_MeasurementJsonCache.h"
+#include "crt_AllMeasurementsResponse.h"
+#include "crt_SampleStoragePool.h"
+#include "crt_FileLogStorage.h"
+#include "crt_MeasurementLog.h"
+#include "crt_MeasurementExport.h"
 #include "crt_IndexHtml.h"
 #include "crt_GridHtml.h"
 
@@ -15,17 +31,56 @@ namespace crt
 	class ServerNode
 	{
 	private:
-		static const uint8_t MAX_SENSORS = 8;
+		static const uint8_t MAX_SENSORS = 64;	// sensor ids 1..64, over all shards
 		static const uint8_t MAX_POLL_RETRIES = 5;
 		static const unsigned long DISCOVER_INTERVAL_MS = 500;
 		static const unsigned long DATA_TIMEOUT_MS = 200;
+		static const unsigned long DATA_TIMEOUT_PER_PACKET_MS = 4;	// added per DataPacket of the reply
 		static const unsigned long LED_FLASH_INTERVAL_MS = 500;
+		static const uint8_t MAX_API_ROUTES = 8;
+		static const uint8_t GRID_COLUMNS = 4;	// sensor widgets per row on /grid
+		static const uint8_t MAX_NAME_LENGTH = 15;
+		static const uint8_t MAX_UNIT_LENGTH = 7;
+		static const uint8_t MAX_CHANNELS = 4;	// the AP channel plus extra ones
+		static const uint32_t CHANNEL_SWITCH_US = 1000;	// esp_wifi_set_channel(), roughly
+
+		// Sharding: every UPLINK_INTERVAL_MS, in between two POLLs, a shard sends a summary and
+		// the changed measurement arrays to the root, a few frames at a time, and a keyframe of
+		// every sensor at least every SHARD_KEYFRAME_INTERVAL uplinks.
+		static const uint8_t MAX_SHARDS = 8;
+		static const unsigned long UPLINK_INTERVAL_MS = 50;
+		static const unsigned long MAX_UPLINK_WAIT_MS = 100;	// for the send callbacks, before leaving the root's channel
+		static const uint8_t MAX_UPLINK_FRAMES_IN_FLIGHT = 4;
+		static const uint8_t SHARD_KEYFRAME_INTERVAL = 40;	// 2 s: how long a restarted root waits for unchanged arrays
+		static const uint8_t SHARD_QUEUE_SIZE = 16;	// root: frames received, not processed yet
+		// Shards and the root stay put and are placed within good range of each other, so their
+		// frames can use a PHY rate that far-away sensors and relays could not: a frame then takes
+		// a tenth of the airtime, which the root's channel would otherwise run out of.
+		static const wifi_phy_rate_t UPLINK_RATE = WIFI_PHY_RATE_24M;
+
+		// Storage for the sample buffers and JSON slabs of all sensors, allocated per sensor
+		// from its SensorCapabilities. E.g. 8 sensors of 64 samples take 5.4 kB, 64 of them
+		// (a root server with shards) 43 kB, a single sensor of 2048 16-bit samples 20.5 kB.
+		static const uint32_t STORAGE_POOL_SIZE = 49152;
+		// Largest reply of a single sensor (e.g. 4096 samples of 16 bits).
+		static const uint32_t MAX_FRAME_BYTES = 8192;
+
+		// Measurement log on the LittleFS partition: 16 segments of 16 chunks of 4 kB
+		// (1 MB of the 1.4 MB partition). At most LOG_FLUSH_INTERVAL_S of data is lost on a reset.
+		typedef MeasurementLog<4096, 16, 16> Log;
+		static constexpr const char* LOG_DIRECTORY = LITTLEFS_ROOT "/mlog";
+		static const uint32_t LOG_FLUSH_INTERVAL_S = 30;
+		// Rows of /api/export.* are formatted into a buffer of this size on the stack.
+		static const uint16_t EXPORT_BUFFER_SIZE = 1024;
+		// An export serves the radio after every slice of about this long, well within DATA_TIMEOUT_MS.
+		static const uint32_t EXPORT_SLICE_US = DATA_TIMEOUT_MS * 1000 / 2;
 
 		enum class State : uint8_t
 		{
 			DISCOVERING,
 			POLLING,
 			WAITING_DATA,
+			UPLINKING,
 		};
 
 		struct SensorState
@@ -33,46 +88,188 @@ namespace crt
 			bool registered;
 			bool seen;
 			uint8_t id;
-			uint8_t mac[6];
+			uint8_t mac[6];		// next hop: the sensor itself, or the relay it registered through
 			bool peerAdded;
-			uint16_t measurements[MEASUREMENT_COUNT];
-			uint8_t measurementCount;
+			uint8_t hopCount;	// 1 = in direct range of the server
+			uint8_t features;	// FEATURE_* bits from its REGISTER
+			SensorCapabilities capabilities;
+			// Two CODEC_RAW frames of capabilities.sampleCount samples, in one block from storagePool:
+			// samples holds the last reply, the next one is reassembled into backBuffer, and
+			// the two are swapped when it changed.
+			uint8_t* sampleBuffers;
+			uint8_t* samples;
+			uint8_t* backBuffer;
+			uint8_t* uplinkBuffer;	// shard: a third frame, the array the root has (uplinkSequence)
+			uint16_t sampleCount;	// samples in the last reply
 			unsigned long lastSeenMs;
+			uint32_t generation;	// value of currentGeneration when this sensor last changed
+			uint8_t missedWindows;	// duty cycling: windows in a row without a reply
+			uint8_t pendingGroup;	// channel group its POLLs move it to, or NO_GROUP
+			uint8_t shard;			// root: the shard server it is reached through; 0: this server
+			uint16_t publishSequence;	// incremented per published measurement array
+			uint16_t uplinkSequence;	// shard: the array in uplinkBuffer, if uplinkValid
+			bool uplinkValid;
+			bool uplinkSent;		// shard: given out in the current uplink
+			uint8_t uplinksSinceKeyframe;
+		};
+
+		// What /api/layout calls a sensor. Kept apart from SensorState, which init() clears.
+		struct SensorLabel
+		{
+			char name[MAX_NAME_LENGTH + 1];
+			char unit[MAX_UNIT_LENGTH + 1];
+		};
+
+		typedef ApiRouter<ServerNode, MAX_API_ROUTES> Router;
+		typedef ChannelScheduler<MAX_SENSORS, MAX_CHANNELS> Channels;
+		typedef ShardAggregator<MAX_SENSORS, MAX_SHARDS> Aggregator;
+
+		// Hands every GET request whose path is known to the router over to it.
+		// WebServer then only needs this single handler for the complete /api/* surface.
+		class ApiRequestHandler : public RequestHandler
+		{
+		private:
+			ServerNode& serverNode;
+			Router::Handler matchedHandler;
+			RouteParams matchedParams;
+
+		public:
+			ApiRequestHandler(ServerNode& serverNode)
+				: serverNode(serverNode), matchedHandler(nullptr)
+			{
+			}
+
+			bool canHandle(HTTPMethod method, const String& uri) override
+			{
+				return (method == HTTP_GET) &&
+					   serverNode.router.match(uri.c_str(), matchedHandler, matchedParams);
+			}
+
+			bool handle(WebServer& server, HTTPMethod requestMethod, const String& requestUri) override
+			{
+				(serverNode.*matchedHandler)(matchedParams);
+				return true;
+			}
+		};
+
+		// WebServer splits the query into String arguments when it parses the request, and does
+		// not keep the raw query. server.arg() returns a copy of such an argument; findArg()
+		// reads it in place, such that a request can be handled without allocating.
+		class ApiWebServer : public WebServer
+		{
+		public:
+			ApiWebServer(int port) : WebServer(port)
+			{
+			}
+
+			// Returns nullptr if the request has no such query argument.
+			const String* findArg(const char* name) const
+			{
+				for (int i = 0; i < _currentArgCount; i++)
+				{
+					if (_currentArgs[i].key == name) return &_currentArgs[i].value;
+				}
+				return nullptr;
+			}
 		};
 
 		const char* apSsid;
 		const char* apPass;
 		int apChannel;
 		uint8_t expectedSensorCount;
-		WebServer server;
+		bool fecEnabled;
+		ApiWebServer server;
+		Router router;
+		ApiRequestHandler apiRequestHandler;
 
 		State currentState;
 		uint8_t currentPollIndex;
 		uint8_t pollRetryCount;
 		unsigned long stateEnteredMs;
+		unsigned long pollSentUs;	// of the first POLL of the current reply
+		PollSchedule<MAX_SENSORS> schedule;
+		bool cyclePlanned;			// schedule.beginCycle() was called for the current poll cycle
+		uint32_t nofMissedWindows;
+		Channels channels;
+		uint8_t tunedChannel;
+		bool hoppingAllowed;		// for the current poll cycle: no station is connected to the AP
+		uint32_t nofChannelSwitches;
 		unsigned long lastDiscoverMs;
 		unsigned long lastLedToggleMs;
 		bool ledOn;
+		uint8_t discoverSequence;
 
 		uint8_t registeredIds[MAX_SENSORS];
 		uint8_t registeredCount;
+		uint8_t firstSensorId;	// the ids this server polls
+		uint8_t lastSensorId;
+
+		// Shard: forwards its sensors to the root server (shardId 0: not a shard)
+		uint8_t shardId;
+		uint8_t rootMac[6];
+		uint8_t rootChannel;
+		uint16_t uplinkCycle;
+		uint8_t uplinkSensorId;		// next sensor to consider in the current uplink
+		ShardDeltaEncoder uplinkEncoder;
+		uint8_t uplinkFrame[ShardDeltaCodec::MAX_SIZE];
+		size_t uplinkFrameLength;	// 0: no frame waiting to be sent
+		uint16_t uplinkFramesSent;
+		uint16_t sendCallbacksAtUplink;
+		uint16_t sendFailuresAtUplink;
+		unsigned long uplinkStartMs;
+		unsigned long lastUplinkMs;
+		uint32_t nofUplinks;
+		uint32_t nofUplinkFrames;
+		uint32_t nofUplinkBytes;
+		uint32_t nofKeyframes;
+		uint32_t nofUplinksSkipped;
+
+		// Root: collects the sensors of shard servers
+		Aggregator aggregator;
 
 		SensorState sensors[MAX_SENSORS + 1]; // indexed 1..MAX_SENSORS
+		SampleStoragePool<STORAGE_POOL_SIZE, 2 * MAX_SENSORS> storagePool;
+		MeasurementJsonCache<MAX_SENSORS> jsonCache;
+		uint32_t currentGeneration;             // incremented on every change of any SensorState
+		uint32_t bootEpoch;                     // random per boot: generations of an earlier boot do not count
+		SensorLabel labels[MAX_SENSORS + 1];	// indexed 1..MAX_SENSORS
+		uint32_t layoutGeneration;              // incremented on every change of what /api/layout reports
+
+		bool logEnabled;
+		bool logReady;
+		FileLogStorage logStorage;
+		Log measurementLog;
+		uint32_t logTimeBase;	// log time at boot: continues where the log ended before the reset
 
 		// Static callback data (set by ESP-NOW callbacks, read by update())
 		static volatile bool newRegisterReceived;
 		static volatile uint8_t receivedRegisterSensorId;
 		static volatile uint8_t receivedRegisterMac[6];
+		static volatile uint8_t receivedRegisterHopCount;
+		static volatile uint8_t receivedRegisterFeatures;
+		static SensorCapabilities receivedRegisterCapabilities;
 
 		static volatile bool newDataReceived;
 
-		// Multi-packet reassembly state
-		static const uint16_t MAX_REASSEMBLY_SIZE = 500;
-		static uint8_t reassemblyBuffer[MAX_REASSEMBLY_SIZE];
-		static volatile uint8_t dataPacketsReceived;
-		static volatile uint8_t dataPacketsExpected;
-		static volatile uint16_t reassemblyBytesReceived;
-		static volatile uint8_t reassemblySensorId;
+		// Multi-packet reassembly state; writes into the backBuffer of the polled sensor.
+		// The callback fills it while update() restarts it or frees that backBuffer,
+		// hence guarded by reassemblerMux.
+		static FragmentReassembler reassembler;
+		static portMUX_TYPE reassemblerMux;
+		static volatile uint32_t nofParityRepairs;	// replies completed from a DataParityPacket
+		static volatile uint32_t nofPollRetries;	// replies that needed a re-POLL
+		static volatile uint16_t nofSendCallbacks;
+		static volatile uint16_t nofSendFailures;
+
+		// Root: frames of shard servers, queued by the ESP-NOW callback for update()
+		static volatile bool shardFramesAccepted;
+		static uint8_t shardFrames[SHARD_QUEUE_SIZE][ShardDeltaCodec::MAX_SIZE];
+		static uint8_t shardFrameLengths[SHARD_QUEUE_SIZE];
+		static_assert(ShardSummaryCodec::MAX_SIZE <= ShardDeltaCodec::MAX_SIZE && ShardDeltaCodec::MAX_SIZE <= 0xFF,
+					  "a queued shard frame must fit its slot and its uint8_t length");
+		static volatile uint8_t shardQueueHead;	// written by the callback only
+		static volatile uint8_t shardQueueTail;	// written by update() only
+		static volatile uint32_t nofShardFramesDropped;
 
 		static constexpr uint8_t BROADCAST_ADDRESS[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
@@ -88,67 +285,94 @@ namespace crt
 			{
 				case MessageType::REGISTER:
 				{
-					if (len >= (int)sizeof(RegisterPacket))
+					RegisterPacketView pkt(incomingData, len);
+					if (pkt.isValid())
 					{
-						RegisterPacket pkt;
-						memcpy(&pkt, incomingData, sizeof(pkt));
-						receivedRegisterSensorId = pkt.sensorId;
+						receivedRegisterSensorId = pkt.getSensorId();
+						receivedRegisterHopCount = pkt.getHopCount();
+						receivedRegisterFeatures = pkt.getFeatures();
+						receivedRegisterCapabilities = pkt.getCapabilities();
 						memcpy((void*)receivedRegisterMac, info->src_addr, 6);
 						newRegisterReceived = true;
-						ESP_LOGI("ServerNode", "[ESP-NOW] REGISTER from sensor %u", pkt.sensorId);
+						ESP_LOGI("ServerNode", "[ESP-NOW] REGISTER from sensor %u (hop %u)", pkt.getSensorId(), pkt.getHopCount());
 					}
 					break;
 				}
 				case MessageType::DATA:
 				{
-					if (len >= 5)
+					// The payload goes straight from the received frame into the sensor's back buffer.
+					DataPacketView pkt(incomingData, len);
+					if (pkt.isValid())
 					{
-						DataPacket pkt;
-						size_t copyLen = len < (int)sizeof(DataPacket) ? len : sizeof(DataPacket);
-						memcpy(&pkt, incomingData, copyLen);
+						ESP_LOGI("ServerNode", "[ESP-NOW] DATA from sensor %u, pkt %u/%u (%u bytes)",
+								 pkt.getSensorId(), pkt.getPacketIndex() + 1, pkt.getTotalPackets(), pkt.getPayloadSize());
 
-						if (pkt.packetIndex == 0)
+						portENTER_CRITICAL(&reassemblerMux);
+						bool complete = reassembler.addData(pkt);
+						portEXIT_CRITICAL(&reassemblerMux);
+						if (complete)
 						{
-							// Start new reassembly
-							reassemblySensorId = pkt.sensorId;
-							dataPacketsExpected = pkt.totalPackets;
-							dataPacketsReceived = 0;
-							reassemblyBytesReceived = 0;
-						}
-
-						if (pkt.sensorId == reassemblySensorId &&
-							pkt.packetIndex == dataPacketsReceived)
-						{
-							uint16_t offset = reassemblyBytesReceived;
-							if (offset + pkt.payloadSize <= MAX_REASSEMBLY_SIZE)
-							{
-								memcpy(reassemblyBuffer + offset, pkt.payload, pkt.payloadSize);
-								reassemblyBytesReceived += pkt.payloadSize;
-							}
-							dataPacketsReceived++;
-
-							ESP_LOGI("ServerNode", "[ESP-NOW] DATA from sensor %u, pkt %u/%u (%u bytes)",
-									 pkt.sensorId, pkt.packetIndex + 1, pkt.totalPackets, pkt.payloadSize);
-
-							if (dataPacketsReceived >= dataPacketsExpected)
-							{
-								newDataReceived = true;
-							}
+							newDataReceived = true;
 						}
 					}
 					break;
 				}
+				case MessageType::DATA_PARITY:
+				{
+					DataParityPacketView pkt(incomingData, len);
+					if (!pkt.isValid()) break;
+					portENTER_CRITICAL(&reassemblerMux);
+					bool repaired = reassembler.addParity(pkt);
+					portEXIT_CRITICAL(&reassemblerMux);
+					if (repaired)
+					{
+						nofParityRepairs++;
+						ESP_LOGI("ServerNode", "[ESP-NOW] PARITY from sensor %u repaired a lost packet", pkt.getSensorId());
+						newDataReceived = true;
+					}
+					break;
+				}
+				case MessageType::SHARD_SUMMARY:
+				{
+					PacketView<ShardSummaryCodec> pkt(incomingData, len);
+					if (pkt.isValid()) queueShardFrame(incomingData, len);
+					break;
+				}
+				case MessageType::SHARD_DELTA:
+				{
+					PacketView<ShardDeltaCodec> pkt(incomingData, len);
+					if (pkt.isValid()) queueShardFrame(incomingData, len);
+					break;
+				}
 				default:
 					break;
 			}
 		}
 
+		// ESP-NOW callback context. A full queue drops the frame; the sensor catches up with the next keyframe.
+		static void queueShardFrame(const uint8_t* frame, int length)
+		{
+			if (!shardFramesAccepted || length > (int)ShardDeltaCodec::MAX_SIZE) return;
+			uint8_t head = shardQueueHead;
+			uint8_t next = (uint8_t)((head + 1) % SHARD_QUEUE_SIZE);
+			if (next == shardQueueTail)
+			{
+				nofShardFramesDropped++;
+				return;
+			}
+			memcpy(shardFrames[head], frame, length);
+			shardFrameLengths[head] = (uint8_t)length;
+			shardQueueHead = next;
+		}
+
 		static void onDataSent(const uint8_t* mac_addr, esp_now_send_status_t status)
 		{
 			if (status != ESP_NOW_SEND_SUCCESS)
 			{
 				ESP_LOGW("ServerNode", "Send failed");
+				nofSendFailures++;
 			}
+			nofSendCallbacks++;
 		}
 
 		// --- Helper methods ---
@@ -160,18 +384,213 @@ namespace crt
 			{
 				esp_now_peer_info_t peer = {};
 				memcpy(peer.peer_addr, s.mac, 6);
-				peer.channel = apChannel;
+				peer.channel = 0; // the current one, which changes with the channel group polled
 				peer.encrypt = false;
 				esp_now_add_peer(&peer);
 				s.peerAdded = true;
 			}
 		}
 
+		// Several sensors share a next hop when they are reached through the same relay.
+		bool isPeerShared(uint8_t sensorId)
+		{
+			for (uint8_t id = 1; id <= MAX_SENSORS; id++)
+			{
+				if (id != sensorId && sensors[id].registered && sensors[id].peerAdded &&
+					memcmp(sensors[id].mac, sensors[sensorId].mac, 6) == 0)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void removeSensorPeer(uint8_t sensorId)
+		{
+			SensorState& s = sensors[sensorId];
+			if (s.peerAdded && !isPeerShared(sensorId))
+			{
+				esp_now_del_peer(s.mac);
+			}
+			s.peerAdded = false;
+		}
+
+		bool isShard() const { return shardId != Aggregator::NO_SHARD; }
+
+		// Switches the radio (and with it the AP) to channel. Only while no station is
+		// connected to the AP, or to return to the AP channel.
+		void tuneTo(uint8_t channel)
+		{
+			if (channel == tunedChannel) return;
+			esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+			tunedChannel = channel;
+			nofChannelSwitches++;
+		}
+
+		// (Re-)starts the reassembly of sensorId's reply and sends it a POLL, on the channel of its group.
+		// Parity is requested if both sides support it.
+		// A sensor that is to move hears its new channel in the POLL and switches after its reply.
+		// If that reply got lost, the sensor may have switched already, so every other retry goes to
+		// the new channel.
+		void sendPoll(uint8_t sensorId)
+		{
+			SensorState& s = sensors[sensorId];
+			PollPacket poll;
+			poll.messageType = MessageType::POLL;
+			poll.sensorId = sensorId;
+			poll.flags = (fecEnabled && (s.features & FEATURE_XOR_PARITY)) ? POLL_FLAG_PARITY : 0;
+			poll.nextPollMs = sleepsBetweenPolls(sensorId) ? schedule.nextPollMs(sensorId, millis()) : 0;
+			poll.channel = 0;
+			if (channels.isEnabled())
+			{
+				uint8_t group = channels.getGroup(sensorId);
+				if (s.pendingGroup != Channels::NO_GROUP)
+				{
+					poll.channel = channels.getChannel(s.pendingGroup);
+					uint8_t attempt = sleepsBetweenPolls(sensorId) ? s.missedWindows : pollRetryCount;
+					if (attempt & 1) group = s.pendingGroup;
+				}
+				if (group != Channels::NO_GROUP) tuneTo(channels.getChannel(group));
+			}
+
+			newDataReceived = false;
+			portENTER_CRITICAL(&reassemblerMux);
+			reassembler.start(sensorId, s.backBuffer, frameBytes(s.capabilities), s.capabilities.maxFragment);
+			portEXIT_CRITICAL(&reassemblerMux);
+			uint8_t frame[PollCodec::MAX_SIZE];
+			esp_now_send(s.mac, frame, PollCodec::encode(poll, frame));
+		}
+
+		// Duty-cycled sensors sleep after their reply, until their next window.
+		bool sleepsBetweenPolls(uint8_t sensorId)
+		{
+			return schedule.isEnabled() && (sensors[sensorId].features & FEATURE_DUTY_CYCLE);
+		}
+
+		// Expected duration of a POLL and the reply of sensorId, from its capabilities.
+		uint32_t replyEstimateUs(uint8_t sensorId)
+		{
+			const SensorState& s = sensors[sensorId];
+			bool withParity = fecEnabled && (s.features & FEATURE_XOR_PARITY);
+			return PollSchedule<MAX_SENSORS>::estimateReplyUs(frameBytes(s.capabilities), s.capabilities.maxFragment, withParity);
+		}
+
+		// Starts the duty cycling estimate of sensorId's reply time over.
+		void resetReplyEstimate(uint8_t sensorId)
+		{
+			schedule.setEstimate(sensorId, replyEstimateUs(sensorId));
+		}
+
+		unsigned long dataTimeoutMs(uint8_t sensorId)
+		{
+			return DATA_TIMEOUT_MS + packetsPerReply(sensors[sensorId].capabilities) * DATA_TIMEOUT_PER_PACKET_MS;
+		}
+
+		// A duty-cycled sensor is waited for until the end of its window, as the ones after it will be awake by then.
+		unsigned long replyTimeoutMs(uint8_t sensorId)
+		{
+			unsigned long timeoutMs = dataTimeoutMs(sensorId);
+			if (!sleepsBetweenPolls(sensorId)) return timeoutMs;
+			unsigned long slotMs = schedule.getSlotMs(sensorId);
+			return (slotMs < timeoutMs) ? slotMs : timeoutMs;
+		}
+
+		void releaseStorage(uint8_t sensorId)
+		{
+			SensorState& s = sensors[sensorId];
+			if (s.backBuffer != nullptr)
+			{
+				// The callback may still be reassembling a reply into it.
+				portENTER_CRITICAL(&reassemblerMux);
+				if (reassembler.getSensorId() == sensorId) reassembler.stop();
+				portEXIT_CRITICAL(&reassemblerMux);
+			}
+			storagePool.release((const uint8_t*)jsonCache.detach(sensorId));
+			storagePool.release(s.sampleBuffers);
+			s.sampleBuffers = nullptr;
+			s.samples = nullptr;
+			s.backBuffer = nullptr;
+			s.uplinkBuffer = nullptr;
+			s.sampleCount = 0;
+			if (s.seen) s.generation = ++currentGeneration; // no longer reported
+			s.seen = false;
+		}
+
+		// Gives sensorId storage for the samples and JSON slab that caps call for, keeping
+		// the current storage if the capabilities did not change. Returns false if the
+		// pool has no room left for them.
+		bool allocateStorage(uint8_t sensorId, const SensorCapabilities& caps)
+		{
+			SensorState& s = sensors[sensorId];
+			if (s.samples != nullptr && s.capabilities == caps) return true;
+
+			releaseStorage(sensorId);
+			uint8_t nofFrames = isShard() ? 3 : 2;
+			uint32_t slabSize = jsonCache.slabSize(caps.sampleCount, caps.sampleWidth);
+			uint8_t* sampleBuffers = storagePool.allocate(nofFrames * frameBytes(caps));
+			uint8_t* slab = storagePool.allocate(slabSize);
+			if (sampleBuffers == nullptr || slab == nullptr)
+			{
+				storagePool.release(sampleBuffers);
+				storagePool.release(slab);
+				return false;
+			}
+
+			s.capabilities = caps;
+			s.sampleBuffers = sampleBuffers;
+			s.samples = sampleBuffers;
+			s.backBuffer = sampleBuffers + frameBytes(caps);
+			s.uplinkBuffer = (nofFrames == 3) ? sampleBuffers + 2 * frameBytes(caps) : nullptr;
+			s.uplinkValid = false;
+			jsonCache.attach(sensorId, (char*)slab, (uint16_t)slabSize);
+			s.generation = ++currentGeneration;
+			layoutGeneration++;
+			ESP_LOGI("ServerNode", "Sensor %u: %u samples of %u bytes, %lu bytes of storage (pool %lu/%lu used)",
+					 sensorId, caps.sampleCount, caps.sampleWidth,
+					 (unsigned long)(storagePool.allocationSize(nofFrames * frameBytes(caps)) + storagePool.allocationSize(slabSize)),
+					 (unsigned long)storagePool.getUsed(), (unsigned long)storagePool.getCapacity());
+			return true;
+		}
+
+		// Publishes the count samples in the back buffer of sensorId by swapping the buffers,
+		// if they differ from the published ones.
+		void publishSamples(uint8_t sensorId, uint16_t count)
+		{
+			SensorState& s = sensors[sensorId];
+			uint8_t width = s.capabilities.sampleWidth;
+			bool changed = !s.seen || s.sampleCount != count ||
+						   memcmp(s.samples, s.backBuffer, (size_t)count * width) != 0;
+			if (!changed) return;
+
+			uint8_t* published = s.backBuffer;
+			s.backBuffer = s.samples;
+			s.samples = published;
+			s.sampleCount = count;
+			s.publishSequence++;
+			s.generation = ++currentGeneration;
+			jsonCache.invalidate(sensorId);
+			if (logReady) measurementLog.append(sensorId, logTime(), s.samples, s.sampleCount, width);
+		}
+
+		bool isInRegisteredIds(uint8_t sensorId)
+		{
+			for (uint8_t i = 0; i < registeredCount; i++)
+			{
+				if (registeredIds[i] == sensorId) return true;
+			}
+			return false;
+		}
+
 		void broadcastDiscover()
 		{
 			DiscoverPacket disc;
 			disc.messageType = MessageType::DISCOVER;
-			esp_now_send(BROADCAST_ADDRESS, (uint8_t*)&disc, sizeof(disc));
+			disc.sequence = discoverSequence++;
+			disc.hopCount = 0;
+			disc.pathCost = 0;
+			uint8_t frame[DiscoverCodec::MAX_SIZE];
+			tuneTo((uint8_t)apChannel); // sensors (re-)register on the AP channel
+			esp_now_send(BROADCAST_ADDRESS, frame, DiscoverCodec::encode(disc, frame));
 			ESP_LOGI("ServerNode", "Broadcast DISCOVER (%u/%u registered)",
 					 registeredCount, expectedSensorCount);
 		}
@@ -182,25 +601,138 @@ namespace crt
 			newRegisterReceived = false;
 
 			uint8_t id = receivedRegisterSensorId;
-			if (id < 1 || id > MAX_SENSORS) return;
+			if (id < firstSensorId || id > lastSensorId) return; // another server's sensor
 
-			if (!sensors[id].registered)
+			SensorCapabilities caps = receivedRegisterCapabilities;
+			const char* rejectReason = checkCapabilities(caps, MAX_FRAME_BYTES);
+			if (rejectReason != nullptr)
+			{
+				ESP_LOGW("ServerNode", "Sensor %u rejected: %s", id, rejectReason);
+				return;
+			}
+			if (!allocateStorage(id, caps))
 			{
+				// Not registered: polling stops if it was, and it is asked again on the next DISCOVER.
+				ESP_LOGW("ServerNode", "Sensor %u rejected: %u samples of %u bytes do not fit in the storage pool (%lu bytes free)",
+						 id, caps.sampleCount, caps.sampleWidth, (unsigned long)storagePool.getLargestFree());
+				if (sensors[id].registered)
+				{
+					removeSensorPeer(id);
+					sensors[id].registered = false;
+					sensors[id].generation = ++currentGeneration;
+					channels.remove(id);
+				}
+				return;
+			}
+
+			if (sensors[id].registered)
+			{
+				// A registered sensor that registers through another next hop has moved in the relay tree.
+				if (memcmp(sensors[id].mac, (const void*)receivedRegisterMac, 6) != 0)
+				{
+					removeSensorPeer(id);
+					memcpy(sensors[id].mac, (const void*)receivedRegisterMac, 6);
+					sensors[id].hopCount = receivedRegisterHopCount;
+					sensors[id].features = receivedRegisterFeatures;
+					resetReplyEstimate(id);
+					ESP_LOGI("ServerNode", "Sensor %u now reached via %02X:%02X:%02X:%02X:%02X:%02X (hop %u)",
+							 id, sensors[id].mac[0], sensors[id].mac[1], sensors[id].mac[2],
+							 sensors[id].mac[3], sensors[id].mac[4], sensors[id].mac[5], sensors[id].hopCount);
+				}
+			}
+			else
+			{
+				if (sensors[id].id != id) layoutGeneration++; // first registration since boot
 				sensors[id].registered = true;
 				sensors[id].id = id;
 				memcpy(sensors[id].mac, (const void*)receivedRegisterMac, 6);
 				sensors[id].peerAdded = false;
+				sensors[id].hopCount = receivedRegisterHopCount;
+				sensors[id].features = receivedRegisterFeatures;
+				sensors[id].missedWindows = 0;
+				resetReplyEstimate(id);
 
-				registeredIds[registeredCount] = id;
-				registeredCount++;
+				if (!isInRegisteredIds(id))
+				{
+					registeredIds[registeredCount] = id;
+					registeredCount++;
+				}
+				sensors[id].generation = ++currentGeneration;
 
 				ESP_LOGI("ServerNode", "Registered sensor %u (%u/%u) MAC=%02X:%02X:%02X:%02X:%02X:%02X",
 						 id, registeredCount, expectedSensorCount,
 						 sensors[id].mac[0], sensors[id].mac[1], sensors[id].mac[2],
 						 sensors[id].mac[3], sensors[id].mac[4], sensors[id].mac[5]);
 			}
+
+			// A REGISTER comes in on the AP channel, so the sensor is back in the home group,
+			// also when it registers again after losing the server on another channel.
+			// Only sensors in direct range move: a relay stays on the channel of its children.
+			channels.add(id, replyEstimateUs(id), sensors[id].hopCount == 1 && (sensors[id].features & FEATURE_CHANNEL_HOP));
+			sensors[id].pendingGroup = Channels::NO_GROUP;
+		}
+
+		// Starts a poll cycle. With extra channels, it plans the next move of a sensor to
+		// another channel group, and orders the sensors by group, such that the radio
+		// switches channels once per group. The radio only leaves the AP channel while
+		// no station is connected to the AP: esp_wifi_set_channel() would move the AP
+		// away from them. Meanwhile, the sensors on other channels are dropped; they
+		// return to the AP channel when their parent times out, and register again.
+		void startCycle()
+		{
+			currentPollIndex = 0;
+			cyclePlanned = false;
+			if (!channels.isEnabled()) return;
+
+			bool allowed = (WiFi.softAPgetStationNum() == 0);
+			if (allowed != hoppingAllowed)
+			{
+				if (allowed)
+				{
+					ESP_LOGI("ServerNode", "Polling on %u channels", channels.getNofGroups());
+				}
+				else
+				{
+					ESP_LOGI("ServerNode", "Station connected: polling on channel %d only", apChannel);
+				}
+				hoppingAllowed = allowed;
+			}
+			if (!hoppingAllowed)
+			{
+				for (uint8_t i = 0; i < registeredCount; i++)
+				{
+					uint8_t id = registeredIds[i];
+					if (!sensors[id].registered || channels.getGroup(id) == 0) continue;
+					removeSensorPeer(id);
+					sensors[id].registered = false;
+					sensors[id].generation = ++currentGeneration;
+					channels.remove(id);
+				}
+			}
+			uint8_t moveId, moveGroup;
+			if (hoppingAllowed && channels.findMove(moveId, moveGroup))
+			{
+				sensors[moveId].pendingGroup = moveGroup;
+				ESP_LOGI("ServerNode", "Moving sensor %u from channel %u to %u", moveId,
+						 channels.getChannel(channels.getGroup(moveId)), channels.getChannel(moveGroup));
+			}
+
+			// Insertion sort: stable, and registeredIds is short and mostly in order already.
+			for (uint8_t i = 1; i < registeredCount; i++)
+			{
+				uint8_t id = registeredIds[i];
+				uint8_t group = channels.getGroup(id);
+				uint8_t j = i;
+				while (j > 0 && channels.getGroup(registeredIds[j - 1]) > group)
+				{
+					registeredIds[j] = registeredIds[j - 1];
+					j--;
+				}
+				registeredIds[j] = id;
+			}
 		}
 
+
 		bool anySensorMissing()
 		{
 			if (registeredCount < expectedSensorCount) return true;
@@ -250,7 +782,7 @@ namespace crt
 			{
 				ESP_LOGI("ServerNode", "All %u sensors registered, starting POLL cycle",
 						 expectedSensorCount);
-				currentPollIndex = 0;
+				startCycle();
 				currentState = State::POLLING;
 			}
 		}
@@ -258,6 +790,7 @@ namespace crt
 		void handlePolling()
 		{
 			processRegister();
+			if (beginUplink()) return; // polling resumes after it
 
 			// Cycle complete?
 			if (currentPollIndex >= registeredCount)
@@ -266,7 +799,7 @@ namespace crt
 				{
 					broadcastDiscover();
 				}
-				currentPollIndex = 0;
+				startCycle();
 			}
 
 			// Skip unregistered sensors
@@ -278,23 +811,35 @@ namespace crt
 
 			if (currentPollIndex >= registeredCount)
 			{
-				// All unregistered, broadcast and reset
-				broadcastDiscover();
-				currentPollIndex = 0;
+				// All unregistered, broadcast and reset. A root without sensors of its own only aggregates.
+				unsigned long now = millis();
+				if (anySensorMissing() && now - lastDiscoverMs >= DISCOVER_INTERVAL_MS)
+				{
+					lastDiscoverMs = now;
+					broadcastDiscover();
+				}
+				startCycle();
 				return;
 			}
 
 			uint8_t sensorId = registeredIds[currentPollIndex];
+			if (schedule.isEnabled())
+			{
+				// Poll cycle: every sensor is polled once, in its window (if it has one yet).
+				if (!cyclePlanned)
+				{
+					schedule.beginCycle(millis(), registeredIds, registeredCount);
+					cyclePlanned = true;
+				}
+				uint32_t windowMs;
+				if (schedule.getWindow(sensorId, windowMs) && (int32_t)(millis() - windowMs) < 0) return;
+			}
 			ensureSensorPeer(sensorId);
 
-			PollPacket poll;
-			poll.messageType = MessageType::POLL;
-			poll.sensorId = sensorId;
-
-			newDataReceived = false;
-			esp_now_send(sensors[sensorId].mac, (uint8_t*)&poll, sizeof(poll));
-
 			pollRetryCount = 0;
+			sendPoll(sensorId);
+
+			pollSentUs = micros();
 			stateEnteredMs = millis();
 			currentState = State::WAITING_DATA;
 		}
@@ -308,39 +853,59 @@ namespace crt
 				newDataReceived = false;
 				uint8_t expectedId = registeredIds[currentPollIndex];
 
-				if (reassemblySensorId == expectedId)
+				SensorState& s = sensors[expectedId];
+				// Not complete if the sensor re-registered and got new storage since.
+				if (reassembler.getSensorId() == expectedId && reassembler.isComplete() && s.samples != nullptr)
 				{
-					uint8_t count = reassemblyBytesReceived / sizeof(uint16_t);
-					if (count > MEASUREMENT_COUNT) count = MEASUREMENT_COUNT;
-
-					memcpy(sensors[expectedId].measurements, reassemblyBuffer,
-						   count * sizeof(uint16_t));
-					sensors[expectedId].measurementCount = count;
-					sensors[expectedId].lastSeenMs = millis();
-					sensors[expectedId].seen = true;
+					// The reply was reassembled in s.backBuffer.
+					uint8_t width = s.capabilities.sampleWidth;
+					uint32_t count = reassembler.getLength() / width;
+					if (count > s.capabilities.sampleCount) count = s.capabilities.sampleCount;
+					publishSamples(expectedId, (uint16_t)count);
+					s.lastSeenMs = millis();
+					s.seen = true;
+					s.missedWindows = 0;
+					if (pollRetryCount == 0) schedule.onReply(expectedId, micros() - pollSentUs);
+					channels.onReply(expectedId, micros() - pollSentUs);
+					if (s.pendingGroup != Channels::NO_GROUP)
+					{
+						// It switched after this reply (or before, if it missed the previous one).
+						channels.setGroup(expectedId, s.pendingGroup);
+						s.pendingGroup = Channels::NO_GROUP;
+					}
 
-					ESP_LOGI("ServerNode", "Sensor %u -> %u measurements, first=%u",
-							 expectedId, count, sensors[expectedId].measurements[0]);
+					ESP_LOGI("ServerNode", "Sensor %u -> %u measurements, first=%lu",
+							 expectedId, s.sampleCount, (unsigned long)readSample(s.samples, 0, width));
 
 					currentPollIndex++;
 					currentState = State::POLLING;
 				}
 			}
-			else if (millis() - stateEnteredMs >= DATA_TIMEOUT_MS)
+			else if (millis() - stateEnteredMs >= replyTimeoutMs(registeredIds[currentPollIndex]))
 			{
 				pollRetryCount++;
 				uint8_t expectedId = registeredIds[currentPollIndex];
 
-				if (pollRetryCount > MAX_POLL_RETRIES)
+				// A duty-cycled sensor whose reply got lost is asleep already: it is not
+				// re-polled, but polled again in its next window.
+				bool sleeps = sleepsBetweenPolls(expectedId);
+				if (sleeps)
+				{
+					sensors[expectedId].missedWindows++;
+					schedule.onMissedWindow(expectedId);
+				}
+
+				if ((sleeps ? sensors[expectedId].missedWindows : pollRetryCount) > MAX_POLL_RETRIES)
 				{
 					ESP_LOGW("ServerNode",
 							 "Sensor %u unresponsive after %u retries, marking unregistered",
 							 expectedId, MAX_POLL_RETRIES);
-					sensors[expectedId].registered = false;
-					sensors[expectedId].peerAdded = false;
-
 					// Remove peer so it can be re-added after re-registration
-					esp_now_del_peer(sensors[expectedId].mac);
+					// (unless other sensors are still reached through it).
+					removeSensorPeer(expectedId);
+					sensors[expectedId].registered = false;
+					sensors[expectedId].generation = ++currentGeneration;
+					channels.remove(expectedId);
 
 					// Remove from registeredIds by shifting
 					for (uint8_t i = currentPollIndex; i < registeredCount - 1; i++)
@@ -351,39 +916,288 @@ namespace crt
 
 					currentState = State::POLLING;
 				}
+				else if (sleeps)
+				{
+					ESP_LOGW("ServerNode", "Sensor %u missed its window (%u/%u)",
+							 expectedId, sensors[expectedId].missedWindows, MAX_POLL_RETRIES);
+					nofMissedWindows++;
+					currentPollIndex++;
+					currentState = State::POLLING;
+				}
 				else
 				{
 					ESP_LOGW("ServerNode", "Sensor %u timeout, retry %u/%u",
 							 expectedId, pollRetryCount, MAX_POLL_RETRIES);
 
-					PollPacket poll;
-					poll.messageType = MessageType::POLL;
-					poll.sensorId = expectedId;
-					esp_now_send(sensors[expectedId].mac, (uint8_t*)&poll, sizeof(poll));
+					nofPollRetries++;
+					sendPoll(expectedId);
 					stateEnteredMs = millis();
 				}
 			}
 		}
 
+		// --- Shards ---
+
+		// Shard: moves the radio to the root's channel and starts sending it the summary and
+		// the arrays that changed. Returns false if it is not a shard, the last uplink was less
+		// than UPLINK_INTERVAL_MS ago, or the radio may not leave the AP channel because a
+		// station is connected.
+		bool beginUplink()
+		{
+			if (!isShard()) return false;
+			unsigned long now = millis();
+			if (now - lastUplinkMs < UPLINK_INTERVAL_MS) return false;
+			lastUplinkMs = now;
+			if (rootChannel != apChannel && WiFi.softAPgetStationNum() > 0)
+			{
+				nofUplinksSkipped++;
+				return false;
+			}
+
+			ShardSummaryPacket summary = {};
+			summary.messageType = MessageType::SHARD_SUMMARY;
+			summary.shardId = shardId;
+			summary.cycle = ++uplinkCycle;
+			summary.firstSensorId = firstSensorId;
+			summary.lastSensorId = lastSensorId;
+			for (uint8_t id = firstSensorId; id <= lastSensorId; id++)
+			{
+				if (sensors[id].registered) summary.registeredMask |= (uint32_t)1 << (id - firstSensorId);
+				sensors[id].uplinkSent = false;
+			}
+			uplinkFrameLength = ShardSummaryCodec::encode(summary, uplinkFrame);
+
+			tuneTo(rootChannel);
+			uplinkSensorId = firstSensorId;
+			uplinkFramesSent = 0;
+			sendCallbacksAtUplink = nofSendCallbacks;
+			sendFailuresAtUplink = nofSendFailures;
+			uplinkStartMs = now;
+			nofUplinks++;
+			currentState = State::UPLINKING;
+			return true;
+		}
+
+		// Puts the next delta frame in uplinkFrame, starting on the next sensor whose array
+		// the root lacks when the current one is done. Returns false when all were sent.
+		bool nextUplinkFrame()
+		{
+			ShardDeltaPacket delta;
+			while (!uplinkEncoder.next(delta))
+			{
+				if (uplinkSensorId > lastSensorId) return false;
+				uint8_t id = uplinkSensorId++;
+				SensorState& s = sensors[id];
+				if (!s.seen || s.uplinkBuffer == nullptr) continue;
+				s.uplinksSinceKeyframe++;
+				bool keyframe = !s.uplinkValid || s.uplinksSinceKeyframe >= SHARD_KEYFRAME_INTERVAL;
+				if (!keyframe && s.uplinkSequence == s.publishSequence) continue;
+				if (keyframe)
+				{
+					s.uplinksSinceKeyframe = 0;
+					nofKeyframes++;
+				}
+				uplinkEncoder.begin(shardId, id, s.hopCount, s.publishSequence, s.uplinkSequence, s.samples,
+									keyframe ? nullptr : s.uplinkBuffer, s.sampleCount, s.capabilities.sampleWidth);
+			}
+			if (delta.flags & SHARD_FLAG_LAST)
+			{
+				// Given out completely: from now on the root has this array.
+				SensorState& s = sensors[delta.sensorId];
+				memcpy(s.uplinkBuffer, s.samples, (size_t)s.sampleCount * s.capabilities.sampleWidth);
+				s.uplinkSequence = s.publishSequence;
+				s.uplinkValid = true;
+				s.uplinkSent = true;
+			}
+			uplinkFrameLength = ShardDeltaCodec::encode(delta, uplinkFrame);
+			return true;
+		}
+
+		// Back to the AP channel and to polling. If any send failed, the root may lack one
+		// of the arrays sent: those sensors get a keyframe next time.
+		void finishUplink()
+		{
+			if (nofSendFailures != sendFailuresAtUplink)
+			{
+				for (uint8_t id = firstSensorId; id <= lastSensorId; id++)
+				{
+					if (sensors[id].uplinkSent) sensors[id].uplinkValid = false;
+				}
+			}
+			tuneTo((uint8_t)apChannel);
+			currentState = State::POLLING;
+		}
+
+		// Sends the uplink frames, at most MAX_UPLINK_FRAMES_IN_FLIGHT ahead of their send callbacks.
+		// Gives up after MAX_UPLINK_WAIT_MS: a sensor whose frames were not all sent is resent next time.
+		void handleUplinking()
+		{
+			uint16_t confirmed = (uint16_t)(nofSendCallbacks - sendCallbacksAtUplink);
+			if (millis() - uplinkStartMs >= MAX_UPLINK_WAIT_MS)
+			{
+				ESP_LOGW("ServerNode", "Uplink to the root timed out (%u/%u frames confirmed)", confirmed, uplinkFramesSent);
+				uplinkEncoder = ShardDeltaEncoder();
+				uplinkFrameLength = 0;
+				finishUplink();
+				return;
+			}
+			if (uplinkFrameLength == 0 && !nextUplinkFrame())
+			{
+				if (confirmed >= uplinkFramesSent) finishUplink();
+				return;
+			}
+			if ((uint16_t)(uplinkFramesSent - confirmed) >= MAX_UPLINK_FRAMES_IN_FLIGHT) return;
+			if (esp_now_send(rootMac, uplinkFrame, uplinkFrameLength) != ESP_OK) return; // tried again on the next update
+			uplinkFramesSent++;
+			nofUplinkFrames++;
+			nofUplinkBytes += uplinkFrameLength;
+			uplinkFrameLength = 0;
+		}
+
+		// Root: a shard announced its sensors. Those it owns join the layout, and stay fresh
+		// as long as the shard reports them registered.
+		void applyShardSummary(const ShardSummaryPacket& summary)
+		{
+			unsigned long now = millis();
+			bool restarted;
+			if (!aggregator.onSummary(summary, now, restarted)) return;
+			if (restarted) ESP_LOGI("ServerNode", "Shard %u restarted", summary.shardId);
+
+			for (uint8_t i = 0; i < 32 && summary.firstSensorId + i <= summary.lastSensorId; i++)
+			{
+				uint8_t id = summary.firstSensorId + i;
+				if (!aggregator.owns(summary.shardId, id, now)) continue;
+				SensorState& s = sensors[id];
+				bool registered = (summary.registeredMask >> i) & 1;
+				if (s.id != id)
+				{
+					s.id = id;
+					layoutGeneration++; // first appearance since boot
+				}
+				s.shard = summary.shardId;
+				if (registered != s.registered)
+				{
+					s.registered = registered;
+					s.generation = ++currentGeneration;
+				}
+				if (registered && s.seen) s.lastSeenMs = now;
+			}
+		}
+
+		// Root: applies a frame of a shard's array to the back buffer of the sensor, and
+		// publishes it after the last one.
+		void applyShardDelta(const ShardDeltaPacket& delta)
+		{
+			unsigned long now = millis();
+			Aggregator::Action action = aggregator.check(delta, now);
+			if (action == Aggregator::Action::DROP) return;
+
+			uint8_t id = delta.sensorId;
+			SensorState& s = sensors[id];
+			SensorCapabilities caps = makeCapabilities(delta.sampleCount, delta.sampleWidth);
+			const uint8_t* previousBuffers = s.sampleBuffers;
+			if (checkCapabilities(caps, MAX_FRAME_BYTES) != nullptr || !allocateStorage(id, caps))
+			{
+				aggregator.onMalformed(id);
+				return;
+			}
+			if (s.sampleBuffers != previousBuffers && !((delta.flags & SHARD_FLAG_KEYFRAME) && delta.frameIndex == 0))
+			{
+				// New storage: nothing to apply a delta, or the rest of a keyframe, to.
+				aggregator.forget(id);
+				return;
+			}
+			if (action == Aggregator::Action::START)
+			{
+				memcpy(s.backBuffer, s.samples, frameBytes(caps));
+			}
+			if (!ShardDeltaEncoder::applyRuns(delta.payload, delta.payloadSize, s.backBuffer, delta.sampleCount, delta.sampleWidth))
+			{
+				aggregator.onMalformed(id);
+				return;
+			}
+			if (aggregator.onApplied(delta))
+			{
+				publishSamples(id, delta.sampleCount);
+				s.hopCount = delta.hopCount;
+				s.shard = delta.shardId;
+				s.lastSeenMs = now;
+				s.seen = true;
+			}
+		}
+
+		// Root: handles the frames that the ESP-NOW callback queued.
+		void processShardFrames()
+		{
+			while (shardQueueTail != shardQueueHead)
+			{
+				uint8_t tail = shardQueueTail;
+				const uint8_t* frame = shardFrames[tail];
+				int length = shardFrameLengths[tail];
+				ShardSummaryPacket summary;
+				ShardDeltaPacket delta;
+				if (ShardSummaryCodec::decode(frame, length, summary))
+				{
+					applyShardSummary(summary);
+				}
+				else if (ShardDeltaCodec::decode(frame, length, delta))
+				{
+					applyShardDelta(delta);
+				}
+				shardQueueTail = (uint8_t)((tail + 1) % SHARD_QUEUE_SIZE);
+			}
+		}
+
+		// Runs one step of the ESP-NOW state machine.
+		void updateRadio()
+		{
+			updateLed();
+			processShardFrames();
+
+			switch (currentState)
+			{
+				case State::DISCOVERING:
+					handleDiscovering();
+					break;
+				case State::POLLING:
+					handlePolling();
+					break;
+				case State::WAITING_DATA:
+					handleWaitingData();
+					break;
+				case State::UPLINKING:
+					handleUplinking();
+					break;
+			}
+		}
+
 		// --- Web server ---
 
-		void handleApiSensors()
+		void handleApiSensors(const RouteParams& params)
 		{
 			unsigned long nowMs = millis();
 
 			String json = "{";
 			json += "\"now\":" + String(nowMs) + ",";
 			json += "\"sensors\":[";
+			bool first = true;
 			for (int i = 1; i <= MAX_SENSORS; i++)
 			{
-				if (i > 1) json += ",";
+				if (!isInLayout(i)) continue;
+				if (!first) json += ",";
+				first = false;
 				SensorState& s = sensors[i];
 				unsigned long age = s.seen ? (nowMs - s.lastSeenMs) : (unsigned long)0xFFFFFFFF;
 
 				json += "{";
 				json += "\"id\":" + String(i) + ",";
 				json += "\"seen\":" + String(s.seen ? "true" : "false") + ",";
-				json += "\"value\":" + String(s.seen ? (int)s.measurements[0] : 0) + ",";
+				json += "\"value\":" + String(s.seen ? readSample(s.samples, 0, s.capabilities.sampleWidth) : 0) + ",";
+				json += "\"hops\":" + String(s.registered ? (int)s.hopCount : 0) + ",";
+				json += "\"channel\":" + String(s.registered && s.shard == Aggregator::NO_SHARD ?
+												 (int)channels.getChannel(channels.getGroup(i)) : 0) + ",";
+				json += "\"shard\":" + String((int)s.shard) + ",";
+				json += "\"samples\":" + String(s.samples != nullptr ? (int)s.capabilities.sampleCount : 0) + ",";
 				json += "\"age_ms\":" + String(s.seen ? age : (unsigned long)0xFFFFFFFF);
 				json += "}";
 			}
@@ -392,8 +1206,9 @@ namespace crt
 			server.send(200, "application/json", json);
 		}
 
-		void handleApiMeasurements(uint8_t sensorId)
+		void handleApiMeasurements(const RouteParams& params)
 		{
+			uint32_t sensorId = params.getUint(0);
 			if (sensorId < 1 || sensorId > MAX_SENSORS || !sensors[sensorId].seen)
 			{
 				server.send(404, "application/json", "{\"error\":\"sensor not found\"}");
@@ -401,53 +1216,315 @@ namespace crt
 			}
 
 			SensorState& s = sensors[sensorId];
-			String json = "{";
-			json += "\"id\":" + String(sensorId) + ",";
-			json += "\"count\":" + String(s.measurementCount) + ",";
-			json += "\"values\":[";
-			for (uint8_t i = 0; i < s.measurementCount; i++)
+			uint16_t length = 0;
+			const char* fragment = jsonCache.get(sensorId, s.samples, s.sampleCount, s.capabilities.sampleWidth, length);
+			if (fragment == nullptr)
 			{
-				if (i > 0) json += ",";
-				json += String(s.measurements[i]);
+				server.send(404, "application/json", "{\"error\":\"no data\"}");
+				return;
 			}
-			json += "]}";
+			// Straight from the cache: send(200, type, fragment) would copy it into a String first.
+			server.setContentLength(length);
+			server.send(200, "application/json", "");
+			server.sendContent(fragment, length);
+		}
 
-			server.send(200, "application/json", json);
+		// Reads an unsigned integer query argument. Returns defaultValue if absent or malformed.
+		uint32_t getUintArg(const char* name, uint32_t defaultValue)
+		{
+			const String* text = server.findArg(name);
+			uint32_t value = 0;
+			if (text == nullptr || text->length() > 0xFF ||
+				!Router::parseUint(text->c_str(), (uint8_t)text->length(), value))
+			{
+				return defaultValue;
+			}
+			return value;
 		}
 
-		void handleApiAllMeasurements()
+		// Optional query arguments:
+		//   since=<generation>  only report sensors that changed after that generation ("delta":true).
+		//   epoch=<epoch>       the "epoch" of the response that generation came from. If it is not the
+		//                       current one, the server restarted since, and a full response is returned.
+		//                       So is one for a generation newer than the current one.
+		// "offline" lists the reported sensors that are not registered (any more), and in a delta
+		// response, "removed" lists the sensors that changed and are no longer reported at all.
+		// The handler returns right away: the WebServer serves one request at a time, so waiting
+		// here for a change would stall every other client.
+		void handleApiAllMeasurements(const RouteParams& params)
 		{
-			String json = "{\"sensors\":[";
-			for (int id = 1; id <= 4; id++)
+			// The response collects the cached fragments first, such that the content length is known
+			// and the response can be sent without building it in one big String.
+			AllMeasurementsResponse<MAX_SENSORS> response;
+			response.begin(server.findArg("since") != nullptr, getUintArg("since", 0),
+						   server.findArg("epoch") == nullptr || getUintArg("epoch", 0) == bootEpoch,
+						   currentGeneration, bootEpoch, layoutGeneration);
+			for (int id = 1; id <= MAX_SENSORS; id++)
 			{
-				if (id > 1) json += ",";
 				SensorState& s = sensors[id];
-				json += "{\"id\":" + String(id) + ",";
-				json += "\"count\":" + String(s.seen ? (int)s.measurementCount : 0) + ",";
-				json += "\"values\":[";
-				if (s.seen)
+				if (!response.includes(s.generation)) continue;
+				const char* fragment = nullptr;
+				uint16_t length = 0;
+				if (s.registered || s.seen)
 				{
-					for (uint8_t i = 0; i < s.measurementCount; i++)
-					{
-						if (i > 0) json += ",";
-						json += String(s.measurements[i]);
-					}
+					fragment = jsonCache.get(id, s.samples, s.sampleCount, s.capabilities.sampleWidth, length);
 				}
-				json += "]}";
+				response.add((uint8_t)id, fragment, length, s.registered);
+			}
+
+			server.setContentLength(response.end());
+			server.send(200, "application/json", "");
+			auto send = [this](const char* data, size_t length) { server.sendContent(data, length); };
+			response.send(send);
+		}
+
+		// Sensors that have a place on the grid page: the expected ones, and any other that
+		// ever registered, here or at a shard (SensorState::id is set then, and kept when
+		// it stops responding).
+		bool isInLayout(uint8_t sensorId)
+		{
+			return (sensorId >= firstSensorId && sensorId < firstSensorId + expectedSensorCount) ||
+				   sensors[sensorId].id == sensorId;
+		}
+
+		static void appendJsonString(String& json, const char* text)
+		{
+			json += "\"";
+			for (const char* p = text; *p != '\0'; p++)
+			{
+				if (*p == '"' || *p == '\\') json += '\\';
+				if ((uint8_t)*p >= 0x20) json += *p;
+			}
+			json += "\"";
+		}
+
+		// Describes the sensor widgets of the grid page, such that it does not need to
+		// know the sensors in advance. Changes only when a sensor joins, its capabilities
+		// change or it is renamed; /api/allmeasurements reports the current "layout", so
+		// the page knows when to fetch this again.
+		void handleApiLayout(const RouteParams& params)
+		{
+			String json = "{";
+			json += "\"layout\":" + String(layoutGeneration) + ",";
+			json += "\"columns\":" + String(GRID_COLUMNS) + ",";
+			json += "\"sensors\":[";
+			uint8_t position = 0;
+			for (int id = 1; id <= MAX_SENSORS; id++)
+			{
+				if (!isInLayout(id)) continue;
+				SensorState& s = sensors[id];
+				if (position > 0) json += ",";
+				json += "{";
+				json += "\"id\":" + String(id) + ",";
+				json += "\"name\":";
+				appendJsonString(json, labels[id].name);
+				json += ",\"unit\":";
+				appendJsonString(json, labels[id].unit);
+				json += ",\"position\":" + String(position) + ",";
+				json += "\"count\":" + String(s.samples != nullptr ? (int)s.capabilities.sampleCount : 0) + ",";
+				json += "\"width\":" + String(s.samples != nullptr ? (int)s.capabilities.sampleWidth : 0) + ",";
+				json += "\"registered\":" + String(s.registered ? "true" : "false");
+				json += "}";
+				position++;
 			}
 			json += "]}";
+
 			server.send(200, "application/json", json);
 		}
 
+		void handleApiStats(const RouteParams& params)
+		{
+			char json[1024];
+			snprintf(json, sizeof(json),
+					 "{\"generation\":%lu,\"jsonCache\":{\"hits\":%lu,\"misses\":%lu,\"bytes\":%lu},"
+					 "\"radio\":{\"parityRepairs\":%lu,\"pollRetries\":%lu},"
+					 "\"schedule\":{\"cycleMs\":%lu,\"burstMs\":%lu,\"cycles\":%lu,\"overruns\":%lu,\"missedWindows\":%lu},"
+					 "\"channels\":{\"count\":%u,\"hopping\":%s,\"switches\":%lu,\"moves\":%lu},"
+					 "\"shards\":{\"shard\":%u,\"uplinks\":%lu,\"uplinkFrames\":%lu,\"uplinkBytes\":%lu,\"keyframes\":%lu,"
+					 "\"uplinksSkipped\":%lu,\"liveShards\":%u,\"framesIn\":%lu,\"duplicates\":%lu,\"outOfSequence\":%lu,"
+					 "\"queueDrops\":%lu},"
+					 "\"storagePool\":{\"used\":%lu,\"capacity\":%lu},"
+					 "\"log\":{\"enabled\":%s,\"segments\":%u,\"chunks\":%lu,\"oldestTime\":%lu,\"time\":%lu,"
+					 "\"bytesAppended\":%lu,\"bytesWritten\":%lu,\"discardedChunks\":%lu,\"writeErrors\":%lu}}",
+					 (unsigned long)currentGeneration,
+					 (unsigned long)jsonCache.getHits(), (unsigned long)jsonCache.getMisses(),
+					 (unsigned long)jsonCache.getFootprint(),
+					 (unsigned long)nofParityRepairs, (unsigned long)nofPollRetries,
+					 (unsigned long)schedule.getCycleMs(), (unsigned long)schedule.getBurstMs(),
+					 (unsigned long)schedule.getNofCycles(), (unsigned long)schedule.getNofOverruns(),
+					 (unsigned long)nofMissedWindows,
+					 channels.getNofGroups(), hoppingAllowed ? "true" : "false",
+					 (unsigned long)nofChannelSwitches, (unsigned long)channels.getNofMoves(),
+					 shardId, (unsigned long)nofUplinks, (unsigned long)nofUplinkFrames, (unsigned long)nofUplinkBytes,
+					 (unsigned long)nofKeyframes, (unsigned long)nofUplinksSkipped, aggregator.getNofLiveShards(millis()),
+					 (unsigned long)aggregator.getNofFrames(), (unsigned long)aggregator.getNofDuplicates(),
+					 (unsigned long)aggregator.getNofOutOfSequence(), (unsigned long)nofShardFramesDropped,
+					 (unsigned long)storagePool.getUsed(), (unsigned long)storagePool.getCapacity(),
+					 logReady ? "true" : "false", measurementLog.getNofSegments(),
+					 (unsigned long)measurementLog.getStoredChunks(), (unsigned long)measurementLog.getOldestTime(),
+					 (unsigned long)logTime(), (unsigned long)measurementLog.getBytesAppended(),
+					 (unsigned long)measurementLog.getBytesWritten(), (unsigned long)measurementLog.getChunksDiscarded(),
+					 (unsigned long)measurementLog.getWriteErrors());
+			server.send(200, "application/json", json);
+		}
+
+		// Optional query arguments:
+		//   sensor=<id>       only that sensor (default: all)
+		//   from=<s>, to=<s>  log time range, inclusive (default: all of the log). "time" under "log"
+		//                     in /api/stats is the current log time.
+		//   current=1         the current measurement arrays instead of the log. Also the
+		//                     default when the log is disabled.
+		// Streams the rows with chunked transfer encoding. The radio keeps running between
+		// slices of the log, so a long export does not stall the polling.
+		void exportMeasurements(ExportFormat format)
+		{
+			uint32_t sensorId = getUintArg("sensor", 0);
+			if (sensorId > MAX_SENSORS)
+			{
+				server.send(404, "application/json", "{\"error\":\"sensor not found\"}");
+				return;
+			}
+			uint32_t fromTime = getUintArg("from", 0);
+			uint32_t toTime = getUintArg("to", 0xFFFFFFFF);
+			bool current = getUintArg("current", 0) != 0 || !logReady;
+
+			MeasurementExport<EXPORT_BUFFER_SIZE> exporter(format);
+			auto send = [this](const char* data, size_t length) { server.sendContent(data, length); };
+
+			server.sendHeader("Content-Disposition", (format == ExportFormat::CSV) ?
+							  "attachment; filename=\"sensors.csv\"" : "attachment; filename=\"sensors.ndjson\"");
+			server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+			server.send(200, exporter.getContentType(), "");
+
+			exporter.begin();
+			if (current)
+			{
+				uint32_t now = logTime();
+				for (int id = 1; id <= MAX_SENSORS; id++)
+				{
+					SensorState& s = sensors[id];
+					if (!s.seen || s.samples == nullptr || (sensorId != 0 && id != (int)sensorId)) continue;
+					exporter.addSamples(now, id, 0, s.samples, s.sampleCount, s.capabilities.sampleWidth, send);
+				}
+			}
+			else
+			{
+				exporter.exportLog(measurementLog, (uint8_t)sensorId, fromTime, toTime, send,
+								   [this]() { updateRadio(); }, []() { return (uint32_t)micros(); }, EXPORT_SLICE_US);
+			}
+			exporter.end(send);
+			server.sendContent("", 0); // last chunk
+
+			ESP_LOGI("ServerNode", "Export: %lu rows, %lu bytes", (unsigned long)exporter.getRows(),
+					 (unsigned long)exporter.getBytesSent());
+		}
+
+		void handleApiExportCsv(const RouteParams& params)
+		{
+			exportMeasurements(ExportFormat::CSV);
+		}
+
+		void handleApiExportNdjson(const RouteParams& params)
+		{
+			exportMeasurements(ExportFormat::NDJSON);
+		}
+
+		// Seconds; non-decreasing over resets as long as the log is kept.
+		uint32_t logTime()
+		{
+			return logTimeBase + millis() / 1000;
+		}
+
+		void initLog()
+		{
+			if (!LITTLEFS.begin(true) || !logStorage.begin())
+			{
+				ESP_LOGE("ServerNode", "LittleFS mount failed, measurement log disabled");
+				return;
+			}
+			unsigned long startMs = millis();
+			measurementLog.begin();
+			logTimeBase = measurementLog.getLastTime() + 1;
+			logReady = true;
+			ESP_LOGI("ServerNode", "Measurement log: %u segments, %lu chunks, %lu damaged, recovered in %lu ms",
+					 measurementLog.getNofSegments(), (unsigned long)measurementLog.getStoredChunks(),
+					 (unsigned long)measurementLog.getChunksDiscarded(), millis() - startMs);
+		}
+
 	public:
+		// With pollCycleMs > 0, every sensor is polled once per cycle of that many ms (at most
+		// PollSchedule::MAX_CYCLE_MS), and sensors that support it sleep in between.
+		// With 0, the sensors are polled one after the other, continuously.
+		// extraChannels (at most MAX_CHANNELS - 1): Wi-Fi channels besides the AP channel that
+		// sensors in direct range can be moved to, when the AP channel is busy.
 		ServerNode(const char* ssid, const char* pass, int channel,
-				   uint8_t expectedSensors)
+				   uint8_t expectedSensors, bool fecEnabled = true, bool logEnabled = true,
+				   unsigned long pollCycleMs = 0, const uint8_t* extraChannels = nullptr, uint8_t nofExtraChannels = 0)
 			: apSsid(ssid), apPass(pass), apChannel(channel),
-			  expectedSensorCount(expectedSensors), server(80),
+			  expectedSensorCount(expectedSensors), fecEnabled(fecEnabled), server(80), apiRequestHandler(*this),
 			  currentState(State::DISCOVERING), currentPollIndex(0),
-			  pollRetryCount(0), stateEnteredMs(0), lastDiscoverMs(0),
-			  lastLedToggleMs(0), ledOn(false), registeredCount(0)
+			  pollRetryCount(0), stateEnteredMs(0), pollSentUs(0), schedule(pollCycleMs), cyclePlanned(false),
+			  nofMissedWindows(0), channels((uint8_t)channel, CHANNEL_SWITCH_US), tunedChannel((uint8_t)channel),
+			  hoppingAllowed(false), nofChannelSwitches(0), lastDiscoverMs(0),
+			  lastLedToggleMs(0), ledOn(false), discoverSequence(0), registeredCount(0),
+			  firstSensorId(1), lastSensorId(MAX_SENSORS), shardId(Aggregator::NO_SHARD), rootMac{}, rootChannel(0),
+			  uplinkCycle(0), uplinkSensorId(0), uplinkFrameLength(0), uplinkFramesSent(0), sendCallbacksAtUplink(0),
+			  sendFailuresAtUplink(0), uplinkStartMs(0), lastUplinkMs(0), nofUplinks(0), nofUplinkFrames(0),
+			  nofUplinkBytes(0), nofKeyframes(0), nofUplinksSkipped(0), currentGeneration(0), bootEpoch(0),
+			  layoutGeneration(0), logEnabled(logEnabled), logReady(false), logStorage(LOG_DIRECTORY),
+			  measurementLog(logStorage, LOG_FLUSH_INTERVAL_S), logTimeBase(0)
 		{
+			for (int id = 1; id <= MAX_SENSORS; id++)
+			{
+				snprintf(labels[id].name, sizeof(labels[id].name), "Sensor %d", id);
+				strcpy(labels[id].unit, "raw");
+			}
+			for (uint8_t i = 0; i < nofExtraChannels; i++)
+			{
+				channels.addChannel(extraChannels[i]);
+			}
+		}
+
+		// Sets the name and unit that /api/layout reports for sensorId (by default
+		// "Sensor <id>" and "raw"). Longer texts are cut off.
+		void setSensorLabel(uint8_t sensorId, const char* name, const char* unit)
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS) return;
+			strncpy(labels[sensorId].name, name, MAX_NAME_LENGTH);
+			labels[sensorId].name[MAX_NAME_LENGTH] = '\0';
+			strncpy(labels[sensorId].unit, unit, MAX_UNIT_LENGTH);
+			labels[sensorId].unit[MAX_UNIT_LENGTH] = '\0';
+			layoutGeneration++;
+		}
+
+		// The sensor ids this server registers and polls: by default 1..MAX_SENSORS, with
+		// expectedSensors of them starting at firstSensorId. REGISTERs of other ids are
+		// ignored, such that servers with sensors in range of each other keep apart.
+		// Call before init().
+		void setSensorRange(uint8_t first, uint8_t last)
+		{
+			if (first < 1) first = 1;
+			if (last > MAX_SENSORS) last = MAX_SENSORS;
+			firstSensorId = first;
+			lastSensorId = last;
+		}
+
+		// Makes this server a shard (shard 1..255): every UPLINK_INTERVAL_MS, between two POLLs,
+		// it sends a summary and the arrays that changed to the root server with STA MAC
+		// address root, which listens on channel. A shard has at most 32 sensor ids (see setSensorRange()).
+		// Call before init().
+		void setUplink(uint8_t shard, const uint8_t* root, uint8_t channel)
+		{
+			shardId = shard;
+			memcpy(rootMac, root, 6);
+			rootChannel = channel;
+		}
+
+		// Makes this server a root server: it also publishes the sensors of the shards that
+		// send it their uplinks, next to its own.
+		void enableAggregator()
+		{
+			shardFramesAccepted = true;
 		}
 
 		void init()
@@ -460,9 +1537,14 @@ namespace crt
 			{
 				sensors[i] = {};
 			}
+			if (isShard() && lastSensorId > firstSensorId + 31) lastSensorId = firstSensorId + 31;
+			aggregator.setLocalRange(firstSensorId, firstSensorId + expectedSensorCount - 1); // the root's own sensors
+
+			if (logEnabled) initLog();
 
 			WiFi.mode(WIFI_AP_STA);
 			WiFi.softAP(apSsid, apPass, apChannel);
+			bootEpoch = esp_random(); // with the radio on, esp_random() is a true random number
 			ESP_LOGI("ServerNode", "AP SSID: %s", apSsid);
 			ESP_LOGI("ServerNode", "AP IP: %s", WiFi.softAPIP().toString().c_str());
 
@@ -472,24 +1554,16 @@ namespace crt
 			server.on("/grid", HTTP_GET, [this]() {
 				server.send(200, "text/html", GRID_HTML);
 			});
-			server.on("/api/sensors", HTTP_GET, [this]() {
-				handleApiSensors();
-			});
-			server.on("/api/measurements/1", HTTP_GET, [this]() {
-				handleApiMeasurements(1);
-			});
-			server.on("/api/measurements/2", HTTP_GET, [this]() {
-				handleApiMeasurements(2);
-			});
-			server.on("/api/measurements/3", HTTP_GET, [this]() {
-				handleApiMeasurements(3);
-			});
-			server.on("/api/measurements/4", HTTP_GET, [this]() {
-				handleApiMeasurements(4);
-			});
-			server.on("/api/allmeasurements", HTTP_GET, [this]() {
-				handleApiAllMeasurements();
-			});
+
+			router.addRoute("/api/sensors", &ServerNode::handleApiSensors);
+			router.addRoute("/api/measurements/{id:uint}", &ServerNode::handleApiMeasurements);
+			router.addRoute("/api/allmeasurements", &ServerNode::handleApiAllMeasurements);
+			router.addRoute("/api/layout", &ServerNode::handleApiLayout);
+			router.addRoute("/api/stats", &ServerNode::handleApiStats);
+			router.addRoute("/api/export.csv", &ServerNode::handleApiExportCsv);
+			router.addRoute("/api/export.ndjson", &ServerNode::handleApiExportNdjson);
+			server.addHandler(&apiRequestHandler);
+
 			server.onNotFound([this]() {
 				server.send(404, "text/plain", "Not found");
 			});
@@ -502,52 +1576,74 @@ namespace crt
 			}
 			else
 			{
-				ESP_LOGI("ServerNode", "ESP-NOW init OK");
+				ESP_LOGI("ServerNode", "ESP-NOW init OK, wire format %08lX", (unsigned long)WIRE_FORMAT_TAG);
 				esp_now_register_recv_cb(onDataRecv);
 				esp_now_register_send_cb(onDataSent);
 
 				// Add broadcast peer for DISCOVER
 				esp_now_peer_info_t peer = {};
 				memcpy(peer.peer_addr, BROADCAST_ADDRESS, 6);
-				peer.channel = apChannel;
+				peer.channel = 0;
 				peer.encrypt = false;
 				esp_now_add_peer(&peer);
+
+				if (isShard())
+				{
+					memcpy(peer.peer_addr, rootMac, 6);
+					esp_now_add_peer(&peer); // channel 0: the current one, which is the root's during an uplink
+					esp_now_rate_config_t rate = {};
+					rate.phymode = WIFI_PHY_MODE_11G;
+					rate.rate = UPLINK_RATE;
+					esp_now_set_peer_rate_config(rootMac, &rate);
+				}
 			}
 
 			ESP_LOGI("ServerNode", "STA MAC: %s", WiFi.macAddress().c_str());
 			ESP_LOGI("ServerNode", "AP MAC: %s", WiFi.softAPmacAddress().c_str());
-			ESP_LOGI("ServerNode", "Expecting %u sensors", expectedSensorCount);
+			ESP_LOGI("ServerNode", "Expecting %u sensors, ids %u..%u", expectedSensorCount, firstSensorId, lastSensorId);
+			if (isShard())
+			{
+				ESP_LOGI("ServerNode", "Shard %u: uplink to %02X:%02X:%02X:%02X:%02X:%02X on channel %u, shard format %08lX",
+						 shardId, rootMac[0], rootMac[1], rootMac[2], rootMac[3], rootMac[4], rootMac[5], rootChannel,
+						 (unsigned long)SHARD_FORMAT_TAG);
+			}
+			if (shardFramesAccepted)
+			{
+				ESP_LOGI("ServerNode", "Root: aggregating shards, shard format %08lX", (unsigned long)SHARD_FORMAT_TAG);
+			}
+			if (channels.isEnabled())
+			{
+				ESP_LOGI("ServerNode", "Sensors in direct range can move to %u other channel(s)", channels.getNofGroups() - 1);
+			}
 		}
 
 		void update()
 		{
 			server.handleClient();
-			updateLed();
-
-			switch (currentState)
-			{
-				case State::DISCOVERING:
-					handleDiscovering();
-					break;
-				case State::POLLING:
-					handlePolling();
-					break;
-				case State::WAITING_DATA:
-					handleWaitingData();
-					break;
-			}
+			updateRadio();
+			if (logReady) measurementLog.update(logTime());
 		}
 	}; // end class ServerNode
 
 	volatile bool ServerNode::newRegisterReceived = false;
 	volatile uint8_t ServerNode::receivedRegisterSensorId = 0;
 	volatile uint8_t ServerNode::receivedRegisterMac[6] = {};
+	volatile uint8_t ServerNode::receivedRegisterHopCount = 0;
+	volatile uint8_t ServerNode::receivedRegisterFeatures = 0;
+	SensorCapabilities ServerNode::receivedRegisterCapabilities = {};
 	volatile bool ServerNode::newDataReceived = false;
-	uint8_t ServerNode::reassemblyBuffer[ServerNode::MAX_REASSEMBLY_SIZE] = {};
-	volatile uint8_t ServerNode::dataPacketsReceived = 0;
-	volatile uint8_t ServerNode::dataPacketsExpected = 0;
-	volatile uint16_t ServerNode::reassemblyBytesReceived = 0;
-	volatile uint8_t ServerNode::reassemblySensorId = 0;
+	FragmentReassembler ServerNode::reassembler;
+	portMUX_TYPE ServerNode::reassemblerMux = portMUX_INITIALIZER_UNLOCKED;
+	volatile uint32_t ServerNode::nofParityRepairs = 0;
+	volatile uint32_t ServerNode::nofPollRetries = 0;
+	volatile uint16_t ServerNode::nofSendCallbacks = 0;
+	volatile uint16_t ServerNode::nofSendFailures = 0;
+	volatile bool ServerNode::shardFramesAccepted = false;
+	uint8_t ServerNode::shardFrames[ServerNode::SHARD_QUEUE_SIZE][ShardDeltaCodec::MAX_SIZE];
+	uint8_t ServerNode::shardFrameLengths[ServerNode::SHARD_QUEUE_SIZE];
+	volatile uint8_t ServerNode::shardQueueHead = 0;
+	volatile uint8_t ServerNode::shardQueueTail = 0;
+	volatile uint32_t ServerNode::nofShardFramesDropped = 0;
 	constexpr uint8_t ServerNode::BROADCAST_ADDRESS[6];
 
 } // end namespace crt
@@ -0,0 +1,264 @@
+// by Marius Versteegen, 2025
+// ShardAggregator: the bookkeeping of a root server that collects the sensors
+// of several shard servers (see crt_ShardDeltaEncoder.h).
+//
+// Every shard announces its range of sensor ids in its summary. A sensor id
+// belongs to the first live shard that claims it, and never to a shard when it
+// is in the root's own range: the same id from another shard (a misconfigured
+// or overlapping range) is dropped as a duplicate, until the owner has been
+// silent for SHARD_TIMEOUT_MS.
+//
+// Per sensor it tracks the sequence of the array the root published. A keyframe
+// always applies. A delta only applies to the array it was made from
+// (baseSequence), and its frames only in order: after a lost frame the sensor
+// waits for the next keyframe, which shards send regularly. Frame 0 always starts
+// the sequence over. Frames of a sequence that is published already are duplicates.
+//
+// The caller keeps the arrays: check() says what to do with a frame. Free of
+// ESP-NOW calls, such that the ShardScaleSimulation test can run it as well.
+
+#pragma once
+#include <cstdint>
+#include <crt_SensorGridPacket.h>
+
+namespace crt
+{
+	template<uint8_t MAX_SENSORS, uint8_t MAX_SHARDS> class ShardAggregator
+	{
+	public:
+		static const uint8_t NO_SHARD = 0;
+		static const unsigned long SHARD_TIMEOUT_MS = 5000;
+
+		enum class Action : uint8_t
+		{
+			DROP,		// duplicate, not the owner, or out of sequence
+			START,		// first frame of a delta: copy the published array, then apply the runs
+			APPLY,		// apply the runs to the array being built
+		};
+
+	private:
+		struct Shard
+		{
+			uint8_t shardId;	// NO_SHARD: free slot
+			uint8_t firstSensorId;
+			uint8_t lastSensorId;
+			uint16_t cycle;
+			unsigned long lastHeardMs;
+		};
+
+		struct Member
+		{
+			uint8_t owner;			// shardId, or NO_SHARD
+			bool published;			// the root has the array of sequence
+			uint16_t sequence;
+			bool building;			// frames of buildSequence are being applied
+			uint16_t buildSequence;
+			uint8_t nextFrame;
+		};
+
+		Shard shards[MAX_SHARDS];
+		Member members[MAX_SENSORS + 1];	// indexed 1..MAX_SENSORS
+		uint8_t localFirst;
+		uint8_t localLast;
+
+		uint32_t nofFrames;
+		uint32_t nofDuplicates;
+		uint32_t nofOutOfSequence;
+
+		Shard* findShard(uint8_t shardId)
+		{
+			for (uint8_t i = 0; i < MAX_SHARDS; i++)
+			{
+				if (shards[i].shardId == shardId) return &shards[i];
+			}
+			return nullptr;
+		}
+
+		bool isLive(const Shard& shard, unsigned long nowMs) const
+		{
+			return shard.shardId != NO_SHARD && nowMs - shard.lastHeardMs < SHARD_TIMEOUT_MS;
+		}
+
+		bool isLocal(uint8_t sensorId) const
+		{
+			return sensorId >= localFirst && sensorId <= localLast;
+		}
+
+		// Makes shard the owner of sensorId, unless another live shard owns it. Returns true if shard owns it.
+		bool claim(const Shard& shard, uint8_t sensorId, unsigned long nowMs)
+		{
+			Member& m = members[sensorId];
+			if (m.owner == shard.shardId) return true;
+			if (m.owner != NO_SHARD)
+			{
+				const Shard* owner = findShard(m.owner);
+				if (owner != nullptr && isLive(*owner, nowMs) &&
+					sensorId >= owner->firstSensorId && sensorId <= owner->lastSensorId)
+				{
+					return false;
+				}
+			}
+			m = {shard.shardId, false, 0, false, 0, 0};
+			return true;
+		}
+
+	public:
+		ShardAggregator() : localFirst(1), localLast(0), nofFrames(0), nofDuplicates(0), nofOutOfSequence(0)
+		{
+			for (uint8_t i = 0; i < MAX_SHARDS; i++) shards[i] = {NO_SHARD, 0, 0, 0, 0};
+			for (uint8_t id = 0; id <= MAX_SENSORS; id++) members[id] = {NO_SHARD, false, 0, false, 0, 0};
+		}
+
+		// The root's own sensors, which no shard can claim.
+		void setLocalRange(uint8_t firstSensorId, uint8_t lastSensorId)
+		{
+			localFirst = firstSensorId;
+			localLast = lastSensorId;
+		}
+
+		// Returns false for a repeated summary, or if there is no room for another shard.
+		// With restarted set, the shard started over (its cycle went back): its sensors
+		// wait for a keyframe.
+		bool onSummary(const ShardSummaryPacket& summary, unsigned long nowMs, bool& restarted)
+		{
+			nofFrames++;
+			restarted = false;
+			if (summary.shardId == NO_SHARD) return false;
+			Shard* shard = findShard(summary.shardId);
+			if (shard == nullptr)
+			{
+				for (uint8_t i = 0; i < MAX_SHARDS && shard == nullptr; i++)
+				{
+					if (!isLive(shards[i], nowMs)) shard = &shards[i];
+				}
+				if (shard == nullptr) return false;
+				*shard = {summary.shardId, 0, 0, (uint16_t)(summary.cycle - 1), nowMs};
+			}
+			else if (summary.cycle == shard->cycle && isLive(*shard, nowMs))
+			{
+				nofDuplicates++;
+				return false;
+			}
+			else if ((int16_t)(summary.cycle - shard->cycle) < 0)
+			{
+				restarted = true;
+				for (uint8_t id = 1; id <= MAX_SENSORS; id++)
+				{
+					if (members[id].owner == summary.shardId) members[id].published = members[id].building = false;
+				}
+			}
+			shard->firstSensorId = summary.firstSensorId;
+			shard->lastSensorId = summary.lastSensorId;
+			shard->cycle = summary.cycle;
+			shard->lastHeardMs = nowMs;
+			return true;
+		}
+
+		// Whether shardId owns sensorId, claiming it if it is free (sensorId is in its range,
+		// and not the root's own).
+		bool owns(uint8_t shardId, uint8_t sensorId, unsigned long nowMs)
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS || isLocal(sensorId)) return false;
+			Shard* shard = findShard(shardId);
+			if (shard == nullptr || sensorId < shard->firstSensorId || sensorId > shard->lastSensorId) return false;
+			return claim(*shard, sensorId, nowMs);
+		}
+
+		// What to do with a delta frame.
+		Action check(const ShardDeltaPacket& delta, unsigned long nowMs)
+		{
+			nofFrames++;
+			if (!owns(delta.shardId, delta.sensorId, nowMs))
+			{
+				nofDuplicates++;
+				return Action::DROP;
+			}
+			Member& m = members[delta.sensorId];
+			if (m.published && delta.sequence == m.sequence)
+			{
+				nofDuplicates++;
+				return Action::DROP;
+			}
+			if (delta.frameIndex == 0)
+			{
+				// Also when building it already: the shard resends a sequence whose uplink it aborted.
+				bool keyframe = (delta.flags & SHARD_FLAG_KEYFRAME) != 0;
+				if (!keyframe && !(m.published && delta.baseSequence == m.sequence))
+				{
+					nofOutOfSequence++;
+					m.building = false;
+					return Action::DROP;
+				}
+				m.building = true;
+				m.buildSequence = delta.sequence;
+				m.nextFrame = 1;
+				return keyframe ? Action::APPLY : Action::START;
+			}
+			if (m.building && delta.sequence == m.buildSequence)
+			{
+				if (delta.frameIndex == m.nextFrame)
+				{
+					m.nextFrame++;
+					return Action::APPLY;
+				}
+				if (delta.frameIndex < m.nextFrame)
+				{
+					nofDuplicates++;
+					return Action::DROP;
+				}
+			}
+			nofOutOfSequence++; // a frame got lost
+			m.building = false;
+			return Action::DROP;
+		}
+
+		// After the frame that check() let apply: returns true if the array is complete, to be published.
+		bool onApplied(const ShardDeltaPacket& delta)
+		{
+			if (!(delta.flags & SHARD_FLAG_LAST)) return false;
+			Member& m = members[delta.sensorId];
+			m.building = false;
+			m.published = true;
+			m.sequence = delta.sequence;
+			return true;
+		}
+
+		// The runs of a frame did not fit the array: wait for a keyframe.
+		void onMalformed(uint8_t sensorId)
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS) return;
+			members[sensorId].building = false;
+			members[sensorId].published = false;
+			nofOutOfSequence++;
+		}
+
+		// The root dropped the array of sensorId (e.g. new storage): wait for a keyframe.
+		void forget(uint8_t sensorId)
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS) return;
+			members[sensorId].published = false;
+			members[sensorId].building = false;
+		}
+
+		uint8_t getOwner(uint8_t sensorId) const
+		{
+			if (sensorId < 1 || sensorId > MAX_SENSORS) return NO_SHARD;
+			return members[sensorId].owner;
+		}
+
+		uint8_t getNofLiveShards(unsigned long nowMs) const
+		{
+			uint8_t n = 0;
+			for (uint8_t i = 0; i < MAX_SHARDS; i++)
+			{
+				if (isLive(shards[i], nowMs)) n++;
+			}
+			return n;
+		}
+
+		uint32_t getNofFrames() const { return nofFrames; }
+		uint32_t getNofDuplicates() const { return nofDuplicates; }
+		uint32_t getNofOutOfSequence() const { return nofOutOfSequence; }
+	}; // end class ShardAggregator
+
+} // end namespace crt
@@ -0,0 +1,145 @@
+// by Marius Versteegen, 2025
+// ShardDeltaEncoder: splits the measurement array of one sensor into the
+// ShardDeltaPackets that a shard server sends to the root server.
+//
+// A keyframe carries all samples. A delta only carries the samples that differ
+// from the previous array (the one with baseSequence, which the root has): as
+// runs of a first sample (2 bytes), a count (1 byte) and the samples. Runs that
+// are only a few unchanged samples apart are merged, as a new run header would
+// cost more than sending those samples along.
+//
+// next() fills one frame at a time, so a shard needs no buffer for the
+// encoded array. Free of ESP-NOW calls, such that the ShardScaleSimulation
+// test can run it as well.
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <crt_SensorGridPacket.h>
+
+namespace crt
+{
+	class ShardDeltaEncoder
+	{
+	public:
+		static const uint8_t RUN_HEADER_SIZE = 3;
+
+	private:
+		ShardDeltaPacket header;	// all but frameIndex, payloadSize and payload
+		const uint8_t* samples;
+		const uint8_t* previous;	// nullptr: keyframe
+		uint16_t position;			// next sample to encode
+		bool done;
+
+		bool isChanged(uint16_t index) const
+		{
+			if (previous == nullptr) return true;
+			size_t offset = (size_t)index * header.sampleWidth;
+			return memcmp(samples + offset, previous + offset, header.sampleWidth) != 0;
+		}
+
+		uint16_t nextChanged(uint16_t from) const
+		{
+			while (from < header.sampleCount && !isChanged(from)) from++;
+			return from;
+		}
+
+		// The end of the run that starts at first, at most maxCount samples long.
+		uint16_t runEnd(uint16_t first, uint16_t maxCount) const
+		{
+			uint16_t end = first + 1;
+			uint16_t limit = (header.sampleCount - first < maxCount) ? header.sampleCount : first + maxCount;
+			while (end < limit)
+			{
+				uint16_t changed = nextChanged(end);
+				if (changed >= limit) break;
+				// Merge the unchanged samples in between, if they are cheaper than a new run.
+				if ((uint32_t)(changed - end) * header.sampleWidth > RUN_HEADER_SIZE) break;
+				end = changed + 1;
+			}
+			return end;
+		}
+
+	public:
+		ShardDeltaEncoder() : header{}, samples(nullptr), previous(nullptr), position(0), done(true)
+		{
+		}
+
+		// Starts encoding count samples of width bytes. previous: the array of baseSequence,
+		// or nullptr for a keyframe. Both arrays must stay unchanged until next() returns false.
+		void begin(uint8_t shardId, uint8_t sensorId, uint8_t hopCount, uint16_t sequence, uint16_t baseSequence,
+				   const uint8_t* samples, const uint8_t* previous, uint16_t count, uint8_t width)
+		{
+			header = {};
+			header.messageType = MessageType::SHARD_DELTA;
+			header.shardId = shardId;
+			header.sensorId = sensorId;
+			header.hopCount = hopCount;
+			header.sequence = sequence;
+			header.baseSequence = (previous == nullptr) ? sequence : baseSequence;
+			header.flags = (previous == nullptr) ? SHARD_FLAG_KEYFRAME : 0;
+			header.sampleWidth = width;
+			header.sampleCount = count;
+			header.frameIndex = 0;
+			this->samples = samples;
+			this->previous = previous;
+			position = nextChanged(0);
+			done = false;
+		}
+
+		bool isBusy() const { return !done; }
+
+		// Fills packet with the next frame. Returns false when all frames were given out.
+		// The last frame has SHARD_FLAG_LAST; a delta without changes is one empty frame.
+		bool next(ShardDeltaPacket& packet)
+		{
+			if (done) return false;
+			packet = header;
+			packet.payloadSize = 0;
+			uint8_t width = header.sampleWidth;
+			while (position < header.sampleCount)
+			{
+				uint32_t room = SHARD_PAYLOAD_MAX_SIZE - packet.payloadSize;
+				if (room < (uint32_t)RUN_HEADER_SIZE + width) break;
+				uint32_t maxCount = (room - RUN_HEADER_SIZE) / width;
+				if (maxCount > 255) maxCount = 255;
+				uint16_t end = runEnd(position, (uint16_t)maxCount);
+				uint16_t count = end - position;
+
+				uint8_t* out = packet.payload + packet.payloadSize;
+				out[0] = (uint8_t)position;
+				out[1] = (uint8_t)(position >> 8);
+				out[2] = (uint8_t)count;
+				memcpy(out + RUN_HEADER_SIZE, samples + (size_t)position * width, (size_t)count * width);
+				packet.payloadSize += RUN_HEADER_SIZE + count * width;
+				position = nextChanged(end);
+			}
+			if (position >= header.sampleCount)
+			{
+				packet.flags |= SHARD_FLAG_LAST;
+				done = true;
+			}
+			header.frameIndex++;
+			return true;
+		}
+
+		// Writes the runs of a payload into samples (count samples of width bytes).
+		// Returns false if a run does not fit in the array; the runs before it are written.
+		static bool applyRuns(const uint8_t* payload, uint8_t payloadSize, uint8_t* samples, uint16_t count, uint8_t width)
+		{
+			uint16_t offset = 0;
+			while (offset + RUN_HEADER_SIZE <= payloadSize)
+			{
+				uint16_t first = (uint16_t)(payload[offset] | (payload[offset + 1] << 8));
+				uint8_t runCount = payload[offset + 2];
+				uint16_t bytes = (uint16_t)(runCount * width);
+				offset += RUN_HEADER_SIZE;
+				if ((uint32_t)first + runCount > count || offset + bytes > payloadSize) return false;
+				memcpy(samples + (size_t)first * width, payload + offset, bytes);
+				offset += bytes;
+			}
+			return offset == payloadSize;
+		}
+	}; // end class ShardDeltaEncoder
+
+} // end namespace crt
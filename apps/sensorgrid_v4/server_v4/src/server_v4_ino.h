@@ -9,14 +9,51 @@ static const char* AP_PASS = "scoliose";
 static const int AP_CHANNEL = 1;
 static const uint8_t EXPECTED_SENSOR_COUNT = 2;
 
+// Ask sensors that support it for a parity packet after their DataPackets,
+// so a single lost DataPacket does not cost a timeout and a re-POLL.
+static const bool FEC_ENABLED = true;
+
+// Keep every received measurement array in a log on the LittleFS partition.
+static const bool LOG_ENABLED = true;
+
+// Poll every sensor once per cycle of this many ms (at most 2000), in windows that
+// are announced to the sensors, such that duty-cycled sensors can sleep in between.
+// 0: poll the sensors one after the other, continuously.
+static const unsigned long POLL_CYCLE_MS = 0;
+
+// Other Wi-Fi channels (1, 6 and 11 do not overlap) that sensors in direct range can be
+// moved to when AP_CHANNEL is busy. The server visits them in turn, only while no
+// browser is connected to the AP. NOF_EXTRA_CHANNELS = 0: all sensors stay on AP_CHANNEL.
+static const uint8_t EXTRA_CHANNELS[] = {6, 11};
+static const uint8_t NOF_EXTRA_CHANNELS = 0;
+
+// The sensor ids this server polls: EXPECTED_SENSOR_COUNT of them from FIRST_SENSOR_ID on,
+// and any other up to LAST_SENSOR_ID that registers.
+static const uint8_t FIRST_SENSOR_ID = 1;
+static const uint8_t LAST_SENSOR_ID = 64;
+
+// Several servers, each on its own AP_CHANNEL with its own range of sensor ids, can feed
+// one root server that serves all sensors. On a shard, SHARD_ID (1..) and the STA MAC
+// address and AP_CHANNEL of the root, which logs both at startup. SHARD_ID = 0: not a shard.
+static const uint8_t SHARD_ID = 0;
+static const uint8_t ROOT_MAC[6] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+static const uint8_t ROOT_CHANNEL = 1;
+
+// On the root server: accept the uplinks of shards.
+static const bool AGGREGATOR_ENABLED = false;
+
 namespace crt
 {
-	ServerNode serverNode(AP_SSID, AP_PASS, AP_CHANNEL, EXPECTED_SENSOR_COUNT);
+	ServerNode serverNode(AP_SSID, AP_PASS, AP_CHANNEL, EXPECTED_SENSOR_COUNT, FEC_ENABLED, LOG_ENABLED, POLL_CYCLE_MS,
+						  EXTRA_CHANNELS, NOF_EXTRA_CHANNELS);
 }
 
 void setup()
 {
 	ESP_LOGI("main", "=== SERVER NODE v4 ===");
+	crt::serverNode.setSensorRange(FIRST_SENSOR_ID, LAST_SENSOR_ID);
+	if (SHARD_ID != 0) crt::serverNode.setUplink(SHARD_ID, ROOT_MAC, ROOT_CHANNEL);
+	if (AGGREGATOR_ENABLED) crt::serverNode.enableAggregator();
 	crt::serverNode.init();
 }
 
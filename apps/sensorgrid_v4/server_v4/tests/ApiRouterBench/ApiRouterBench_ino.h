@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_ApiRouterBench.h"
+
+namespace crt
+{
+	ApiRouterBench apiRouterBench;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== API ROUTER BENCHMARK ===");
+	crt::apiRouterBench.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
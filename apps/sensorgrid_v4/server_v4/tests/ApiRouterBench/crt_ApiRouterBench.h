@@ -0,0 +1,130 @@
+// by Marius Versteegen, 2025
+// Measures ApiRouter dispatch and parameter-parse throughput.
+// Dispatch is measured for routers holding 4, 16 and 48 routes, to show
+// that the cost per request does not grow with the number of endpoints.
+// Also checks that the router rejects what it cannot represent.
+
+#pragma once
+#include <Arduino.h>
+#include <stdio.h>
+#include <crt_ApiRouter.h>
+
+namespace crt
+{
+	class ApiRouterBench
+	{
+	private:
+		static const uint32_t ITERATIONS = 100000;
+		static const uint8_t MAX_SYNTHETIC_ROUTES = 48;
+
+		char syntheticPaths[MAX_SYNTHETIC_ROUTES][32];
+		volatile uint32_t sink;
+
+		void onSensors(const RouteParams& params) { sink = sink + params.count(); }
+		void onMeasurements(const RouteParams& params) { sink = sink + params.getUint(0); }
+
+		template<uint8_t MAX_ROUTES> void benchDispatch()
+		{
+			ApiRouter<ApiRouterBench, MAX_ROUTES> router;
+			router.addRoute("/api/sensors", &ApiRouterBench::onSensors);
+			router.addRoute("/api/measurements/{id:uint}", &ApiRouterBench::onMeasurements);
+			for (uint8_t i = 0; router.getNofRoutes() < MAX_ROUTES && i < MAX_SYNTHETIC_ROUTES; i++)
+			{
+				router.addRoute(syntheticPaths[i], &ApiRouterBench::onSensors);
+			}
+
+			typename ApiRouter<ApiRouterBench, MAX_ROUTES>::Handler handler;
+			RouteParams params;
+			const char* paths[] = {"/api/sensors", "/api/measurements/3", "/api/measurements/77", "/api/unknown"};
+
+			unsigned long startUs = micros();
+			uint32_t nofMatches = 0;
+			for (uint32_t i = 0; i < ITERATIONS; i++)
+			{
+				if (router.match(paths[i & 3], handler, params))
+				{
+					(this->*handler)(params);
+					nofMatches++;
+				}
+			}
+			unsigned long elapsedUs = micros() - startUs;
+
+			ESP_LOGI("ApiRouterBench", "%u routes: %lu ns/dispatch (%lu dispatches/s, %u matched)",
+					 router.getNofRoutes(),
+					 (unsigned long)((uint64_t)elapsedUs * 1000 / ITERATIONS),
+					 (unsigned long)((uint64_t)ITERATIONS * 1000000 / (elapsedUs ? elapsedUs : 1)),
+					 nofMatches);
+		}
+
+		void benchParse()
+		{
+			const char* values[] = {"0", "17", "123456", "4294967295"};
+			uint8_t lengths[] = {1, 2, 6, 10};
+
+			unsigned long startUs = micros();
+			for (uint32_t i = 0; i < ITERATIONS; i++)
+			{
+				uint32_t value = 0;
+				ApiRouter<ApiRouterBench, 1>::parseUint(values[i & 3], lengths[i & 3], value);
+				sink = sink + value;
+			}
+			unsigned long elapsedUs = micros() - startUs;
+
+			ESP_LOGI("ApiRouterBench", "uint parse: %lu ns/value (%lu values/s)",
+					 (unsigned long)((uint64_t)elapsedUs * 1000 / ITERATIONS),
+					 (unsigned long)((uint64_t)ITERATIONS * 1000000 / (elapsedUs ? elapsedUs : 1)));
+		}
+
+		typedef ApiRouter<ApiRouterBench, 4>::Handler Handler;
+
+		void check(bool ok, const char* what)
+		{
+			ESP_LOGI("ApiRouterBench", "%s: %s", ok ? "OK  " : "FAIL", what);
+		}
+
+		void checkLimits()
+		{
+			ApiRouter<ApiRouterBench, 4> router;
+			Handler handler;
+			RouteParams params;
+
+			check(router.addRoute("/api/measurements/{id:uint}", &ApiRouterBench::onMeasurements),
+				  "uint parameter route added");
+			check(!router.addRoute("/api/measurements/{name:text}", &ApiRouterBench::onSensors),
+				  "text parameter at the position of a uint parameter rejected");
+			check(router.match("/api/measurements/12", handler, params) && params.getUint(0) == 12,
+				  "uint parameter still matches");
+
+			// A segment of 300 characters, which does not fit the 8-bit segment length.
+			static char longPath[320];
+			strcpy(longPath, "/api/");
+			memset(longPath + 5, 'a', 300);
+			longPath[305] = '\0';
+			check(!router.addRoute(longPath, &ApiRouterBench::onSensors), "route with a segment over 255 characters rejected");
+			strcpy(longPath, "/api/measurements/");
+			memset(longPath + 18, '1', 300);
+			longPath[318] = '\0';
+			check(!router.match(longPath, handler, params), "path with a segment over 255 characters not matched");
+		}
+
+	public:
+		ApiRouterBench() : sink(0)
+		{
+			for (uint8_t i = 0; i < MAX_SYNTHETIC_ROUTES; i++)
+			{
+				snprintf(syntheticPaths[i], sizeof(syntheticPaths[i]), "/api/endpoint%u/{n:uint}", i);
+			}
+		}
+
+		void run()
+		{
+			benchDispatch<4>();
+			benchDispatch<16>();
+			benchDispatch<48>();
+			benchParse();
+			checkLimits();
+			ESP_LOGI("ApiRouterBench", "ApiRouterBench done");
+		}
+	}; // end class ApiRouterBench
+
+} // end namespace crt
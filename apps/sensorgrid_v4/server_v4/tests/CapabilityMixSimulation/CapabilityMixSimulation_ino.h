@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_CapabilityMixSimulation.h"
+
+namespace crt
+{
+	CapabilityMixSimulation capabilityMixSimulation;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== CAPABILITY MIX SIMULATION ===");
+	crt::capabilityMixSimulation.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
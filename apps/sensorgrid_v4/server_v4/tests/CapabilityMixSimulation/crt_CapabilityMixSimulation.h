@@ -0,0 +1,222 @@
+// by Marius Versteegen, 2025
+// CapabilityMixSimulation: sensors with different SensorCapabilities (16 to
+// 2048 samples, 8 to 32 bits) register at one server. Reports per sensor the
+// storage taken from the pool, and the cost of polling it once: DataPackets,
+// airtime, reassembly and JSON serialisation time.
+//
+// Registration follows ServerNode::processRegister(): checkCapabilities(),
+// then the sample buffers and JSON slab from a SampleStoragePool of the same
+// size. The replies are built as SensorNode does and put together by the real
+// FragmentReassembler in the sensor's back buffer, which is then swapped in.
+// The radio is not simulated beyond an airtime model.
+
+#pragma once
+#include <Arduino.h>
+#include <crt_SensorGridPacket.h>
+#include <crt_SensorCapabilities.h>
+#include <crt_PacketCodec.h>
+#include <crt_FragmentReassembler.h>
+#include <crt_SampleStoragePool.h>
+#include <crt_MeasurementJsonCache.h>
+
+namespace crt
+{
+	class CapabilityMixSimulation
+	{
+	private:
+		static const uint8_t MAX_SENSORS = 8;
+		static const uint32_t STORAGE_POOL_SIZE = 40960; // as ServerNode
+		static const uint32_t MAX_FRAME_BYTES = 8192;    // as ServerNode
+		static const uint16_t REPETITIONS = 20;
+
+		struct Sensor
+		{
+			SensorCapabilities caps;
+			uint8_t* sampleBuffers;
+			uint8_t* samples;
+			uint8_t* backBuffer;
+			uint32_t storageBytes;
+		};
+
+		SampleStoragePool<STORAGE_POOL_SIZE, 2 * MAX_SENSORS> pool;
+		MeasurementJsonCache<MAX_SENSORS> jsonCache;
+		FragmentReassembler reassembler;
+		Sensor sensors[MAX_SENSORS + 1];
+		uint8_t frame[MAX_FRAME_BYTES];          // what the sensor sends
+		volatile uint32_t sink;
+		uint32_t seed;
+
+		// 1 Mbps, long preamble, 43 bytes of 802.11 action frame overhead, ACK.
+		static uint32_t frameAirtimeUs(size_t bytes)
+		{
+			return 192 + (43 + bytes) * 8 + 304;
+		}
+
+		void release(uint8_t id)
+		{
+			pool.release((const uint8_t*)jsonCache.detach(id));
+			pool.release(sensors[id].sampleBuffers);
+			sensors[id] = {};
+		}
+
+		// As ServerNode::processRegister() and allocateStorage().
+		bool registerSensor(uint8_t id, const SensorCapabilities& caps)
+		{
+			const char* rejectReason = checkCapabilities(caps, MAX_FRAME_BYTES);
+			if (rejectReason != nullptr)
+			{
+				ESP_LOGI("CapabilityMixSimulation", "sensor %u: %5u x %u bytes  rejected: %s",
+						 id, caps.sampleCount, caps.sampleWidth, rejectReason);
+				return false;
+			}
+
+			release(id);
+			uint32_t slabSize = jsonCache.slabSize(caps.sampleCount, caps.sampleWidth);
+			uint8_t* sampleBuffers = pool.allocate(2 * frameBytes(caps));
+			uint8_t* slab = pool.allocate(slabSize);
+			if (sampleBuffers == nullptr || slab == nullptr)
+			{
+				pool.release(sampleBuffers);
+				pool.release(slab);
+				ESP_LOGI("CapabilityMixSimulation", "sensor %u: %5u x %u bytes  rejected: needs %lu bytes, largest free block %lu",
+						 id, caps.sampleCount, caps.sampleWidth,
+						 (unsigned long)(pool.allocationSize(2 * frameBytes(caps)) + pool.allocationSize(slabSize)),
+						 (unsigned long)pool.getLargestFree());
+				return false;
+			}
+
+			sensors[id].caps = caps;
+			sensors[id].sampleBuffers = sampleBuffers;
+			sensors[id].samples = sampleBuffers;
+			sensors[id].backBuffer = sampleBuffers + frameBytes(caps);
+			sensors[id].storageBytes = pool.allocationSize(2 * frameBytes(caps)) + pool.allocationSize(slabSize);
+			jsonCache.attach(id, (char*)slab, (uint16_t)slabSize);
+			ESP_LOGI("CapabilityMixSimulation", "sensor %u: %5u x %u bytes  storage %5lu bytes (samples 2 x %lu, JSON %lu), pool %lu/%lu used",
+					 id, caps.sampleCount, caps.sampleWidth, (unsigned long)sensors[id].storageBytes,
+					 (unsigned long)frameBytes(caps), (unsigned long)slabSize,
+					 (unsigned long)pool.getUsed(), (unsigned long)pool.getCapacity());
+			return true;
+		}
+
+		// One POLL and its reply, as SensorNode sends it. Returns the airtime in us.
+		uint32_t pollOnce(uint8_t id)
+		{
+			Sensor& s = sensors[id];
+			const SensorCapabilities& caps = s.caps;
+			uint32_t totalBytes = frameBytes(caps);
+			uint16_t totalPackets = packetsPerReply(caps);
+
+			reassembler.start(id, s.backBuffer, totalBytes, caps.maxFragment);
+			uint32_t airtimeUs = frameAirtimeUs(sizeof(PollPacket));
+			for (uint16_t i = 0; i < totalPackets; i++)
+			{
+				uint32_t offset = (uint32_t)i * caps.maxFragment;
+				uint32_t remaining = totalBytes - offset;
+				uint8_t chunk = (remaining > caps.maxFragment) ? caps.maxFragment : (uint8_t)remaining;
+
+				DataPacket header;
+				header.messageType = MessageType::DATA;
+				header.sensorId = id;
+				header.packetIndex = (uint8_t)i;
+				header.totalPackets = (uint8_t)totalPackets;
+				header.payloadSize = chunk;
+
+				uint8_t packet[DataCodec::MAX_SIZE];
+				DataCodec::encodeHeader(header, packet);
+				memcpy(packet + DataCodec::HEADER_SIZE, frame + offset, chunk);
+				size_t frameSize = DataCodec::HEADER_SIZE + chunk;
+				airtimeUs += frameAirtimeUs(frameSize);
+				reassembler.addData(DataPacketView(packet, frameSize));
+			}
+
+			uint8_t* published = s.backBuffer;
+			s.backBuffer = s.samples;
+			s.samples = published;
+			return airtimeUs;
+		}
+
+		void pollAll()
+		{
+			ESP_LOGI("CapabilityMixSimulation", "id | samples x width | packets | airtime ms | reassembly us | JSON us (bytes)");
+			uint32_t sweepAirtimeUs = 0;
+			uint32_t sweepCpuUs = 0;
+
+			for (uint8_t id = 1; id <= MAX_SENSORS; id++)
+			{
+				Sensor& s = sensors[id];
+				if (s.samples == nullptr) continue;
+
+				uint32_t totalBytes = frameBytes(s.caps);
+				for (uint32_t i = 0; i < totalBytes; i++)
+				{
+					seed = seed * 1664525u + 1013904223u;
+					frame[i] = (uint8_t)(seed >> 24);
+				}
+
+				uint32_t airtimeUs = 0;
+				unsigned long startUs = micros();
+				for (uint16_t r = 0; r < REPETITIONS; r++)
+				{
+					airtimeUs = pollOnce(id);
+				}
+				uint32_t reassemblyUs = (micros() - startUs) / REPETITIONS;
+
+				if (!reassembler.isComplete() || memcmp(s.samples, frame, totalBytes) != 0)
+				{
+					ESP_LOGW("CapabilityMixSimulation", "sensor %u: reply corrupted!", id);
+				}
+
+				uint16_t length = 0;
+				startUs = micros();
+				for (uint16_t r = 0; r < REPETITIONS; r++)
+				{
+					jsonCache.invalidate(id);
+					sink = sink + (uint32_t)(uintptr_t)jsonCache.get(id, s.samples, s.caps.sampleCount, s.caps.sampleWidth, length);
+				}
+				uint32_t jsonUs = (micros() - startUs) / REPETITIONS;
+
+				ESP_LOGI("CapabilityMixSimulation", "%2u | %5u x %u | %3u | %4lu.%01lu | %5lu | %5lu (%u)",
+						 id, s.caps.sampleCount, s.caps.sampleWidth, packetsPerReply(s.caps),
+						 (unsigned long)(airtimeUs / 1000), (unsigned long)(airtimeUs / 100 % 10),
+						 (unsigned long)reassemblyUs, (unsigned long)jsonUs, length);
+				sweepAirtimeUs += airtimeUs;
+				sweepCpuUs += reassemblyUs + jsonUs;
+			}
+
+			ESP_LOGI("CapabilityMixSimulation", "sweep over all sensors: airtime %lu.%01lu ms, server CPU %lu us, at most %lu sweeps/s",
+					 (unsigned long)(sweepAirtimeUs / 1000), (unsigned long)(sweepAirtimeUs / 100 % 10),
+					 (unsigned long)sweepCpuUs,
+					 (unsigned long)(sweepAirtimeUs ? 1000000 / sweepAirtimeUs : 0));
+		}
+
+	public:
+		CapabilityMixSimulation() : sink(0), seed(2025)
+		{
+			memset(sensors, 0, sizeof(sensors));
+		}
+
+		void run()
+		{
+			ESP_LOGI("CapabilityMixSimulation", "--- registration, pool of %lu bytes ---", (unsigned long)pool.getCapacity());
+			registerSensor(1, makeCapabilities(16, 2));
+			registerSensor(2, makeCapabilities(MEASUREMENT_COUNT, 2));
+			registerSensor(3, makeCapabilities(MEASUREMENT_COUNT, 2));
+			registerSensor(4, makeCapabilities(2048, 2));
+			registerSensor(5, makeCapabilities(256, 1));
+			registerSensor(6, makeCapabilities(512, 4, 200));
+			registerSensor(7, makeCapabilities(4096, 2));      // does not fit any more
+			registerSensor(8, makeCapabilities(100, 3));       // unsupported width
+
+			pollAll();
+
+			ESP_LOGI("CapabilityMixSimulation", "--- sensor 4 re-registers with 1024 samples, sensor 7 tries again ---");
+			registerSensor(4, makeCapabilities(1024, 2));
+			registerSensor(7, makeCapabilities(1000, 2)); // fits in the rest of the gap left by sensor 4
+			ESP_LOGI("CapabilityMixSimulation", "JSON cache footprint %lu bytes", (unsigned long)jsonCache.getFootprint());
+
+			pollAll();
+			ESP_LOGI("CapabilityMixSimulation", "CapabilityMixSimulation done");
+		}
+	}; // end class CapabilityMixSimulation
+
+} // end namespace crt
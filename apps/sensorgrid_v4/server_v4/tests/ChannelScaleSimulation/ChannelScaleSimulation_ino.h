@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_ChannelScaleSimulation.h"
+
+namespace crt
+{
+	ChannelScaleSimulation channelScaleSimulation;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== CHANNEL SCALE SIMULATION ===");
+	crt::channelScaleSimulation.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
@@ -0,0 +1,289 @@
+// by Marius Versteegen, 2025
+// ChannelScaleSimulation: the sample throughput of a sensor grid polled on one
+// to three Wi-Fi channels, by one radio (visiting the channels in turn) or by
+// one radio per channel.
+//
+// 24 directly reached sensors (20 of 64 samples, 4 of 1024 samples, 16 bits)
+// are polled continuously for 60 s, as ServerNode does: POLL, DataPackets and
+// a parity packet, a timeout of 200 ms plus 4 ms per DataPacket and a re-POLL
+// when more than one frame is lost. Every channel carries background traffic
+// of other networks: a frame waits until the channel is free, and is lost more
+// often on a busy channel. All sensors start on the home channel; the real
+// ChannelScheduler moves them, one per round of the first radio, and a sensor
+// only moves after its reply to the POLL that tells it to.
+// Two scenarios: all channels quiet, and a home channel that is half busy.
+
+#pragma once
+#include <Arduino.h>
+#include <crt_SensorGridPacket.h>
+#include <crt_PacketCodec.h>
+#include <crt_PollSchedule.h>
+#include <crt_ChannelScheduler.h>
+
+namespace crt
+{
+	class ChannelScaleSimulation
+	{
+	private:
+		static const uint8_t SENSORS = 24;
+		static const uint8_t MAX_CHANNELS = 3;
+		static const uint32_t DURATION_US = 60000000;
+		static const uint32_t SWITCH_US = 1000;			// esp_wifi_set_channel(), as ServerNode assumes
+		static const uint32_t PROCESSING_US = 300;		// per frame
+		static const uint32_t BACKOFF_MAX_US = 500;		// random channel access delay per frame
+		static const uint32_t BUSY_PERIOD_MAX_US = 2000;	// of the background traffic
+		static const uint16_t BASE_LOSS_PER_MILLE = 10;
+		static const uint32_t SERVER_LOOP_MAX_US = 1000;
+		static const uint32_t DATA_TIMEOUT_MS = 200;	// as ServerNode
+		static const uint32_t DATA_TIMEOUT_PER_PACKET_MS = 4;
+		static const uint8_t MAX_POLL_RETRIES = 5;
+
+		typedef ChannelScheduler<SENSORS, MAX_CHANNELS> Scheduler;
+
+		struct Sensor
+		{
+			uint16_t sampleCount;
+			uint8_t pendingGroup;	// the group its next POLL moves it to
+			uint32_t replies;
+		};
+
+		struct Radio
+		{
+			uint64_t clockUs;
+			uint8_t group;			// being polled
+			uint8_t ids[SENSORS];	// its members, at the start of the group's round
+			uint8_t nofIds;
+			uint8_t next;
+			uint8_t currentChannel;
+			uint32_t rounds;
+		};
+
+		Sensor sensors[SENSORS + 1];
+		uint32_t randomState;
+
+		// Per run
+		uint64_t samplesDelivered;
+		uint32_t replies;
+		uint32_t timeouts;
+		uint32_t switches;
+
+		uint32_t random32()
+		{
+			randomState ^= randomState << 13;
+			randomState ^= randomState >> 17;
+			randomState ^= randomState << 5;
+			return randomState;
+		}
+
+		bool chance(uint32_t perMille)
+		{
+			return random32() % 1000 < perMille;
+		}
+
+		static uint32_t frameAirtimeUs(uint32_t payloadBytes)
+		{
+			return 192 + (43 + payloadBytes) * 8 + 304;
+		}
+
+		static uint32_t frameBytesOf(const Sensor& s)
+		{
+			return (uint32_t)s.sampleCount * 2;
+		}
+
+		static uint16_t packetsOf(const Sensor& s)
+		{
+			return (uint16_t)((frameBytesOf(s) + DATA_PAYLOAD_MAX_SIZE - 1) / DATA_PAYLOAD_MAX_SIZE);
+		}
+
+		// One frame on a channel that is busy busyPerMille of the time. Returns false if it is lost.
+		bool sendFrame(uint64_t& t, uint32_t payloadBytes, uint16_t busyPerMille)
+		{
+			t += PROCESSING_US;
+			while (chance(busyPerMille)) t += random32() % BUSY_PERIOD_MAX_US;
+			t += random32() % BACKOFF_MAX_US + frameAirtimeUs(payloadBytes);
+			return !chance(BASE_LOSS_PER_MILLE + busyPerMille / 10);
+		}
+
+		// A POLL and the reply of sensor id. Returns false on a timeout.
+		bool exchange(uint64_t& t, uint8_t id, uint16_t busyPerMille)
+		{
+			const Sensor& s = sensors[id];
+			uint64_t start = t;
+			bool pollArrived = sendFrame(t, PollCodec::HEADER_SIZE, busyPerMille);
+			uint8_t lost = 0;
+			if (pollArrived)
+			{
+				uint16_t packets = packetsOf(s);
+				uint32_t lastPayload = frameBytesOf(s) - (uint32_t)(packets - 1) * DATA_PAYLOAD_MAX_SIZE;
+				for (uint16_t p = 0; p <= packets; p++) // the last one is the parity packet
+				{
+					uint32_t payload = (p + 1 < packets) ? DATA_PAYLOAD_MAX_SIZE
+									 : (p + 1 == packets) ? lastPayload
+									 : (packets > 1 ? DATA_PAYLOAD_MAX_SIZE : lastPayload);
+					if (!sendFrame(t, DataCodec::HEADER_SIZE + payload, busyPerMille)) lost++;
+				}
+			}
+			if (!pollArrived || lost > 1)
+			{
+				t = start + (DATA_TIMEOUT_MS + packetsOf(s) * DATA_TIMEOUT_PER_PACKET_MS) * 1000;
+				return false;
+			}
+			t += random32() % SERVER_LOOP_MAX_US;
+			return true;
+		}
+
+		// The next step of a radio: start the round of its next occupied group, or poll a sensor.
+		void step(Scheduler& scheduler, Radio& radio, uint8_t radioIndex, const uint16_t* busyPerMille)
+		{
+			if (radio.next >= radio.nofIds)
+			{
+				// Next group of this radio with members
+				for (uint8_t n = 0; n < scheduler.getNofGroups(); n++)
+				{
+					radio.group = (uint8_t)((radio.group + 1) % scheduler.getNofGroups());
+					if (radio.group == radioIndex) radio.rounds++; // back at its first group
+					if (scheduler.getRadio(radio.group) != radioIndex) continue;
+					radio.nofIds = 0;
+					for (uint8_t id = 1; id <= SENSORS; id++)
+					{
+						if (scheduler.getGroup(id) == radio.group) radio.ids[radio.nofIds++] = id;
+					}
+					if (radio.nofIds > 0) break;
+				}
+				radio.next = 0;
+				if (radio.nofIds == 0)
+				{
+					radio.clockUs += 1000; // nothing to poll
+					return;
+				}
+				uint8_t channel = scheduler.getChannel(radio.group);
+				if (channel != radio.currentChannel)
+				{
+					radio.currentChannel = channel;
+					radio.clockUs += SWITCH_US;
+					switches++;
+				}
+
+				// The first radio plans the moves, as ServerNode does at the start of a cycle.
+				uint8_t moveId, moveGroup;
+				if (radioIndex == 0 && radio.group == 0 && scheduler.findMove(moveId, moveGroup))
+				{
+					sensors[moveId].pendingGroup = moveGroup;
+				}
+				return;
+			}
+
+			uint8_t id = radio.ids[radio.next++];
+			if (scheduler.getGroup(id) != radio.group) return; // moved meanwhile
+			uint64_t start = radio.clockUs;
+			bool ok = false;
+			for (uint8_t attempt = 0; attempt <= MAX_POLL_RETRIES && !ok; attempt++)
+			{
+				ok = exchange(radio.clockUs, id, busyPerMille[radio.group]);
+				if (!ok) timeouts++;
+			}
+			if (!ok) return;
+			replies++;
+			sensors[id].replies++;
+			samplesDelivered += sensors[id].sampleCount;
+			scheduler.onReply(id, (uint32_t)(radio.clockUs - start));
+			if (sensors[id].pendingGroup != Scheduler::NO_GROUP)
+			{
+				scheduler.setGroup(id, sensors[id].pendingGroup);
+				sensors[id].pendingGroup = Scheduler::NO_GROUP;
+			}
+		}
+
+		float run(const char* scenario, const uint16_t* busyPerMille, uint8_t nofChannels, uint8_t nofRadios, float reference)
+		{
+			static const uint8_t CHANNELS[MAX_CHANNELS] = {1, 6, 11};
+			randomState = 0x9E3779B9;
+			samplesDelivered = 0;
+			replies = 0;
+			timeouts = 0;
+			switches = 0;
+
+			Scheduler scheduler(CHANNELS[0], SWITCH_US, nofRadios);
+			for (uint8_t c = 1; c < nofChannels; c++) scheduler.addChannel(CHANNELS[c]);
+			for (uint8_t id = 1; id <= SENSORS; id++)
+			{
+				sensors[id].sampleCount = (id % 6 == 0) ? 1024 : 64;
+				sensors[id].pendingGroup = Scheduler::NO_GROUP;
+				sensors[id].replies = 0;
+				scheduler.add(id, PollSchedule<SENSORS>::estimateReplyUs(frameBytesOf(sensors[id]), DATA_PAYLOAD_MAX_SIZE, true), true);
+			}
+
+			Radio radios[MAX_CHANNELS];
+			for (uint8_t r = 0; r < nofRadios; r++)
+			{
+				radios[r] = Radio{};
+				radios[r].group = (uint8_t)(nofChannels - 1); // the first step starts at the radio's first group
+				radios[r].currentChannel = CHANNELS[r];
+			}
+
+			while (true)
+			{
+				uint8_t r = 0;
+				for (uint8_t i = 1; i < nofRadios; i++)
+				{
+					if (radios[i].clockUs < radios[r].clockUs) r = i;
+				}
+				if (radios[r].clockUs >= DURATION_US) break;
+				step(scheduler, radios[r], r, busyPerMille);
+			}
+
+			// The whole grid is refreshed as often as its least polled sensor.
+			uint32_t slowest = 0xFFFFFFFF;
+			for (uint8_t id = 1; id <= SENSORS; id++)
+			{
+				if (sensors[id].replies < slowest) slowest = sensors[id].replies;
+			}
+			float refreshesPerS = slowest * 1e6f / DURATION_US;
+			float samplesPerS = samplesDelivered * 1e6f / DURATION_US;
+			char groups[64];
+			int length = 0;
+			for (uint8_t g = 0; g < scheduler.getNofGroups(); g++)
+			{
+				length += snprintf(groups + length, sizeof(groups) - length, "%s%u:%2u (%.1f)", g > 0 ? ", " : "",
+								   scheduler.getChannel(g), scheduler.getNofMembers(g),
+								   (float)scheduler.getCongestion(g) / Scheduler::UNIT);
+			}
+			ESP_LOGI("ChannelScaleSimulation", "%-10s | %u ch, %u radio%s | grid %5.2f/s %4.2fx | %6.0f samples/s | %5lu replies, %4lu timeouts | "
+					 "%5lu switches, %3lu moves | round %5.1f ms | channel: sensors (congestion) %s",
+					 scenario, nofChannels, nofRadios, nofRadios > 1 ? "s" : " ", refreshesPerS,
+					 reference > 0 ? refreshesPerS / reference : 1.0f, samplesPerS, (unsigned long)replies, (unsigned long)timeouts,
+					 (unsigned long)switches, (unsigned long)scheduler.getNofMoves(),
+					 radios[0].rounds > 0 ? DURATION_US / 1000.0f / radios[0].rounds : 0.0f, groups);
+			return refreshesPerS;
+		}
+
+		// Returns the grid refresh rate on a single channel.
+		float runScenario(const char* scenario, const uint16_t* busyPerMille, float reference)
+		{
+			float single = run(scenario, busyPerMille, 1, 1, reference);
+			if (reference == 0) reference = single;
+			run(scenario, busyPerMille, 2, 1, reference);
+			run(scenario, busyPerMille, 3, 1, reference);
+			run(scenario, busyPerMille, 2, 2, reference);
+			run(scenario, busyPerMille, 3, 3, reference);
+			return single;
+		}
+
+	public:
+		ChannelScaleSimulation() : randomState(1), samplesDelivered(0), replies(0), timeouts(0), switches(0)
+		{
+		}
+
+		void run()
+		{
+			ESP_LOGI("ChannelScaleSimulation", "%u sensors, %lu s; grid refreshes (every sensor polled) per second, relative to 1 quiet channel:",
+					 SENSORS, (unsigned long)(DURATION_US / 1000000));
+			static const uint16_t QUIET[MAX_CHANNELS] = {50, 50, 50};
+			static const uint16_t BUSY_HOME[MAX_CHANNELS] = {500, 50, 50};
+			float reference = runScenario("quiet", QUIET, 0);
+			runScenario("busy home", BUSY_HOME, reference);
+			ESP_LOGI("ChannelScaleSimulation", "ChannelScaleSimulation done");
+		}
+	}; // end class ChannelScaleSimulation
+
+} // end namespace crt
@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_DeltaSyncBench.h"
+
+namespace crt
+{
+	DeltaSyncBench deltaSyncBench;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== DELTA SYNC BENCHMARK ===");
+	crt::deltaSyncBench.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
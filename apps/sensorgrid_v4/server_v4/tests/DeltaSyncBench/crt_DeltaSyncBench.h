@@ -0,0 +1,233 @@
+// by Marius Versteegen, 2025
+// DeltaSyncBench: /api/allmeasurements with and without ?since=, through the
+// AllMeasurementsResponse of ServerNode::handleApiAllMeasurements(), fed the way
+// that handler feeds it. HTTP headers not included.
+//
+//   checks: full and delta bodies after sensors changed, went offline and lost
+//           their values, and for a since of another boot (epoch) or from the
+//           future. Each body is compared with one that is built straight from
+//           the generations of the sensors.
+//   bench:  the bodies that a grid page polling every 100 ms receives with full
+//           and with delta responses, and the time it takes to assemble them
+//           (after the changed sensors have been serialised once, which both
+//           kinds of response share). Per poll, the values of 0, 1, 4 or all 16
+//           sensors change.
+
+#pragma once
+#include <Arduino.h>
+#include <crt_SensorGridPacket.h>
+#include <crt_MeasurementJsonCache.h>
+#include <crt_AllMeasurementsResponse.h>
+
+namespace crt
+{
+	class DeltaSyncBench
+	{
+	private:
+		static const uint8_t NOF_SENSORS = 16;
+		static const uint16_t POLLS = 500;
+		static const uint16_t POLLS_PER_SECOND = 10;
+		static const uint16_t REPEATS = 20;	// builds per poll that are timed, for the resolution of micros()
+		static const uint16_t SLAB_SIZE = 40 + 6 * MEASUREMENT_COUNT; // MeasurementJsonCache::slabSize() for 16 bit samples
+		static const uint16_t BODY_SIZE = 256 + NOF_SENSORS * SLAB_SIZE;
+		static const uint32_t EPOCH = 3735928559u;
+		static const uint32_t LAYOUT = 1;
+
+		// What the handler reads of a ServerNode::SensorState.
+		struct Sensor
+		{
+			uint32_t generation;
+			bool registered;
+			bool hasValues;	// registered or seen, with a slab in the cache
+		};
+
+		MeasurementJsonCache<NOF_SENSORS> cache;
+		uint16_t measurements[NOF_SENSORS + 1][MEASUREMENT_COUNT];
+		Sensor sensors[NOF_SENSORS + 1];
+		char slabs[NOF_SENSORS + 1][SLAB_SIZE];
+		char body[BODY_SIZE];
+		char expected[BODY_SIZE];
+		uint32_t bodyLength;
+		uint32_t contentLength;
+		bool bodyIsDelta;
+		uint32_t currentGeneration;
+		uint32_t seed;
+
+		void changeSensor(uint8_t id)
+		{
+			for (uint8_t i = 0; i < MEASUREMENT_COUNT; i++)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				measurements[id][i] = (uint16_t)((seed >> 16) & 1023);
+			}
+			cache.invalidate(id);
+			sensors[id].generation = ++currentGeneration;
+		}
+
+		void newData(uint8_t nofChanged)
+		{
+			for (uint8_t n = 0; n < nofChanged; n++)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				changeSensor((nofChanged == NOF_SENSORS) ? n + 1 : 1 + (seed >> 16) % NOF_SENSORS);
+			}
+		}
+
+		const char* getFragment(uint8_t id, uint16_t& length)
+		{
+			return cache.get(id, (const uint8_t*)measurements[id], MEASUREMENT_COUNT, sizeof(uint16_t), length);
+		}
+
+		// As ServerNode::handleApiAllMeasurements() does. The client receives the body in body.
+		// Returns its length.
+		uint32_t respond(bool hasSince, uint32_t since, bool sameBoot)
+		{
+			AllMeasurementsResponse<NOF_SENSORS> response;
+			response.begin(hasSince, since, sameBoot, currentGeneration, EPOCH, LAYOUT);
+			for (uint8_t id = 1; id <= NOF_SENSORS; id++)
+			{
+				Sensor& s = sensors[id];
+				if (!response.includes(s.generation)) continue;
+				const char* fragment = nullptr;
+				uint16_t length = 0;
+				if (s.hasValues) fragment = getFragment(id, length);
+				response.add(id, fragment, length, s.registered);
+			}
+
+			contentLength = (uint32_t)response.end();
+			bodyLength = 0;
+			auto receive = [this](const char* data, size_t length) {
+				if (bodyLength + length <= BODY_SIZE) memcpy(body + bodyLength, data, length);
+				bodyLength += (uint32_t)length;
+			};
+			response.send(receive);
+			bodyIsDelta = response.isDelta();
+			return bodyLength;
+		}
+
+		// The body of a full (delta: false) or delta response, built straight from the
+		// generations. Returns its length.
+		uint32_t expectBody(bool delta, uint32_t since)
+		{
+			char offline[4 * NOF_SENSORS + 1] = "";
+			char removed[4 * NOF_SENSORS + 1] = "";
+			char* p = expected;
+			p += sprintf(p, "{\"generation\":%lu,\"epoch\":%lu,\"delta\":%s,\"layout\":%lu,\"sensors\":[",
+						 (unsigned long)currentGeneration, (unsigned long)EPOCH, delta ? "true" : "false", (unsigned long)LAYOUT);
+			bool first = true;
+			for (uint8_t id = 1; id <= NOF_SENSORS; id++)
+			{
+				const Sensor& s = sensors[id];
+				if (delta && s.generation <= since) continue;
+				if (!s.hasValues)
+				{
+					if (delta) sprintf(removed + strlen(removed), removed[0] ? ",%u" : "%u", (unsigned)id);
+					continue;
+				}
+				if (!s.registered) sprintf(offline + strlen(offline), offline[0] ? ",%u" : "%u", (unsigned)id);
+				if (!first) *p++ = ',';
+				first = false;
+				uint16_t length = 0;
+				const char* fragment = getFragment(id, length);
+				memcpy(p, fragment, length);
+				p += length;
+			}
+			p += sprintf(p, "],\"offline\":[%s],\"removed\":[%s]}", offline, removed);
+			return (uint32_t)(p - expected);
+		}
+
+		void check(const char* what, bool hasSince, uint32_t since, bool sameBoot, bool expectDelta)
+		{
+			uint32_t length = respond(hasSince, since, sameBoot);
+			uint32_t expectedLength = expectBody(expectDelta, since);
+			bool ok = bodyIsDelta == expectDelta && length == contentLength && length == expectedLength &&
+					  memcmp(body, expected, length) == 0;
+			ESP_LOGI("DeltaSyncBench", "%s: %s", ok ? "OK  " : "FAIL", what);
+			if (!ok)
+			{
+				ESP_LOGW("DeltaSyncBench", "  got %.*s", (int)(length < 200 ? length : 200), body);
+				ESP_LOGW("DeltaSyncBench", "  expected %.*s", (int)(expectedLength < 200 ? expectedLength : 200), expected);
+			}
+		}
+
+		void checkResponses()
+		{
+			uint32_t before = currentGeneration;
+			changeSensor(12);
+			sensors[3].registered = false;		// stopped responding, keeps its values
+			sensors[3].generation = ++currentGeneration;
+			sensors[7].hasValues = false;		// lost its storage
+			sensors[7].generation = ++currentGeneration;
+
+			check("delta: sensor 12 changed, 3 offline, 7 removed", true, before, true, true);
+			const char* tail = "],\"offline\":[3],\"removed\":[7]}";
+			uint32_t length = respond(true, before, true);
+			bool ok = length > strlen(tail) && memcmp(body + length - strlen(tail), tail, strlen(tail)) == 0;
+			ESP_LOGI("DeltaSyncBench", "%s: %s", ok ? "OK  " : "FAIL", "delta lists sensor 3 as offline and 7 as removed");
+			check("delta: nothing changed", true, currentGeneration, true, true);
+			check("full: no since", false, 0, true, false);
+			check("full: since of another boot", true, before, false, false);
+			check("full: since from the future", true, currentGeneration + 1, true, false);
+
+			sensors[3].registered = true;
+			sensors[7].hasValues = true;
+			changeSensor(3);
+			changeSensor(7);
+		}
+
+		void bench(uint8_t nofChanged)
+		{
+			uint64_t fullBytes = 0, deltaBytes = 0;
+			unsigned long fullUs = 0, deltaUs = 0;
+			for (uint16_t poll = 0; poll < POLLS; poll++)
+			{
+				uint32_t since = currentGeneration;
+				newData(nofChanged);
+				fullBytes += respond(false, 0, true);	// serialises the changed sensors
+				deltaBytes += respond(true, since, true);
+
+				unsigned long startUs = micros();
+				for (uint16_t i = 0; i < REPEATS; i++) respond(false, 0, true);
+				fullUs += micros() - startUs;
+
+				startUs = micros();
+				for (uint16_t i = 0; i < REPEATS; i++) respond(true, since, true);
+				deltaUs += micros() - startUs;
+			}
+
+			ESP_LOGI("DeltaSyncBench",
+					 "%2u of %u sensors change per poll: full %5lu bytes/poll (%3lu kB/s), delta %5lu bytes/poll (%3lu kB/s), "
+					 "full %5lu ns/request, delta %5lu ns/request",
+					 nofChanged, NOF_SENSORS,
+					 (unsigned long)(fullBytes / POLLS), (unsigned long)(fullBytes * POLLS_PER_SECOND / POLLS / 1000),
+					 (unsigned long)(deltaBytes / POLLS), (unsigned long)(deltaBytes * POLLS_PER_SECOND / POLLS / 1000),
+					 (unsigned long)((uint64_t)fullUs * 1000 / POLLS / REPEATS),
+					 (unsigned long)((uint64_t)deltaUs * 1000 / POLLS / REPEATS));
+		}
+
+	public:
+		DeltaSyncBench() : bodyLength(0), contentLength(0), bodyIsDelta(false), currentGeneration(0), seed(12345)
+		{
+			for (uint8_t id = 1; id <= NOF_SENSORS; id++)
+			{
+				cache.attach(id, slabs[id], SLAB_SIZE);
+				sensors[id].registered = true;
+				sensors[id].hasValues = true;
+			}
+			newData(NOF_SENSORS);
+		}
+
+		void run()
+		{
+			checkResponses();
+			ESP_LOGI("DeltaSyncBench", "%u sensors x %u values, polled %u times per second",
+					 NOF_SENSORS, MEASUREMENT_COUNT, POLLS_PER_SECOND);
+			bench(0);
+			bench(1);
+			bench(4);
+			bench(NOF_SENSORS);
+			ESP_LOGI("DeltaSyncBench", "DeltaSyncBench done");
+		}
+	}; // end class DeltaSyncBench
+
+} // end namespace crt
@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_ExportStreamTest.h"
+
+namespace crt
+{
+	ExportStreamTest exportStreamTest;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== EXPORT STREAM TEST ===");
+	crt::exportStreamTest.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
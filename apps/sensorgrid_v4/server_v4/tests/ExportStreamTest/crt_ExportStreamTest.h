@@ -0,0 +1,245 @@
+// by Marius Versteegen, 2025
+// ExportStreamTest: streams a large synthetic measurement history out of a
+// MeasurementLog as CSV and NDJSON, the way /api/export.csv and
+// /api/export.ndjson do, and checks every row.
+//
+// The history: 8 sensors report every second for 2 hours, with different
+// capabilities (sensor 8 sends 1024 samples, so its records are split over
+// chunks by the log). The log keeps its last 1 MB, which exports as several
+// MB of text. The sink parses the stream as it comes in, with a few bytes of
+// state, and models a slow client (1 Mbit/s) on a virtual clock. between()
+// stands for the radio: it appends new measurements to the log during the
+// export, and the test reports the longest (virtual) time between two calls.
+// That time must stay below the server's DATA_TIMEOUT_MS, or a sensor reply
+// would time out during an export.
+
+#pragma once
+#include <Arduino.h>
+#include <LITTLEFS.h>
+#include <crt_SensorCapabilities.h>
+#include "crt_FileLogStorage.h"
+#include "crt_MeasurementLog.h"
+#include "crt_MeasurementExport.h"
+
+namespace crt
+{
+	class ExportStreamTest
+	{
+	private:
+		typedef MeasurementLog<4096, 16, 16> Log; // as ServerNode
+		typedef MeasurementExport<1024> Export;	  // as ServerNode
+
+		static const uint8_t SENSORS = 8;
+		static const uint32_t DURATION_S = 2 * 3600;
+		static const uint32_t CLIENT_BITS_PER_S = 1000000;
+		static const uint32_t DATA_TIMEOUT_MS = 200;					// as ServerNode
+		static const uint32_t SLICE_US = DATA_TIMEOUT_MS * 1000 / 2;	// as ServerNode
+
+		FileLogStorage files;
+		uint8_t samples[1024 * 2];
+
+		// Checks the rows of the stream as they arrive: every number ends a field,
+		// every '\n' ends a row (the CSV header has no numbers).
+		struct Checker
+		{
+			uint32_t number;
+			bool inNumber;
+			uint16_t field;
+			uint32_t rowTime;
+			uint8_t rowSensor;
+			bool rowOk;
+
+			uint32_t rows;
+			uint32_t badRows;
+			uint32_t bytes;
+			uint32_t largestSend;
+			uint64_t virtualUs;
+			uint32_t firstTime;
+			uint32_t lastTime;
+		};
+
+		Checker checker;
+		uint64_t lastRadioUs;
+		uint64_t longestRadioGapUs;
+		uint32_t radioCalls;
+		uint32_t radioTime;
+		uint32_t radioSeconds;	// appended during this export
+
+		static uint16_t countOf(uint8_t sensorId)
+		{
+			return (sensorId == 8) ? 1024 : (sensorId == 7) ? 16 : (sensorId == 6) ? 200 : MEASUREMENT_COUNT;
+		}
+
+		static uint8_t widthOf(uint8_t sensorId)
+		{
+			return (sensorId == 7) ? 4 : (sensorId == 6) ? 1 : 2;
+		}
+
+		static uint32_t valueOf(uint32_t time, uint8_t sensorId, uint16_t index)
+		{
+			uint32_t v = time * 31u + sensorId * 1000u + index * 7u;
+			uint8_t width = widthOf(sensorId);
+			return (width == 1) ? (v & 0xFF) : (width == 2) ? (v & 0xFFFF) : v * 2654435761u;
+		}
+
+		void fillSamples(uint32_t time, uint8_t sensorId)
+		{
+			uint8_t width = widthOf(sensorId);
+			for (uint16_t i = 0; i < countOf(sensorId); i++)
+			{
+				uint32_t v = valueOf(time, sensorId, i);
+				for (uint8_t b = 0; b < width; b++) samples[i * width + b] = (uint8_t)(v >> (8 * b));
+			}
+		}
+
+		void appendSecond(Log& log, uint32_t time)
+		{
+			for (uint8_t id = 1; id <= SENSORS; id++)
+			{
+				fillSamples(time, id);
+				log.append(id, time, samples, countOf(id), widthOf(id));
+			}
+			log.update(time);
+		}
+
+		void endField()
+		{
+			Checker& c = checker;
+			if (c.field == 0) c.rowTime = c.number;
+			else if (c.field == 1) c.rowSensor = (uint8_t)c.number;
+			else if (c.rowSensor < 1 || c.rowSensor > SENSORS || c.field - 2 >= countOf(c.rowSensor) ||
+					 c.number != valueOf(c.rowTime, c.rowSensor, c.field - 2)) c.rowOk = false;
+			c.field++;
+		}
+
+		void endRow()
+		{
+			Checker& c = checker;
+			if (c.field == 0) return; // CSV header
+			if (c.field < 2 || c.field - 2 != countOf(c.rowSensor) || c.rowTime < c.lastTime) c.rowOk = false;
+			if (c.rows == 0) c.firstTime = c.rowTime;
+			c.lastTime = c.rowTime;
+			c.rows++;
+			if (!c.rowOk) c.badRows++;
+			c.field = 0;
+			c.rowOk = true;
+		}
+
+		void receive(const char* data, size_t length)
+		{
+			Checker& c = checker;
+			c.bytes += length;
+			if (length > c.largestSend) c.largestSend = length;
+			c.virtualUs += (uint64_t)length * 8 * 1000000 / CLIENT_BITS_PER_S;
+			for (size_t i = 0; i < length; i++)
+			{
+				char ch = data[i];
+				if (ch >= '0' && ch <= '9')
+				{
+					c.number = (c.inNumber ? c.number * 10 : 0) + (uint32_t)(ch - '0');
+					c.inNumber = true;
+					continue;
+				}
+				if (c.inNumber) endField();
+				c.inNumber = false;
+				if (ch == '\n') endRow();
+			}
+		}
+
+		// The radio, called between the slices of the export: keeps polling, so the log
+		// grows by a second for every (virtual) second of the export.
+		void radio(Log& log)
+		{
+			uint64_t gap = checker.virtualUs - lastRadioUs;
+			if (gap > longestRadioGapUs) longestRadioGapUs = gap;
+			lastRadioUs = checker.virtualUs;
+			radioCalls++;
+			while (radioSeconds < checker.virtualUs / 1000000)
+			{
+				appendSecond(log, ++radioTime);
+				radioSeconds++;
+			}
+		}
+
+		void exportRange(Log& log, ExportFormat format, const char* name, uint8_t sensorId, uint32_t fromTime, uint32_t toTime)
+		{
+			checker = Checker{0, false, 0, 0, 0, true, 0, 0, 0, 0, 0, 0, 0};
+			lastRadioUs = 0;
+			longestRadioGapUs = 0;
+			radioCalls = 0;
+			radioSeconds = 0;
+
+			Export exporter(format);
+			auto send = [this](const char* data, size_t length) { receive(data, length); };
+			unsigned long startUs = micros();
+			exporter.begin();
+			exporter.exportLog(log, sensorId, fromTime, toTime, send, [&]() { radio(log); },
+							   [this]() { return (uint32_t)checker.virtualUs; }, SLICE_US);
+			exporter.end(send);
+			unsigned long elapsedUs = micros() - startUs;
+
+			uint32_t expectedRows = (toTime - fromTime + 1) * (sensorId == 0 ? SENSORS : 1);
+			bool ok = checker.badRows == 0 && checker.rows == expectedRows && exporter.getRows() == expectedRows &&
+					  checker.firstTime == fromTime && checker.lastTime == toTime && checker.bytes == exporter.getBytesSent() &&
+					  longestRadioGapUs < (uint64_t)DATA_TIMEOUT_MS * 1000;
+			ESP_LOGI("ExportStreamTest", "%-6s %-22s | %5lu rows %s | %8lu bytes in %4lu sends (max %4lu) | %5lu ms | at 1 Mbit/s: %5lu s, radio every <= %3lu ms",
+					 (format == ExportFormat::CSV) ? "CSV" : "NDJSON", name, (unsigned long)checker.rows,
+					 ok ? "OK" : "WRONG", (unsigned long)checker.bytes, (unsigned long)exporter.getNofSends(),
+					 (unsigned long)checker.largestSend, elapsedUs / 1000,
+					 (unsigned long)(checker.virtualUs / 1000000), (unsigned long)(longestRadioGapUs / 1000));
+			if (!ok)
+			{
+				ESP_LOGW("ExportStreamTest", "  %lu bad rows, expected %lu rows from %lu to %lu, got %lu to %lu, radio gap limit %lu ms",
+						 (unsigned long)checker.badRows, (unsigned long)expectedRows, (unsigned long)fromTime,
+						 (unsigned long)toTime, (unsigned long)checker.firstTime, (unsigned long)checker.lastTime,
+						 (unsigned long)DATA_TIMEOUT_MS);
+			}
+		}
+
+		void clear()
+		{
+			uint32_t segments[64];
+			uint16_t count = files.list(segments, 64);
+			for (uint16_t i = 0; i < count && i < 64; i++) files.remove(segments[i]);
+		}
+
+	public:
+		ExportStreamTest() : files(LITTLEFS_ROOT "/exportstream"), lastRadioUs(0), longestRadioGapUs(0), radioCalls(0), radioTime(0), radioSeconds(0)
+		{
+		}
+
+		void run()
+		{
+			if (!LITTLEFS.begin(true) || !files.begin())
+			{
+				ESP_LOGE("ExportStreamTest", "LittleFS mount failed");
+				return;
+			}
+			clear();
+
+			Log log(files, 30);
+			log.begin();
+			for (uint32_t time = 0; time < DURATION_S; time++) appendSecond(log, time);
+			log.flush();
+			radioTime = DURATION_S - 1;
+
+			uint32_t oldest = log.getOldestTime() + 1; // the oldest second may be partly recycled
+			uint32_t last = log.getLastTime();
+			ESP_LOGI("ExportStreamTest", "history: %lu s of %u sensors written, log keeps %lu..%lu (%lu chunks); exporter: %u bytes",
+					 (unsigned long)DURATION_S, SENSORS, (unsigned long)oldest, (unsigned long)last,
+					 (unsigned long)log.getStoredChunks(), (unsigned)sizeof(Export));
+
+			exportRange(log, ExportFormat::CSV, "all, everything", 0, oldest, last);
+
+			// The first export added to the log, and may have recycled its oldest segment.
+			oldest = log.getOldestTime() + 1;
+			last = log.getLastTime();
+			exportRange(log, ExportFormat::NDJSON, "all, everything", 0, oldest, last);
+			exportRange(log, ExportFormat::CSV, "sensor 8, 2 minutes", 8, oldest + 100, oldest + 219);
+			exportRange(log, ExportFormat::NDJSON, "sensor 3, 4 minutes", 3, last - 240, last - 1);
+			clear();
+			ESP_LOGI("ExportStreamTest", "ExportStreamTest done");
+		}
+	}; // end class ExportStreamTest
+
+} // end namespace crt
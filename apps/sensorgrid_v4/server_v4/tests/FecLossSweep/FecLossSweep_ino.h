@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_FecLossSweep.h"
+
+namespace crt
+{
+	FecLossSweep fecLossSweep;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== FEC LOSS SWEEP ===");
+	crt::fecLossSweep.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
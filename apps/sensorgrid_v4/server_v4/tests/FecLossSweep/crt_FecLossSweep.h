@@ -0,0 +1,244 @@
+// by Marius Versteegen, 2025
+// FecLossSweep: effective goodput and average response latency of POLL/DATA
+// exchanges with and without the parity packet, at 1..20% frame loss.
+//
+// The radio is simulated: every frame (POLL, DataPackets, DataParityPacket) is
+// lost independently with the given probability; this is the loss that remains
+// after ESP-NOW's own MAC retransmissions. The sensor side (buildParityPacket)
+// and the server side (FragmentReassembler) are the real code, and every
+// completed reply is compared with the data that was sent.
+// Timing follows ServerNode: a reply that is incomplete after DATA_TIMEOUT_MS
+// is polled again, at most MAX_POLL_RETRIES times.
+
+#pragma once
+#include <Arduino.h>
+#include <crt_SensorGridPacket.h>
+#include <crt_PacketCodec.h>
+#include <crt_FragmentReassembler.h>
+
+namespace crt
+{
+	class FecLossSweep
+	{
+	private:
+		static const uint16_t NOF_POLLS = 2000;
+		static const unsigned long DATA_TIMEOUT_US = 200000;
+		static const uint8_t MAX_POLL_RETRIES = 5;
+		static const uint16_t PROCESSING_US = 300;      // sensor: POLL received to first DataPacket sent
+		static const uint16_t MAX_SIZE = 500;
+
+		FragmentReassembler reassembler;
+		uint8_t data[MAX_SIZE];
+		uint8_t received[MAX_SIZE];
+		uint32_t seed;
+
+		struct Result
+		{
+			uint32_t delivered;
+			uint32_t failed;
+			uint32_t corrupted;
+			uint32_t repaired;
+			uint64_t totalUs;
+			uint64_t latencySumUs;
+		};
+
+		// 0..9999
+		uint16_t random10000()
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return (uint16_t)((seed >> 8) % 10000);
+		}
+
+		bool lost(uint16_t lossPer10000)
+		{
+			return random10000() < lossPer10000;
+		}
+
+		// 1 Mbps, long preamble, 43 bytes of 802.11 action frame overhead, ACK.
+		static uint32_t frameAirtimeUs(size_t bytes)
+		{
+			return 192 + (43 + bytes) * 8 + 304;
+		}
+
+		// One POLL and its reply. Returns true if the reply was complete; elapsedUs is
+		// the time until completion, or until the server gives up waiting.
+		bool pollOnce(uint16_t totalBytes, bool withParity, uint16_t lossPer10000, uint32_t& elapsedUs)
+		{
+			reassembler.start(1, received, totalBytes, DATA_PAYLOAD_MAX_SIZE);
+			elapsedUs = frameAirtimeUs(sizeof(PollPacket));
+			if (lost(lossPer10000))
+			{
+				elapsedUs += DATA_TIMEOUT_US;
+				return false;
+			}
+			elapsedUs += PROCESSING_US;
+
+			const uint8_t maxPerPacket = DATA_PAYLOAD_MAX_SIZE;
+			uint8_t totalPackets = (totalBytes + maxPerPacket - 1) / maxPerPacket;
+			uint16_t offset = 0;
+			for (uint8_t i = 0; i < totalPackets; i++)
+			{
+				uint16_t remaining = totalBytes - offset;
+				uint8_t chunk = (remaining > maxPerPacket) ? maxPerPacket : (uint8_t)remaining;
+
+				DataPacket pkt;
+				pkt.messageType = MessageType::DATA;
+				pkt.sensorId = 1;
+				pkt.packetIndex = i;
+				pkt.totalPackets = totalPackets;
+				pkt.payloadSize = chunk;
+				memcpy(pkt.payload, data + offset, chunk);
+				offset += chunk;
+
+				uint8_t frame[DataCodec::MAX_SIZE];
+				size_t frameSize = DataCodec::encode(pkt, frame);
+				elapsedUs += frameAirtimeUs(frameSize);
+				if (!lost(lossPer10000) && reassembler.addData(DataPacketView(frame, frameSize))) return true;
+			}
+
+			if (withParity)
+			{
+				DataParityPacket parity;
+				buildParityPacket(1, data, totalBytes, DATA_PAYLOAD_MAX_SIZE, parity);
+				uint8_t frame[DataParityCodec::MAX_SIZE];
+				size_t paritySize = DataParityCodec::encode(parity, frame);
+				elapsedUs += frameAirtimeUs(paritySize);
+				if (!lost(lossPer10000) && reassembler.addParity(DataParityPacketView(frame, paritySize))) return true;
+			}
+
+			elapsedUs += DATA_TIMEOUT_US;
+			return false;
+		}
+
+		// Encodes a DataPacket of data, as the sensor sends it.
+		static size_t encodeDataPacket(const uint8_t* data, uint16_t totalBytes, uint8_t index, uint8_t* frame)
+		{
+			DataPacket pkt;
+			pkt.messageType = MessageType::DATA;
+			pkt.sensorId = 1;
+			pkt.packetIndex = index;
+			pkt.totalPackets = (uint8_t)((totalBytes + DATA_PAYLOAD_MAX_SIZE - 1) / DATA_PAYLOAD_MAX_SIZE);
+			uint16_t offset = (uint16_t)index * DATA_PAYLOAD_MAX_SIZE;
+			pkt.payloadSize = (totalBytes - offset > DATA_PAYLOAD_MAX_SIZE) ? DATA_PAYLOAD_MAX_SIZE : (uint8_t)(totalBytes - offset);
+			memcpy(pkt.payload, data + offset, pkt.payloadSize);
+			return DataCodec::encode(pkt, frame);
+		}
+
+		// A parity frame of a 2-packet reply with a payload shorter than a fragment must be
+		// rejected: the repair would use the bytes of the previous parity frame beyond it.
+		bool checkShortParity()
+		{
+			const uint16_t totalBytes = DATA_PAYLOAD_MAX_SIZE + 10;
+			uint8_t frame[DataCodec::MAX_SIZE];
+			uint8_t parityFrame[DataParityCodec::MAX_SIZE];
+			DataParityPacket parity;
+
+			// A repaired reply, such that the parity of the reassembler holds the bytes of this reply.
+			for (uint16_t i = 0; i < totalBytes; i++) data[i] = (uint8_t)random10000();
+			reassembler.start(1, received, totalBytes, DATA_PAYLOAD_MAX_SIZE);
+			reassembler.addData(DataPacketView(frame, encodeDataPacket(data, totalBytes, 0, frame)));
+			buildParityPacket(1, data, totalBytes, DATA_PAYLOAD_MAX_SIZE, parity);
+			bool ok = reassembler.addParity(DataParityPacketView(parityFrame, DataParityCodec::encode(parity, parityFrame)));
+
+			// The next reply loses its first packet, and gets a parity frame that is cut short.
+			for (uint16_t i = 0; i < totalBytes; i++) data[i] = (uint8_t)random10000();
+			reassembler.start(1, received, totalBytes, DATA_PAYLOAD_MAX_SIZE);
+			reassembler.addData(DataPacketView(frame, encodeDataPacket(data, totalBytes, 1, frame)));
+			buildParityPacket(1, data, totalBytes, DATA_PAYLOAD_MAX_SIZE, parity);
+			parity.payloadSize = 10;
+			ok = ok && !reassembler.addParity(DataParityPacketView(parityFrame, DataParityCodec::encode(parity, parityFrame)));
+			ok = ok && !reassembler.isComplete();
+
+			// The complete parity frame still repairs it.
+			parity.payloadSize = DATA_PAYLOAD_MAX_SIZE;
+			ok = ok && reassembler.addParity(DataParityPacketView(parityFrame, DataParityCodec::encode(parity, parityFrame)));
+			ok = ok && reassembler.getLength() == totalBytes && memcmp(reassembler.getData(), data, totalBytes) == 0;
+			return ok;
+		}
+
+		Result sweepOne(uint16_t totalBytes, bool withParity, uint16_t lossPer10000)
+		{
+			Result result = {};
+			for (uint16_t n = 0; n < NOF_POLLS; n++)
+			{
+				for (uint16_t i = 0; i < totalBytes; i++)
+				{
+					data[i] = (uint8_t)random10000();
+				}
+
+				uint32_t responseUs = 0;
+				bool ok = false;
+				for (uint8_t attempt = 0; attempt <= MAX_POLL_RETRIES && !ok; attempt++)
+				{
+					uint32_t elapsedUs = 0;
+					ok = pollOnce(totalBytes, withParity, lossPer10000, elapsedUs);
+					responseUs += elapsedUs;
+				}
+
+				result.totalUs += responseUs;
+				if (!ok)
+				{
+					result.failed++;
+					continue;
+				}
+				result.delivered++;
+				result.latencySumUs += responseUs;
+				if (reassembler.wasRepaired()) result.repaired++;
+				if (reassembler.getLength() != totalBytes || memcmp(reassembler.getData(), data, totalBytes) != 0)
+				{
+					result.corrupted++;
+				}
+			}
+			return result;
+		}
+
+		void sweep(uint16_t totalBytes)
+		{
+			const uint16_t lossRates[] = {100, 200, 500, 1000, 1500, 2000}; // per 10000
+			uint8_t totalPackets = (totalBytes + DATA_PAYLOAD_MAX_SIZE - 1) / DATA_PAYLOAD_MAX_SIZE;
+			ESP_LOGI("FecLossSweep", "--- %u bytes per reply (%u DataPacket(s)) ---", totalBytes, totalPackets);
+			ESP_LOGI("FecLossSweep", "loss | goodput B/s plain -> parity | avg latency ms plain -> parity | repaired | failed plain/parity");
+
+			for (uint16_t lossRate : lossRates)
+			{
+				Result plain = sweepOne(totalBytes, false, lossRate);
+				Result parity = sweepOne(totalBytes, true, lossRate);
+
+				ESP_LOGI("FecLossSweep", "%3u%% | %6lu -> %6lu | %6lu.%01lu -> %6lu.%01lu | %4lu | %lu/%lu%s",
+						 lossRate / 100,
+						 (unsigned long)goodputBytesPerS(plain, totalBytes),
+						 (unsigned long)goodputBytesPerS(parity, totalBytes),
+						 (unsigned long)(averageLatencyUs(plain) / 1000), (unsigned long)(averageLatencyUs(plain) / 100 % 10),
+						 (unsigned long)(averageLatencyUs(parity) / 1000), (unsigned long)(averageLatencyUs(parity) / 100 % 10),
+						 (unsigned long)parity.repaired,
+						 (unsigned long)plain.failed, (unsigned long)parity.failed,
+						 (plain.corrupted + parity.corrupted) ? "  CORRUPTED REPLIES!" : "");
+			}
+		}
+
+		static uint32_t goodputBytesPerS(const Result& result, uint16_t totalBytes)
+		{
+			return result.totalUs ? (uint32_t)((uint64_t)result.delivered * totalBytes * 1000000 / result.totalUs) : 0;
+		}
+
+		static uint32_t averageLatencyUs(const Result& result)
+		{
+			return result.delivered ? (uint32_t)(result.latencySumUs / result.delivered) : 0;
+		}
+
+	public:
+		FecLossSweep() : seed(4711)
+		{
+		}
+
+		void run()
+		{
+			ESP_LOGI("FecLossSweep", "parity frame shorter than a fragment: %s", checkShortParity() ? "rejected, OK" : "ACCEPTED!");
+			sweep(MEASUREMENT_COUNT * sizeof(uint16_t)); // the current v4 payload
+			sweep(400);                                  // 200 measurements
+			sweep(MAX_SIZE);                             // 250 measurements
+			ESP_LOGI("FecLossSweep", "FecLossSweep done");
+		}
+	}; // end class FecLossSweep
+
+} // end namespace crt
@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_FrameHandlingBench.h"
+
+namespace crt
+{
+	FrameHandlingBench frameHandlingBench;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== FRAME HANDLING BENCHMARK ===");
+	crt::frameHandlingBench.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
@@ -0,0 +1,171 @@
+// by Marius Versteegen, 2025
+// FrameHandlingBench: CPU cost of handling the DATA frames of a POLL reply on
+// the server, from the received frame up to the published samples.
+//
+//   copying:   as ServerNode did before: copy the frame into a stack DataPacket,
+//              reassemble it into a shared reassembly buffer, then copy the
+//              completed reply into the sensor's samples.
+//   zero-copy: as ServerNode does now: read the frame through a DataPacketView,
+//              reassemble straight into the sensor's back buffer, then swap the
+//              back buffer with the published one.
+//
+// Both variants use the same FragmentReassembler and the same change check
+// (memcmp). The ESP_LOGI per frame is left out; it costs the same in both.
+
+#pragma once
+#include <Arduino.h>
+#include <crt_SensorGridPacket.h>
+#include <crt_PacketCodec.h>
+#include <crt_PacketView.h>
+#include <crt_FragmentReassembler.h>
+
+namespace crt
+{
+	class FrameHandlingBench
+	{
+	private:
+		static const uint32_t MAX_FRAME_BYTES = 4096;
+		static const uint16_t MAX_PACKETS = (MAX_FRAME_BYTES + DATA_PAYLOAD_MAX_SIZE - 1) / DATA_PAYLOAD_MAX_SIZE;
+		static const uint32_t FRAMES_PER_RUN = 40000;
+		static const uint8_t SENSOR_ID = 1;
+
+		FragmentReassembler reassembler;
+		uint8_t frames[MAX_PACKETS][DataCodec::MAX_SIZE]; // as received by the ESP-NOW callback
+		size_t frameSizes[MAX_PACKETS];
+		uint8_t reassemblyBuffer[MAX_FRAME_BYTES];       // copying: shared by all sensors
+		uint8_t sampleBuffers[2][MAX_FRAME_BYTES];       // samples, and the back buffer for zero-copy
+		uint8_t* samples;
+		uint8_t* backBuffer;
+		volatile uint32_t sink;
+
+		uint16_t buildFrames(uint32_t totalBytes)
+		{
+			uint16_t totalPackets = (uint16_t)((totalBytes + DATA_PAYLOAD_MAX_SIZE - 1) / DATA_PAYLOAD_MAX_SIZE);
+			for (uint16_t i = 0; i < totalPackets; i++)
+			{
+				uint32_t offset = (uint32_t)i * DATA_PAYLOAD_MAX_SIZE;
+				uint32_t remaining = totalBytes - offset;
+				uint8_t chunk = (remaining > DATA_PAYLOAD_MAX_SIZE) ? DATA_PAYLOAD_MAX_SIZE : (uint8_t)remaining;
+
+				DataPacket pkt;
+				pkt.messageType = MessageType::DATA;
+				pkt.sensorId = SENSOR_ID;
+				pkt.packetIndex = (uint8_t)i;
+				pkt.totalPackets = (uint8_t)totalPackets;
+				pkt.payloadSize = chunk;
+				for (uint8_t b = 0; b < chunk; b++)
+				{
+					pkt.payload[b] = (uint8_t)(offset + b);
+				}
+				frameSizes[i] = DataCodec::encode(pkt, frames[i]);
+			}
+			return totalPackets;
+		}
+
+		// New data in every reply, as from a real sensor.
+		void changeFirstSample(uint32_t reply)
+		{
+			frames[0][DataCodec::HEADER_SIZE] = (uint8_t)reply;
+		}
+
+		unsigned long runCopying(uint32_t totalBytes, uint16_t totalPackets, uint32_t nofReplies)
+		{
+			unsigned long startUs = micros();
+			for (uint32_t reply = 0; reply < nofReplies; reply++)
+			{
+				changeFirstSample(reply);
+				reassembler.start(SENSOR_ID, reassemblyBuffer, totalBytes, DATA_PAYLOAD_MAX_SIZE);
+				for (uint16_t i = 0; i < totalPackets; i++)
+				{
+					DataPacket pkt;
+					size_t copyLen = frameSizes[i] < sizeof(DataPacket) ? frameSizes[i] : sizeof(DataPacket);
+					memcpy(&pkt, frames[i], copyLen);
+					reassembler.addData(DataPacketView((const uint8_t*)&pkt, (int)copyLen));
+				}
+				if (memcmp(samples, reassembler.getData(), reassembler.getLength()) != 0)
+				{
+					memcpy(samples, reassembler.getData(), reassembler.getLength());
+				}
+				sink = sink + samples[0];
+			}
+			return micros() - startUs;
+		}
+
+		unsigned long runZeroCopy(uint32_t totalBytes, uint16_t totalPackets, uint32_t nofReplies)
+		{
+			unsigned long startUs = micros();
+			for (uint32_t reply = 0; reply < nofReplies; reply++)
+			{
+				changeFirstSample(reply);
+				reassembler.start(SENSOR_ID, backBuffer, totalBytes, DATA_PAYLOAD_MAX_SIZE);
+				for (uint16_t i = 0; i < totalPackets; i++)
+				{
+					DataPacketView pkt(frames[i], (int)frameSizes[i]);
+					if (pkt.isValid()) reassembler.addData(pkt);
+				}
+				if (memcmp(samples, backBuffer, reassembler.getLength()) != 0)
+				{
+					uint8_t* published = backBuffer;
+					backBuffer = samples;
+					samples = published;
+				}
+				sink = sink + samples[0];
+			}
+			return micros() - startUs;
+		}
+
+		// The published samples must be those of the last reply: byte i of a reply is
+		// (uint8_t)i, except for its first sample.
+		bool samplesMatch(uint32_t totalBytes, uint32_t lastReply) const
+		{
+			if (samples[0] != (uint8_t)lastReply) return false;
+			for (uint32_t i = 1; i < totalBytes; i++)
+			{
+				if (samples[i] != (uint8_t)i) return false;
+			}
+			return true;
+		}
+
+		void bench(uint16_t sampleCount)
+		{
+			uint32_t totalBytes = (uint32_t)sampleCount * sizeof(uint16_t);
+			uint16_t totalPackets = buildFrames(totalBytes);
+			uint32_t nofReplies = FRAMES_PER_RUN / totalPackets;
+			uint32_t nofFrames = nofReplies * totalPackets;
+
+			memset(sampleBuffers, 0, sizeof(sampleBuffers));
+			unsigned long copyingUs = runCopying(totalBytes, totalPackets, nofReplies);
+			bool ok = samplesMatch(totalBytes, nofReplies - 1);
+			memset(sampleBuffers, 0, sizeof(sampleBuffers));
+			unsigned long zeroCopyUs = runZeroCopy(totalBytes, totalPackets, nofReplies);
+			ok = ok && samplesMatch(totalBytes, nofReplies - 1);
+
+			// Bytes copied per reply: frame + payload + samples, against payload only.
+			uint32_t copiedBefore = 0;
+			for (uint16_t i = 0; i < totalPackets; i++) copiedBefore += frameSizes[i];
+			copiedBefore += 2 * totalBytes;
+
+			ESP_LOGI("FrameHandlingBench", "%4u samples (%2u pkt): copying %4lu ns/frame, zero-copy %4lu ns/frame, %5lu -> %4lu bytes copied per reply%s",
+					 sampleCount, totalPackets,
+					 (unsigned long)((uint64_t)copyingUs * 1000 / nofFrames),
+					 (unsigned long)((uint64_t)zeroCopyUs * 1000 / nofFrames),
+					 (unsigned long)copiedBefore, (unsigned long)totalBytes, ok ? "" : "  WRONG SAMPLES!");
+		}
+
+	public:
+		FrameHandlingBench() : samples(sampleBuffers[0]), backBuffer(sampleBuffers[1]), sink(0)
+		{
+			memset(sampleBuffers, 0, sizeof(sampleBuffers));
+		}
+
+		void run()
+		{
+			bench(16);
+			bench(MEASUREMENT_COUNT);
+			bench(1024);
+			bench(2048);
+			ESP_LOGI("FrameHandlingBench", "FrameHandlingBench done");
+		}
+	}; // end class FrameHandlingBench
+
+} // end namespace crt
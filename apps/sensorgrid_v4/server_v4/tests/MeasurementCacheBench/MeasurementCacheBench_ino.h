@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_MeasurementCacheBench.h"
+
+namespace crt
+{
+	MeasurementCacheBench measurementCacheBench;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== MEASUREMENT CACHE BENCHMARK ===");
+	crt::measurementCacheBench.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
@@ -0,0 +1,149 @@
+// by Marius Versteegen, 2025
+// Compares the cost of producing an /api/allmeasurements body by formatting
+// every value from scratch (as ServerNode did before) with concatenating the
+// fragments kept by MeasurementJsonCache.
+// Per round, new data arrives for all sensors, after which 1..16 readers
+// (dashboards polling the same server) each request the complete body.
+
+#pragma once
+#include <Arduino.h>
+#include <crt_SensorGridPacket.h>
+#include <crt_MeasurementJsonCache.h>
+
+namespace crt
+{
+	class MeasurementCacheBench
+	{
+	private:
+		static const uint8_t NOF_SENSORS = 4;
+		static const uint16_t ROUNDS = 200;
+		static const uint16_t SLAB_SIZE = 40 + 6 * MEASUREMENT_COUNT; // MeasurementJsonCache::slabSize() for 16 bit samples
+		static const uint16_t BODY_SIZE = 16 + NOF_SENSORS * SLAB_SIZE;
+
+		MeasurementJsonCache<NOF_SENSORS> cache;
+		uint16_t measurements[NOF_SENSORS + 1][MEASUREMENT_COUNT];
+		char slabs[NOF_SENSORS + 1][SLAB_SIZE];
+		char body[BODY_SIZE];
+		volatile uint32_t sink;
+		uint32_t seed;
+
+		void newData()
+		{
+			for (uint8_t id = 1; id <= NOF_SENSORS; id++)
+			{
+				for (uint8_t i = 0; i < MEASUREMENT_COUNT; i++)
+				{
+					seed = seed * 1664525u + 1013904223u;
+					measurements[id][i] = (uint16_t)((seed >> 16) & 1023);
+				}
+				cache.invalidate(id);
+			}
+		}
+
+		String formatFromScratch()
+		{
+			String json = "{\"sensors\":[";
+			for (uint8_t id = 1; id <= NOF_SENSORS; id++)
+			{
+				if (id > 1) json += ",";
+				json += "{\"id\":" + String(id) + ",";
+				json += "\"count\":" + String((int)MEASUREMENT_COUNT) + ",";
+				json += "\"values\":[";
+				for (uint8_t i = 0; i < MEASUREMENT_COUNT; i++)
+				{
+					if (i > 0) json += ",";
+					json += String(measurements[id][i]);
+				}
+				json += "]}";
+			}
+			json += "]}";
+			sink = sink + json.length();
+			return json;
+		}
+
+		uint32_t concatenateFromCache()
+		{
+			char* p = body;
+			memcpy(p, "{\"sensors\":[", 12);
+			p += 12;
+			for (uint8_t id = 1; id <= NOF_SENSORS; id++)
+			{
+				if (id > 1) *p++ = ',';
+				uint16_t length = 0;
+				const char* fragment = cache.get(id, (const uint8_t*)measurements[id], MEASUREMENT_COUNT, sizeof(uint16_t), length);
+				memcpy(p, fragment, length);
+				p += length;
+			}
+			memcpy(p, "]}", 2);
+			p += 2;
+			sink = sink + (uint32_t)(p - body);
+			return (uint32_t)(p - body);
+		}
+
+		// The cached body must be the body that is formatted from scratch.
+		bool bodiesMatch()
+		{
+			String json = formatFromScratch();
+			uint32_t length = concatenateFromCache();
+			return json.length() == length && memcmp(json.c_str(), body, length) == 0;
+		}
+
+		void bench(uint8_t nofReaders)
+		{
+			unsigned long scratchUs = 0;
+			unsigned long cachedUs = 0;
+			cache.resetStats();
+
+			for (uint16_t round = 0; round < ROUNDS; round++)
+			{
+				newData();
+
+				unsigned long startUs = micros();
+				for (uint8_t reader = 0; reader < nofReaders; reader++)
+				{
+					formatFromScratch();
+				}
+				scratchUs += micros() - startUs;
+
+				startUs = micros();
+				for (uint8_t reader = 0; reader < nofReaders; reader++)
+				{
+					concatenateFromCache();
+				}
+				cachedUs += micros() - startUs;
+			}
+
+			uint32_t hits = cache.getHits();
+			uint32_t misses = cache.getMisses();
+			bool ok = bodiesMatch();
+			uint32_t nofRequests = (uint32_t)ROUNDS * nofReaders;
+			ESP_LOGI("MeasurementCacheBench",
+					 "%2u readers: scratch %lu us/request, cached %lu us/request (hits %lu, misses %lu)%s",
+					 nofReaders,
+					 (unsigned long)(scratchUs / nofRequests),
+					 (unsigned long)(cachedUs / nofRequests),
+					 (unsigned long)hits, (unsigned long)misses, ok ? "" : "  WRONG BODY!");
+		}
+
+	public:
+		MeasurementCacheBench() : sink(0), seed(12345)
+		{
+			for (uint8_t id = 1; id <= NOF_SENSORS; id++)
+			{
+				cache.attach(id, slabs[id], SLAB_SIZE);
+			}
+		}
+
+		void run()
+		{
+			ESP_LOGI("MeasurementCacheBench", "%u sensors x %u values, cache footprint %lu bytes",
+					 NOF_SENSORS, MEASUREMENT_COUNT, (unsigned long)cache.getFootprint());
+			for (uint8_t nofReaders = 1; nofReaders <= 16; nofReaders *= 2)
+			{
+				bench(nofReaders);
+			}
+			ESP_LOGI("MeasurementCacheBench", "MeasurementCacheBench done");
+		}
+	}; // end class MeasurementCacheBench
+
+} // end namespace crt
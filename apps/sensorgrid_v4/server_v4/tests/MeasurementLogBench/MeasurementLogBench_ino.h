@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_MeasurementLogBench.h"
+
+namespace crt
+{
+	MeasurementLogBench measurementLogBench;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== MEASUREMENT LOG BENCH ===");
+	crt::measurementLogBench.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
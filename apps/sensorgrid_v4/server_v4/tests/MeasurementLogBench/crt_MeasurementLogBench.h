@@ -0,0 +1,316 @@
+// by Marius Versteegen, 2025
+// MeasurementLogBench: write amplification, range queries and crash recovery
+// of the MeasurementLog, with the same FileLogStorage as ServerNode (in
+// LITTLEFS_ROOT/mlogbench; on a PC that is just a directory).
+//
+//   writes:   SENSORS sensors of 64 16-bit samples each report every second,
+//             for a simulated DURATION_S. The log (4 kB chunks) is compared
+//             with appending every reply to its segment file as it comes in.
+//             Flash use follows a model of LittleFS (FlashModelStorage): a
+//             write that continues a partially written 4 kB block copies that
+//             block to a fresh one, data is programmed in 128-byte units, and
+//             every sync commits 128 bytes of metadata.
+//   queries:  one sensor for one minute, and all sensors for ten minutes,
+//             through the index and by scanning every chunk.
+//   recovery: the log is abandoned with unflushed data and a torn chunk at the
+//             end of its newest segment, as after a reset during a write, and
+//             opened again.
+
+#pragma once
+#include <Arduino.h>
+#include <LITTLEFS.h>
+#include <crt_SensorGridPacket.h>
+#include "crt_FileLogStorage.h"
+#include "crt_MeasurementLog.h"
+
+namespace crt
+{
+	// Counts what LittleFS would program for the appends to a FileLogStorage.
+	class FlashModelStorage : public ILogStorage
+	{
+	private:
+		static const uint32_t BLOCK_SIZE = 4096;
+		static const uint32_t PROG_SIZE = 128;
+		static const uint32_t METADATA_PER_SYNC = 128;
+
+		FileLogStorage& files;
+
+		static uint32_t roundUp(uint32_t bytes)
+		{
+			return (bytes + PROG_SIZE - 1) / PROG_SIZE * PROG_SIZE;
+		}
+
+	public:
+		uint32_t bytesAppended;
+		uint32_t bytesProgrammed;
+		uint32_t blocksErased;
+		uint32_t syncs;
+		uint32_t bytesRead;
+
+		FlashModelStorage(FileLogStorage& files) : files(files)
+		{
+			resetCounters();
+		}
+
+		void resetCounters()
+		{
+			bytesAppended = bytesProgrammed = blocksErased = syncs = bytesRead = 0;
+		}
+
+		bool create(uint32_t segment) /*override*/ { return files.create(segment); }
+		uint32_t getSize(uint32_t segment) /*override*/ { return files.getSize(segment); }
+		bool remove(uint32_t segment) /*override*/ { return files.remove(segment); }
+		uint16_t list(uint32_t* segments, uint16_t maxSegments) /*override*/ { return files.list(segments, maxSegments); }
+
+		bool read(uint32_t segment, uint32_t offset, uint8_t* data, uint32_t length) /*override*/
+		{
+			bytesRead += length;
+			return files.read(segment, offset, data, length);
+		}
+
+		bool append(uint32_t segment, const uint8_t* data, uint32_t length) /*override*/
+		{
+			uint32_t tail = files.getSize(segment) % BLOCK_SIZE;
+			uint32_t remaining = length;
+			if (tail > 0)
+			{
+				uint32_t bytes = (remaining < BLOCK_SIZE - tail) ? remaining : BLOCK_SIZE - tail;
+				bytesProgrammed += roundUp(tail + bytes);
+				blocksErased++;
+				remaining -= bytes;
+			}
+			while (remaining > 0)
+			{
+				uint32_t bytes = (remaining < BLOCK_SIZE) ? remaining : BLOCK_SIZE;
+				bytesProgrammed += roundUp(bytes);
+				blocksErased++;
+				remaining -= bytes;
+			}
+			bytesProgrammed += METADATA_PER_SYNC;
+			bytesAppended += length;
+			syncs++;
+			return files.append(segment, data, length);
+		}
+	};
+
+	class MeasurementLogBench
+	{
+	private:
+		typedef MeasurementLog<4096, 16, 16> Log; // as ServerNode
+
+		static const uint8_t SENSORS = 8;
+		static const uint16_t SAMPLES = MEASUREMENT_COUNT;
+		static const uint32_t DURATION_S = 2 * 3600;
+		static const uint32_t FLUSH_INTERVAL_S = 30;
+
+		FileLogStorage files;
+		FlashModelStorage flash;
+		uint16_t samples[SAMPLES];
+		uint32_t seed;
+		volatile uint32_t sink;
+
+		void clear()
+		{
+			uint32_t segments[64];
+			uint16_t count = files.list(segments, 64);
+			for (uint16_t i = 0; i < count && i < 64; i++) files.remove(segments[i]);
+		}
+
+		void fillSamples(uint8_t sensorId, uint32_t time)
+		{
+			for (uint16_t i = 0; i < SAMPLES; i++)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				samples[i] = (uint16_t)(sensorId * 1000 + (time % 100) + (seed >> 28));
+			}
+		}
+
+		void report(const char* name, uint32_t sampleBytes, unsigned long elapsedUs)
+		{
+			ESP_LOGI("MeasurementLogBench", "%-18s | %8lu | %8lu | %9lu | %6lu | %6lu | %3lu.%02lu | %6lu",
+					 name, (unsigned long)sampleBytes, (unsigned long)flash.bytesAppended,
+					 (unsigned long)flash.bytesProgrammed, (unsigned long)flash.blocksErased,
+					 (unsigned long)flash.syncs,
+					 (unsigned long)(flash.bytesProgrammed / sampleBytes),
+					 (unsigned long)(flash.bytesProgrammed * 100ull / sampleBytes % 100),
+					 (unsigned long)(elapsedUs / 1000));
+		}
+
+		// Every reply appended to its segment file right away, as records of the same format.
+		void writePerReply()
+		{
+			clear();
+			flash.resetCounters();
+			uint32_t sampleBytes = 0;
+			uint32_t segment = 0;
+			uint32_t segmentBytes = 0;
+			uint8_t record[Log::RECORD_HEADER_SIZE + SAMPLES * 2];
+			files.create(segment);
+
+			unsigned long startUs = micros();
+			for (uint32_t time = 0; time < DURATION_S; time++)
+			{
+				for (uint8_t id = 1; id <= SENSORS; id++)
+				{
+					fillSamples(id, time);
+					memset(record, 0, Log::RECORD_HEADER_SIZE);
+					memcpy(record + Log::RECORD_HEADER_SIZE, samples, SAMPLES * 2);
+					if (segmentBytes + sizeof(record) > Log::SEGMENT_SIZE)
+					{
+						files.remove(segment >= 15 ? segment - 15 : 0xFFFFFFFF);
+						files.create(++segment);
+						segmentBytes = 0;
+					}
+					flash.append(segment, record, sizeof(record));
+					segmentBytes += sizeof(record);
+					sampleBytes += SAMPLES * 2;
+				}
+			}
+			report("per reply", sampleBytes, micros() - startUs);
+		}
+
+		void writeLog(Log& log)
+		{
+			clear();
+			flash.resetCounters();
+			log.begin();
+
+			unsigned long startUs = micros();
+			for (uint32_t time = 0; time < DURATION_S; time++)
+			{
+				for (uint8_t id = 1; id <= SENSORS; id++)
+				{
+					fillSamples(id, time);
+					log.append(id, time, (const uint8_t*)samples, SAMPLES, 2);
+				}
+				log.update(time);
+			}
+			report("log, 4 kB chunks", log.getBytesAppended(), micros() - startUs);
+		}
+
+		void query(Log& log, const char* name, uint8_t sensorId, uint32_t fromTime, uint32_t toTime)
+		{
+			uint32_t readBefore = log.getChunksRead();
+			uint32_t samplesFound = 0;
+			unsigned long startUs = micros();
+			uint32_t records = log.query(sensorId, fromTime, toTime, [&](const LogRecord& r, const uint8_t* data) {
+				samplesFound += r.sampleCount;
+				sink = sink + data[0];
+			});
+			unsigned long indexedUs = micros() - startUs;
+			uint32_t indexedChunks = log.getChunksRead() - readBefore;
+
+			readBefore = log.getChunksRead();
+			uint32_t scanRecords = 0;
+			startUs = micros();
+			log.query(0, 0, 0xFFFFFFFF, [&](const LogRecord& r, const uint8_t* data) {
+				if ((sensorId == 0 || r.sensorId == sensorId) && r.time >= fromTime && r.time <= toTime)
+				{
+					scanRecords++;
+					sink = sink + data[0];
+				}
+			});
+			unsigned long scanUs = micros() - startUs;
+			uint32_t scanChunks = log.getChunksRead() - readBefore;
+
+			uint32_t expected = (sensorId == 0 ? SENSORS : 1) * (toTime - fromTime + 1) * SAMPLES;
+			ESP_LOGI("MeasurementLogBench", "%-26s | %5lu records %s | indexed: %3lu chunks %6lu us | full scan: %3lu chunks %6lu us",
+					 name, (unsigned long)records,
+					 (samplesFound == expected && scanRecords == records) ? "OK" : "WRONG",
+					 (unsigned long)indexedChunks, indexedUs, (unsigned long)scanChunks, scanUs);
+		}
+
+		void recover()
+		{
+			uint32_t lastFlushedTime;
+			uint32_t chunksBefore;
+			{
+				Log log(flash, FLUSH_INTERVAL_S);
+				log.begin();
+				uint32_t time = log.getLastTime() + 1;
+				for (uint32_t t = 0; t < 40; t++, time++)
+				{
+					for (uint8_t id = 1; id <= SENSORS; id++)
+					{
+						fillSamples(id, time);
+						log.append(id, time, (const uint8_t*)samples, SAMPLES, 2);
+					}
+					log.update(time);
+				}
+				log.flush();
+				lastFlushedTime = time - 1;
+				for (uint32_t t = 0; t < 2; t++, time++) // less than a chunk, still in RAM
+				{
+					for (uint8_t id = 1; id <= SENSORS; id++)
+					{
+						fillSamples(id, time);
+						log.append(id, time, (const uint8_t*)samples, SAMPLES, 2);
+					}
+				}
+				chunksBefore = log.getStoredChunks();
+			} // reset: the write buffer is lost
+
+			// The reset hit while writing the next chunk: only half of it reached the flash.
+			uint32_t segments[32];
+			uint16_t count = files.list(segments, 32);
+			uint32_t newestSegment = 0;
+			for (uint16_t i = 0; i < count; i++) if (segments[i] > newestSegment) newestSegment = segments[i];
+			uint8_t torn[2048];
+			memset(torn, 0xA5, sizeof(torn));
+			files.append(newestSegment, torn, sizeof(torn));
+
+			Log log(flash, FLUSH_INTERVAL_S);
+			unsigned long startUs = micros();
+			log.begin();
+			unsigned long recoverUs = micros() - startUs;
+			uint32_t chunksKept = log.getStoredChunks();
+			uint32_t lastTime = log.getLastTime();
+
+			uint32_t records = log.query(1, lastFlushedTime, lastFlushedTime, [](const LogRecord&, const uint8_t*) {});
+			log.append(1, lastTime + 1, (const uint8_t*)samples, SAMPLES, 2);
+			bool appended = log.flush();
+
+			ESP_LOGI("MeasurementLogBench", "recovery: %lu us, %lu of %lu chunks kept, %lu discarded, last time %lu (expected %lu), last record %s, appending %s",
+					 recoverUs, (unsigned long)chunksKept, (unsigned long)chunksBefore,
+					 (unsigned long)log.getChunksDiscarded(), (unsigned long)lastTime,
+					 (unsigned long)lastFlushedTime, records == 1 ? "found" : "MISSING", appended ? "OK" : "FAILED");
+		}
+
+	public:
+		MeasurementLogBench() : files(LITTLEFS_ROOT "/mlogbench"), flash(files), seed(2025), sink(0)
+		{
+		}
+
+		void run()
+		{
+			if (!LITTLEFS.begin(true) || !files.begin())
+			{
+				ESP_LOGE("MeasurementLogBench", "LittleFS mount failed");
+				return;
+			}
+
+			ESP_LOGI("MeasurementLogBench", "--- %u sensors x %u samples every second, %lu s ---",
+					 SENSORS, SAMPLES, (unsigned long)DURATION_S);
+			ESP_LOGI("MeasurementLogBench", "writes             | samples  | to FS    | flash     | erases | syncs  | ampl.  | ms");
+			writePerReply();
+
+			Log log(flash, FLUSH_INTERVAL_S);
+			writeLog(log);
+			ESP_LOGI("MeasurementLogBench", "retained: %u segments, %lu chunks, time %lu..%lu, %lu segments recycled",
+					 log.getNofSegments(), (unsigned long)log.getStoredChunks(), (unsigned long)log.getOldestTime(),
+					 (unsigned long)log.getLastTime(), (unsigned long)log.getSegmentsRecycled());
+
+			uint32_t oldest = log.getOldestTime() + 1; // the oldest second may be partly recycled
+			uint32_t middle = (oldest + log.getLastTime()) / 2;
+			query(log, "sensor 3, 1 minute", 3, middle, middle + 59);
+			query(log, "all sensors, 10 minutes", 0, middle - 300, middle + 299);
+			query(log, "sensor 5, last 10 s (RAM)", 5, log.getLastTime() - 9, log.getLastTime());
+			log.flush();
+
+			recover();
+			clear();
+			ESP_LOGI("MeasurementLogBench", "MeasurementLogBench done");
+		}
+	}; // end class MeasurementLogBench
+
+} // end namespace crt
@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_PacketCodecBench.h"
+
+namespace crt
+{
+	PacketCodecBench packetCodecBench;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== PACKET CODEC BENCHMARK ===");
+	crt::packetCodecBench.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
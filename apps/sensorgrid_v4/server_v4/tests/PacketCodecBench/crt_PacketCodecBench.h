@@ -0,0 +1,243 @@
+// by Marius Versteegen, 2025
+// PacketCodecBench: checks and measures the codecs of crt_PacketCodec.h.
+//
+//   round trip: random DISCOVER, REGISTER, POLL and DATA packets are encoded,
+//               decoded and read through the views; every field must survive,
+//               and the bytes must equal the packed struct (the wire format
+//               did not change, so v4 nodes with older firmware still match).
+//   validation: truncated frames, wrong message types and bad payload sizes
+//               must be rejected.
+//   throughput: encode and decode time per packet, next to a plain memcpy of
+//               the packed struct (how packets were sent and received before).
+//               decode includes isValid().
+
+#pragma once
+#include <Arduino.h>
+#include <crt_SensorGridPacket.h>
+#include <crt_PacketCodec.h>
+#include <crt_PacketView.h>
+
+namespace crt
+{
+	class PacketCodecBench
+	{
+	private:
+		static const uint16_t ROUND_TRIPS = 1000;
+		static const uint32_t ITERATIONS = 200000;
+
+		uint32_t seed;
+		uint16_t failures;
+		volatile uint32_t sink;
+
+		uint8_t random8()
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return (uint8_t)(seed >> 24);
+		}
+
+		uint16_t random16()
+		{
+			return (uint16_t)(random8() | (random8() << 8));
+		}
+
+		void check(bool ok, const char* what)
+		{
+			if (!ok)
+			{
+				if (failures < 10) ESP_LOGW("PacketCodecBench", "FAILED: %s", what);
+				failures++;
+			}
+		}
+
+		// Encodes p, checks the bytes against the packed struct, and decodes it again.
+		template<typename Codec>
+		bool roundTrip(const typename Codec::Packet& p, typename Codec::Packet& decoded, uint8_t* frame, size_t& size)
+		{
+			size = Codec::encode(p, frame);
+			check(size == Codec::size(p), "encoded size");
+			check(memcmp(frame, &p, size) == 0, "bytes differ from the packed struct");
+			return Codec::decode(frame, (int)size, decoded);
+		}
+
+		void testRoundTrips()
+		{
+			uint8_t frame[DataCodec::MAX_SIZE];
+			size_t size;
+
+			for (uint16_t i = 0; i < ROUND_TRIPS; i++)
+			{
+				DiscoverPacket disc{MessageType::DISCOVER, random8(), random8(), random8()};
+				DiscoverPacket discOut{};
+				check(roundTrip<DiscoverCodec>(disc, discOut, frame, size), "DISCOVER decode");
+				check(discOut.sequence == disc.sequence && discOut.hopCount == disc.hopCount &&
+					  discOut.pathCost == disc.pathCost, "DISCOVER fields");
+				DiscoverPacketView discView(frame, (int)size);
+				check(discView.isValid() && discView.getPathCost() == disc.pathCost, "DISCOVER view");
+
+				RegisterPacket reg;
+				reg.messageType = MessageType::REGISTER;
+				reg.sensorId = random8();
+				reg.hopCount = random8();
+				reg.features = random8();
+				reg.capabilities = {random8(), random16(), random8(), random8(), random8()};
+				RegisterPacket regOut{};
+				check(roundTrip<RegisterCodec>(reg, regOut, frame, size), "REGISTER decode");
+				check(regOut.sensorId == reg.sensorId && regOut.hopCount == reg.hopCount &&
+					  regOut.features == reg.features &&
+					  memcmp(&regOut.capabilities, &reg.capabilities, sizeof(SensorCapabilities)) == 0, "REGISTER fields");
+				RegisterPacketView regView(frame, (int)size);
+				check(regView.isValid() && regView.getCapabilities().sampleCount == reg.capabilities.sampleCount, "REGISTER view");
+
+				PollPacket poll{MessageType::POLL, random8(), random8(), random16(), random8()};
+				PollPacket pollOut{};
+				check(roundTrip<PollCodec>(poll, pollOut, frame, size), "POLL decode");
+				check(pollOut.sensorId == poll.sensorId && pollOut.flags == poll.flags &&
+					  pollOut.nextPollMs == poll.nextPollMs && pollOut.channel == poll.channel, "POLL fields");
+				PollPacketView pollView(frame, (int)size);
+				check(pollView.isValid() && pollView.getNextPollMs() == poll.nextPollMs && pollView.getChannel() == poll.channel,
+					  "POLL view");
+
+				DataPacket data;
+				data.messageType = MessageType::DATA;
+				data.sensorId = random8();
+				data.packetIndex = random8();
+				data.totalPackets = random8();
+				data.payloadSize = random8() % (DATA_PAYLOAD_MAX_SIZE + 1);
+				for (uint8_t b = 0; b < data.payloadSize; b++) data.payload[b] = random8();
+				DataPacket dataOut{};
+				check(roundTrip<DataCodec>(data, dataOut, frame, size), "DATA decode");
+				check(size == DataCodec::HEADER_SIZE + data.payloadSize, "DATA size");
+				check(dataOut.packetIndex == data.packetIndex && dataOut.totalPackets == data.totalPackets &&
+					  dataOut.payloadSize == data.payloadSize &&
+					  memcmp(dataOut.payload, data.payload, data.payloadSize) == 0, "DATA fields");
+				DataPacketView dataView(frame, (int)size);
+				check(dataView.isValid() && dataView.getPayload()[0] == frame[DataCodec::HEADER_SIZE], "DATA view");
+			}
+		}
+
+		void testValidation()
+		{
+			uint8_t frame[DataCodec::MAX_SIZE];
+			RegisterPacket reg{};
+			reg.messageType = MessageType::REGISTER;
+			size_t size = RegisterCodec::encode(reg, frame);
+			for (size_t len = 0; len < size; len++)
+			{
+				check(!RegisterCodec::isValid(frame, (int)len), "truncated REGISTER accepted");
+			}
+			check(!PollCodec::isValid(frame, (int)size), "REGISTER accepted as POLL");
+			check(!RegisterCodec::isValid(nullptr, (int)size), "null frame accepted");
+
+			DataPacket data{};
+			data.messageType = MessageType::DATA;
+			data.payloadSize = DATA_PAYLOAD_MAX_SIZE;
+			size = DataCodec::encode(data, frame);
+			check(DataCodec::isValid(frame, (int)size), "full DATA rejected");
+			check(!DataCodec::isValid(frame, (int)size - 1), "DATA shorter than its payloadSize accepted");
+			check(!DataCodec::isValid(frame, (int)DataCodec::MAX_SIZE + 1), "DATA longer than MAX_SIZE accepted");
+			frame[DataCodec::offsetOf<&DataPacket::payloadSize>()] = DATA_PAYLOAD_MAX_SIZE + 1;
+			check(!DataCodec::isValid(frame, (int)size + 1), "DATA payloadSize above the maximum accepted");
+
+			DataPacket out;
+			check(!DataCodec::decode(frame, (int)size, out), "invalid DATA decoded");
+		}
+
+		// Byte 1 (the sensorId or sequence) changes every iteration, such that the
+		// compiler cannot hoist the work out of the loop.
+		template<typename Codec>
+		void benchCodec(const char* name, const typename Codec::Packet& p)
+		{
+			using Packet = typename Codec::Packet;
+			uint8_t frame[DataCodec::MAX_SIZE];
+			Packet packet = p;
+			Packet copy;
+			size_t size = Codec::size(p);
+
+			unsigned long startUs = micros();
+			for (uint32_t i = 0; i < ITERATIONS; i++)
+			{
+				((uint8_t*)&packet)[1] = (uint8_t)i;
+				memcpy(frame, &packet, size);
+				sink = sink + frame[i % size];
+			}
+			unsigned long memcpyEncodeUs = micros() - startUs;
+
+			startUs = micros();
+			for (uint32_t i = 0; i < ITERATIONS; i++)
+			{
+				frame[1] = (uint8_t)i;
+				memcpy(&copy, frame, size);
+				sink = sink + ((const uint8_t*)&copy)[i % size];
+			}
+			unsigned long memcpyDecodeUs = micros() - startUs;
+
+			startUs = micros();
+			for (uint32_t i = 0; i < ITERATIONS; i++)
+			{
+				((uint8_t*)&packet)[1] = (uint8_t)i;
+				Codec::encode(packet, frame);
+				sink = sink + frame[i % size];
+			}
+			unsigned long encodeUs = micros() - startUs;
+
+			startUs = micros();
+			for (uint32_t i = 0; i < ITERATIONS; i++)
+			{
+				frame[1] = (uint8_t)i;
+				Codec::decode(frame, (int)size, copy);
+				sink = sink + ((const uint8_t*)&copy)[i % size];
+			}
+			unsigned long decodeUs = micros() - startUs;
+
+			ESP_LOGI("PacketCodecBench", "%-9s %3u bytes | encode %4lu ns (memcpy %4lu) | decode %4lu ns (memcpy %4lu)",
+					 name, (unsigned)size,
+					 (unsigned long)((uint64_t)encodeUs * 1000 / ITERATIONS),
+					 (unsigned long)((uint64_t)memcpyEncodeUs * 1000 / ITERATIONS),
+					 (unsigned long)((uint64_t)decodeUs * 1000 / ITERATIONS),
+					 (unsigned long)((uint64_t)memcpyDecodeUs * 1000 / ITERATIONS));
+		}
+
+	public:
+		PacketCodecBench() : seed(2025), failures(0), sink(0)
+		{
+		}
+
+		void run()
+		{
+			ESP_LOGI("PacketCodecBench", "wire format tag %08lX", (unsigned long)WIRE_FORMAT_TAG);
+
+			testRoundTrips();
+			testValidation();
+			if (failures == 0)
+			{
+				ESP_LOGI("PacketCodecBench", "round trip (%u packets of each type) and validation: OK", ROUND_TRIPS);
+			}
+			else
+			{
+				ESP_LOGW("PacketCodecBench", "round trip and validation: %u FAILURES", failures);
+			}
+
+			DiscoverPacket disc{MessageType::DISCOVER, 7, 1, 3};
+			RegisterPacket reg{MessageType::REGISTER, 3, 1, FEATURE_XOR_PARITY, {}};
+			reg.capabilities = SensorCapabilities{PROTOCOL_VERSION, MEASUREMENT_COUNT, 2, CODEC_RAW, DATA_PAYLOAD_MAX_SIZE};
+			PollPacket poll{MessageType::POLL, 3, POLL_FLAG_PARITY, 1000, 0};
+			DataPacket data;
+			data.messageType = MessageType::DATA;
+			data.sensorId = 3;
+			data.packetIndex = 0;
+			data.totalPackets = 1;
+			data.payloadSize = MEASUREMENT_COUNT * sizeof(uint16_t);
+			for (uint8_t b = 0; b < data.payloadSize; b++) data.payload[b] = b;
+			DataPacket fullData = data;
+			fullData.payloadSize = DATA_PAYLOAD_MAX_SIZE;
+
+			benchCodec<DiscoverCodec>("DISCOVER", disc);
+			benchCodec<RegisterCodec>("REGISTER", reg);
+			benchCodec<PollCodec>("POLL", poll);
+			benchCodec<DataCodec>("DATA", data);
+			benchCodec<DataCodec>("DATA max", fullData);
+			ESP_LOGI("PacketCodecBench", "PacketCodecBench done");
+		}
+	}; // end class PacketCodecBench
+
+} // end namespace crt
@@ -0,0 +1,21 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <Arduino.h>
+#include "crt_ShardScaleSimulation.h"
+
+namespace crt
+{
+	ShardScaleSimulation shardScaleSimulation;
+}
+
+void setup()
+{
+	ESP_LOGI("main", "=== SHARD SCALE SIMULATION ===");
+	crt::shardScaleSimulation.run();
+}
+
+void loop()
+{
+	delay(1000);
+}
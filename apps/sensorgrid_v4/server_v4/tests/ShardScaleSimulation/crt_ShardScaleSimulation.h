@@ -0,0 +1,453 @@
+// by Marius Versteegen, 2025
+// ShardScaleSimulation: how many sensors a root server can show, fresh enough,
+// when one to four shard servers on their own Wi-Fi channels poll them and
+// forward their measurement arrays, compared to a single server.
+//
+// Every shard polls its sensors (64 samples of 16 bits) continuously, as
+// ServerNode does: POLL, a DataPacket and a parity packet, and a timeout and
+// re-POLL when more than one of them is lost. Every 50 ms, in between two POLLs,
+// it moves to the root's channel and sends the summary and the changed arrays, made by
+// the real ShardDeltaEncoder, frame by frame, at ServerNode's UPLINK_RATE of
+// 24 Mbit/s instead of the 1 Mbit/s of the polling. The root applies them with the
+// real ShardAggregator and checks every published array against the shard's.
+// A frame waits until its channel is free: the root channel carries the
+// polling of the shard that shares it as well as the uplinks of all others.
+//
+// Freshness: the age of the root's view of a sensor just before it is
+// replaced, i.e. from the POLL of the previous array until the next one
+// arrives at the root. The headline is the number of sensors whose mean age
+// stays within TARGET_AGE_MS. Two data models: all samples change on every POLL, and
+// 10% of them do. The count stops at ROOT_MAX_SENSORS, the most sensors that a
+// ServerNode holds; a count that reached it is marked with a '+'.
+
+#pragma once
+#include <Arduino.h>
+#include <crt_SensorGridPacket.h>
+#include <crt_PacketCodec.h>
+#include <crt_ShardDeltaEncoder.h>
+#include <crt_ShardAggregator.h>
+
+namespace crt
+{
+	class ShardScaleSimulation
+	{
+	private:
+		static const uint8_t MAX_SHARDS = 4;
+		static const uint8_t MAX_PER_SHARD = 32;	// ShardSummaryPacket::registeredMask
+		static const uint8_t MAX_SENSORS = MAX_SHARDS * MAX_PER_SHARD;
+		static const uint8_t ROOT_MAX_SENSORS = 64;		// as ServerNode::MAX_SENSORS
+		static const uint16_t SAMPLES = 64;
+		static const uint8_t WIDTH = 2;
+		static const uint32_t FRAME_BYTES = SAMPLES * WIDTH;
+		static const uint32_t DURATION_US = 60000000;
+		static const uint32_t SWITCH_US = 1000;			// esp_wifi_set_channel(), as ServerNode assumes
+		static const uint32_t PROCESSING_US = 300;		// per frame
+		static const uint32_t BACKOFF_MAX_US = 500;		// random channel access delay per frame
+		static const uint16_t LOSS_PER_MILLE = 2;		// after the MAC layer retries of unicast frames
+		static const uint32_t UPLINK_RATE_MBPS = 24;
+		static const uint32_t DATA_TIMEOUT_MS = 200 + 4;	// as ServerNode, for one DataPacket
+		static const uint8_t MAX_POLL_RETRIES = 5;
+		static const uint32_t UPLINK_INTERVAL_US = 50000;	// as ServerNode
+		static const uint8_t KEYFRAME_INTERVAL = 40;		// as ServerNode
+		static const uint32_t TARGET_AGE_MS = 200;	// mean
+		static const uint16_t AGE_BIN_MS = 5;
+		static const uint16_t AGE_BINS = 400;
+
+		typedef ShardAggregator<MAX_SENSORS, MAX_SHARDS> Aggregator;
+
+		// A sensor as its shard sees it
+		struct Sensor
+		{
+			uint16_t samples[SAMPLES];
+			uint16_t uplink[SAMPLES];	// the array the root has
+			uint16_t publishSequence;
+			uint16_t uplinkSequence;
+			bool uplinkValid;
+			bool uplinkSent;
+			uint8_t sinceKeyframe;
+			uint64_t polledUs;			// of the array in samples
+		};
+
+		// The same sensor at the root
+		struct RootSensor
+		{
+			uint8_t published[FRAME_BYTES];
+			uint8_t back[FRAME_BYTES];
+			bool seen;
+			uint64_t polledUs;			// at the shard, of the published array
+		};
+
+		struct Shard
+		{
+			uint8_t shardId;
+			uint8_t channel;
+			uint8_t firstSensorId;
+			uint8_t nofSensors;
+			uint8_t next;				// next sensor to poll
+			uint64_t clockUs;
+			uint64_t lastUplinkUs;
+			uint16_t cycle;
+		};
+
+		Sensor sensors[MAX_SENSORS + 1];	// indexed 1..MAX_SENSORS
+		RootSensor rootSensors[MAX_SENSORS + 1];
+		Shard shards[MAX_SHARDS];
+		uint64_t channelFreeUs[14];			// Wi-Fi channels 1..13
+		uint32_t randomState;
+		uint8_t changesPerPoll;
+		bool uplinks;						// false: a single server, publishing right away
+		uint8_t rootChannel;
+
+		// Per run
+		uint32_t ageBins[AGE_BINS + 1];
+		uint32_t nofAges;
+		uint64_t ageSumMs;
+		uint32_t polls;
+		uint32_t timeouts;
+		uint32_t uplinkFrames;
+		uint64_t uplinkBytes;
+		uint64_t rootChannelBusyUs;
+		uint32_t keyframes;
+		uint32_t mismatches;
+
+		uint32_t random32()
+		{
+			randomState ^= randomState << 13;
+			randomState ^= randomState >> 17;
+			randomState ^= randomState << 5;
+			return randomState;
+		}
+
+		bool chance(uint32_t perMille)
+		{
+			return random32() % 1000 < perMille;
+		}
+
+		static uint32_t frameAirtimeUs(uint32_t frameBytes)
+		{
+			return 192 + (43 + frameBytes) * 8 + 304;
+		}
+
+		// 802.11g: preamble, the frame at UPLINK_RATE_MBPS, SIFS and the ACK.
+		static uint32_t uplinkAirtimeUs(uint32_t frameBytes)
+		{
+			return 20 + (43 + frameBytes) * 8 / UPLINK_RATE_MBPS + 10 + 28;
+		}
+
+		// One frame on channel: waits until it is free. Returns false if it is lost.
+		bool sendFrame(uint64_t& t, uint8_t channel, uint32_t frameBytes, bool uplink = false)
+		{
+			t += PROCESSING_US;
+			if (t < channelFreeUs[channel]) t = channelFreeUs[channel];
+			uint32_t airtimeUs = uplink ? 34 + random32() % (16 * 9) + uplinkAirtimeUs(frameBytes)	// DIFS and backoff slots of 9 us
+									   : random32() % BACKOFF_MAX_US + frameAirtimeUs(frameBytes);
+			t += airtimeUs;
+			channelFreeUs[channel] = t;
+			if (channel == rootChannel) rootChannelBusyUs += airtimeUs;
+			return !chance(LOSS_PER_MILLE);
+		}
+
+		// A POLL and the reply of one sensor. Returns false on a timeout.
+		bool exchange(uint64_t& t, uint8_t channel)
+		{
+			uint64_t start = t;
+			bool pollArrived = sendFrame(t, channel, PollCodec::HEADER_SIZE);
+			uint8_t lost = 0;
+			if (pollArrived)
+			{
+				if (!sendFrame(t, channel, DataCodec::HEADER_SIZE + FRAME_BYTES)) lost++;
+				if (!sendFrame(t, channel, DataParityCodec::HEADER_SIZE + FRAME_BYTES)) lost++;
+			}
+			if (!pollArrived || lost > 1)
+			{
+				t = start + DATA_TIMEOUT_MS * 1000;
+				return false;
+			}
+			return true;
+		}
+
+		void recordAge(uint64_t ageUs)
+		{
+			uint32_t ms = (uint32_t)(ageUs / 1000);
+			uint32_t bin = ms / AGE_BIN_MS;
+			ageBins[bin < AGE_BINS ? bin : AGE_BINS]++;
+			ageSumMs += ms;
+			nofAges++;
+		}
+
+		uint32_t percentileMs(uint32_t perMille)
+		{
+			uint32_t wanted = (uint32_t)((uint64_t)nofAges * perMille / 1000);
+			uint32_t count = 0;
+			for (uint16_t bin = 0; bin <= AGE_BINS; bin++)
+			{
+				count += ageBins[bin];
+				if (count > wanted) return (uint32_t)(bin + 1) * AGE_BIN_MS;
+			}
+			return (uint32_t)(AGE_BINS + 1) * AGE_BIN_MS;
+		}
+
+		// The root's view of id is replaced by the array polled at polledUs, at time t.
+		void onRootPublished(uint8_t id, uint64_t polledUs, uint64_t t)
+		{
+			RootSensor& r = rootSensors[id];
+			if (r.seen) recordAge(t - r.polledUs);
+			r.polledUs = polledUs;
+			r.seen = true;
+		}
+
+		void pollNext(Shard& shard)
+		{
+			uint8_t id = shard.firstSensorId + shard.next++;
+			bool ok = false;
+			for (uint8_t attempt = 0; attempt <= MAX_POLL_RETRIES && !ok; attempt++)
+			{
+				ok = exchange(shard.clockUs, shard.channel);
+				if (!ok) timeouts++;
+			}
+			if (!ok) return;
+			polls++;
+
+			Sensor& s = sensors[id];
+			for (uint8_t c = 0; c < changesPerPoll; c++)
+			{
+				uint16_t index = (changesPerPoll >= SAMPLES) ? c : (uint16_t)(random32() % SAMPLES);
+				s.samples[index] = (uint16_t)(s.samples[index] + 1 + random32() % 1000);
+			}
+			s.publishSequence++;
+			s.polledUs = shard.clockUs;
+			if (!uplinks) onRootPublished(id, shard.clockUs, shard.clockUs);
+		}
+
+		// The root receives a frame, as ServerNode::processShardFrames() handles it.
+		void deliver(const uint8_t* frame, size_t length, Aggregator& root, uint64_t t)
+		{
+			unsigned long nowMs = (unsigned long)(t / 1000);
+			ShardSummaryPacket summary;
+			ShardDeltaPacket delta;
+			if (ShardSummaryCodec::decode(frame, (int)length, summary))
+			{
+				bool restarted;
+				root.onSummary(summary, nowMs, restarted);
+				for (uint8_t id = summary.firstSensorId; id <= summary.lastSensorId; id++) root.owns(summary.shardId, id, nowMs);
+				return;
+			}
+			if (!ShardDeltaCodec::decode(frame, (int)length, delta)) return;
+
+			Aggregator::Action action = root.check(delta, nowMs);
+			if (action == Aggregator::Action::DROP) return;
+			RootSensor& r = rootSensors[delta.sensorId];
+			if (action == Aggregator::Action::START) memcpy(r.back, r.published, FRAME_BYTES);
+			if (!ShardDeltaEncoder::applyRuns(delta.payload, delta.payloadSize, r.back, delta.sampleCount, delta.sampleWidth))
+			{
+				root.onMalformed(delta.sensorId);
+				return;
+			}
+			if (root.onApplied(delta))
+			{
+				memcpy(r.published, r.back, FRAME_BYTES);
+				const Sensor& s = sensors[delta.sensorId];
+				if (memcmp(r.published, s.samples, FRAME_BYTES) != 0) mismatches++;
+				onRootPublished(delta.sensorId, s.polledUs, t);
+			}
+		}
+
+		// Sends a frame to the root. Returns false if it got lost.
+		bool uplinkFrame(Shard& shard, const uint8_t* frame, size_t length, Aggregator& root)
+		{
+			uplinkFrames++;
+			uplinkBytes += length;
+			if (!sendFrame(shard.clockUs, rootChannel, (uint32_t)length, true)) return false;
+			deliver(frame, length, root, shard.clockUs);
+			return true;
+		}
+
+		// The summary and the arrays the root lacks, as ServerNode's UPLINKING state sends them.
+		void uplink(Shard& shard, Aggregator& root)
+		{
+			shard.lastUplinkUs = shard.clockUs;
+			if (shard.channel != rootChannel) shard.clockUs += SWITCH_US;
+
+			uint8_t frame[ShardDeltaCodec::MAX_SIZE];
+			ShardSummaryPacket summary = {};
+			summary.messageType = MessageType::SHARD_SUMMARY;
+			summary.shardId = shard.shardId;
+			summary.cycle = ++shard.cycle;
+			summary.firstSensorId = shard.firstSensorId;
+			summary.lastSensorId = (uint8_t)(shard.firstSensorId + shard.nofSensors - 1);
+			summary.registeredMask = (shard.nofSensors >= 32) ? 0xFFFFFFFF : (((uint32_t)1 << shard.nofSensors) - 1);
+			bool failed = !uplinkFrame(shard, frame, ShardSummaryCodec::encode(summary, frame), root);
+
+			ShardDeltaEncoder encoder;
+			ShardDeltaPacket delta;
+			for (uint8_t i = 0; i < shard.nofSensors; i++)
+			{
+				uint8_t id = shard.firstSensorId + i;
+				Sensor& s = sensors[id];
+				s.uplinkSent = false;
+				s.sinceKeyframe++;
+				bool keyframe = !s.uplinkValid || s.sinceKeyframe >= KEYFRAME_INTERVAL;
+				if (!keyframe && s.uplinkSequence == s.publishSequence) continue;
+				if (keyframe)
+				{
+					s.sinceKeyframe = 0;
+					keyframes++;
+				}
+				encoder.begin(shard.shardId, id, 1, s.publishSequence, s.uplinkSequence, (const uint8_t*)s.samples,
+							  keyframe ? nullptr : (const uint8_t*)s.uplink, SAMPLES, WIDTH);
+				while (encoder.next(delta))
+				{
+					if (!uplinkFrame(shard, frame, ShardDeltaCodec::encode(delta, frame), root)) failed = true;
+				}
+				memcpy(s.uplink, s.samples, FRAME_BYTES);
+				s.uplinkSequence = s.publishSequence;
+				s.uplinkValid = true;
+				s.uplinkSent = true;
+			}
+			if (failed)
+			{
+				for (uint8_t i = 0; i < shard.nofSensors; i++)
+				{
+					if (sensors[shard.firstSensorId + i].uplinkSent) sensors[shard.firstSensorId + i].uplinkValid = false;
+				}
+			}
+			if (shard.channel != rootChannel) shard.clockUs += SWITCH_US;
+		}
+
+		// Returns the mean age, in ms.
+		uint32_t run(uint8_t nofShards, uint8_t perShard, bool withUplinks)
+		{
+			static const uint8_t CHANNELS[MAX_SHARDS] = {1, 5, 9, 13};
+			randomState = 0x9E3779B9;
+			uplinks = withUplinks;
+			rootChannel = CHANNELS[0];
+			memset(ageBins, 0, sizeof(ageBins));
+			memset(channelFreeUs, 0, sizeof(channelFreeUs));
+			nofAges = 0;
+			ageSumMs = 0;
+			polls = 0;
+			timeouts = 0;
+			uplinkFrames = 0;
+			uplinkBytes = 0;
+			rootChannelBusyUs = 0;
+			keyframes = 0;
+			mismatches = 0;
+
+			Aggregator root;
+			for (uint8_t id = 1; id <= MAX_SENSORS; id++)
+			{
+				sensors[id] = {};
+				for (uint16_t i = 0; i < SAMPLES; i++) sensors[id].samples[i] = (uint16_t)random32();
+				rootSensors[id].seen = false;
+			}
+			for (uint8_t n = 0; n < nofShards; n++)
+			{
+				shards[n] = {};
+				shards[n].shardId = n + 1;
+				shards[n].channel = CHANNELS[n];
+				shards[n].firstSensorId = (uint8_t)(1 + n * perShard);
+				shards[n].nofSensors = perShard;
+				shards[n].clockUs = random32() % 10000; // not in lockstep
+			}
+
+			while (true)
+			{
+				uint8_t n = 0;
+				for (uint8_t i = 1; i < nofShards; i++)
+				{
+					if (shards[i].clockUs < shards[n].clockUs) n = i;
+				}
+				Shard& shard = shards[n];
+				if (shard.clockUs >= DURATION_US) break;
+				if (uplinks && shard.clockUs - shard.lastUplinkUs >= UPLINK_INTERVAL_US)
+				{
+					uplink(shard, root);
+				}
+				else
+				{
+					if (shard.next >= shard.nofSensors) shard.next = 0;
+					pollNext(shard);
+				}
+			}
+
+			uint32_t p90 = percentileMs(900);
+			float seconds = DURATION_US / 1e6f;
+			if (uplinks)
+			{
+				ESP_LOGI("ShardScaleSimulation", "%u shard%s x %2u = %3u sensors | age mean %4lu ms, p90 %4lu ms | %6.1f polls/s, %3lu timeouts | "
+						 "uplink %5.0f frames/s, %6.1f kB/s, %4lu keyframes | root channel busy %3.0f%% | %lu mismatches%s",
+						 nofShards, nofShards > 1 ? "s" : " ", perShard, nofShards * perShard,
+						 (unsigned long)(nofAges > 0 ? ageSumMs / nofAges : 0), (unsigned long)p90, polls / seconds,
+						 (unsigned long)timeouts, uplinkFrames / seconds, uplinkBytes / seconds / 1000,
+						 (unsigned long)keyframes, 100.0f * rootChannelBusyUs / DURATION_US, (unsigned long)mismatches,
+						 mismatches ? "  MISMATCHES!" : "");
+			}
+			else
+			{
+				ESP_LOGI("ShardScaleSimulation", "1 server  x %2u = %3u sensors | age mean %4lu ms, p90 %4lu ms | %6.1f polls/s, %3lu timeouts",
+						 perShard, perShard, (unsigned long)(nofAges > 0 ? ageSumMs / nofAges : 0), (unsigned long)p90,
+						 polls / seconds, (unsigned long)timeouts);
+			}
+			return (uint32_t)(nofAges > 0 ? ageSumMs / nofAges : 0);
+		}
+
+		// The most sensors per server that the root (or the single server) can hold.
+		static uint8_t limitPerServer(uint8_t nofShards, bool withUplinks)
+		{
+			uint8_t limit = ROOT_MAX_SENSORS / nofShards;
+			return (withUplinks && limit > MAX_PER_SHARD) ? MAX_PER_SHARD : limit;
+		}
+
+		// The most sensors per server (in steps of 2) whose mean age stays within TARGET_AGE_MS.
+		uint8_t maxSensorsWithinTarget(uint8_t nofShards, bool withUplinks)
+		{
+			uint8_t best = 0;
+			uint8_t limit = limitPerServer(nofShards, withUplinks);
+			for (uint8_t perShard = 2; perShard <= limit; perShard += 2)
+			{
+				if (run(nofShards, perShard, withUplinks) > TARGET_AGE_MS) break;
+				best = perShard;
+			}
+			return best;
+		}
+
+		void runModel(const char* model, uint8_t changes)
+		{
+			changesPerPoll = changes;
+			ESP_LOGI("ShardScaleSimulation", "--- %s ---", model);
+			uint8_t single = maxSensorsWithinTarget(1, false);
+			const char* singleMark = (single + 2 > limitPerServer(1, false)) ? "+" : "";
+			uint8_t totals[MAX_SHARDS];
+			const char* marks[MAX_SHARDS];
+			for (uint8_t n = 1; n <= MAX_SHARDS; n++)
+			{
+				uint8_t perShard = maxSensorsWithinTarget(n, true);
+				totals[n - 1] = (uint8_t)(n * perShard);
+				marks[n - 1] = (perShard + 2 > limitPerServer(n, true)) ? "+" : "";
+			}
+			float base = totals[0] > 0 ? totals[0] : 1;
+			ESP_LOGI("ShardScaleSimulation", "%s: sensors within a mean age of %lu ms: 1 server %u%s; root with 1..4 shards %u%s, %u%s, %u%s, %u%s "
+					 "(%.1fx, %.1fx, %.1fx, %.1fx one shard; %.1fx one server with 4 shards)",
+					 model, (unsigned long)TARGET_AGE_MS, single, singleMark, totals[0], marks[0], totals[1], marks[1],
+					 totals[2], marks[2], totals[3], marks[3],
+					 totals[0] / base, totals[1] / base, totals[2] / base, totals[3] / base,
+					 single > 0 ? (float)totals[3] / single : 0.0f);
+		}
+
+	public:
+		ShardScaleSimulation() : randomState(1), changesPerPoll(SAMPLES), uplinks(false), rootChannel(1), nofAges(0), ageSumMs(0),
+								 polls(0), timeouts(0), uplinkFrames(0), uplinkBytes(0), rootChannelBusyUs(0), keyframes(0), mismatches(0)
+		{
+		}
+
+		void run()
+		{
+			ESP_LOGI("ShardScaleSimulation", "%u samples of %u bytes per sensor, %lu s per run, shards on channels 1, 5, 9, 13, root on 1",
+					 SAMPLES, WIDTH, (unsigned long)(DURATION_US / 1000000));
+			runModel("all samples change", SAMPLES);
+			runModel("10% of the samples change", SAMPLES / 10);
+			ESP_LOGI("ShardScaleSimulation", "ShardScaleSimulation done");
+		}
+	}; // end class ShardScaleSimulation
+
+} // end namespace crt
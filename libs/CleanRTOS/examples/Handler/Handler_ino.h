@@ -37,4 +37,4 @@ void setup()
 void loop()
 {
 	vTaskDelay(1);// Nothing to do in loop - all example code runs in the 4 threads above.
-}3
\ No newline at end of file
+}
\ No newline at end of file
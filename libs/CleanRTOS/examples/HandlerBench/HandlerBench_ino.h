@@ -0,0 +1,54 @@
+// by Marius Versteegen, 2025
+
+#include <crt_CleanRTOS.h>        // This file includes crt_Config.h  You'll need to change defines there for a release build.
+
+// All Tasks should be created in this main file.
+#include <crt_Handler.h>
+#include "crt_HandlerBench.h"
+namespace crt
+{
+	MainInits mainInits;            // Initialize CleanRTOS.
+
+	// One Handler for listeners of 5 to 250 ms. Its own period is only the default for addHandlerListener(pListener).
+	Handler<13 /*MAXLISTENERCOUNT*/> benchHandler("BenchHandler", 2 /*priority*/, ARDUINO_RUNNING_CORE, 10 /*periodMs*/);
+	HandlerBenchReporter<Handler<13>, 13> handlerBenchReporter("HandlerBenchReporter", 2 /*priority*/, 4000 /*stackBytes*/, ARDUINO_RUNNING_CORE, benchHandler);
+
+	HandlerBenchListener btn1("btn1", benchHandler, 5 /*periodMs*/, 0 /*phaseMs*/);
+	HandlerBenchListener btn2("btn2", benchHandler, 5 /*periodMs*/, 1 /*phaseMs*/);
+	HandlerBenchListener btn3("btn3", benchHandler, 5 /*periodMs*/, 2 /*phaseMs*/);
+	HandlerBenchListener btn4("btn4", benchHandler, 5 /*periodMs*/, 3 /*phaseMs*/);
+	HandlerBenchListener led1("led1", benchHandler, 10 /*periodMs*/, 0 /*phaseMs*/);
+	HandlerBenchListener led2("led2", benchHandler, 10 /*periodMs*/, 5 /*phaseMs*/);
+	HandlerBenchListener disp1("disp1", benchHandler, 20 /*periodMs*/, 7 /*phaseMs*/);
+	HandlerBenchListener disp2("disp2", benchHandler, 20 /*periodMs*/, 17 /*phaseMs*/);
+	HandlerBenchListener scale1("scale1", benchHandler, 70 /*periodMs*/, 11 /*phaseMs*/);
+	HandlerBenchListener scale2("scale2", benchHandler, 70 /*periodMs*/, 46 /*phaseMs*/);
+	HandlerBenchListener log("log", benchHandler, 100 /*periodMs*/, 13 /*phaseMs*/);
+	HandlerBenchListener wifi("wifi", benchHandler, 250 /*periodMs*/, 29 /*phaseMs*/);
+	HandlerBenchListener late("late", 10 /*periodMs*/);	// Added by the reporter, after the Handler has started.
+}
+
+void setup()
+{
+	crt::handlerBenchReporter.addListener(crt::btn1);
+	crt::handlerBenchReporter.addListener(crt::btn2);
+	crt::handlerBenchReporter.addListener(crt::btn3);
+	crt::handlerBenchReporter.addListener(crt::btn4);
+	crt::handlerBenchReporter.addListener(crt::led1);
+	crt::handlerBenchReporter.addListener(crt::led2);
+	crt::handlerBenchReporter.addListener(crt::disp1);
+	crt::handlerBenchReporter.addListener(crt::disp2);
+	crt::handlerBenchReporter.addListener(crt::scale1);
+	crt::handlerBenchReporter.addListener(crt::scale2);
+	crt::handlerBenchReporter.addListener(crt::log);
+	crt::handlerBenchReporter.addListener(crt::wifi);
+	crt::handlerBenchReporter.addLateListener(crt::late);
+	crt::benchHandler.start();  // IMPORTANT NOTE! a Handler task needs to be started manually,
+								// AFTER its listeners have been added or have added themselves to the handler.
+	ESP_LOGI("checkpoint", "start of main");
+}
+
+void loop()
+{
+	vTaskDelay(1);// Nothing to do in loop - all example code runs in the tasks above.
+}
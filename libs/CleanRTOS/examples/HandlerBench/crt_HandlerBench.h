@@ -0,0 +1,125 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <crt_CleanRTOS.h>
+#include <crt_Handler.h>
+
+// This file measures the CPU use and jitter of a single Handler that updates listeners with
+// different periods: like a 5 ms button debouncer and a 70 ms weight scale, in the same task.
+// Every listener works WORK_US per update(). The listeners of the same period get different
+// phases, to spread them. After RUN_MS, the HandlerBenchReporter logs the statistics per
+// listener and of the Handler as a whole.
+// One listener is only added by the HandlerBenchReporter, while the Handler is running already.
+// It must get its updates, and no listener may get more updates than its period allows.
+
+namespace crt
+{
+	class HandlerBenchListener : public IHandlerListener
+	{
+	public:
+		static const int64_t WORK_US = 20;
+
+	private:
+		const char* listenerName;
+		uint32_t periodMs;
+
+	public:
+		HandlerBenchListener(const char* listenerName, IHandler& handler, uint32_t periodMs, uint32_t phaseMs) :
+			listenerName(listenerName), periodMs(periodMs)
+		{
+			handler.addHandlerListener(this, periodMs, phaseMs);
+		}
+
+		// Not added to a Handler yet.
+		HandlerBenchListener(const char* listenerName, uint32_t periodMs) :
+			listenerName(listenerName), periodMs(periodMs)
+		{}
+
+		const char* getName()
+		{
+			return listenerName;
+		}
+
+		uint32_t getPeriodMs()
+		{
+			return periodMs;
+		}
+
+		/*override keyword not supported in current compiler*/
+		void update()
+		{
+			int64_t startUs = esp_timer_get_time();
+			while (esp_timer_get_time() - startUs < WORK_US) {}
+		}
+	}; // end class HandlerBenchListener
+
+	template<typename HANDLER, unsigned int LISTENERCOUNT> class HandlerBenchReporter : public Task
+	{
+	public:
+		static const uint32_t RUN_MS = 2000;
+
+	private:
+		HANDLER& handler;
+		HandlerBenchListener* listeners[LISTENERCOUNT];
+		uint32_t nofListeners;
+		HandlerBenchListener* pLateListener;
+
+	public:
+		HandlerBenchReporter(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			HANDLER& handler) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), handler(handler), nofListeners(0), pLateListener(nullptr)
+		{
+			start();
+		}
+
+		void addListener(HandlerBenchListener& listener)
+		{
+			assert(nofListeners < LISTENERCOUNT);
+			listeners[nofListeners++] = &listener;
+		}
+
+		// listener is added to the Handler after it has started.
+		void addLateListener(HandlerBenchListener& listener)
+		{
+			addListener(listener);
+			pLateListener = &listener;
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			vTaskDelay(1000); // wait for the Handler to have started up as well.
+			if (pLateListener != nullptr)
+			{
+				handler.addHandlerListener(pLateListener, pLateListener->getPeriodMs(), 0);
+			}
+			handler.resetStats();
+			vTaskDelay(RUN_MS);
+
+			HandlerStats handlerStats = handler.getHandlerStats();
+			uint32_t expectedUpdates = 0;
+			uint32_t updates = 0;
+			for (uint32_t i = 0; i < nofListeners; i++)
+			{
+				HandlerListenerStats stats = handler.getListenerStats(listeners[i]);
+				ESP_LOGI("HandlerBench", "%-6s period: %3" PRIu32 " ms  updates: %4" PRIu32 "  overruns: %" PRIu32 "  lateness avg: %4" PRIu32 " us  max: %5" PRIu32 " us",
+					listeners[i]->getName(), listeners[i]->getPeriodMs(), stats.updates, stats.overruns,
+					(uint32_t)(stats.updates ? stats.totalLatenessUs / stats.updates : 0), (uint32_t)stats.maxLatenessUs);
+				expectedUpdates += RUN_MS / listeners[i]->getPeriodMs();
+				updates += stats.updates;
+				assert(stats.updates > 0);
+				assert(stats.updates <= RUN_MS / listeners[i]->getPeriodMs() + 2);	// Not scheduled twice.
+			}
+			ESP_LOGI("HandlerBench", "Handler: updates: %" PRIu32 " (%" PRIu32 " expected)  wake-ups: %" PRIu32 "  CPU: %.2f%% (of which in update(): %.2f%%)",
+				updates, expectedUpdates, handlerStats.wakeUps, 100.0 * handlerStats.activeUs / handlerStats.elapsedUs,
+				100.0 * updates * HandlerBenchListener::WORK_US / handlerStats.elapsedUs);
+			ESP_LOGI("HandlerBench", "HandlerBench done");
+
+			while (true)
+			{
+				vTaskDelay(1000);
+			}
+		}
+	}; // end class HandlerBenchReporter
+};// end namespace crt
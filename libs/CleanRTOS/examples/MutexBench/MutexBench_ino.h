@@ -0,0 +1,50 @@
+// by Marius Versteegen, 2025
+
+#include <crt_CleanRTOS.h>        // This file includes crt_Config.h  You'll need to change defines there for a release build.
+#include <crt_Mutex.h>            // crt_Mutex.h must be included separately.
+
+// All Tasks should be created in this main file.
+#include "crt_MutexBench.h"
+namespace crt
+{
+	MainInits mainInits;            // Initialize CleanRTOS.
+
+	// The runners have the highest priority, such that they can stop the others in time.
+	MutexBenchController mutexBenchController("MutexBenchController", 3 /*priority*/, 4000 /*stackBytes*/, ARDUINO_RUNNING_CORE);
+
+	typedef MutexBenchRunner<SpinLocking> SpinRunner;
+	SpinRunner spinRunner("SpinRunner", 3, 4000, ARDUINO_RUNNING_CORE, mutexBenchController);
+	MutexBenchBackground<SpinRunner> spinBackground("SpinBackground", 1, 4000, ARDUINO_RUNNING_CORE, spinRunner);
+	MutexBenchWorker<SpinRunner> spinWorker1("SpinW1", 2, 4000, ARDUINO_RUNNING_CORE, spinRunner);
+	MutexBenchWorker<SpinRunner> spinWorker2("SpinW2", 2, 4000, ARDUINO_RUNNING_CORE, spinRunner);
+	MutexBenchWorker<SpinRunner> spinWorker3("SpinW3", 2, 4000, ARDUINO_RUNNING_CORE, spinRunner);
+	MutexBenchWorker<SpinRunner> spinWorker4("SpinW4", 2, 4000, ARDUINO_RUNNING_CORE, spinRunner);
+	MutexBenchWorker<SpinRunner> spinWorker5("SpinW5", 2, 4000, ARDUINO_RUNNING_CORE, spinRunner);
+	MutexBenchWorker<SpinRunner> spinWorker6("SpinW6", 2, 4000, ARDUINO_RUNNING_CORE, spinRunner);
+	MutexBenchWorker<SpinRunner> spinWorker7("SpinW7", 2, 4000, ARDUINO_RUNNING_CORE, spinRunner);
+	MutexBenchWorker<SpinRunner> spinWorker8("SpinW8", 2, 4000, ARDUINO_RUNNING_CORE, spinRunner);
+
+	typedef MutexBenchRunner<BlockLocking> BlockRunner;
+	BlockRunner blockRunner("BlockRunner", 3, 4000, ARDUINO_RUNNING_CORE, mutexBenchController);
+	MutexBenchBackground<BlockRunner> blockBackground("BlockBackground", 1, 4000, ARDUINO_RUNNING_CORE, blockRunner);
+	MutexBenchWorker<BlockRunner> blockWorker1("BlockW1", 2, 4000, ARDUINO_RUNNING_CORE, blockRunner);
+	MutexBenchWorker<BlockRunner> blockWorker2("BlockW2", 2, 4000, ARDUINO_RUNNING_CORE, blockRunner);
+	MutexBenchWorker<BlockRunner> blockWorker3("BlockW3", 2, 4000, ARDUINO_RUNNING_CORE, blockRunner);
+	MutexBenchWorker<BlockRunner> blockWorker4("BlockW4", 2, 4000, ARDUINO_RUNNING_CORE, blockRunner);
+	MutexBenchWorker<BlockRunner> blockWorker5("BlockW5", 2, 4000, ARDUINO_RUNNING_CORE, blockRunner);
+	MutexBenchWorker<BlockRunner> blockWorker6("BlockW6", 2, 4000, ARDUINO_RUNNING_CORE, blockRunner);
+	MutexBenchWorker<BlockRunner> blockWorker7("BlockW7", 2, 4000, ARDUINO_RUNNING_CORE, blockRunner);
+	MutexBenchWorker<BlockRunner> blockWorker8("BlockW8", 2, 4000, ARDUINO_RUNNING_CORE, blockRunner);
+}
+
+void setup()
+{
+	crt::mutexBenchController.addBench(crt::spinRunner);
+	crt::mutexBenchController.addBench(crt::blockRunner);
+	ESP_LOGI("checkpoint", "start of main");
+}
+
+void loop()
+{
+	vTaskDelay(1);// Nothing to do in loop - all example code runs in the tasks above.
+}
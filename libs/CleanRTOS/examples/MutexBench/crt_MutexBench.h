@@ -0,0 +1,297 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <atomic>
+#include <crt_CleanRTOS.h>
+#include <crt_Mutex.h>
+
+// This file compares a spinning lock with the blocking Mutex, for 2, 4 and 8 tasks that contend for it.
+// Every worker task locks the lock, holds it for HOLD_US, unlocks it, and works WORK_US outside of it,
+// for RUN_US per step. Meanwhile, a background task of a lower priority counts how often it gets to run.
+//  - spin:  SimpleMutex, which retries with taskYIELD() (like Mutex did before).
+//  - block: Mutex, which blocks until the lock is released, with priority inheritance.
+// It logs the locks per second, the background loops per second (the CPU time left for other tasks),
+// and, for the Mutex, its statistics.
+// The MutexBenchController runs the benches one after the other.
+
+namespace crt
+{
+	// Waits actively, like a task that does some work.
+	inline void busyFor(int64_t us)
+	{
+		int64_t startUs = esp_timer_get_time();
+		while (esp_timer_get_time() - startUs < us) {}
+	}
+
+	struct SpinLocking
+	{
+		static const bool HAS_STATS = false;
+		static const char* name() { return "spin"; }
+		SimpleMutex simpleMutex;
+
+		void lock(Task* /*pTask*/) { simpleMutex.lock(); }
+		void unlock(Task* /*pTask*/) { simpleMutex.unlock(); }
+		MutexStats getStats() { return MutexStats(); }
+		void resetStats() {}
+	};
+
+	struct BlockLocking
+	{
+		static const bool HAS_STATS = true;
+		static const char* name() { return "block"; }
+		Mutex mutex;
+
+		BlockLocking() : mutex(1) {}
+		void lock(Task* pTask) { mutex.lock(pTask); }
+		void unlock(Task* pTask) { mutex.unlock(pTask); }
+		MutexStats getStats() { return mutex.getStats(); }
+		void resetStats() { mutex.resetStats(); }
+	};
+
+	class IMutexBenchTask
+	{
+	public:
+		virtual void go() = 0;
+	};
+
+	class IMutexBench
+	{
+	public:
+		virtual void run() = 0;
+	};
+
+	class IMutexBenchListener
+	{
+	public:
+		virtual void benchDone() = 0;
+	};
+
+	template<typename LOCKING> class MutexBenchRunner : public Task, public IMutexBench
+	{
+	public:
+		static const uint32_t MAX_WORKERS = 8;
+		static const int64_t RUN_US = 200000;
+		static const int64_t HOLD_US = 5;
+		static const int64_t WORK_US = 20;
+
+	private:
+		LOCKING locking;
+		Flag flagRun;
+		Queue<uint32_t, MAX_WORKERS + 1> queueCounts;	// the counts of the workers and the background task
+		::std::atomic<bool> bRunning;
+		IMutexBenchListener& listener;
+		IMutexBenchTask* workers[MAX_WORKERS];
+		uint32_t nofWorkers;
+		IMutexBenchTask* pBackground;
+
+	public:
+		MutexBenchRunner(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			IMutexBenchListener& listener) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagRun(this), queueCounts(this), bRunning(false),
+			listener(listener), nofWorkers(0), pBackground(nullptr)
+		{
+			start();
+		}
+
+		void addWorker(IMutexBenchTask* pWorker)
+		{
+			assert(nofWorkers < MAX_WORKERS);
+			workers[nofWorkers++] = pWorker;
+		}
+
+		void setBackground(IMutexBenchTask* pBackground)
+		{
+			this->pBackground = pBackground;
+		}
+
+		// Called by the workers.
+		void lockedWork(Task* pTask)
+		{
+			locking.lock(pTask);
+			busyFor(HOLD_US);
+			locking.unlock(pTask);
+		}
+
+		bool isRunning()
+		{
+			return bRunning.load(::std::memory_order_relaxed);
+		}
+
+		void done(uint32_t count)
+		{
+			queueCounts.write(count);
+		}
+
+		// Called by the controller.
+		void run()
+		{
+			flagRun.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			uint32_t count;
+			while (true)
+			{
+				wait(flagRun);
+				for (uint32_t n = 2; n <= nofWorkers; n *= 2)
+				{
+					locking.resetStats();
+					bRunning = true;
+					pBackground->go();
+					for (uint32_t i = 0; i < n; i++) workers[i]->go();
+					vTaskDelay(pdMS_TO_TICKS(RUN_US / 1000));
+					bRunning = false;
+
+					uint32_t locks = 0;
+					for (uint32_t i = 0; i < n; i++)
+					{
+						queueCounts.read(count);
+						locks += count;
+					}
+					uint32_t backgroundLoops;
+					queueCounts.read(backgroundLoops);	// The background task has the lowest priority, so it ends last.
+
+					ESP_LOGI("MutexBench", "%-5s tasks: %" PRIu32 "  locks/s: %7" PRIu32 "  background loops/s: %7" PRIu32,
+						LOCKING::name(), n, (uint32_t)((uint64_t)locks * 1000000 / RUN_US),
+						(uint32_t)((uint64_t)backgroundLoops * 1000000 / RUN_US));
+					if (LOCKING::HAS_STATS)
+					{
+						MutexStats stats = locking.getStats();
+						ESP_LOGI("MutexBench", "%-5s tasks: %" PRIu32 "  contended: %3" PRIu32 "%%  wait avg: %5" PRIu32 " us  max: %6" PRIu32 " us  max hold: %5" PRIu32 " us",
+							LOCKING::name(), n, stats.contendedAcquisitions * 100 / stats.acquisitions,
+							(uint32_t)(stats.contendedAcquisitions ? stats.totalWaitUs / stats.contendedAcquisitions : 0),
+							(uint32_t)stats.maxWaitUs, (uint32_t)stats.maxHoldUs);
+					}
+				}
+				listener.benchDone();
+			}
+		}
+	}; // end class MutexBenchRunner
+
+	template<typename RUNNER> class MutexBenchWorker : public Task, public IMutexBenchTask
+	{
+	private:
+		Flag flagGo;
+		RUNNER& runner;
+
+	public:
+		MutexBenchWorker(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			RUNNER& runner) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagGo(this), runner(runner)
+		{
+			runner.addWorker(this);
+			start();
+		}
+
+		void go()
+		{
+			flagGo.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			while (true)
+			{
+				wait(flagGo);
+				uint32_t count = 0;
+				while (runner.isRunning())
+				{
+					runner.lockedWork(this);
+					busyFor(RUNNER::WORK_US);
+					count++;
+				}
+				runner.done(count);
+			}
+		}
+	}; // end class MutexBenchWorker
+
+	// Runs at a lower priority than the workers, and counts how often it gets to run.
+	template<typename RUNNER> class MutexBenchBackground : public Task, public IMutexBenchTask
+	{
+	private:
+		Flag flagGo;
+		RUNNER& runner;
+
+	public:
+		MutexBenchBackground(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			RUNNER& runner) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagGo(this), runner(runner)
+		{
+			runner.setBackground(this);
+			start();
+		}
+
+		void go()
+		{
+			flagGo.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			while (true)
+			{
+				wait(flagGo);
+				uint32_t count = 0;
+				while (runner.isRunning())
+				{
+					busyFor(RUNNER::WORK_US);
+					count++;
+				}
+				runner.done(count);
+			}
+		}
+	}; // end class MutexBenchBackground
+
+	class MutexBenchController : public Task, public IMutexBenchListener
+	{
+	private:
+		static const uint32_t MAX_BENCHES = 4;
+		Flag flagDone;
+		IMutexBench* benches[MAX_BENCHES];
+		uint32_t nofBenches;
+
+	public:
+		MutexBenchController(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagDone(this), nofBenches(0)
+		{
+			start();
+		}
+
+		void addBench(IMutexBench& bench)
+		{
+			assert(nofBenches < MAX_BENCHES);
+			benches[nofBenches++] = &bench;
+		}
+
+		void benchDone()
+		{
+			flagDone.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			vTaskDelay(1000); // wait for other threads to have started up as well.
+
+			for (uint32_t i = 0; i < nofBenches; i++)
+			{
+				benches[i]->run();
+				wait(flagDone);
+			}
+			ESP_LOGI("MutexBench", "MutexBench done");
+
+			while (true)
+			{
+				vTaskDelay(1000);
+			}
+		}
+	}; // end class MutexBenchController
+};// end namespace crt
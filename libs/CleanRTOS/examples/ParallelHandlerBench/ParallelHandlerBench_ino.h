@@ -0,0 +1,33 @@
+// by Marius Versteegen, 2025
+
+#include <crt_CleanRTOS.h>        // This file includes crt_Config.h  You'll need to change defines there for a release build.
+
+// All Tasks should be created in this main file.
+#include <crt_Handler.h>
+#include <crt_ParallelHandler.h>
+#include "crt_ParallelHandlerBench.h"
+namespace crt
+{
+	MainInits mainInits;            // Initialize CleanRTOS.
+
+	// 100 listeners, plus the one that is added late.
+	Handler<101 /*MAXLISTENERCOUNT*/> singleHandler("SingleHandler", 2 /*priority*/, ARDUINO_RUNNING_CORE, 10 /*periodMs*/);
+	ParallelHandler<101 /*MAXLISTENERCOUNT*/> parallelHandler("ParallelHandler", 2 /*priority*/, 10 /*periodMs*/);
+
+	ParallelHandlerBenchGroup<Handler<101>, 100> singleGroup("Handler", singleHandler);
+	ParallelHandlerBenchGroup<ParallelHandler<101>, 100> parallelGroup("ParallelHandler", parallelHandler);
+
+	// The controller has the highest priority, such that it can stop the steps in time.
+	ParallelHandlerBenchController parallelHandlerBenchController("ParallelHandlerBenchController", 3 /*priority*/, 4000 /*stackBytes*/, ARDUINO_RUNNING_CORE,
+		singleGroup, parallelGroup);
+}
+
+void setup()
+{
+	ESP_LOGI("checkpoint", "start of main");
+}
+
+void loop()
+{
+	vTaskDelay(1);// Nothing to do in loop - all example code runs in the tasks above.
+}
@@ -0,0 +1,194 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <atomic>
+#include <crt_CleanRTOS.h>
+#include <crt_Handler.h>
+#include <crt_ParallelHandler.h>
+
+// This file compares a ParallelHandler with a single Handler, for 10, 50 and 100 listeners.
+// Every listener has a period of PERIOD_MS and works WORK_US per update(), so 100 listeners
+// need 1.5 cores. Both schedulers get MAXLISTENERS listeners up front; only the first
+// nofActive of them do their work, the others return from update() at once.
+// Per step, the ParallelHandlerBenchController logs the updates per second (and how many
+// were expected), the worst lateness of an update, and the overruns. For the ParallelHandler,
+// it also logs per worker how many updates it ran, how many of those it stole, and how busy it was.
+// Each scheduler also gets one listener more while it is running already. It must get its
+// updates, and no more than its period allows.
+
+namespace crt
+{
+	inline void busyFor(int64_t us)
+	{
+		int64_t startUs = esp_timer_get_time();
+		while (esp_timer_get_time() - startUs < us) {}
+	}
+
+	class ParallelHandlerBenchListener : public IHandlerListener
+	{
+	public:
+		static const uint32_t PERIOD_MS = 10;
+		static const int64_t WORK_US = 150;
+
+	private:
+		uint32_t index;
+		::std::atomic<uint32_t>* pNofActive;
+
+	public:
+		ParallelHandlerBenchListener() : index(0), pNofActive(nullptr)
+		{}
+
+		void init(IHandler& handler, uint32_t index, ::std::atomic<uint32_t>& nofActive)
+		{
+			this->index = index;
+			pNofActive = &nofActive;
+			handler.addHandlerListener(this, PERIOD_MS, index % PERIOD_MS /*phaseMs*/);
+		}
+
+		/*override keyword not supported in current compiler*/
+		void update()
+		{
+			if (index < pNofActive->load(::std::memory_order_relaxed))
+			{
+				busyFor(WORK_US);
+			}
+		}
+	}; // end class ParallelHandlerBenchListener
+
+	// A single Handler has no workers to report on.
+	template<unsigned int MAXLISTENERCOUNT> void logWorkerStats(Handler<MAXLISTENERCOUNT>& handler)
+	{}
+
+	template<unsigned int MAXLISTENERCOUNT> void logWorkerStats(ParallelHandler<MAXLISTENERCOUNT>& handler)
+	{
+		for (uint32_t i = 0; i < ParallelHandler<MAXLISTENERCOUNT>::NOFWORKERS; i++)
+		{
+			ParallelHandlerWorkerStats stats = handler.getWorkerStats(i);
+			ESP_LOGI("ParallelHandlerBench", "                worker %" PRIu32 ": updates: %5" PRIu32 "  steals: %5" PRIu32 "  busy: %3" PRIu32 "%%",
+				i, stats.updates, stats.steals, (uint32_t)(stats.activeUs * 100 / stats.elapsedUs));
+		}
+	}
+
+	class IParallelHandlerBenchGroup
+	{
+	public:
+		virtual const char* getName() = 0;
+		virtual void setNofActive(uint32_t nofActive) = 0;
+		virtual void addLateListener() = 0;
+		virtual void resetStats() = 0;
+		virtual void logStats(uint32_t runMs) = 0;
+	};
+
+	template<typename HANDLER, uint32_t MAXLISTENERS> class ParallelHandlerBenchGroup : public IParallelHandlerBenchGroup
+	{
+	private:
+		const char* name;
+		HANDLER& handler;
+		ParallelHandlerBenchListener listeners[MAXLISTENERS];
+		ParallelHandlerBenchListener lateListener;	// Added after the handler has started.
+		::std::atomic<uint32_t> nofActive;
+
+	public:
+		ParallelHandlerBenchGroup(const char* name, HANDLER& handler) : name(name), handler(handler), nofActive(0)
+		{
+			for (uint32_t i = 0; i < MAXLISTENERS; i++)
+			{
+				listeners[i].init(handler, i, nofActive);
+			}
+		}
+
+		const char* getName()
+		{
+			return name;
+		}
+
+		void setNofActive(uint32_t nofActive)
+		{
+			this->nofActive = nofActive;
+		}
+
+		// The late listener works like the first listener, so in every step.
+		void addLateListener()
+		{
+			lateListener.init(handler, 0, nofActive);
+		}
+
+		void resetStats()
+		{
+			handler.resetStats();
+		}
+
+		void logStats(uint32_t runMs)
+		{
+			uint32_t updates = 0;
+			uint32_t overruns = 0;
+			int64_t maxLatenessUs = 0;
+			for (uint32_t i = 0; i < nofActive; i++)
+			{
+				HandlerListenerStats stats = handler.getListenerStats(&listeners[i]);
+				updates += stats.updates;
+				overruns += stats.overruns;
+				if (stats.maxLatenessUs > maxLatenessUs) maxLatenessUs = stats.maxLatenessUs;
+			}
+			ESP_LOGI("ParallelHandlerBench", "%-15s listeners: %3" PRIu32 "  updates/s: %5" PRIu32 " (%5" PRIu32 " expected)  max lateness: %6" PRIu32 " us  overruns: %" PRIu32,
+				name, (uint32_t)nofActive, updates * 1000 / runMs, (uint32_t)nofActive * 1000 / ParallelHandlerBenchListener::PERIOD_MS,
+				(uint32_t)maxLatenessUs, overruns);
+			logWorkerStats(handler);
+
+			HandlerListenerStats lateStats = handler.getListenerStats(&lateListener);
+			ESP_LOGI("ParallelHandlerBench", "                late listener: updates: %5" PRIu32, lateStats.updates);
+			assert(lateStats.updates > 0);
+			assert(lateStats.updates <= runMs / ParallelHandlerBenchListener::PERIOD_MS + 2);	// Not scheduled twice.
+		}
+	}; // end class ParallelHandlerBenchGroup
+
+	class ParallelHandlerBenchController : public Task
+	{
+	public:
+		static const uint32_t RUN_MS = 1000;
+
+	private:
+		IParallelHandlerBenchGroup& singleGroup;
+		IParallelHandlerBenchGroup& parallelGroup;
+
+	public:
+		ParallelHandlerBenchController(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			IParallelHandlerBenchGroup& singleGroup, IParallelHandlerBenchGroup& parallelGroup) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), singleGroup(singleGroup), parallelGroup(parallelGroup)
+		{
+			start();
+		}
+
+	private:
+		void runStep(IParallelHandlerBenchGroup& group, uint32_t nofActive)
+		{
+			group.setNofActive(nofActive);
+			vTaskDelay(100);	// Let the load settle.
+			group.resetStats();
+			vTaskDelay(RUN_MS);
+			group.logStats(RUN_MS);
+			group.setNofActive(0);
+		}
+
+		/*override keyword not supported*/
+		void main()
+		{
+			vTaskDelay(1000); // wait for the handlers to have started up as well.
+			singleGroup.addLateListener();
+			parallelGroup.addLateListener();
+
+			const uint32_t nofActives[] = { 10, 50, 100 };
+			for (uint32_t i = 0; i < sizeof(nofActives) / sizeof(nofActives[0]); i++)
+			{
+				runStep(singleGroup, nofActives[i]);
+				runStep(parallelGroup, nofActives[i]);
+			}
+			ESP_LOGI("ParallelHandlerBench", "ParallelHandlerBench done");
+
+			while (true)
+			{
+				vTaskDelay(1000);
+			}
+		}
+	}; // end class ParallelHandlerBenchController
+};// end namespace crt
@@ -0,0 +1,63 @@
+// by Marius Versteegen, 2025
+
+#include <crt_CleanRTOS.h>        // This file includes crt_Config.h  You'll need to change defines there for a release build.
+
+// All Tasks should be created in this main file.
+#include "crt_PoolBench.h"
+namespace crt
+{
+	MainInits mainInits;            // Initialize CleanRTOS.
+
+	PoolBenchController poolBenchController("PoolBenchController", 2 /*priority*/, 4000 /*stackBytes*/, ARDUINO_RUNNING_CORE);
+
+	// A small T, like the ball position of the pong app, and a large one.
+	typedef PoolBenchData<4> SmallData;
+	typedef PoolBenchData<64> LargeData;
+
+	typedef PoolBenchWriter<Pool<SmallData, PoolMutex>, SmallData> MutexWriter;
+	MutexWriter mutexWriter("Mutex", 2, 4000, ARDUINO_RUNNING_CORE, "PoolMutex", poolBenchController);
+	PoolBenchReader<MutexWriter, SmallData> mutexReader1("MutexR1", 2, 4000, ARDUINO_RUNNING_CORE, mutexWriter);
+	PoolBenchReader<MutexWriter, SmallData> mutexReader2("MutexR2", 2, 4000, ARDUINO_RUNNING_CORE, mutexWriter);
+	PoolBenchReader<MutexWriter, SmallData> mutexReader3("MutexR3", 2, 4000, ARDUINO_RUNNING_CORE, mutexWriter);
+	PoolBenchReader<MutexWriter, SmallData> mutexReader4("MutexR4", 2, 4000, ARDUINO_RUNNING_CORE, mutexWriter);
+
+	typedef PoolBenchWriter<Pool<SmallData, PoolSeqLock>, SmallData> SeqLockWriter;
+	SeqLockWriter seqLockWriter("SeqLock", 2, 4000, ARDUINO_RUNNING_CORE, "PoolSeqLock", poolBenchController);
+	PoolBenchReader<SeqLockWriter, SmallData> seqLockReader1("SeqLockR1", 2, 4000, ARDUINO_RUNNING_CORE, seqLockWriter);
+	PoolBenchReader<SeqLockWriter, SmallData> seqLockReader2("SeqLockR2", 2, 4000, ARDUINO_RUNNING_CORE, seqLockWriter);
+	PoolBenchReader<SeqLockWriter, SmallData> seqLockReader3("SeqLockR3", 2, 4000, ARDUINO_RUNNING_CORE, seqLockWriter);
+	PoolBenchReader<SeqLockWriter, SmallData> seqLockReader4("SeqLockR4", 2, 4000, ARDUINO_RUNNING_CORE, seqLockWriter);
+
+	typedef PoolBenchWriter<Pool<LargeData, PoolMutex>, LargeData> MutexLargeWriter;
+	MutexLargeWriter mutexLargeWriter("MutexLarge", 2, 4000, ARDUINO_RUNNING_CORE, "PoolMutex", poolBenchController);
+	PoolBenchReader<MutexLargeWriter, LargeData> mutexLargeReader1("MutexLargeR1", 2, 4000, ARDUINO_RUNNING_CORE, mutexLargeWriter);
+	PoolBenchReader<MutexLargeWriter, LargeData> mutexLargeReader2("MutexLargeR2", 2, 4000, ARDUINO_RUNNING_CORE, mutexLargeWriter);
+	PoolBenchReader<MutexLargeWriter, LargeData> mutexLargeReader3("MutexLargeR3", 2, 4000, ARDUINO_RUNNING_CORE, mutexLargeWriter);
+	PoolBenchReader<MutexLargeWriter, LargeData> mutexLargeReader4("MutexLargeR4", 2, 4000, ARDUINO_RUNNING_CORE, mutexLargeWriter);
+
+	typedef PoolBenchWriter<Pool<LargeData, PoolSeqLock>, LargeData> SeqLockLargeWriter;
+	SeqLockLargeWriter seqLockLargeWriter("SeqLockLarge", 2, 4000, ARDUINO_RUNNING_CORE, "PoolSeqLock", poolBenchController);
+	PoolBenchReader<SeqLockLargeWriter, LargeData> seqLockLargeReader1("SeqLockLargeR1", 2, 4000, ARDUINO_RUNNING_CORE, seqLockLargeWriter);
+	PoolBenchReader<SeqLockLargeWriter, LargeData> seqLockLargeReader2("SeqLockLargeR2", 2, 4000, ARDUINO_RUNNING_CORE, seqLockLargeWriter);
+	PoolBenchReader<SeqLockLargeWriter, LargeData> seqLockLargeReader3("SeqLockLargeR3", 2, 4000, ARDUINO_RUNNING_CORE, seqLockLargeWriter);
+	PoolBenchReader<SeqLockLargeWriter, LargeData> seqLockLargeReader4("SeqLockLargeR4", 2, 4000, ARDUINO_RUNNING_CORE, seqLockLargeWriter);
+
+	typedef PoolBenchWriter<Pool<LargeData, PoolTripleBuffer>, LargeData> TripleLargeWriter;
+	TripleLargeWriter tripleLargeWriter("TripleLarge", 2, 4000, ARDUINO_RUNNING_CORE, "PoolTripleBuffer", poolBenchController);
+	PoolBenchReader<TripleLargeWriter, LargeData> tripleLargeReader1("TripleLargeR1", 2, 4000, ARDUINO_RUNNING_CORE, tripleLargeWriter);
+}
+
+void setup()
+{
+	crt::poolBenchController.addBench(crt::mutexWriter);
+	crt::poolBenchController.addBench(crt::seqLockWriter);
+	crt::poolBenchController.addBench(crt::mutexLargeWriter);
+	crt::poolBenchController.addBench(crt::seqLockLargeWriter);
+	crt::poolBenchController.addBench(crt::tripleLargeWriter);
+	ESP_LOGI("checkpoint", "start of main");
+}
+
+void loop()
+{
+	vTaskDelay(1);// Nothing to do in loop - all example code runs in the tasks above.
+}
@@ -0,0 +1,244 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <atomic>
+#include <crt_CleanRTOS.h>
+
+// This file compares the Pool policies under contention: one writer task writes as fast as it can,
+// while 1 to 4 reader tasks read as fast as they can, for RUN_US each.
+// It measures the reads and writes per second, the longest read, and counts torn reads (a read
+// that returns half of one write and half of another), which must stay 0.
+// PoolTripleBuffer allows a single reader only, so its bench stops at 1 reader.
+// The PoolBenchController runs the benches one after the other, and logs the results.
+
+namespace crt
+{
+	// All values are equal, unless a read was torn.
+	template<uint32_t COUNT> struct PoolBenchData
+	{
+		int32_t values[COUNT];
+	};
+
+	struct PoolBenchReaderResult
+	{
+		uint32_t reads;
+		uint32_t tornReads;
+		int64_t maxReadUs;
+	};
+
+	class IPoolBenchReader
+	{
+	public:
+		virtual void go() = 0;
+	};
+
+	class IPoolBench
+	{
+	public:
+		virtual void run() = 0;
+	};
+
+	class IPoolBenchListener
+	{
+	public:
+		virtual void benchDone() = 0;
+	};
+
+	template<typename POOL, typename DATA> class PoolBenchWriter : public Task, public IPoolBench
+	{
+	public:
+		static const uint32_t MAX_READERS = 4;
+		static const int64_t RUN_US = 200000;
+
+	private:
+		POOL pool;
+		Flag flagRun;
+		Queue<PoolBenchReaderResult, MAX_READERS> queueResults;
+		::std::atomic<bool> bRunning;
+		const char* label;
+		IPoolBenchListener& listener;
+		IPoolBenchReader* readers[MAX_READERS];
+		uint32_t nofReaders;
+
+	public:
+		PoolBenchWriter(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			const char* label, IPoolBenchListener& listener) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagRun(this), queueResults(this), bRunning(false),
+			label(label), listener(listener), nofReaders(0)
+		{
+			start();
+		}
+
+		void addReader(IPoolBenchReader* pReader)
+		{
+			assert(nofReaders < MAX_READERS);
+			readers[nofReaders++] = pReader;
+		}
+
+		// Called by the readers.
+		POOL& getPool()
+		{
+			return pool;
+		}
+
+		bool isRunning()
+		{
+			return bRunning.load(::std::memory_order_relaxed);
+		}
+
+		void readerDone(const PoolBenchReaderResult& result)
+		{
+			queueResults.write(result);
+		}
+
+		// Called by the controller.
+		void run()
+		{
+			flagRun.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			DATA data;
+			PoolBenchReaderResult result;
+			while (true)
+			{
+				wait(flagRun);
+				for (uint32_t n = 1; n <= nofReaders; n++)
+				{
+					bRunning = true;
+					for (uint32_t i = 0; i < n; i++) readers[i]->go();
+
+					uint32_t writes = 0;
+					int64_t startUs = esp_timer_get_time();
+					while (esp_timer_get_time() - startUs < RUN_US)
+					{
+						writes++;
+						for (uint32_t j = 0; j < sizeof(data.values) / sizeof(data.values[0]); j++) data.values[j] = writes;
+						pool.write(data);
+					}
+					bRunning = false;
+
+					uint32_t reads = 0;
+					uint32_t tornReads = 0;
+					int64_t maxReadUs = 0;
+					for (uint32_t i = 0; i < n; i++)
+					{
+						queueResults.read(result);
+						reads += result.reads;
+						tornReads += result.tornReads;
+						if (result.maxReadUs > maxReadUs) maxReadUs = result.maxReadUs;
+					}
+
+					ESP_LOGI("PoolBench", "%-16s %3u bytes  readers: %" PRIu32 "  reads/s: %8" PRIu32 "  writes/s: %8" PRIu32 "  max read: %5" PRIu32 " us  torn: %" PRIu32,
+						label, (unsigned)sizeof(DATA), n, (uint32_t)((uint64_t)reads * 1000000 / RUN_US),
+						(uint32_t)((uint64_t)writes * 1000000 / RUN_US), (uint32_t)maxReadUs, tornReads);
+					assert(tornReads == 0);
+				}
+				listener.benchDone();
+			}
+		}
+	}; // end class PoolBenchWriter
+
+	template<typename WRITER, typename DATA> class PoolBenchReader : public Task, public IPoolBenchReader
+	{
+	private:
+		Flag flagGo;
+		WRITER& writer;
+
+	public:
+		PoolBenchReader(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			WRITER& writer) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagGo(this), writer(writer)
+		{
+			writer.addReader(this);
+			start();
+		}
+
+		void go()
+		{
+			flagGo.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			DATA data;
+			PoolBenchReaderResult result;
+			while (true)
+			{
+				wait(flagGo);
+				result.reads = 0;
+				result.tornReads = 0;
+				result.maxReadUs = 0;
+				while (writer.isRunning())
+				{
+					int64_t beforeUs = esp_timer_get_time();
+					writer.getPool().read(data);
+					int64_t readUs = esp_timer_get_time() - beforeUs;
+					if (readUs > result.maxReadUs) result.maxReadUs = readUs;
+					result.reads++;
+
+					for (uint32_t j = 1; j < sizeof(data.values) / sizeof(data.values[0]); j++)
+					{
+						if (data.values[j] != data.values[0])
+						{
+							result.tornReads++;
+							break;
+						}
+					}
+				}
+				writer.readerDone(result);
+			}
+		}
+	}; // end class PoolBenchReader
+
+	class PoolBenchController : public Task, public IPoolBenchListener
+	{
+	private:
+		static const uint32_t MAX_BENCHES = 8;
+		Flag flagDone;
+		IPoolBench* benches[MAX_BENCHES];
+		uint32_t nofBenches;
+
+	public:
+		PoolBenchController(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagDone(this), nofBenches(0)
+		{
+			start();
+		}
+
+		void addBench(IPoolBench& bench)
+		{
+			assert(nofBenches < MAX_BENCHES);
+			benches[nofBenches++] = &bench;
+		}
+
+		void benchDone()
+		{
+			flagDone.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			vTaskDelay(1000); // wait for other threads to have started up as well.
+
+			for (uint32_t i = 0; i < nofBenches; i++)
+			{
+				benches[i]->run();
+				wait(flagDone);
+			}
+			ESP_LOGI("PoolBench", "PoolBench done");
+
+			while (true)
+			{
+				vTaskDelay(1000);
+			}
+		}
+	}; // end class PoolBenchController
+};// end namespace crt
@@ -0,0 +1,12 @@
+// by Marius Versteegen, 2025
+
+// The ino code has been moved to a header file such that it 
+// can be inspected in non-Arduino IDE environments with 
+// proper code highlighting and intellisense too.
+
+#include "QueueBatchBench_ino.h"
+
+// IMPORTANT: required for this example to work:
+// if you are building from Arduino IDE, make sure to set 
+// the build setting "Core Debug Level" to "info"
+// and select baudrate=115200 in Serial Monitor.
@@ -0,0 +1,94 @@
+// by Marius Versteegen, 2025
+
+#include <crt_CleanRTOS.h>        // This file includes crt_Config.h  You'll need to change defines there for a release build.
+
+// All Tasks should be created in this main file.
+#include "crt_QueueBatchBench.h"
+namespace crt
+{
+	MainInits mainInits;            // Initialize CleanRTOS.
+
+	QueueBatchBenchController queueBatchBenchController("QueueBatchBenchController", 2 /*priority*/, 4000 /*stackBytes*/, ARDUINO_RUNNING_CORE);
+
+	// Every consumer is fed by its own producer task. The benches run one after the other.
+	// The Batch producers and consumers keep BATCH messages on their stack, hence the larger stacks.
+
+	typedef SizedMessage<4> Message4;
+	typedef QueueBatchBenchConsumer<Queue<Message4, 16>, Message4, PerMessage> QueuePerMessage4;
+	typedef QueueBatchBenchConsumer<Queue<Message4, 16>, Message4, Batch> QueueBatch4;
+	typedef QueueBatchBenchConsumer<SpscQueue<Message4, 16>, Message4, PerMessage> SpscPerMessage4;
+	typedef QueueBatchBenchConsumer<SpscQueue<Message4, 16>, Message4, Batch> SpscBatch4;
+	typedef QueueBatchBenchConsumer<SpscQueue<Message4, 16>, Message4, InPlace> SpscInPlace4;
+
+	QueuePerMessage4 queuePerMessage4("Q4", 2, 4000, ARDUINO_RUNNING_CORE, "Queue", queueBatchBenchController);
+	QueueBatchBenchProducer<QueuePerMessage4> queuePerMessageProducer4("Q4P", 2, 4000, ARDUINO_RUNNING_CORE, queuePerMessage4);
+	QueueBatch4 queueBatch4("QB4", 2, 6000, ARDUINO_RUNNING_CORE, "Queue", queueBatchBenchController);
+	QueueBatchBenchProducer<QueueBatch4> queueBatchProducer4("QB4P", 2, 6000, ARDUINO_RUNNING_CORE, queueBatch4);
+	SpscPerMessage4 spscPerMessage4("S4", 2, 4000, ARDUINO_RUNNING_CORE, "SpscQueue", queueBatchBenchController);
+	QueueBatchBenchProducer<SpscPerMessage4> spscPerMessageProducer4("S4P", 2, 4000, ARDUINO_RUNNING_CORE, spscPerMessage4);
+	SpscBatch4 spscBatch4("SB4", 2, 6000, ARDUINO_RUNNING_CORE, "SpscQueue", queueBatchBenchController);
+	QueueBatchBenchProducer<SpscBatch4> spscBatchProducer4("SB4P", 2, 6000, ARDUINO_RUNNING_CORE, spscBatch4);
+	SpscInPlace4 spscInPlace4("SI4", 2, 4000, ARDUINO_RUNNING_CORE, "SpscQueue", queueBatchBenchController);
+	QueueBatchBenchProducer<SpscInPlace4> spscInPlaceProducer4("SI4P", 2, 4000, ARDUINO_RUNNING_CORE, spscInPlace4);
+
+	typedef SizedMessage<64> Message64;
+	typedef QueueBatchBenchConsumer<Queue<Message64, 16>, Message64, PerMessage> QueuePerMessage64;
+	typedef QueueBatchBenchConsumer<Queue<Message64, 16>, Message64, Batch> QueueBatch64;
+	typedef QueueBatchBenchConsumer<SpscQueue<Message64, 16>, Message64, PerMessage> SpscPerMessage64;
+	typedef QueueBatchBenchConsumer<SpscQueue<Message64, 16>, Message64, Batch> SpscBatch64;
+	typedef QueueBatchBenchConsumer<SpscQueue<Message64, 16>, Message64, InPlace> SpscInPlace64;
+
+	QueuePerMessage64 queuePerMessage64("Q64", 2, 4000, ARDUINO_RUNNING_CORE, "Queue", queueBatchBenchController);
+	QueueBatchBenchProducer<QueuePerMessage64> queuePerMessageProducer64("Q64P", 2, 4000, ARDUINO_RUNNING_CORE, queuePerMessage64);
+	QueueBatch64 queueBatch64("QB64", 2, 6000, ARDUINO_RUNNING_CORE, "Queue", queueBatchBenchController);
+	QueueBatchBenchProducer<QueueBatch64> queueBatchProducer64("QB64P", 2, 6000, ARDUINO_RUNNING_CORE, queueBatch64);
+	SpscPerMessage64 spscPerMessage64("S64", 2, 4000, ARDUINO_RUNNING_CORE, "SpscQueue", queueBatchBenchController);
+	QueueBatchBenchProducer<SpscPerMessage64> spscPerMessageProducer64("S64P", 2, 4000, ARDUINO_RUNNING_CORE, spscPerMessage64);
+	SpscBatch64 spscBatch64("SB64", 2, 6000, ARDUINO_RUNNING_CORE, "SpscQueue", queueBatchBenchController);
+	QueueBatchBenchProducer<SpscBatch64> spscBatchProducer64("SB64P", 2, 6000, ARDUINO_RUNNING_CORE, spscBatch64);
+	SpscInPlace64 spscInPlace64("SI64", 2, 4000, ARDUINO_RUNNING_CORE, "SpscQueue", queueBatchBenchController);
+	QueueBatchBenchProducer<SpscInPlace64> spscInPlaceProducer64("SI64P", 2, 4000, ARDUINO_RUNNING_CORE, spscInPlace64);
+
+	typedef SizedMessage<256> Message256;
+	typedef QueueBatchBenchConsumer<Queue<Message256, 16>, Message256, PerMessage> QueuePerMessage256;
+	typedef QueueBatchBenchConsumer<Queue<Message256, 16>, Message256, Batch> QueueBatch256;
+	typedef QueueBatchBenchConsumer<SpscQueue<Message256, 16>, Message256, PerMessage> SpscPerMessage256;
+	typedef QueueBatchBenchConsumer<SpscQueue<Message256, 16>, Message256, Batch> SpscBatch256;
+	typedef QueueBatchBenchConsumer<SpscQueue<Message256, 16>, Message256, InPlace> SpscInPlace256;
+
+	QueuePerMessage256 queuePerMessage256("Q256", 2, 4000, ARDUINO_RUNNING_CORE, "Queue", queueBatchBenchController);
+	QueueBatchBenchProducer<QueuePerMessage256> queuePerMessageProducer256("Q256P", 2, 4000, ARDUINO_RUNNING_CORE, queuePerMessage256);
+	QueueBatch256 queueBatch256("QB256", 2, 6000, ARDUINO_RUNNING_CORE, "Queue", queueBatchBenchController);
+	QueueBatchBenchProducer<QueueBatch256> queueBatchProducer256("QB256P", 2, 6000, ARDUINO_RUNNING_CORE, queueBatch256);
+	SpscPerMessage256 spscPerMessage256("S256", 2, 4000, ARDUINO_RUNNING_CORE, "SpscQueue", queueBatchBenchController);
+	QueueBatchBenchProducer<SpscPerMessage256> spscPerMessageProducer256("S256P", 2, 4000, ARDUINO_RUNNING_CORE, spscPerMessage256);
+	SpscBatch256 spscBatch256("SB256", 2, 6000, ARDUINO_RUNNING_CORE, "SpscQueue", queueBatchBenchController);
+	QueueBatchBenchProducer<SpscBatch256> spscBatchProducer256("SB256P", 2, 6000, ARDUINO_RUNNING_CORE, spscBatch256);
+	SpscInPlace256 spscInPlace256("SI256", 2, 4000, ARDUINO_RUNNING_CORE, "SpscQueue", queueBatchBenchController);
+	QueueBatchBenchProducer<SpscInPlace256> spscInPlaceProducer256("SI256P", 2, 4000, ARDUINO_RUNNING_CORE, spscInPlace256);
+}
+
+void setup()
+{
+	crt::queueBatchBenchController.addBench(crt::queuePerMessage4);
+	crt::queueBatchBenchController.addBench(crt::queueBatch4);
+	crt::queueBatchBenchController.addBench(crt::spscPerMessage4);
+	crt::queueBatchBenchController.addBench(crt::spscBatch4);
+	crt::queueBatchBenchController.addBench(crt::spscInPlace4);
+	crt::queueBatchBenchController.addBench(crt::queuePerMessage64);
+	crt::queueBatchBenchController.addBench(crt::queueBatch64);
+	crt::queueBatchBenchController.addBench(crt::spscPerMessage64);
+	crt::queueBatchBenchController.addBench(crt::spscBatch64);
+	crt::queueBatchBenchController.addBench(crt::spscInPlace64);
+	crt::queueBatchBenchController.addBench(crt::queuePerMessage256);
+	crt::queueBatchBenchController.addBench(crt::queueBatch256);
+	crt::queueBatchBenchController.addBench(crt::spscPerMessage256);
+	crt::queueBatchBenchController.addBench(crt::spscBatch256);
+	crt::queueBatchBenchController.addBench(crt::spscInPlace256);
+	ESP_LOGI("checkpoint", "start of main");
+}
+
+void loop()
+{
+	vTaskDelay(1);// Nothing to do in loop - all example code runs in the tasks above.
+}
@@ -0,0 +1,287 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <crt_CleanRTOS.h>
+
+// This file measures the throughput of Queue and SpscQueue for messages of 4, 64 and 256 bytes,
+// per way of moving them:
+//  - PerMessage: the producer fills a message and writes it; the owner reads the messages one by one.
+//  - Batch:      the producer writes BATCH messages with writeMany(); the owner reads them with readMany().
+//  - InPlace:    the producer fills the message in the slot of the queue (beginWrite/endWrite), and
+//                the owner uses it there (beginRead/endRead). Only SpscQueue and MpscQueue offer that.
+// Every bench has a consumer task that owns the queue and a producer task that writes MESSAGES
+// messages as fast as it can. The QueueBatchBenchController runs the benches one after the other.
+
+namespace crt
+{
+	template<uint32_t SIZE> struct SizedMessage
+	{
+		uint8_t bytes[SIZE];
+	};
+
+	static const uint32_t BATCH = 8;
+
+	// The producer fills every byte of a message, and the consumer looks at the first and last one,
+	// such that the bench includes the work of making and using a message.
+	template<typename MESSAGE> inline void fillMessage(MESSAGE& message, uint32_t sequence)
+	{
+		memset(message.bytes, (uint8_t)sequence, sizeof(message.bytes));
+	}
+
+	template<typename MESSAGE> inline uint32_t useMessage(const MESSAGE& message)
+	{
+		return message.bytes[0] + message.bytes[sizeof(message.bytes) - 1];
+	}
+
+	struct PerMessage
+	{
+		static const char* name() { return "PerMessage"; }
+
+		template<typename QUEUE, typename MESSAGE> static void produce(QUEUE& queue, uint32_t count)
+		{
+			MESSAGE message;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				fillMessage(message, i);
+				queue.write(message);
+			}
+		}
+
+		template<typename QUEUE, typename MESSAGE> static uint32_t drain(QUEUE& queue, uint32_t& checksum)
+		{
+			MESSAGE message;
+			uint32_t count = 0;
+			while (queue.tryRead(message))
+			{
+				checksum += useMessage(message);
+				count++;
+			}
+			return count;
+		}
+	};
+
+	struct Batch
+	{
+		static const char* name() { return "Batch"; }
+
+		template<typename QUEUE, typename MESSAGE> static void produce(QUEUE& queue, uint32_t count)
+		{
+			MESSAGE messages[BATCH];
+			for (uint32_t i = 0; i < count; i += BATCH)
+			{
+				uint32_t n = (count - i < BATCH) ? count - i : BATCH;
+				for (uint32_t j = 0; j < n; j++) fillMessage(messages[j], i + j);
+				queue.writeMany(messages, n);
+			}
+		}
+
+		template<typename QUEUE, typename MESSAGE> static uint32_t drain(QUEUE& queue, uint32_t& checksum)
+		{
+			MESSAGE messages[BATCH];
+			uint32_t count = 0;
+			uint32_t n;
+			while ((n = queue.readMany(messages, BATCH)) > 0)
+			{
+				for (uint32_t j = 0; j < n; j++) checksum += useMessage(messages[j]);
+				count += n;
+			}
+			return count;
+		}
+	};
+
+	struct InPlace
+	{
+		static const char* name() { return "InPlace"; }
+
+		template<typename QUEUE, typename MESSAGE> static void produce(QUEUE& queue, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				fillMessage(*queue.beginWrite(), i);
+				queue.endWrite();
+			}
+		}
+
+		template<typename QUEUE, typename MESSAGE> static uint32_t drain(QUEUE& queue, uint32_t& checksum)
+		{
+			uint32_t count = 0;
+			MESSAGE* pMessage;
+			while ((pMessage = queue.beginRead()) != nullptr)
+			{
+				checksum += useMessage(*pMessage);
+				queue.endRead();
+				count++;
+			}
+			return count;
+		}
+	};
+
+	class IQueueBatchBenchProducer
+	{
+	public:
+		virtual void go() = 0;
+	};
+
+	class IQueueBatchBench
+	{
+	public:
+		virtual void run() = 0;
+	};
+
+	class IQueueBatchBenchListener
+	{
+	public:
+		virtual void benchDone() = 0;
+	};
+
+	template<typename QUEUE, typename MESSAGE, typename MODE> class QueueBatchBenchConsumer : public Task, public IQueueBatchBench
+	{
+	public:
+		static const uint32_t MESSAGES = 50000;
+
+	private:
+		QUEUE queue;
+		Flag flagRun;
+		const char* label;
+		IQueueBatchBenchListener& listener;
+		IQueueBatchBenchProducer* pProducer;
+
+	public:
+		QueueBatchBenchConsumer(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			const char* label, IQueueBatchBenchListener& listener) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), queue(this, true /*bWriteWaitIfQueueFull*/), flagRun(this),
+			label(label), listener(listener), pProducer(nullptr)
+		{
+			start();
+		}
+
+		void setProducer(IQueueBatchBenchProducer* pProducer)
+		{
+			this->pProducer = pProducer;
+		}
+
+		// Called by the producer: writes count messages into the queue.
+		void produce(uint32_t count)
+		{
+			MODE::template produce<QUEUE, MESSAGE>(queue, count);
+		}
+
+		// Called by the controller.
+		void run()
+		{
+			flagRun.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			while (true)
+			{
+				wait(flagRun);
+#ifdef CRT_HOST
+				uint32_t kernelCallsBefore = crt_host::kernelCalls;
+#endif
+				int64_t startUs = esp_timer_get_time();
+				pProducer->go();
+				uint32_t received = 0;
+				uint32_t checksum = 0;
+				while (received < MESSAGES)
+				{
+					wait(queue);
+					received += MODE::template drain<QUEUE, MESSAGE>(queue, checksum);
+				}
+				int64_t elapsedUs = esp_timer_get_time() - startUs;
+
+				uint32_t msgsPerSecond = (uint32_t)((uint64_t)MESSAGES * 1000000 / elapsedUs);
+				ESP_LOGI("QueueBatchBench", "%-9s %-10s %3u bytes  msgs/s: %7" PRIu32 "  MB/s: %6.1f  (checksum %" PRIu32 ")",
+					label, MODE::name(), (unsigned)sizeof(MESSAGE), msgsPerSecond,
+					(double)msgsPerSecond * sizeof(MESSAGE) / 1e6, checksum);
+#ifdef CRT_HOST
+				// The event group and queue calls per message; on the ESP32, each is a critical section.
+				ESP_LOGI("QueueBatchBench", "%-9s %-10s %3u bytes  kernel calls per message: %.2f",
+					label, MODE::name(), (unsigned)sizeof(MESSAGE), (double)(crt_host::kernelCalls - kernelCallsBefore) / MESSAGES);
+#endif
+				listener.benchDone();
+			}
+		}
+	}; // end class QueueBatchBenchConsumer
+
+	template<typename CONSUMER> class QueueBatchBenchProducer : public Task, public IQueueBatchBenchProducer
+	{
+	private:
+		Flag flagGo;
+		CONSUMER& consumer;
+
+	public:
+		QueueBatchBenchProducer(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			CONSUMER& consumer) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagGo(this), consumer(consumer)
+		{
+			consumer.setProducer(this);
+			start();
+		}
+
+		void go()
+		{
+			flagGo.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			while (true)
+			{
+				wait(flagGo);
+				consumer.produce(CONSUMER::MESSAGES);
+			}
+		}
+	}; // end class QueueBatchBenchProducer
+
+	class QueueBatchBenchController : public Task, public IQueueBatchBenchListener
+	{
+	private:
+		static const uint32_t MAX_BENCHES = 16;
+		Flag flagDone;
+		IQueueBatchBench* benches[MAX_BENCHES];
+		uint32_t nofBenches;
+
+	public:
+		QueueBatchBenchController(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagDone(this), nofBenches(0)
+		{
+			start();
+		}
+
+		void addBench(IQueueBatchBench& bench)
+		{
+			assert(nofBenches < MAX_BENCHES);
+			benches[nofBenches++] = &bench;
+		}
+
+		void benchDone()
+		{
+			flagDone.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			vTaskDelay(1000); // wait for other threads to have started up as well.
+
+			for (uint32_t i = 0; i < nofBenches; i++)
+			{
+				benches[i]->run();
+				wait(flagDone);
+			}
+			ESP_LOGI("QueueBatchBench", "QueueBatchBench done");
+
+			while (true)
+			{
+				vTaskDelay(1000);
+			}
+		}
+	}; // end class QueueBatchBenchController
+};// end namespace crt
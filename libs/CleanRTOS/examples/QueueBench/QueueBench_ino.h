@@ -0,0 +1,49 @@
+// by Marius Versteegen, 2025
+
+#include <crt_CleanRTOS.h>        // This file includes crt_Config.h  You'll need to change defines there for a release build.
+
+// All Tasks should be created in this main file.
+#include "crt_QueueBench.h"
+namespace crt
+{
+	MainInits mainInits;            // Initialize CleanRTOS.
+
+	QueueBenchController queueBenchController("QueueBenchController", 2 /*priority*/, 4000 /*stackBytes*/, ARDUINO_RUNNING_CORE);
+
+	// Every consumer is fed by its own producer tasks. The benches run one after the other.
+	typedef QueueBenchConsumer<Queue<BenchMessage, 64>> QueueConsumer;
+	typedef QueueBenchConsumer<SpscQueue<BenchMessage, 64>> SpscConsumer;
+	typedef QueueBenchConsumer<MpscQueue<BenchMessage, 64>> MpscConsumer;
+
+	QueueConsumer queueConsumer1("Queue", 2, 4000, ARDUINO_RUNNING_CORE, "Queue", queueBenchController);
+	QueueBenchProducer<QueueConsumer> queueProducer1("QueueP", 2, 4000, ARDUINO_RUNNING_CORE, queueConsumer1);
+
+	SpscConsumer spscConsumer("Spsc", 2, 4000, ARDUINO_RUNNING_CORE, "SpscQueue", queueBenchController);
+	QueueBenchProducer<SpscConsumer> spscProducer("SpscP", 2, 4000, ARDUINO_RUNNING_CORE, spscConsumer);
+
+	MpscConsumer mpscConsumer1("Mpsc", 2, 4000, ARDUINO_RUNNING_CORE, "MpscQueue", queueBenchController);
+	QueueBenchProducer<MpscConsumer> mpscProducer1("MpscP", 2, 4000, ARDUINO_RUNNING_CORE, mpscConsumer1);
+
+	QueueConsumer queueConsumer2("Queue2", 2, 4000, ARDUINO_RUNNING_CORE, "Queue", queueBenchController);
+	QueueBenchProducer<QueueConsumer> queueProducer2a("Queue2P1", 2, 4000, ARDUINO_RUNNING_CORE, queueConsumer2);
+	QueueBenchProducer<QueueConsumer> queueProducer2b("Queue2P2", 2, 4000, ARDUINO_RUNNING_CORE, queueConsumer2);
+
+	MpscConsumer mpscConsumer2("Mpsc2", 2, 4000, ARDUINO_RUNNING_CORE, "MpscQueue", queueBenchController);
+	QueueBenchProducer<MpscConsumer> mpscProducer2a("Mpsc2P1", 2, 4000, ARDUINO_RUNNING_CORE, mpscConsumer2);
+	QueueBenchProducer<MpscConsumer> mpscProducer2b("Mpsc2P2", 2, 4000, ARDUINO_RUNNING_CORE, mpscConsumer2);
+}
+
+void setup()
+{
+	crt::queueBenchController.addBench(crt::queueConsumer1);
+	crt::queueBenchController.addBench(crt::spscConsumer);
+	crt::queueBenchController.addBench(crt::mpscConsumer1);
+	crt::queueBenchController.addBench(crt::queueConsumer2);
+	crt::queueBenchController.addBench(crt::mpscConsumer2);
+	ESP_LOGI("checkpoint", "start of main");
+}
+
+void loop()
+{
+	vTaskDelay(1);// Nothing to do in loop - all example code runs in the tasks above.
+}
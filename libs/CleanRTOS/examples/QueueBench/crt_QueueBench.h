@@ -0,0 +1,230 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <crt_CleanRTOS.h>
+
+// This file compares Queue with SpscQueue and MpscQueue.
+// Every bench has a consumer task that owns the queue, and one or two producer tasks.
+// It measures:
+//  - messages per second: the producers write THROUGHPUT_MESSAGES each, as fast as they can.
+//    The consumer waits for the queue and then reads until it is empty.
+//  - wake latency: after that, the producers write LATENCY_MESSAGES each, one per ms, such
+//    that the consumer is asleep every time. The latency is the time from the write to the read.
+// The QueueBenchController runs the benches one after the other, and logs the results.
+
+namespace crt
+{
+	struct BenchMessage
+	{
+		int64_t sentUs;
+		uint32_t sequence;
+	};
+
+	class IQueueBenchProducer
+	{
+	public:
+		virtual void go() = 0;
+	};
+
+	class IQueueBench
+	{
+	public:
+		virtual void run() = 0;
+	};
+
+	class IQueueBenchListener
+	{
+	public:
+		virtual void benchDone() = 0;
+	};
+
+	template<typename QUEUE> class QueueBenchConsumer : public Task, public IQueueBench
+	{
+	public:
+		static const uint32_t THROUGHPUT_MESSAGES = 100000;	// per producer
+		static const uint32_t LATENCY_MESSAGES = 200;		// per producer
+
+	private:
+		QUEUE queue;
+		Flag flagRun;
+		const char* label;
+		IQueueBenchListener& listener;
+		IQueueBenchProducer* producers[2];
+		uint32_t nofProducers;
+
+	public:
+		QueueBenchConsumer(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			const char* label, IQueueBenchListener& listener) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), queue(this, true /*bWriteWaitIfQueueFull*/), flagRun(this),
+			label(label), listener(listener), nofProducers(0)
+		{
+			start();
+		}
+
+		void addProducer(IQueueBenchProducer* pProducer)
+		{
+			assert(nofProducers < 2);
+			producers[nofProducers++] = pProducer;
+		}
+
+		// Called by the producers.
+		void post(BenchMessage message)
+		{
+			queue.write(message);
+		}
+
+		// Called by the controller.
+		void run()
+		{
+			flagRun.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			BenchMessage message;
+			while (true)
+			{
+				wait(flagRun);
+
+				// Messages per second.
+#ifdef CRT_HOST
+				uint32_t kernelCallsBefore = crt_host::kernelCalls;
+#endif
+				for (uint32_t i = 0; i < nofProducers; i++) producers[i]->go();
+				uint32_t received = 0;
+				int64_t firstSentUs = 0;
+				while (received < nofProducers * THROUGHPUT_MESSAGES)
+				{
+					wait(queue);
+					while (queue.tryRead(message))
+					{
+						if (received++ == 0) firstSentUs = message.sentUs;
+					}
+				}
+				int64_t elapsedUs = esp_timer_get_time() - firstSentUs;
+#ifdef CRT_HOST
+				uint32_t kernelCalls = crt_host::kernelCalls - kernelCallsBefore;
+#endif
+
+				// Wake latency.
+				for (uint32_t i = 0; i < nofProducers; i++) producers[i]->go();
+				int64_t sumLatencyUs = 0;
+				int64_t maxLatencyUs = 0;
+				for (received = 0; received < nofProducers * LATENCY_MESSAGES; )
+				{
+					wait(queue);
+					while (queue.tryRead(message))
+					{
+						int64_t latencyUs = esp_timer_get_time() - message.sentUs;
+						sumLatencyUs += latencyUs;
+						if (latencyUs > maxLatencyUs) maxLatencyUs = latencyUs;
+						received++;
+					}
+				}
+
+				ESP_LOGI("QueueBench", "%-10s producers: %" PRIu32 "  msgs/s: %7" PRIu32 "  wake latency avg: %3" PRIu32 " us  max: %4" PRIu32 " us",
+					label, nofProducers, (uint32_t)((uint64_t)nofProducers * THROUGHPUT_MESSAGES * 1000000 / elapsedUs),
+					(uint32_t)(sumLatencyUs / received), (uint32_t)maxLatencyUs);
+#ifdef CRT_HOST
+				// The event group and queue calls per message; on the ESP32, each is a critical section.
+				ESP_LOGI("QueueBench", "%-10s kernel calls per message: %.2f", label,
+					(double)kernelCalls / (nofProducers * THROUGHPUT_MESSAGES));
+#endif
+				listener.benchDone();
+			}
+		}
+	}; // end class QueueBenchConsumer
+
+	template<typename CONSUMER> class QueueBenchProducer : public Task, public IQueueBenchProducer
+	{
+	private:
+		Flag flagGo;
+		CONSUMER& consumer;
+
+	public:
+		QueueBenchProducer(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			CONSUMER& consumer) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagGo(this), consumer(consumer)
+		{
+			consumer.addProducer(this);
+			start();
+		}
+
+		void go()
+		{
+			flagGo.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			BenchMessage message;
+			while (true)
+			{
+				wait(flagGo);
+				message.sentUs = esp_timer_get_time();
+				for (message.sequence = 0; message.sequence < CONSUMER::THROUGHPUT_MESSAGES; message.sequence++)
+				{
+					consumer.post(message);
+				}
+
+				wait(flagGo);	// The consumer has received the messages of all producers.
+				for (message.sequence = 0; message.sequence < CONSUMER::LATENCY_MESSAGES; message.sequence++)
+				{
+					vTaskDelay(1);
+					message.sentUs = esp_timer_get_time();
+					consumer.post(message);
+				}
+			}
+		}
+	}; // end class QueueBenchProducer
+
+	class QueueBenchController : public Task, public IQueueBenchListener
+	{
+	private:
+		static const uint32_t MAX_BENCHES = 8;
+		Flag flagDone;
+		IQueueBench* benches[MAX_BENCHES];
+		uint32_t nofBenches;
+
+	public:
+		QueueBenchController(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagDone(this), nofBenches(0)
+		{
+			start();
+		}
+
+		void addBench(IQueueBench& bench)
+		{
+			assert(nofBenches < MAX_BENCHES);
+			benches[nofBenches++] = &bench;
+		}
+
+		void benchDone()
+		{
+			flagDone.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			vTaskDelay(1000); // wait for other threads to have started up as well.
+
+			for (uint32_t i = 0; i < nofBenches; i++)
+			{
+				benches[i]->run();
+				wait(flagDone);
+			}
+			ESP_LOGI("QueueBench", "QueueBench done");
+
+			while (true)
+			{
+				vTaskDelay(1000);
+			}
+		}
+	}; // end class QueueBenchController
+};// end namespace crt
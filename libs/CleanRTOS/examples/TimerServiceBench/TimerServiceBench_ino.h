@@ -0,0 +1,79 @@
+// by Marius Versteegen, 2025
+
+#include <crt_CleanRTOS.h>        // This file includes crt_Config.h  You'll need to change defines there for a release build.
+
+// All Tasks should be created in this main file.
+#include "crt_TimerServiceBench.h"
+namespace crt
+{
+	MainInits mainInits;            // Initialize CleanRTOS.
+
+	TimerService timerService(100 /*resolutionUs*/);
+	TimerService boundaryService(1000 /*resolutionUs*/);	// Only for the deadlines on slot boundaries.
+
+	// The controller has the highest priority, such that its measurements are not interrupted by the bench tasks.
+	TimerServiceBenchController timerServiceBenchController("TimerServiceBenchController", 3 /*priority*/, 4000 /*stackBytes*/, ARDUINO_RUNNING_CORE,
+		timerService, boundaryService);
+
+	// 50 tasks with 20 SoftTimers each.
+	TimerServiceBenchTask t00("t00", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 0);
+	TimerServiceBenchTask t01("t01", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 20);
+	TimerServiceBenchTask t02("t02", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 40);
+	TimerServiceBenchTask t03("t03", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 60);
+	TimerServiceBenchTask t04("t04", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 80);
+	TimerServiceBenchTask t05("t05", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 100);
+	TimerServiceBenchTask t06("t06", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 120);
+	TimerServiceBenchTask t07("t07", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 140);
+	TimerServiceBenchTask t08("t08", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 160);
+	TimerServiceBenchTask t09("t09", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 180);
+	TimerServiceBenchTask t10("t10", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 200);
+	TimerServiceBenchTask t11("t11", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 220);
+	TimerServiceBenchTask t12("t12", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 240);
+	TimerServiceBenchTask t13("t13", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 260);
+	TimerServiceBenchTask t14("t14", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 280);
+	TimerServiceBenchTask t15("t15", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 300);
+	TimerServiceBenchTask t16("t16", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 320);
+	TimerServiceBenchTask t17("t17", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 340);
+	TimerServiceBenchTask t18("t18", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 360);
+	TimerServiceBenchTask t19("t19", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 380);
+	TimerServiceBenchTask t20("t20", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 400);
+	TimerServiceBenchTask t21("t21", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 420);
+	TimerServiceBenchTask t22("t22", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 440);
+	TimerServiceBenchTask t23("t23", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 460);
+	TimerServiceBenchTask t24("t24", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 480);
+	TimerServiceBenchTask t25("t25", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 500);
+	TimerServiceBenchTask t26("t26", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 520);
+	TimerServiceBenchTask t27("t27", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 540);
+	TimerServiceBenchTask t28("t28", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 560);
+	TimerServiceBenchTask t29("t29", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 580);
+	TimerServiceBenchTask t30("t30", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 600);
+	TimerServiceBenchTask t31("t31", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 620);
+	TimerServiceBenchTask t32("t32", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 640);
+	TimerServiceBenchTask t33("t33", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 660);
+	TimerServiceBenchTask t34("t34", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 680);
+	TimerServiceBenchTask t35("t35", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 700);
+	TimerServiceBenchTask t36("t36", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 720);
+	TimerServiceBenchTask t37("t37", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 740);
+	TimerServiceBenchTask t38("t38", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 760);
+	TimerServiceBenchTask t39("t39", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 780);
+	TimerServiceBenchTask t40("t40", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 800);
+	TimerServiceBenchTask t41("t41", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 820);
+	TimerServiceBenchTask t42("t42", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 840);
+	TimerServiceBenchTask t43("t43", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 860);
+	TimerServiceBenchTask t44("t44", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 880);
+	TimerServiceBenchTask t45("t45", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 900);
+	TimerServiceBenchTask t46("t46", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 920);
+	TimerServiceBenchTask t47("t47", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 940);
+	TimerServiceBenchTask t48("t48", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 960);
+	TimerServiceBenchTask t49("t49", 2 /*priority*/, 3000 /*stackBytes*/, ARDUINO_RUNNING_CORE, timerService, timerServiceBenchController, 980);
+}
+
+void setup()
+{
+	ESP_LOGI("checkpoint", "start of main");
+}
+
+void loop()
+{
+	vTaskDelay(1);// Nothing to do in loop - all example code runs in the tasks above.
+}
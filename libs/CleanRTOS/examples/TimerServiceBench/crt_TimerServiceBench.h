@@ -0,0 +1,253 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <crt_CleanRTOS.h>
+
+// This file measures a TimerService with 1000 SoftTimers, spread over 50 tasks of 20 each.
+// The SoftTimers have periods of 20 to 119 ms. The odd ones are periodic; the even ones
+// are one-shot, and are started again by their task each time they fire.
+// The TimerServiceBenchController:
+//  - measures the time of a start() plus stop() of a SoftTimer and of a Timer, while no
+//    SoftTimers run, and again (for the SoftTimer) while the 1000 run;
+//  - lets the 1000 SoftTimers run for RUN_MS, and logs how many fired, how late (from the
+//    deadline to the firing), how often the hardware timer woke the TimerService, and how
+//    much of the time that took.
+//  - on a second, idle TimerService, BOUNDARY_COUNT times: a SoftTimer with its deadline on
+//    the first tick of a slot of level 1, and a SoftTimer one tick earlier, in the slot before.
+//    That takes 2 wake-ups: one to cascade the slot of the earlier one, and one for its deadline.
+//    The latter reaches the tick of the boundary as well, so the other SoftTimer must fire in it:
+//    the cascade of its slot may not move it a tick further, with a wake-up of its own.
+
+namespace crt
+{
+	class ITimerServiceBenchTask
+	{
+	public:
+		virtual void go() = 0;
+		virtual void stop() = 0;
+		virtual uint32_t getReceived() = 0;
+	};
+
+	class TimerServiceBenchController : public Task
+	{
+	public:
+		static const uint32_t MAX_TASKS = 50;
+		static const uint32_t TIMERS_PER_TASK = 20;
+		static const uint32_t RUN_MS = 2000;
+		static const uint32_t START_STOP_COUNT = 10000;
+		static const uint32_t BOUNDARY_COUNT = 10;
+
+	private:
+		TimerService& timerService;
+		TimerService& boundaryService;
+		SoftTimer softTimer;
+		SoftTimer boundaryTimer;
+		SoftTimer earlierTimer;		// One tick before boundaryTimer.
+		Timer timer;
+		ITimerServiceBenchTask* tasks[MAX_TASKS];
+		uint32_t nofTasks;
+
+	public:
+		TimerServiceBenchController(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			TimerService& timerService, TimerService& boundaryService) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), timerService(timerService), boundaryService(boundaryService),
+			softTimer(this, timerService), boundaryTimer(this, boundaryService), earlierTimer(this, boundaryService), timer(this), nofTasks(0)
+		{
+			start();
+		}
+
+		// The duration of SoftTimer number index, of all tasks together.
+		static uint64_t getDurationUs(uint32_t index)
+		{
+			return (20 + index % 100) * 1000;
+		}
+
+		void addTask(ITimerServiceBenchTask& task)
+		{
+			assert(nofTasks < MAX_TASKS);
+			tasks[nofTasks++] = &task;
+		}
+
+	private:
+		uint32_t getReceived()
+		{
+			uint32_t received = 0;
+			for (uint32_t i = 0; i < nofTasks; i++) received += tasks[i]->getReceived();
+			return received;
+		}
+
+		// Returns the time of a start() plus a stop(), in ns.
+		template<typename TIMER> uint32_t measureStartStop(TIMER& timerToMeasure)
+		{
+			int64_t startUs = esp_timer_get_time();
+			for (uint32_t i = 0; i < START_STOP_COUNT; i++)
+			{
+				timerToMeasure.start(10000);
+				timerToMeasure.stop();
+			}
+			return (uint32_t)((esp_timer_get_time() - startUs) * 1000 / START_STOP_COUNT);
+		}
+
+		// The deadline of the middle of the tick, such that the few microseconds until start()
+		// reads the time do not move it to another tick.
+		int64_t toDueUs(uint64_t tick)
+		{
+			return boundaryService.getBaseUs() + (int64_t)tick * boundaryService.getResolutionUs() - boundaryService.getResolutionUs() / 2;
+		}
+
+		void benchSlotBoundary()
+		{
+			boundaryTimer.sleep_us(1000);	// Sets the base of boundaryService.
+			boundaryService.resetStats();
+			int64_t resolutionUs = boundaryService.getResolutionUs();
+			for (uint32_t i = 0; i < BOUNDARY_COUNT; i++)
+			{
+				// Deadlines beyond level 0, on the first tick of a slot of level 1 and on the tick before.
+				uint64_t nowTick = (uint64_t)((esp_timer_get_time() - boundaryService.getBaseUs()) / resolutionUs) + 1;
+				uint64_t boundaryTick = (nowTick + 2 * TimerService::SLOTS) & ~(uint64_t)(TimerService::SLOTS - 1);
+				boundaryTimer.start(toDueUs(boundaryTick) - esp_timer_get_time());
+				earlierTimer.start(toDueUs(boundaryTick - 1) - esp_timer_get_time());
+				waitAll(boundaryTimer + earlierTimer);
+			}
+			TimerServiceStats stats = boundaryService.getStats();
+			ESP_LOGI("TimerServiceBench", "deadline on a slot of level 1: wake-ups: %" PRIu32 " (%" PRIu32 " expected)  fired: %" PRIu32,
+				stats.wakeUps, 2 * BOUNDARY_COUNT, stats.fired);
+			assert(stats.fired == 2 * BOUNDARY_COUNT);
+			assert(stats.wakeUps == 2 * BOUNDARY_COUNT);	// Not a wake-up of its own, a tick later, for the boundary.
+		}
+
+		/*override keyword not supported*/
+		void main()
+		{
+			vTaskDelay(1000); // wait for other threads to have started up as well.
+
+			ESP_LOGI("TimerServiceBench", "start+stop, idle:     SoftTimer: %5" PRIu32 " ns  Timer: %5" PRIu32 " ns",
+				measureStartStop(softTimer), measureStartStop(timer));
+
+			for (uint32_t i = 0; i < nofTasks; i++) tasks[i]->go();
+			vTaskDelay(500);	// Let the load settle.
+			timerService.resetStats();
+			uint32_t receivedBefore = getReceived();
+			vTaskDelay(RUN_MS);
+			TimerServiceStats stats = timerService.getStats();
+			uint32_t received = getReceived() - receivedBefore;
+
+			ESP_LOGI("TimerServiceBench", "start+stop, %4" PRIu32 " running: SoftTimer: %5" PRIu32 " ns",
+				nofTasks * TIMERS_PER_TASK, measureStartStop(softTimer));
+
+			for (uint32_t i = 0; i < nofTasks; i++) tasks[i]->stop();
+
+			// The one-shot SoftTimers fire a bit less often, as their tasks start them again a bit later.
+			uint64_t expectedPerKiloSecond = 0;
+			for (uint32_t i = 0; i < nofTasks * TIMERS_PER_TASK; i++) expectedPerKiloSecond += 1000000000 / getDurationUs(i);
+			uint32_t expectedPerSecond = (uint32_t)(expectedPerKiloSecond / 1000);
+
+			uint32_t seconds100 = (uint32_t)(stats.elapsedUs / 10000);
+			ESP_LOGI("TimerServiceBench", "fired/s: %5" PRIu32 " (%5" PRIu32 " expected)  received by the tasks/s: %5" PRIu32 "  overruns: %" PRIu32,
+				stats.fired * 100 / seconds100, expectedPerSecond, received * 100 / seconds100, stats.overruns);
+			ESP_LOGI("TimerServiceBench", "wake-ups/s: %5" PRIu32 "  cascaded/s: %5" PRIu32,
+				stats.wakeUps * 100 / seconds100, stats.cascaded * 100 / seconds100);
+			ESP_LOGI("TimerServiceBench", "lateness avg: %4" PRIu32 " us  max: %5" PRIu32 " us  CPU in the TimerService: %.2f%%",
+				(uint32_t)(stats.totalLatenessUs / (stats.fired > 0 ? stats.fired : 1)), (uint32_t)stats.maxLatenessUs,
+				(double)stats.activeUs * 100 / stats.elapsedUs);
+
+			benchSlotBoundary();
+			ESP_LOGI("TimerServiceBench", "TimerServiceBench done");
+
+			while (true)
+			{
+				vTaskDelay(1000);
+			}
+		}
+	}; // end class TimerServiceBenchController
+	class TimerServiceBenchTask : public Task, public ITimerServiceBenchTask
+	{
+	public:
+		static const uint32_t NOFTIMERS = TimerServiceBenchController::TIMERS_PER_TASK;
+
+	private:
+		SoftTimer timers[NOFTIMERS];
+		uint64_t durationsUs[NOFTIMERS];
+		uint32_t timersMask;
+		Flag flagGo;
+		Flag flagStop;
+		uint32_t firstIndex;
+		uint32_t received;
+
+	public:
+		TimerServiceBenchTask(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			TimerService& timerService, TimerServiceBenchController& controller, uint32_t firstIndex) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber),
+			timers{ {this, timerService}, {this, timerService}, {this, timerService}, {this, timerService}, {this, timerService},
+					{this, timerService}, {this, timerService}, {this, timerService}, {this, timerService}, {this, timerService},
+					{this, timerService}, {this, timerService}, {this, timerService}, {this, timerService}, {this, timerService},
+					{this, timerService}, {this, timerService}, {this, timerService}, {this, timerService}, {this, timerService} },
+			timersMask(0), flagGo(this), flagStop(this), firstIndex(firstIndex), received(0)
+		{
+			for (uint32_t i = 0; i < NOFTIMERS; i++)
+			{
+				durationsUs[i] = TimerServiceBenchController::getDurationUs(firstIndex + i);
+				timersMask |= timers[i].getBitMask();
+			}
+			controller.addTask(*this);
+			start();
+		}
+
+		void go()
+		{
+			flagGo.set();
+		}
+
+		void stop()
+		{
+			flagStop.set();
+		}
+
+		uint32_t getReceived()
+		{
+			return received;
+		}
+
+	private:
+		bool isPeriodic(uint32_t i)
+		{
+			return ((firstIndex + i) % 2) == 1;
+		}
+
+		/*override keyword not supported*/
+		void main()
+		{
+			wait(flagGo);
+			for (uint32_t i = 0; i < NOFTIMERS; i++)
+			{
+				if (isPeriodic(i))
+				{
+					timers[i].start_periodic(durationsUs[i]);
+				}
+				else
+				{
+					timers[i].start(durationsUs[i]);
+				}
+			}
+
+			while (true)
+			{
+				waitAny(timersMask | flagStop.getBitMask());
+				if (hasFired(flagStop))
+				{
+					for (uint32_t i = 0; i < NOFTIMERS; i++) timers[i].stop();
+					continue;
+				}
+				for (uint32_t i = 0; i < NOFTIMERS; i++)
+				{
+					if (hasFired(timers[i]))
+					{
+						received++;
+						if (!isPeriodic(i)) timers[i].start(durationsUs[i]);
+					}
+				}
+			}
+		}
+	}; // end class TimerServiceBenchTask
+
+};// end namespace crt
@@ -0,0 +1,42 @@
+// by Marius Versteegen, 2025
+
+#include <crt_CleanRTOS.h>        // This file includes crt_Config.h  You'll need to change defines there for a release build.
+
+// All Tasks should be created in this main file.
+// The TraceLogger is a task, so let's include it here.
+#include <crt_TraceLogger.h>
+#include <crt_TraceSinks.h>
+#include "crt_TraceLoggerBench.h"
+namespace crt
+{
+	MainInits mainInits;            // Initialize CleanRTOS.
+
+	// To decode the traces on the PC instead, use:
+	// TraceBinarySink innerSink;
+	// and pipe the serial output through tools/trace_decode.py.
+	TraceTextSink innerSink;
+	TraceBenchSink traceBenchSink(innerSink);
+	BenchTraceLogger traceLogger("TraceLogger", 1 /*priority*/, ARDUINO_RUNNING_CORE, 10 /*drainPeriodMs*/, traceBenchSink);
+
+	TraceBenchProducer producer0("TraceBenchProducer0", 2 /*priority*/, 4000 /*stackBytes*/, 0 /*core*/, traceLogger, 0);
+	TraceBenchProducer producer1("TraceBenchProducer1", 2 /*priority*/, 4000 /*stackBytes*/, 1 /*core*/, traceLogger, 1);
+	TraceBenchProducer producer2("TraceBenchProducer2", 2 /*priority*/, 4000 /*stackBytes*/, 0 /*core*/, traceLogger, 2);
+	TraceBenchProducer producer3("TraceBenchProducer3", 2 /*priority*/, 4000 /*stackBytes*/, 1 /*core*/, traceLogger, 3);
+
+	TraceLoggerBenchController traceLoggerBenchController("TraceLoggerBenchController", 3 /*priority*/, 4000 /*stackBytes*/, ARDUINO_RUNNING_CORE,
+		traceLogger, traceBenchSink);
+}
+
+void setup()
+{
+	ESP_LOGI("checkpoint", "start of main");
+	crt::traceLoggerBenchController.setProducer(0, crt::producer0);
+	crt::traceLoggerBenchController.setProducer(1, crt::producer1);
+	crt::traceLoggerBenchController.setProducer(2, crt::producer2);
+	crt::traceLoggerBenchController.setProducer(3, crt::producer3);
+}
+
+void loop()
+{
+	vTaskDelay(1);// Nothing to do in loop - all example code runs in the tasks above.
+}
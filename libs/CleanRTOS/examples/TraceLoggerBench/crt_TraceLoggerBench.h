@@ -0,0 +1,226 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <atomic>
+#include <crt_CleanRTOS.h>
+#include <crt_TraceLogger.h>
+#include <crt_TraceSinks.h>
+
+// This file measures the TraceLogger:
+//  - The time per trace() call, with 0, 1 and 4 numbers. The calls are made in batches that
+//    fit in the ring, with a pause in between for the drain task, so nothing is dropped.
+//  - A flood: NOFPRODUCERS tasks trace in bursts for FLOOD_MS, more than the drain task
+//    gets rid of. Every trace must be either drained or counted as dropped.
+//  - A sample of traces with several types of numbers, which is passed on to the inner sink
+//    (a TraceTextSink, or a TraceBinarySink for tools/trace_decode.py).
+
+namespace crt
+{
+	typedef TraceLogger<512 /*RECORDS_PER_CORE*/> BenchTraceLogger;
+
+	// Counts what the drain task delivers, and only passes it on to the inner sink
+	// while bForward is set, such that the UART does not limit the bench.
+	class TraceBenchSink : public ITraceSink
+	{
+	public:
+		::std::atomic<uint32_t> nofWritten;
+		::std::atomic<uint32_t> nofLost;
+		::std::atomic<bool> bForward;
+
+	private:
+		ITraceSink& innerSink;
+
+	public:
+		TraceBenchSink(ITraceSink& innerSink) : nofWritten(0), nofLost(0), bForward(false), innerSink(innerSink)
+		{}
+
+		/*override keyword not supported*/
+		void write(uint32_t core, const TraceEntry& entry)
+		{
+			nofWritten++;
+			if (bForward) innerSink.write(core, entry);
+		}
+
+		/*override keyword not supported*/
+		void lost(uint32_t core, uint32_t count)
+		{
+			nofLost += count;
+			if (bForward) innerSink.lost(core, count);
+		}
+
+		/*override keyword not supported*/
+		void flush()
+		{
+			innerSink.flush();
+		}
+	};
+
+	class TraceBenchProducer : public Task
+	{
+	public:
+		static const uint32_t BURST = 100;
+
+		::std::atomic<uint32_t> nofAttempts;
+
+	private:
+		Flag flagGo;
+		BenchTraceLogger& traceLogger;
+		uint32_t id;
+		int64_t untilUs;
+
+	public:
+		TraceBenchProducer(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			BenchTraceLogger& traceLogger, uint32_t id) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), nofAttempts(0), flagGo(this), traceLogger(traceLogger), id(id), untilUs(0)
+		{
+			start();
+		}
+
+		// Called by the controller.
+		void flood(uint32_t durationMs)
+		{
+			untilUs = esp_timer_get_time() + (int64_t)durationMs * 1000;
+			flagGo.set();
+		}
+
+	private:
+		/*override keyword not supported*/
+		void main()
+		{
+			while (true)
+			{
+				wait(flagGo);
+				uint32_t i = 0;
+				while (esp_timer_get_time() < untilUs)
+				{
+					for (uint32_t j = 0; j < BURST; j++)
+					{
+						traceLogger.trace("producer %" PRIu32 ": %" PRIu32, id, i++);
+					}
+					nofAttempts += BURST;
+					vTaskDelay(1);
+				}
+			}
+		}
+	}; // end class TraceBenchProducer
+
+	class TraceLoggerBenchController : public Task
+	{
+	public:
+		static const uint32_t NOFPRODUCERS = 4;
+		static const uint32_t BATCH = 256;
+		static const uint32_t BATCHES = 40;
+		static const uint32_t FLOOD_MS = 500;
+
+	private:
+		BenchTraceLogger& traceLogger;
+		TraceBenchSink& sink;
+		TraceBenchProducer* producers[NOFPRODUCERS];
+
+	public:
+		TraceLoggerBenchController(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			BenchTraceLogger& traceLogger, TraceBenchSink& sink) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), traceLogger(traceLogger), sink(sink), producers{}
+		{
+			start();
+		}
+
+		void setProducer(uint32_t index, TraceBenchProducer& producer)
+		{
+			producers[index] = &producer;
+		}
+
+	private:
+		void benchCall(uint32_t nofArgs, const char* label)
+		{
+			uint32_t droppedBefore = traceLogger.getStats().dropped;
+			int64_t sumUs = 0;
+			for (uint32_t batch = 0; batch < BATCHES; batch++)
+			{
+				int64_t startUs = esp_timer_get_time();
+				for (uint32_t i = 0; i < BATCH; i++)
+				{
+					switch (nofArgs)
+					{
+					case 0:
+						traceLogger.trace("tick");
+						break;
+					case 1:
+						traceLogger.trace("i: %" PRIu32, i);
+						break;
+					default:
+						traceLogger.trace("i: %" PRIu32 " batch: %" PRIu32 " x: %f y: %d", i, batch, 0.5f, -1);
+						break;
+					}
+				}
+				sumUs += esp_timer_get_time() - startUs;
+				vTaskDelay(20);	// Let the drain task empty the ring.
+			}
+			uint32_t dropped = traceLogger.getStats().dropped - droppedBefore;
+			ESP_LOGI("TraceLoggerBench", "%-20s %6.1f ns per call, dropped: %" PRIu32,
+				label, (double)sumUs * 1000.0 / (BATCHES * BATCH), dropped);
+		}
+
+		void benchFlood()
+		{
+			vTaskDelay(50);	// Such that the calls above have been drained.
+			uint32_t writtenBefore = sink.nofWritten;
+			uint32_t lostBefore = sink.nofLost;
+			uint32_t attemptsBefore = 0;
+			for (uint32_t p = 0; p < NOFPRODUCERS; p++)
+			{
+				attemptsBefore += producers[p]->nofAttempts;
+			}
+
+			for (uint32_t p = 0; p < NOFPRODUCERS; p++)
+			{
+				producers[p]->flood(FLOOD_MS);
+			}
+			vTaskDelay(FLOOD_MS + 200);	// The flood, plus the time for the last drains.
+
+			uint32_t attempts = 0;
+			for (uint32_t p = 0; p < NOFPRODUCERS; p++)
+			{
+				attempts += producers[p]->nofAttempts;
+			}
+			attempts -= attemptsBefore;
+			uint32_t written = sink.nofWritten - writtenBefore;
+			uint32_t lost = sink.nofLost - lostBefore;
+			ESP_LOGI("TraceLoggerBench", "flood of %" PRIu32 " producers: %" PRIu32 " traces, %" PRIu32 " drained, %" PRIu32 " dropped (%.1f%%)",
+				NOFPRODUCERS, attempts, written, lost, attempts ? 100.0 * lost / attempts : 0.0);
+			ESP_LOGI("TraceLoggerBench", "drained: %.0f traces per second", written * 1000.0 / FLOOD_MS);
+			assert(written + lost == attempts);	// No trace is lost silently.
+		}
+
+		void sample()
+		{
+			sink.bForward = true;
+			traceLogger.trace("sample: no numbers, 100%% sure");
+			traceLogger.trace("sample: int32 %" PRId32 ", uint32 %" PRIu32 ", hex 0x%08" PRIx32, (int32_t)-42, (uint32_t)4000000000u, (uint32_t)0xbeef);
+			traceLogger.trace("sample: float %.3f, double %g, char %c", 3.14159f, 2.5e-3, 'x');
+			traceLogger.logText("sample: via ILogger");
+			traceLogger.logInt32(-7);
+			traceLogger.logFloat(1.5f);
+			vTaskDelay(50);
+			sink.bForward = false;
+		}
+
+		/*override keyword not supported*/
+		void main()
+		{
+			vTaskDelay(1000); // wait for other threads to have started up as well.
+
+			benchCall(0, "trace(), 0 numbers");
+			benchCall(1, "trace(), 1 number");
+			benchCall(4, "trace(), 4 numbers");
+			benchFlood();
+			sample();
+			ESP_LOGI("TraceLoggerBench", "TraceLoggerBench done");
+
+			while (true)
+			{
+				vTaskDelay(1000);
+			}
+		}
+	}; // end class TraceLoggerBenchController
+};// end namespace crt
@@ -0,0 +1,24 @@
+// by Marius Versteegen, 2025
+
+#include <crt_CleanRTOS.h>        // This file includes crt_Config.h  You'll need to change defines there for a release build.
+
+// All Tasks should be created in this main file.
+#include "crt_WaitBench.h"
+namespace crt
+{
+	MainInits mainInits;            // Initialize CleanRTOS.
+
+	WaitBenchController waitBenchController("WaitBenchController", 2 /*priority*/, 4000 /*stackBytes*/, ARDUINO_RUNNING_CORE);
+	WaitBenchWaiter waitBenchWaiter("WaitBenchWaiter", 2 /*priority*/, 4000 /*stackBytes*/, ARDUINO_RUNNING_CORE, waitBenchController);
+}
+
+void setup()
+{
+	ESP_LOGI("checkpoint", "start of main");
+	crt::waitBenchController.setWaiter(crt::waitBenchWaiter);
+}
+
+void loop()
+{
+	vTaskDelay(1);// Nothing to do in loop - all example code runs in the tasks above.
+}
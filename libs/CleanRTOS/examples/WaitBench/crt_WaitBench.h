@@ -0,0 +1,215 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <atomic>
+#include <crt_CleanRTOS.h>
+
+// This file measures the wake latency of a task with 50 flags, which span three event groups:
+// 23 in the first, 24 in the second and 3 in the third. Per bench, the WaitBenchController
+// sets a flag ROUNDS times, once per 2 ms, and the WaitBenchWaiter measures the time from
+// the set() to its wake-up (or, for the timeouts, waits TIMEOUT_ROUNDS times):
+//  - wait(flag):             the plain wait for a single flag of the first event group.
+//  - waitAny(set), group 0:  a WaitableSet of all 50 flags; the flag is in the first event group.
+//  - waitAny(set), group 2:  the same set; the flag is in the third event group.
+//  - waitAny(a+b+c), group 1: a bitmask of three flags of the second event group, combined
+//                            with +; the middle one is set.
+//  - waitAny(set), timeout:  no flag is set; the time from the timeout of TIMEOUT_MS to the return.
+//  - waitAny(mask), timeout: the same, with a bitmask of two flags of the first event group.
+
+namespace crt
+{
+	enum class WaitBenchMode { Single, SetFirstGroup, SetLastGroup, MaskSecondGroup, SetTimeout, MaskTimeout };
+
+	class IWaitBenchListener
+	{
+	public:
+		virtual void benchDone() = 0;
+	};
+
+	class WaitBenchWaiter : public Task
+	{
+	public:
+		static const uint32_t NOFFLAGS = 50;
+		static const uint32_t ROUNDS = 500;
+		static const uint32_t TIMEOUT_ROUNDS = 100;
+		static const uint32_t TIMEOUT_MS = 5;
+
+	private:
+		Flag flags[NOFFLAGS];
+		Flag flagGo;
+		WaitableSet allFlags;
+		IWaitBenchListener& listener;
+		WaitBenchMode mode;
+		const char* label;
+		::std::atomic<int64_t> setUs;
+
+	public:
+		WaitBenchWaiter(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber,
+			IWaitBenchListener& listener) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber),
+			flags{ this, this, this, this, this, this, this, this, this, this,
+				this, this, this, this, this, this, this, this, this, this,
+				this, this, this, this, this, this, this, this, this, this,
+				this, this, this, this, this, this, this, this, this, this,
+				this, this, this, this, this, this, this, this, this, this },
+			flagGo(this), listener(listener), mode(WaitBenchMode::Single), label(""), setUs(0)
+		{
+			for (uint32_t i = 0; i < NOFFLAGS; i++)
+			{
+				allFlags.add(flags[i]);
+			}
+			start();
+		}
+
+		// Called by the controller.
+		void run(WaitBenchMode mode, const char* label)
+		{
+			this->mode = mode;
+			this->label = label;
+			flagGo.set();
+		}
+
+		bool isTimeoutBench()
+		{
+			return mode == WaitBenchMode::SetTimeout || mode == WaitBenchMode::MaskTimeout;
+		}
+
+		// Called by the controller.
+		void setFlag()
+		{
+			Flag& flag = (mode == WaitBenchMode::SetLastGroup) ? flags[NOFFLAGS - 1] :
+				(mode == WaitBenchMode::MaskSecondGroup) ? flags[25] : flags[0];
+			setUs = esp_timer_get_time();
+			flag.set();
+		}
+
+	private:
+		// Returns the latency of a single round.
+		int64_t waitOnce()
+		{
+			int64_t startUs = esp_timer_get_time();
+			bool bFired = false;
+			switch (mode)
+			{
+			case WaitBenchMode::Single:
+				wait(flags[0]);
+				return esp_timer_get_time() - setUs;
+			case WaitBenchMode::SetFirstGroup:
+				waitAny(allFlags);
+				bFired = hasFired(flags[0]);
+				assert(bFired);
+				return esp_timer_get_time() - setUs;
+			case WaitBenchMode::SetLastGroup:
+				waitAny(allFlags);
+				bFired = hasFired(flags[NOFFLAGS - 1]);
+				assert(bFired);
+				return esp_timer_get_time() - setUs;
+			case WaitBenchMode::MaskSecondGroup:
+				assert(((flags[24] + flags[25] + flags[26]) >> Waitable::groupShift) == 1);	// Not the sum of the group bytes.
+				waitAny(flags[24] + flags[25] + flags[26]);
+				bFired = hasFired(flags[25]);
+				assert(bFired);
+				return esp_timer_get_time() - setUs;
+			case WaitBenchMode::SetTimeout:
+				bFired = waitAny(allFlags, TIMEOUT_MS);
+				break;
+			case WaitBenchMode::MaskTimeout:
+				bFired = waitAny(flags[1] + flags[2], TIMEOUT_MS);
+				break;
+			}
+			assert(!bFired);
+			return esp_timer_get_time() - startUs - TIMEOUT_MS * 1000;
+		}
+
+		/*override keyword not supported*/
+		void main()
+		{
+			while (true)
+			{
+				wait(flagGo);
+
+#ifdef CRT_HOST
+				uint32_t kernelCallsBefore = crt_host::kernelCalls;
+#endif
+				uint32_t rounds = isTimeoutBench() ? TIMEOUT_ROUNDS : ROUNDS;
+				int64_t sumLatencyUs = 0;
+				int64_t maxLatencyUs = 0;
+				for (uint32_t i = 0; i < rounds; i++)
+				{
+					int64_t latencyUs = waitOnce();
+					sumLatencyUs += latencyUs;
+					if (latencyUs > maxLatencyUs) maxLatencyUs = latencyUs;
+				}
+#ifdef CRT_HOST
+				// Including the set() calls of the controller.
+				double kernelCallsPerRound = (double)(crt_host::kernelCalls - kernelCallsBefore) / rounds;
+#endif
+
+				ESP_LOGI("WaitBench", "%-24s latency avg: %4" PRIu32 " us  max: %5" PRIu32 " us",
+					label, (uint32_t)(sumLatencyUs / rounds), (uint32_t)maxLatencyUs);
+#ifdef CRT_HOST
+				ESP_LOGI("WaitBench", "%-24s kernel calls per round: %.2f", label, kernelCallsPerRound);
+#endif
+				listener.benchDone();
+			}
+		}
+	}; // end class WaitBenchWaiter
+
+	class WaitBenchController : public Task, public IWaitBenchListener
+	{
+	private:
+		Flag flagDone;
+		WaitBenchWaiter* pWaiter;
+
+	public:
+		WaitBenchController(const char *taskName, unsigned int taskPriority, unsigned int taskSizeBytes, unsigned int taskCoreNumber) :
+			Task(taskName, taskPriority, taskSizeBytes, taskCoreNumber), flagDone(this), pWaiter(nullptr)
+		{
+			start();
+		}
+
+		void setWaiter(WaitBenchWaiter& waiter)
+		{
+			pWaiter = &waiter;
+		}
+
+		void benchDone()
+		{
+			flagDone.set();
+		}
+
+	private:
+		void runBench(WaitBenchMode mode, const char* label)
+		{
+			pWaiter->run(mode, label);
+			if (!pWaiter->isTimeoutBench())
+			{
+				for (uint32_t i = 0; i < WaitBenchWaiter::ROUNDS; i++)
+				{
+					vTaskDelay(2);	// Such that the waiter is asleep.
+					pWaiter->setFlag();
+				}
+			}
+			wait(flagDone);
+		}
+
+		/*override keyword not supported*/
+		void main()
+		{
+			vTaskDelay(1000); // wait for other threads to have started up as well.
+
+			runBench(WaitBenchMode::Single, "wait(flag)");
+			runBench(WaitBenchMode::SetFirstGroup, "waitAny(set), group 0");
+			runBench(WaitBenchMode::SetLastGroup, "waitAny(set), group 2");
+			runBench(WaitBenchMode::MaskSecondGroup, "waitAny(a+b+c), group 1");
+			runBench(WaitBenchMode::SetTimeout, "waitAny(set), timeout");
+			runBench(WaitBenchMode::MaskTimeout, "waitAny(mask), timeout");
+			ESP_LOGI("WaitBench", "WaitBench done");
+
+			while (true)
+			{
+				vTaskDelay(1000);
+			}
+		}
+	}; // end class WaitBenchController
+};// end namespace crt
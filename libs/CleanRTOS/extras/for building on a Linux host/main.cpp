@@ -0,0 +1,39 @@
+// by Marius Versteegen, 2025
+
+// The counterpart of the main.cpp in "for building with ESP_IDF", for a Linux host.
+// It wraps an Arduino IDE .ino file, such that it runs on the host backend of
+// CleanRTOS (see src/internals/host/crt_HostFreeRTOS.h).
+//
+// The .ino is chosen by CMakeLists.txt, via CRT_HOST_INO.
+// Usage: <example> [seconds]   - runs setup() and loop() for that many seconds (default 4, as in CMakeLists.txt).
+
+#include <crt_CleanRTOS.h>
+#include <crt_Logger.h>
+
+namespace crt
+{
+	// Create a "global" logger object within namespace crt, like the main.cpp of the ESP32 does.
+	const unsigned int pinButtonDump = 22; // Pulling this pin low dumps the latest logs.
+	Logger<100> theLogger("Logger", 2 /*priority*/, ARDUINO_RUNNING_CORE, pinButtonDump);
+	ILogger& logger = theLogger;
+}
+
+#include CRT_HOST_INO
+
+int main(int argc, char* argv[])
+{
+	int64_t runUs = (argc > 1 ? atoi(argv[1]) : 4) * 1000000LL;
+
+	crt_host::startScheduler();
+	setup();
+	int64_t startUs = esp_timer_get_time();
+	while (esp_timer_get_time() - startUs < runUs)
+	{
+		loop();
+		taskYIELD();
+	}
+
+	// The tasks never end, so leave without running the destructors of the global objects.
+	fflush(stdout);
+	_exit(0);
+}
@@ -16,7 +16,10 @@
 #include "crt_Task.h"
 #include "crt_Flag.h"
 #include "crt_Queue.h"
+#include "crt_SpscQueue.h"
+#include "crt_MpscQueue.h"
 #include "crt_Timer.h"
+#include "crt_TimerService.h"
 #include "crt_Pool.h"
 #include "crt_IHandler.h"
 #include "crt_IHandlerListener.h"
@@ -11,6 +11,7 @@
 namespace crt
 {
 	const uint32_t MAX_MUTEXNESTING = 20;
+	const uint32_t MAX_EVENTGROUPS = 4;		// Per Task: 23 waitables in the first event group, 24 in each next one.
 
 	// below, the mutexIDs directly involved in this test can be found.
 	const uint32_t MutexID_Logger = (1 << 30);	// High ID, so can be nested very deeply.
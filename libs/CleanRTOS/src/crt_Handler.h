@@ -2,6 +2,7 @@
 #include "internals/crt_FreeRTOS.h"
 #include "crt_ILogger.h"
 #include "crt_Task.h"
+#include "crt_Timer.h"
 #include "crt_IHandler.h"
 #include "crt_IHandlerListener.h"
 
@@ -9,38 +10,81 @@
 
 // A Handler object can be used to replace multiple periodic tasks by a single task,
 // thereby saving task-switching overhead and resources.
- 
-// For that end, the handler task periodically calls update() member functions of the 
+
+// For that end, the handler task periodically calls update() member functions of the
 // objects that originally had their own task.
 
-// (see the Handler example in the examples folder)
+// Each listener can be added with a period and phase of its own. By default, it gets the
+// period of the Handler, and phase 0. The Handler keeps its listeners in a min-heap on their
+// next deadline, calls the ones that are due, and then sleeps until the next deadline
+// (with vTaskDelay for the whole ticks, and a Timer for the rest).
+
+// Per listener, the Handler keeps statistics (see getListenerStats()): how late update() was called
+// (the jitter), how long it took, and how many periods were skipped because a deadline
+// had already passed (overruns). getHandlerStats() tells how much of the time the Handler was busy.
+
+// (see the Handler and HandlerBench examples in the examples folder)
 
-// NOTE: a Handler task must be started manually after its listeners have been added,
-// by calling its start() member function.
+// NOTE: a Handler task starts itself, and waits 500 ms for its listeners to be added before
+// it schedules them. Calling its start() member function again (from setup(), as the examples
+// do) is harmless. A listener that is added later is scheduled at the next wake-up of the
+// Handler, and first updated phaseMs after that.
 
 // This Handler class assumes that 1 tick equals 1ms.
 // Within the ArduinoIDE, that's the default already.
-// The ESP_IDF however, uses 10ms per tick by default 
+// The ESP_IDF however, uses 10ms per tick by default
 //    so if you use that, update in sdkconfig: CONFIG_FREERTOS_HZ=1000
 
-// The define below can be uncommented temporarily to analyse the timings of the handler.
-// #define TEST_CRT_HANDLER
-
 namespace crt
 {
 	extern ILogger& logger;
 
+	struct HandlerListenerStats
+	{
+		uint32_t updates;
+		uint32_t overruns;			// Periods that were skipped, because their deadline had passed.
+		int64_t totalLatenessUs;	// The time from the deadline to the call of update().
+		int64_t maxLatenessUs;
+		int64_t totalUpdateUs;		// The time spent in update().
+		int64_t maxUpdateUs;
+	};
+
+	struct HandlerStats
+	{
+		uint32_t wakeUps;
+		int64_t activeUs;			// The time from each wake-up to the next sleep.
+		int64_t elapsedUs;
+	};
+
 	template<unsigned int MAXLISTENERCOUNT> class Handler : public Task, public IHandler
 	{
-	private: 
-		const uint64_t infiniteBatchSizeUs = 1000000000000; // 1e6 s means: infinite: no limitation in batchsize.
+	private:
+		static const uint64_t infiniteBatchSizeUs = 1000000000000; // 1e6 s means: infinite: no limitation in batchsize.
+		static const int64_t minTimerSleepUs = 50;			// A Timer cannot sleep shorter.
+
+		struct Entry
+		{
+			IHandlerListener* pListener;
+			uint64_t periodUs;
+			uint64_t phaseUs;
+			uint64_t dueUs;
+			HandlerListenerStats stats;
+		};
 
 		// that converts LOGSIZE to stackSize in the initializer list of the constructor.
-		IHandlerListener* arHandlerListener[MAXLISTENERCOUNT] = {};
-		uint16_t nofHandlerListeners;
+		Entry entries[MAXLISTENERCOUNT] = {};
+		uint16_t nofHandlerListeners;			// Guarded by mux: listeners may be added by any task.
+		portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+		// Only used by the Handler task, so a listener that is added meanwhile cannot disturb it.
+		uint16_t heap[MAXLISTENERCOUNT] = {};	// Indices in entries, ordered on dueUs.
+		uint16_t nofScheduled;					// The entries that are in the heap.
 		uint16_t periodMs;
 		uint64_t periodUs;
 		uint64_t batchSizeUs;
+		Timer timer;
+		HandlerStats handlerStats;
+		int64_t statsStartUs;
+		bool bStarted;
 
 	public:
 		Handler(const char* taskName, unsigned int taskPriority, unsigned int taskCoreNumber, uint16_t periodMs) :
@@ -51,19 +95,79 @@ namespace crt
 		// batchSizeUs : if a series of consequtive update() calls exceeds batchSizeUs,
 		//               a task yield is inserted.
 		Handler(const char *taskName, unsigned int taskPriority, unsigned int taskCoreNumber, uint16_t periodMs, uint64_t batchSizeUs) :
-			Task(taskName, taskPriority, 5500 + MAXLISTENERCOUNT * sizeof(IHandlerListener*), taskCoreNumber), nofHandlerListeners(0), periodMs(periodMs), periodUs(periodMs*1000), batchSizeUs(batchSizeUs)// assert period.
+			Task(taskName, taskPriority, 5500 + MAXLISTENERCOUNT * sizeof(IHandlerListener*), taskCoreNumber), nofHandlerListeners(0), nofScheduled(0), periodMs(periodMs), periodUs(periodMs*1000), batchSizeUs(batchSizeUs),// assert period.
+			timer(this), handlerStats(), statsStartUs(0), bStarted(false)
 		{
 			start();
 		}
 
+		// Starts the task, once.
+		void start()
+		{
+			if (!bStarted)
+			{
+				bStarted = true;
+				Task::start();
+			}
+		}
+
 		/*override keyword not supported in current compiler*/
 		void addHandlerListener(IHandlerListener* pHandlerListener)
 		{
+			addHandlerListener(pHandlerListener, periodMs, 0);
+		}
+
+		// update() is called every periodMs, the first time phaseMs after the Handler starts
+		// (or, if it has started already, after its next wake-up).
+		// Different phases for listeners with the same period spread their updates.
+		/*override keyword not supported in current compiler*/
+		void addHandlerListener(IHandlerListener* pHandlerListener, uint32_t periodMs, uint32_t phaseMs)
+		{
+			assert(periodMs > 0);
+			taskENTER_CRITICAL(&mux);
 			if (!isAlreadyPresent(pHandlerListener))
-			{	
+			{
 				assert(nofHandlerListeners < MAXLISTENERCOUNT);
-				arHandlerListener[nofHandlerListeners++] = pHandlerListener;
+				Entry& entry = entries[nofHandlerListeners];
+				entry.pListener = pHandlerListener;
+				entry.periodUs = (uint64_t)periodMs * 1000;
+				entry.phaseUs = (uint64_t)phaseMs * 1000;
+				nofHandlerListeners++;	// The Handler task picks it up from here.
 			}
+			taskEXIT_CRITICAL(&mux);
+		}
+
+		// Can be called by any task. The numbers may be an update behind.
+		HandlerListenerStats getListenerStats(IHandlerListener* pHandlerListener)
+		{
+			for (int i = 0; i < nofHandlerListeners; i++)
+			{
+				if (entries[i].pListener == pHandlerListener)
+				{
+					return entries[i].stats;
+				}
+			}
+			assert(false); // Not a listener of this Handler.
+			return HandlerListenerStats();
+		}
+
+		HandlerStats getHandlerStats()
+		{
+			HandlerStats result = handlerStats;
+			result.elapsedUs = esp_timer_get_time() - statsStartUs;
+			return result;
+		}
+
+		// Clears the statistics of the Handler and its listeners. The result of a
+		// simultaneous update is lost.
+		void resetStats()
+		{
+			for (int i = 0; i < nofHandlerListeners; i++)
+			{
+				entries[i].stats = HandlerListenerStats();
+			}
+			handlerStats = HandlerStats();
+			statsStartUs = esp_timer_get_time();
 		}
 
 	private:
@@ -71,7 +175,7 @@ namespace crt
 		{
 			for (int i = 0; i < nofHandlerListeners; i++)
 			{
-				if (arHandlerListener[i] == pHandlerListener)
+				if (entries[i].pListener == pHandlerListener)
 				{
 					return true;
 				}
@@ -79,93 +183,151 @@ namespace crt
 			return false;
 		}
 
+		// Listeners with the same deadline are updated in the order in which they were added.
+		bool isEarlier(uint16_t a, uint16_t b)
+		{
+			const Entry& entryA = entries[heap[a]];
+			const Entry& entryB = entries[heap[b]];
+			return (entryA.dueUs < entryB.dueUs) || (entryA.dueUs == entryB.dueUs && heap[a] < heap[b]);
+		}
+
+		void swap(uint16_t a, uint16_t b)
+		{
+			uint16_t temp = heap[a];
+			heap[a] = heap[b];
+			heap[b] = temp;
+		}
+
+		void siftUp(uint16_t pos)
+		{
+			while (pos > 0)
+			{
+				uint16_t parent = (pos - 1) / 2;
+				if (!isEarlier(pos, parent)) break;
+				swap(pos, parent);
+				pos = parent;
+			}
+		}
+
+		void siftDown(uint16_t pos)
+		{
+			while (true)
+			{
+				uint16_t earliest = pos;
+				uint16_t left = 2 * pos + 1;
+				uint16_t right = left + 1;
+				if (left < nofScheduled && isEarlier(left, earliest)) earliest = left;
+				if (right < nofScheduled && isEarlier(right, earliest)) earliest = right;
+				if (earliest == pos) break;
+				swap(pos, earliest);
+				pos = earliest;
+			}
+		}
+
+		// Puts the listeners that were added since the last call in the heap, the first
+		// deadline of each phaseUs after nowUs.
+		void scheduleAddedListeners(int64_t nowUs)
+		{
+			taskENTER_CRITICAL(&mux);
+			uint16_t nofListeners = nofHandlerListeners;
+			taskEXIT_CRITICAL(&mux);
+			while (nofScheduled < nofListeners)
+			{
+				uint16_t i = nofScheduled++;
+				entries[i].dueUs = nowUs + entries[i].phaseUs;
+				heap[i] = i;
+				siftUp(i);
+			}
+		}
+
+		// Calls the update() of the listener at the top of the heap, and schedules its next one.
+		void updateFirst(int64_t nowUs)
+		{
+			Entry& entry = entries[heap[0]];
+			int64_t latenessUs = nowUs - (int64_t)entry.dueUs;
+			if (latenessUs < 0) latenessUs = 0;	// Woken less than minTimerSleepUs early.
+
+			entry.pListener->update();
+
+			int64_t afterUs = esp_timer_get_time();
+			int64_t updateUs = afterUs - nowUs;
+			HandlerListenerStats& stats = entry.stats;
+			stats.updates++;
+			stats.totalLatenessUs += latenessUs;
+			if (latenessUs > stats.maxLatenessUs) stats.maxLatenessUs = latenessUs;
+			stats.totalUpdateUs += updateUs;
+			if (updateUs > stats.maxUpdateUs) stats.maxUpdateUs = updateUs;
+
+			// The next deadline. Skip the ones that have already passed.
+			entry.dueUs += entry.periodUs;
+			if ((int64_t)entry.dueUs <= afterUs)
+			{
+				uint64_t missed = (afterUs - entry.dueUs) / entry.periodUs + 1;
+				stats.overruns += missed;
+				entry.dueUs += missed * entry.periodUs;
+			}
+			siftDown(0);
+		}
+
+		void sleepUntil(int64_t dueUs)
+		{
+			int64_t remainingUs = dueUs - esp_timer_get_time();
+			if (remainingUs >= 2000)
+			{
+				// Sleep the whole ticks but one, as the first tick may be partial.
+				vTaskDelay(remainingUs / 1000 - 1);
+				remainingUs = dueUs - esp_timer_get_time();
+			}
+			if (remainingUs >= minTimerSleepUs)
+			{
+				timer.sleep_us(remainingUs);
+			}
+		}
+
 		void main()
 		{
-#ifdef TEST_CRT_HANDLER
-			uint64_t before2		= esp_timer_get_time();	// For measuring of actual complete period.
-			uint64_t after2			= 0;
-			uint64_t diff2			= 0;
-			int32_t  nofYieldsDone  = 0;
-			uint64_t yieldTimeSpent = 0;
-			uint64_t beforeBatches  = 0;
-			uint64_t spentOnBatches = 0;
-#endif
-			uint64_t beforeAll		= esp_timer_get_time();
-			uint64_t afterAll		= 0;	// gross Time spent by Handler, including yields to other threads.
-			uint32_t diffAll		= 0;
-
-			uint64_t beforeBatch    = 0;
-			uint64_t batchTimeSpent	= 0;
-			
 			vTaskDelay(500); // wait for other objects to initialise and add themselves as handlerlistener.
+
+			resetStats();
+			int64_t lastStackCheckUs = 0;
 			while (true)
 			{
-				beforeBatch = esp_timer_get_time();
+				int64_t wakeUs = esp_timer_get_time();
+				int64_t nowUs = wakeUs;
+				int64_t beforeBatch = wakeUs;
 
-#ifdef TEST_CRT_HANDLER
-				yieldTimeSpent = 0;
-				nofYieldsDone  = 0;
-				beforeBatches  = beforeBatch;
-#endif				
-
-				for (int i = 0; i < nofHandlerListeners; i++)
+				scheduleAddedListeners(wakeUs);
+				while (nofScheduled > 0 && (int64_t)entries[heap[0]].dueUs < nowUs + minTimerSleepUs)
 				{
-					arHandlerListener[i]->update();
+					updateFirst(nowUs);
+					nowUs = esp_timer_get_time();
 
-					if (batchSizeUs != infiniteBatchSizeUs)
+					if (batchSizeUs != infiniteBatchSizeUs && (uint64_t)(nowUs - beforeBatch) > batchSizeUs)
 					{
-						uint64_t nowUs = esp_timer_get_time();
-						batchTimeSpent = (nowUs - beforeBatch);
-
-						if (batchTimeSpent > batchSizeUs)
-						{
-							taskYIELD();
-
-#ifdef TEST_CRT_HANDLER
-							yieldTimeSpent += (esp_timer_get_time() - nowUs);
-							nofYieldsDone++;
-#endif
-							beforeBatch = esp_timer_get_time();
-						}
+						taskYIELD();
+						nowUs = esp_timer_get_time();
+						beforeBatch = nowUs;
 					}
 				}
 
-				afterAll = esp_timer_get_time();     // time in micro seconds.
-				diffAll = (afterAll - beforeAll);    // difference in milliseconds
-				                                     // This is the time spent on batches,
-													 // yields and optionally the test code
-				                                     // within the #defines below.
-				if (diffAll >= periodUs)
+				if (nowUs - lastStackCheckUs > 1000000)
 				{
-					ESP_LOGI("Probleem", "Handler Delay too long in us:%"PRIu32, diffAll);
+					dumpStackHighWaterMarkIfIncreased();	// Takes about 0.25ms, so not at every wake-up.
+					lastStackCheckUs = nowUs;
+					nowUs = esp_timer_get_time();
 				}
 
-				if (diffAll < periodUs) {
-					vTaskDelay((periodUs - diffAll) / 1000);
+				handlerStats.wakeUps++;
+				handlerStats.activeUs += nowUs - wakeUs;
+
+				if (nofScheduled > 0)
+				{
+					sleepUntil(entries[heap[0]].dueUs);
+				}
+				else
+				{
+					vTaskDelay(periodMs);
 				}
-				beforeAll = esp_timer_get_time();	 // This is the clean cut where the old interval ends
-
-				dumpStackHighWaterMarkIfIncreased();
-
-#ifdef TEST_CRT_HANDLER
-				after2 = esp_timer_get_time();
-				diff2 = (uint32_t)(after2 - before2);
-				before2 = after2;
-
-				spentOnBatches = afterAll - beforeBatches;
-
-				logger.logText("-----------------------------------------------------");
-				logger.logText(Task::taskName);
-				logger.logText("Diagnostics:");
-				logger.logText("nofYieldsDone:");
-				logger.logUint32(nofYieldsDone);
-				logger.logText("gross time spent on batches in microsecs, including yields:");
-				logger.logUint32((int32_t)spentOnBatches);
-				logger.logText("nett time spent on batches in microsecs:");
-				logger.logUint32((int32_t)(spentOnBatches - yieldTimeSpent));
-				logger.logText("handler interval microsecs");
-				logger.logUint32((int32_t)diff2);
-#endif
 			}
 		}
 	}; // end class crt_Handler
@@ -1,6 +1,7 @@
 // by Marius Versteegen, 2023
 
 #pragma once
+#include <stdint.h>
 #include "crt_IHandlerListener.h"
 
 namespace crt
@@ -9,5 +10,6 @@ namespace crt
 	{
 	public:
 		virtual void addHandlerListener(IHandlerListener* pHandlerListener) = 0;
+		virtual void addHandlerListener(IHandlerListener* pHandlerListener, uint32_t periodMs, uint32_t phaseMs) = 0;
 	};
 };
@@ -111,7 +111,7 @@ namespace crt
 			if (bPrinting) { return; } // prevent logging during printing: printing slows down everything, so the logs won't be representative anymore.
 			//MutexSection(mutex, portMAX_DELAY);
 			//SuspendSchedulerSection();
-			if (latestBatchCount < (LOGSIZE - 1))
+			if (latestBatchCount < (int32_t)(LOGSIZE - 1))
 			{
 				(*pNextTextLog++) = text;
 				(*pNextLogType++) = LogType::lt_Text;
@@ -127,7 +127,7 @@ namespace crt
 			if (bPrinting) { return; } // prevent logging during printing: printing slows down everything, so the logs won't be representative anymore.
 			//MutexSection(mutex, portMAX_DELAY);
 			//SuspendSchedulerSection();
-			if (latestBatchCount++ >= (LOGSIZE - 1)) { --latestBatchCount; return; }
+			if (latestBatchCount++ >= (int32_t)(LOGSIZE - 1)) { --latestBatchCount; return; }
 			(*pNextInt32Log++) = intNumber;
 			(*pNextLogType++) = LogType::lt_Int32;
 #endif
@@ -140,7 +140,7 @@ namespace crt
             if (bPrinting) { return; } // prevent logging during printing: printing slows down everything, so the logs won't be representative anymore.
             //MutexSection(mutex, portMAX_DELAY);
             //SuspendSchedulerSection();
-            if (latestBatchCount++ >= (LOGSIZE - 1)) { --latestBatchCount; return; }
+            if (latestBatchCount++ >= (int32_t)(LOGSIZE - 1)) { --latestBatchCount; return; }
             (*pNextUint32Log++) = intNumber;
             (*pNextLogType++) = LogType::lt_Uint32;
 #endif
@@ -153,7 +153,7 @@ namespace crt
 			if (bPrinting) { return; } // prevent logging during printing: printing slows down everything, so the logs won't be representative anymore.
 			//MutexSection(mutex, portMAX_DELAY);
 			//SuspendSchedulerSection();
-			if (latestBatchCount++ >= (LOGSIZE - 1)) { --latestBatchCount; return; }
+			if (latestBatchCount++ >= (int32_t)(LOGSIZE - 1)) { --latestBatchCount; return; }
 			(*pNextFloatLog++) = floatNumber;
 			(*pNextLogType++) = LogType::lt_Float;
 #endif
@@ -5,7 +5,9 @@
 
 #pragma once
 #include "internals/crt_FreeRTOS.h"
+#ifndef CRT_HOST
 #include "esp_timer.h"
+#endif
 
 namespace crt
 {
@@ -0,0 +1,204 @@
+// by Marius Versteegen, 2025
+
+// An MpscQueue is a Queue for any number of producer tasks and a single consumer
+// task (the task that owns it). Like an SpscQueue, it only touches the event bit of
+// the owner when the queue goes from empty to non-empty (on a write) and back
+// (on a read), so most messages pass without a kernel call.
+//
+// It is a bounded lock-free ring buffer in which every slot has a sequence number:
+// a producer claims a slot by advancing the tail with a compare-and-swap, copies
+// its message into it, and then publishes it by updating the sequence number of the
+// slot. The owner reads the slots in order, so a producer that is preempted between
+// claiming and publishing holds up the messages behind it (not the other producers).
+//
+// Use it like a Queue: wait for it (or waitAny/hasFired), then read() or
+// tryRead() until it is empty. COUNT must be a power of two.
+// Like on an SpscQueue, beginWrite()/endWrite() and beginRead()/endRead() hand out the
+// slot itself, and readMany() frees a batch of messages with a single head update.
+// (see the QueueBench example in the examples folder)
+
+#pragma once
+#include <atomic>
+#include "internals/crt_FreeRTOS.h"
+#include "internals/crt_Backoff.h"
+#include "crt_Waitable.h"
+#include "crt_Task.h"
+
+namespace crt
+{
+	template<typename TYPE, uint32_t COUNT> class MpscQueue : public Waitable
+	{
+		static_assert(COUNT > 0 && (COUNT & (COUNT - 1)) == 0, "COUNT must be a power of two");
+
+	private:
+		struct Slot
+		{
+			// == position:     free, to be written at that position.
+			// == position + 1: holds the message of that position.
+			::std::atomic<uint32_t> sequence;
+			TYPE item;
+		};
+
+		Task* pTask;
+		bool bWriteWaitIfQueueFull;
+
+		alignas(64) ::std::atomic<uint32_t> head;	// written by the consumer only
+		alignas(64) ::std::atomic<uint32_t> tail;	// claimed by the producers
+		Slot slots[COUNT];
+
+		// Advances the head past the n freed slots from position h on.
+		void consume(uint32_t h, uint32_t n)
+		{
+			head.store(h + n, ::std::memory_order_seq_cst);
+
+			Slot& next = slots[(h + n) % COUNT];
+			if (next.sequence.load(::std::memory_order_seq_cst) != h + n + 1)
+			{
+				// Nothing published after these. A producer that publishes it between the
+				// check above and the clear sets the bit before it is cleared, so check again.
+				pTask->clearEventBits(Waitable::getBitMask());
+				if (next.sequence.load(::std::memory_order_seq_cst) == h + n + 1)
+				{
+					pTask->setEventBits(Waitable::getBitMask());
+				}
+			}
+		}
+
+	public:
+		MpscQueue(Task* pTask, bool bWriteWaitIfQueueFull = false) : Waitable(WaitableType::wt_Queue), pTask(pTask),
+			bWriteWaitIfQueueFull(bWriteWaitIfQueueFull), head(0), tail(0)
+		{
+			Waitable::init(pTask->queryBitNumber(this));
+			for (uint32_t i = 0; i < COUNT; i++)
+			{
+				slots[i].sequence.store(i, ::std::memory_order_relaxed);
+			}
+		}
+
+		// Can be called by any task.
+		// Returns false if the queue is full (which cannot happen if bWriteWaitIfQueueFull==true).
+		bool write(const TYPE& variableToCopy)
+		{
+			uint32_t position;
+			TYPE* pSlot = beginWrite(position);
+			if (pSlot == nullptr) return false;
+			*pSlot = variableToCopy;
+			endWrite(position);
+			return true;
+		}
+
+		// Can be called by any task.
+		// Claims the next free slot, such that the message can be filled in place,
+		// without a copy. Publish it with endWrite(position).
+		// Returns nullptr if the queue is full (which cannot happen if bWriteWaitIfQueueFull==true).
+		TYPE* beginWrite(uint32_t& position)
+		{
+			position = tail.load(::std::memory_order_relaxed);
+			uint32_t tries = 0;
+			while (true)
+			{
+				Slot& slot = slots[position % COUNT];
+				int32_t diff = (int32_t)(slot.sequence.load(::std::memory_order_acquire) - position);
+				if (diff == 0)
+				{
+					if (tail.compare_exchange_weak(position, position + 1, ::std::memory_order_relaxed)) return &slot.item;
+					// else: another producer got it; position now holds the new tail.
+				}
+				else if (diff < 0)
+				{
+					// The slot still holds the message of the previous round: the queue is full.
+					if (!bWriteWaitIfQueueFull) return nullptr;
+					backOff(++tries);
+					position = tail.load(::std::memory_order_relaxed);
+				}
+				else
+				{
+					position = tail.load(::std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// To be called by the task that claimed the slot, with the position that beginWrite() returned.
+		// Keep the time between both short: the messages behind this one wait for it.
+		void endWrite(uint32_t position)
+		{
+			slots[position % COUNT].sequence.store(position + 1, ::std::memory_order_seq_cst);
+
+			if (head.load(::std::memory_order_seq_cst) == position)
+			{
+				// The owner is waiting for exactly this slot: wake it.
+				pTask->setEventBits(Waitable::getBitMask());
+			}
+		}
+
+		// To be called by the owner only. Waits if the queue is empty.
+		void read(TYPE& returnVariable)
+		{
+			while (!tryRead(returnVariable))
+			{
+				pTask->wait(*this);
+			}
+		}
+
+		// To be called by the owner only. Returns false if the queue is empty,
+		// or if the next message is claimed but not yet published.
+		bool tryRead(TYPE& returnVariable)
+		{
+			TYPE* pMessage = beginRead();
+			if (pMessage == nullptr) return false;
+			returnVariable = *pMessage;
+			endRead();
+			return true;
+		}
+
+		// To be called by the owner only.
+		// Hands out the oldest message, such that it can be used in place, without a copy.
+		// It stays valid until endRead(). Returns nullptr if there is no published message.
+		TYPE* beginRead()
+		{
+			uint32_t h = head.load(::std::memory_order_relaxed);
+			Slot& slot = slots[h % COUNT];
+			if (slot.sequence.load(::std::memory_order_acquire) != h + 1) return nullptr;
+			return &slot.item;
+		}
+
+		// To be called by the owner only, after beginRead() returned a message.
+		void endRead()
+		{
+			uint32_t h = head.load(::std::memory_order_relaxed);
+			slots[h % COUNT].sequence.store(h + COUNT, ::std::memory_order_release);	// free for the next round
+			consume(h, 1);
+		}
+
+		// To be called by the owner only.
+		// Reads up to maxCount published messages, without waiting, and returns how many it read.
+		// The event bit is updated at most once per batch.
+		uint32_t readMany(TYPE* items, uint32_t maxCount)
+		{
+			uint32_t h = head.load(::std::memory_order_relaxed);
+			uint32_t count = 0;
+			for (; count < maxCount; count++)
+			{
+				Slot& slot = slots[(h + count) % COUNT];
+				if (slot.sequence.load(::std::memory_order_acquire) != h + count + 1) break;
+				items[count] = slot.item;
+				slot.sequence.store(h + count + COUNT, ::std::memory_order_release);
+			}
+			if (count > 0) consume(h, count);
+			return count;
+		}
+
+		// Includes the messages that are claimed but not yet published.
+		int getNofMessagesWaiting()
+		{
+			return tail.load(::std::memory_order_acquire) - head.load(::std::memory_order_acquire);
+		}
+
+		// To be called by the owner only.
+		void clear()
+		{
+			TYPE dummy;
+			while (tryRead(dummy)) {}
+		}
+	};
+};
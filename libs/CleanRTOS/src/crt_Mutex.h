@@ -1,5 +1,8 @@
 #pragma once
 #include "internals/crt_FreeRTOS.h"
+#ifndef CRT_HOST
+#include "esp_timer.h"
+#endif
 
 namespace crt
 {
@@ -19,47 +22,129 @@ namespace crt
 
 	// Each Task has its own mutex stack. That makes sure that within the Task,
 	// mutexes are always locked in the order of their mutex priority.
-	
+
+	// A task that finds the mutex locked blocks until it is released (or until the timeout
+	// of lock(pTask, timeoutMs)). Meanwhile, the task that holds the mutex inherits its
+	// priority, if that is higher, such that a task of medium priority cannot keep it waiting.
+
+	// Every Mutex keeps statistics, see getStats().
+	struct MutexStats
+	{
+		uint32_t acquisitions;
+		uint32_t contendedAcquisitions;	// The mutex was locked by another task at the time.
+		uint32_t timeouts;
+		int64_t totalWaitUs;
+		int64_t maxWaitUs;
+		int64_t maxHoldUs;
+	};
+
 	class Mutex
 	{
 	public:
 		uint32_t mutexID;
 		SemaphoreHandle_t freeRtosMutex;
 		BaseType_t rc;
-		
+
+	private:
+		// Updated by the task that holds the mutex, and by tasks that time out.
+		// The 64 bit fields take two stores on the ESP32, hence guarded by statsMux.
+		MutexStats stats;
+		portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+		int64_t lockedUs;	// Only used by the task that holds the mutex.
+
 	public:
 		// MutexSections with lower mutexID can wrap MutexSections with higher mutexID.
 		// but not the other way around (to prevent deadlocks).
 		Mutex(uint32_t mutexID) :
-			mutexID(mutexID), freeRtosMutex(xSemaphoreCreateMutex())
-			//mutexID(mutexID), freeRtosMutex(xSemaphoreCreateBinary())
+			mutexID(mutexID), freeRtosMutex(xSemaphoreCreateMutex()), stats(), lockedUs(0)
 		{
 			assert(mutexID != 0);	// MutexID should not be 0. Zero is reserved (to indicate absence of mutexID)
-			//xSemaphoreGive(freeRtosMutex);	// In case of a binary semaphore: that one should be given before it can be taken.
 		}
 		
 		void lock(Task* pTask)
 		{
-			while (true)
-			{
-				assert(mutexID > pTask->mutexIdStack.top()); // Error : Potential Deadlock : Within each thread, never try to lock a mutex with lower mutex priority than a mutex that is locked(before it).
+			bool bLocked = take(pTask, portMAX_DELAY);
+			assert(bLocked);
+			(void)bLocked;
+		}
 
-				// max tickDelay is the constant portMAX_DELAY
-				rc = xSemaphoreTake(freeRtosMutex, 0.0001 /* tickDelay */);
-				if (rc == pdPASS)
-				{
-					assert(pTask->mutexIdStack.push(mutexID));// Assert would mean that either the amount of nested concurrently locked mutexes for this task exceeds the constant MAX_MUTEXNESTING, or the lock and unlock of the mutex are not performed in the same task.
-					break;
-				}
-				taskYIELD(); // Feed the wdt.
-			}
+		// Returns false if the mutex could not be locked within timeoutMs.
+		// The timeout is rounded up to whole ticks: pdMS_TO_TICKS would turn a
+		// timeout below a tick (10 ms at 100 Hz) into a mere try.
+		bool lock(Task* pTask, uint32_t timeoutMs)
+		{
+			return take(pTask, (TickType_t)(((uint64_t)timeoutMs * configTICK_RATE_HZ + 999) / 1000));
 		}
 		
 		void unlock(Task* pTask)
 		{
+			int64_t holdUs = esp_timer_get_time() - lockedUs;
+			if (holdUs > stats.maxHoldUs)
+			{
+				taskENTER_CRITICAL(&statsMux);
+				stats.maxHoldUs = holdUs;
+				taskEXIT_CRITICAL(&statsMux);
+			}
+
 			pTask->mutexIdStack.pop();
 			rc = xSemaphoreGive(freeRtosMutex);
 			assert(rc == pdPASS);
 		}
+
+		// Can be called by any task, also while it holds the mutex.
+		MutexStats getStats()
+		{
+			taskENTER_CRITICAL(&statsMux);
+			MutexStats result = stats;
+			taskEXIT_CRITICAL(&statsMux);
+			return result;
+		}
+
+		// To be called while no task uses the mutex.
+		void resetStats()
+		{
+			taskENTER_CRITICAL(&statsMux);
+			stats = MutexStats();
+			taskEXIT_CRITICAL(&statsMux);
+		}
+
+	private:
+		bool take(Task* pTask, TickType_t ticksToWait)
+		{
+			assert(mutexID > pTask->mutexIdStack.top()); // Error : Potential Deadlock : Within each thread, never try to lock a mutex with lower mutex priority than a mutex that is locked(before it).
+
+			int64_t waitUs = 0;
+			bool bContended = false;
+			if (xSemaphoreTake(freeRtosMutex, 0) != pdPASS)
+			{
+				// Blocks, and lends our priority to the holder.
+				int64_t startUs = esp_timer_get_time();
+				if (ticksToWait == 0 || xSemaphoreTake(freeRtosMutex, ticksToWait) != pdPASS)
+				{
+					taskENTER_CRITICAL(&statsMux);
+					stats.timeouts++;
+					taskEXIT_CRITICAL(&statsMux);
+					return false;
+				}
+				bContended = true;
+				waitUs = esp_timer_get_time() - startUs;
+			}
+
+			bool bPushed = pTask->mutexIdStack.push(mutexID);
+			assert(bPushed);// Assert would mean that either the amount of nested concurrently locked mutexes for this task exceeds the constant MAX_MUTEXNESTING, or the lock and unlock of the mutex are not performed in the same task.
+			(void)bPushed;
+
+			taskENTER_CRITICAL(&statsMux);
+			stats.acquisitions++;
+			if (bContended)
+			{
+				stats.contendedAcquisitions++;
+				stats.totalWaitUs += waitUs;
+				if (waitUs > stats.maxWaitUs) stats.maxWaitUs = waitUs;
+			}
+			taskEXIT_CRITICAL(&statsMux);
+			lockedUs = esp_timer_get_time();
+			return true;
+		}
 	};
 };
@@ -20,14 +20,27 @@ namespace crt
 	private:
 		Task* pTask;
 		Mutex& mutex;
+		bool bLocked;
 	public:
-		MutexSection(Task* pTask, Mutex& mutex) : pTask(pTask), mutex(mutex)
+		MutexSection(Task* pTask, Mutex& mutex) : pTask(pTask), mutex(mutex), bLocked(true)
 		{
 			mutex.lock(pTask);
 		}
+
+		// Gives up after timeoutMs. Check isLocked() before using the resource.
+		MutexSection(Task* pTask, Mutex& mutex, uint32_t timeoutMs) : pTask(pTask), mutex(mutex)
+		{
+			bLocked = mutex.lock(pTask, timeoutMs);
+		}
+
 		~MutexSection()
 		{
-			mutex.unlock(pTask);
+			if (bLocked) mutex.unlock(pTask);
+		}
+
+		bool isLocked()
+		{
+			return bLocked;
 		}
 	};
 };
@@ -0,0 +1,500 @@
+// by Marius Versteegen, 2025
+
+// A ParallelHandler is a Handler (see crt_Handler.h) that runs its listeners on two worker
+// tasks, one pinned to each core of a dual-core ESP32, instead of on a single task.
+//
+// Every listener has a home worker, which keeps it in a min-heap on its next deadline, like
+// the Handler does. The listeners are spread over the workers in the order in which they
+// are added. A worker runs the listeners of its own heap that are due. If none are, it steals
+// the earliest due listener from the heap of the other worker, which is then busy. After the
+// update, the listener goes back to the heap of its home worker. A worker that finds a backlog
+// in its heap wakes the other worker if that one is sleeping, such that it can steal from it.
+//
+// A listener can be added with:
+//  - a core: it always runs on the worker of that core, and is never stolen.
+//  - exclusive: it always runs on worker 0, and is never stolen. Exclusive listeners thus never
+//    run in parallel with each other, as on a single Handler. Use it for listeners that share
+//    data that is not protected.
+// Any other listener may run on either core, so its update() must not assume a core, and
+// must be safe to run in parallel with the update() of other listeners.
+//
+// On a single-core part, both workers run on core 0. That works, but gains nothing.
+// The worker tasks are named after the ParallelHandler, with "_0" or "_1" for worker 0 or 1.
+//
+// Like the Handler, a ParallelHandler starts itself, and waits 500 ms for its listeners
+// to be added before it schedules them. A listener that is added later is scheduled by its
+// home worker, which is woken for it, and first updated phaseMs after that.
+// It assumes that 1 tick equals 1ms.
+// (see the ParallelHandlerBench example in the examples folder)
+
+#pragma once
+#include <atomic>
+#include "internals/crt_FreeRTOS.h"
+#include "crt_Task.h"
+#include "crt_Flag.h"
+#include "crt_Timer.h"
+#include "crt_IHandler.h"
+#include "crt_IHandlerListener.h"
+#include "crt_Handler.h"
+
+namespace crt
+{
+	struct ParallelHandlerWorkerStats
+	{
+		uint32_t wakeUps;
+		uint32_t updates;
+		uint32_t steals;			// Updates of listeners of the other worker.
+		int64_t activeUs;			// The time from each wake-up to the next sleep.
+		int64_t elapsedUs;
+	};
+
+	template<unsigned int MAXLISTENERCOUNT> class ParallelHandler : public IHandler
+	{
+	public:
+		static const int32_t anyCore = -1;
+		static const uint32_t NOFWORKERS = 2;
+
+	private:
+		static const int64_t minTimerSleepUs = 50;	// A Timer cannot sleep shorter.
+		static const uint16_t none = 0xffff;
+
+		struct Entry
+		{
+			IHandlerListener* pListener;
+			uint64_t periodUs;
+			uint64_t phaseUs;
+			int64_t dueUs;
+			uint8_t home;			// The index of the worker that keeps it in its heap.
+			bool bPinned;			// Never stolen.
+			HandlerListenerStats stats;
+		};
+
+		class Worker : public Task
+		{
+		private:
+			static const uint32_t MAX_NAME = 16;	// configMAX_TASK_NAME_LEN of the ESP32, including the 0.
+
+		public:
+			char name[MAX_NAME];		// The name of the ParallelHandler with the index of the worker: "<name>_0".
+			ParallelHandler& owner;
+			uint8_t index;
+			portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;	// Guards heap and nofEntries.
+			uint16_t heap[MAXLISTENERCOUNT] = {};				// Indices in entries, ordered on dueUs.
+			uint16_t nofEntries;
+			uint16_t nofSeen;			// The entries of the owner that have been checked for this home.
+			Flag flagWork;
+			Timer timer;
+			::std::atomic<bool> bIdle;
+			ParallelHandlerWorkerStats stats;
+
+			Worker(const char* taskName, unsigned int taskPriority, unsigned int taskCoreNumber, ParallelHandler& owner, uint8_t index) :
+				Task(name, taskPriority, 5500, taskCoreNumber), owner(owner), index(index), nofEntries(0), nofSeen(0),
+				flagWork(this), timer(this), bIdle(false), stats()
+			{
+				// Shortens the name of the ParallelHandler if needed, such that FreeRTOS keeps the index.
+				snprintf(name, sizeof(name), "%.*s_%u", (int)(MAX_NAME - 3), taskName, (unsigned int)index);
+			}
+
+			void begin()
+			{
+				Task::start();
+			}
+
+			bool isEarlier(uint16_t a, uint16_t b)
+			{
+				const Entry& entryA = owner.entries[heap[a]];
+				const Entry& entryB = owner.entries[heap[b]];
+				return (entryA.dueUs < entryB.dueUs) || (entryA.dueUs == entryB.dueUs && heap[a] < heap[b]);
+			}
+
+			void swap(uint16_t a, uint16_t b)
+			{
+				uint16_t temp = heap[a];
+				heap[a] = heap[b];
+				heap[b] = temp;
+			}
+
+			void siftUp(uint16_t pos)
+			{
+				while (pos > 0)
+				{
+					uint16_t parent = (pos - 1) / 2;
+					if (!isEarlier(pos, parent)) break;
+					swap(pos, parent);
+					pos = parent;
+				}
+			}
+
+			void siftDown(uint16_t pos)
+			{
+				while (true)
+				{
+					uint16_t earliest = pos;
+					uint16_t left = 2 * pos + 1;
+					uint16_t right = left + 1;
+					if (left < nofEntries && isEarlier(left, earliest)) earliest = left;
+					if (right < nofEntries && isEarlier(right, earliest)) earliest = right;
+					if (earliest == pos) break;
+					swap(pos, earliest);
+					pos = earliest;
+				}
+			}
+
+			// To be called within the critical section of mux.
+			uint16_t removeAt(uint16_t pos)
+			{
+				uint16_t entryIndex = heap[pos];
+				nofEntries--;
+				if (pos < nofEntries)
+				{
+					heap[pos] = heap[nofEntries];
+					siftDown(pos);
+					siftUp(pos);
+				}
+				return entryIndex;
+			}
+
+			void push(uint16_t entryIndex)
+			{
+				taskENTER_CRITICAL(&mux);
+				heap[nofEntries] = entryIndex;
+				siftUp(nofEntries++);
+				taskEXIT_CRITICAL(&mux);
+			}
+
+			// Takes the first listener of the heap if it is due. Sets bBacklog if the next one is due as well.
+			uint16_t takeDue(int64_t nowUs, bool& bBacklog)
+			{
+				uint16_t entryIndex = none;
+				taskENTER_CRITICAL(&mux);
+				if (nofEntries > 0 && owner.entries[heap[0]].dueUs < nowUs + minTimerSleepUs)
+				{
+					entryIndex = removeAt(0);
+					bBacklog = (nofEntries > 0 && owner.entries[heap[0]].dueUs < nowUs + minTimerSleepUs);
+				}
+				taskEXIT_CRITICAL(&mux);
+				return entryIndex;
+			}
+
+			// Takes the earliest due listener that is not pinned.
+			uint16_t takeDueForThief(int64_t nowUs)
+			{
+				uint16_t entryIndex = none;
+				taskENTER_CRITICAL(&mux);
+				int64_t earliestUs = nowUs + minTimerSleepUs;
+				uint16_t earliestPos = none;
+				for (uint16_t pos = 0; pos < nofEntries; pos++)
+				{
+					const Entry& entry = owner.entries[heap[pos]];
+					if (!entry.bPinned && entry.dueUs < earliestUs)
+					{
+						earliestUs = entry.dueUs;
+						earliestPos = pos;
+					}
+				}
+				if (earliestPos != none)
+				{
+					entryIndex = removeAt(earliestPos);
+				}
+				taskEXIT_CRITICAL(&mux);
+				return entryIndex;
+			}
+
+			// Pushes the listeners of this home that were added since the last call, the first
+			// deadline of each phaseUs after fromUs.
+			void scheduleAddedListeners(int64_t fromUs)
+			{
+				uint16_t nofListeners = owner.getNofHandlerListeners();
+				while (nofSeen < nofListeners)
+				{
+					uint16_t i = nofSeen++;
+					Entry& entry = owner.entries[i];
+					if (entry.home == index)
+					{
+						entry.dueUs = fromUs + entry.phaseUs;
+						push(i);
+					}
+				}
+			}
+
+			int64_t nextDueUs()
+			{
+				int64_t dueUs = INT64_MAX;
+				taskENTER_CRITICAL(&mux);
+				if (nofEntries > 0) dueUs = owner.entries[heap[0]].dueUs;
+				taskEXIT_CRITICAL(&mux);
+				return dueUs;
+			}
+
+			void wake()
+			{
+				if (bIdle.load(::std::memory_order_seq_cst))
+				{
+					flagWork.set();
+				}
+			}
+
+			void sleepUntil(int64_t dueUs)
+			{
+				int64_t remainingUs = dueUs - esp_timer_get_time();
+				if (remainingUs < minTimerSleepUs) return;
+
+				// Sleep on the Timer, unless flagWork is set first.
+				timer.start(remainingUs);
+				waitAny(timer.getBitMask() | flagWork.getBitMask());
+				if (hasFired(flagWork))
+				{
+					timer.stop();
+				}
+				hasFired(timer);
+			}
+
+		private:
+			/*override keyword not supported*/
+			void main()
+			{
+				vTaskDelay(500); // wait for other objects to initialise and add themselves as handlerlistener.
+
+				scheduleAddedListeners(owner.getStartUs());
+				Worker& other = owner.getWorker(1 - index);
+
+				int64_t lastStackCheckUs = 0;
+				while (true)
+				{
+					int64_t activeFromUs = esp_timer_get_time();
+					int64_t nowUs = activeFromUs;
+					stats.wakeUps++;
+					scheduleAddedListeners(nowUs);
+
+					while (true)
+					{
+						bool bBacklog = false;
+						uint16_t entryIndex = takeDue(nowUs, bBacklog);
+						if (entryIndex != none)
+						{
+							if (bBacklog) other.wake();
+						}
+						else
+						{
+							entryIndex = other.takeDueForThief(nowUs);
+							if (entryIndex == none) break;
+							stats.steals++;
+						}
+						owner.update(entryIndex, nowUs);
+						stats.updates++;
+						nowUs = esp_timer_get_time();
+
+						// Per update, as an overloaded worker may not come to sleep for long.
+						stats.activeUs += nowUs - activeFromUs;
+						activeFromUs = nowUs;
+					}
+
+					if (nowUs - lastStackCheckUs > 1000000)
+					{
+						dumpStackHighWaterMarkIfIncreased();	// Takes about 0.25ms, so not at every wake-up.
+						lastStackCheckUs = nowUs;
+						nowUs = esp_timer_get_time();
+					}
+					stats.activeUs += nowUs - activeFromUs;
+
+					// Announce the sleep before the last look, such that a backlog or a listener
+					// that arises in between wakes us.
+					bIdle.store(true, ::std::memory_order_seq_cst);
+					scheduleAddedListeners(esp_timer_get_time());
+					int64_t dueUs = nextDueUs();
+					int64_t otherDueUs = other.nextDueUs();
+					if (otherDueUs < dueUs && otherDueUs < esp_timer_get_time())
+					{
+						dueUs = otherDueUs;	// The other worker is late: come back soon to help.
+					}
+					if (dueUs == INT64_MAX)
+					{
+						dueUs = esp_timer_get_time() + (int64_t)owner.periodMs * 1000;	// Only steals.
+					}
+					sleepUntil(dueUs);
+					bIdle.store(false, ::std::memory_order_seq_cst);
+				}
+			}
+		}; // end class Worker
+
+		Entry entries[MAXLISTENERCOUNT] = {};
+		portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;	// Guards nofHandlerListeners and nextHome.
+		uint16_t nofHandlerListeners;	// Listeners may be added by any task, also after start-up.
+		uint16_t periodMs;
+		uint8_t nextHome;
+		int64_t startUs;
+		int64_t statsStartUs;
+		bool bStarted;
+		Worker workers[NOFWORKERS];
+
+	public:
+		// periodMs : the period of the listeners that are added without one.
+		ParallelHandler(const char* taskName, unsigned int taskPriority, uint16_t periodMs) :
+			nofHandlerListeners(0), periodMs(periodMs), nextHome(0), startUs(0), statsStartUs(0), bStarted(false),
+			workers{ { taskName, taskPriority, 0, *this, 0 }, { taskName, taskPriority, portNUM_PROCESSORS > 1 ? 1u : 0u, *this, 1 } }
+		{
+			start();
+		}
+
+		// Starts the worker tasks, once.
+		void start()
+		{
+			if (!bStarted)
+			{
+				bStarted = true;
+				startUs = esp_timer_get_time() + 500000;	// The workers schedule their listeners from then on.
+				statsStartUs = startUs;
+				for (uint32_t i = 0; i < NOFWORKERS; i++) workers[i].begin();
+			}
+		}
+
+		/*override keyword not supported in current compiler*/
+		void addHandlerListener(IHandlerListener* pHandlerListener)
+		{
+			addHandlerListener(pHandlerListener, periodMs, 0, anyCore, false);
+		}
+
+		/*override keyword not supported in current compiler*/
+		void addHandlerListener(IHandlerListener* pHandlerListener, uint32_t periodMs, uint32_t phaseMs)
+		{
+			addHandlerListener(pHandlerListener, periodMs, phaseMs, anyCore, false);
+		}
+
+		// core : anyCore, or the core to run on.
+		// bExclusive : never run in parallel with another exclusive listener.
+		void addHandlerListener(IHandlerListener* pHandlerListener, uint32_t periodMs, uint32_t phaseMs, int32_t core, bool bExclusive)
+		{
+			assert(periodMs > 0);
+			assert(core == anyCore || (core >= 0 && core < (int32_t)NOFWORKERS));
+			int32_t home = -1;
+			taskENTER_CRITICAL(&mux);
+			if (!isAlreadyPresent(pHandlerListener))
+			{
+				assert(nofHandlerListeners < MAXLISTENERCOUNT);
+				Entry& entry = entries[nofHandlerListeners];
+				entry.pListener = pHandlerListener;
+				entry.periodUs = (uint64_t)periodMs * 1000;
+				entry.phaseUs = (uint64_t)phaseMs * 1000;
+				if (bExclusive)
+				{
+					entry.home = 0;
+				}
+				else if (core != anyCore)
+				{
+					entry.home = core;
+				}
+				else
+				{
+					entry.home = nextHome;
+					nextHome = (nextHome + 1) % NOFWORKERS;
+				}
+				entry.bPinned = bExclusive || (core != anyCore);
+				home = entry.home;
+				nofHandlerListeners++;	// Its home worker picks it up from here.
+			}
+			taskEXIT_CRITICAL(&mux);
+			if (home >= 0)
+			{
+				workers[home].wake();	// Such that a late listener does not wait for the next deadline.
+			}
+		}
+
+		// Can be called by any task. The numbers may be an update behind.
+		HandlerListenerStats getListenerStats(IHandlerListener* pHandlerListener)
+		{
+			for (int i = 0; i < nofHandlerListeners; i++)
+			{
+				if (entries[i].pListener == pHandlerListener)
+				{
+					return entries[i].stats;
+				}
+			}
+			assert(false); // Not a listener of this ParallelHandler.
+			return HandlerListenerStats();
+		}
+
+		ParallelHandlerWorkerStats getWorkerStats(uint32_t workerIndex)
+		{
+			assert(workerIndex < NOFWORKERS);
+			ParallelHandlerWorkerStats result = workers[workerIndex].stats;
+			result.elapsedUs = esp_timer_get_time() - statsStartUs;
+			return result;
+		}
+
+		// Clears the statistics of the workers and the listeners. The result of a
+		// simultaneous update is lost.
+		void resetStats()
+		{
+			for (int i = 0; i < nofHandlerListeners; i++)
+			{
+				entries[i].stats = HandlerListenerStats();
+			}
+			for (uint32_t i = 0; i < NOFWORKERS; i++)
+			{
+				workers[i].stats = ParallelHandlerWorkerStats();
+			}
+			statsStartUs = esp_timer_get_time();
+		}
+
+	private:
+		bool isAlreadyPresent(IHandlerListener* pHandlerListener)
+		{
+			for (int i = 0; i < nofHandlerListeners; i++)
+			{
+				if (entries[i].pListener == pHandlerListener)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		uint16_t getNofHandlerListeners()
+		{
+			taskENTER_CRITICAL(&mux);
+			uint16_t result = nofHandlerListeners;
+			taskEXIT_CRITICAL(&mux);
+			return result;
+		}
+
+		int64_t getStartUs()
+		{
+			return startUs;
+		}
+
+		Worker& getWorker(uint32_t workerIndex)
+		{
+			return workers[workerIndex];
+		}
+
+		// Calls the update() of the listener, and returns it to the heap of its home worker.
+		// The listener is in no heap meanwhile, so no other worker can take it.
+		void update(uint16_t entryIndex, int64_t nowUs)
+		{
+			Entry& entry = entries[entryIndex];
+			int64_t latenessUs = nowUs - entry.dueUs;
+			if (latenessUs < 0) latenessUs = 0;	// Woken less than minTimerSleepUs early.
+
+			entry.pListener->update();
+
+			int64_t afterUs = esp_timer_get_time();
+			int64_t updateUs = afterUs - nowUs;
+			HandlerListenerStats& stats = entry.stats;
+			stats.updates++;
+			stats.totalLatenessUs += latenessUs;
+			if (latenessUs > stats.maxLatenessUs) stats.maxLatenessUs = latenessUs;
+			stats.totalUpdateUs += updateUs;
+			if (updateUs > stats.maxUpdateUs) stats.maxUpdateUs = updateUs;
+
+			// The next deadline. Skip the ones that have already passed.
+			entry.dueUs += entry.periodUs;
+			if (entry.dueUs <= afterUs)
+			{
+				uint64_t missed = (afterUs - entry.dueUs) / entry.periodUs + 1;
+				stats.overruns += missed;
+				entry.dueUs += missed * entry.periodUs;
+			}
+			workers[entry.home].push(entryIndex);
+		}
+	}; // end class ParallelHandler
+}; // end namespace crt
@@ -3,18 +3,37 @@
 // Pools can be used to protect access to shared data without 
 // explicitly worrying about mutexes. The class of the shared data should provide a copy constructor.
 // Internally, a SimpleMutex is used to avoid concurrent access to the encapsulated data.
-// (see the Pool example in the examples folder)
+//
+// A reader can be blocked behind a writer that holds the mutex, and - if the writer has a
+// lower priority - behind any task in between. The second template parameter selects
+// an alternative that does not block:
+//   Pool<T, PoolSeqLock>      - For a trivially copyable T, and a single writer task.
+//                               A write never waits. A read that overlaps with a write retries.
+//                               Suits small T that is read more often than written.
+//   Pool<T, PoolTripleBuffer> - For a single writer task and a single reader task.
+//                               Neither ever waits or retries: they each own one of three copies
+//                               and swap the third. Suits large T. It costs three copies of T.
+// (see the Pool and PoolBench examples in the examples folder)
 
 #pragma once
+#include <atomic>
+#include <cstring>
+#include <type_traits>
 #include "internals/crt_FreeRTOS.h"
 #include "internals/crt_SimpleMutex.h"
+#include "internals/crt_Backoff.h"
 #include "crt_Mutex.h"
 #include "crt_MutexSection.h"
 
 namespace crt
 {
+	// The policies of Pool.
+	struct PoolMutex {};
+	struct PoolSeqLock {};
+	struct PoolTripleBuffer {};
+
 	// This class allows automatic Mutex release using the RAI-pattern.
-	template <class T> class Pool
+	template <class T, class POLICY = PoolMutex> class Pool
 	{
 	private:
         T data;
@@ -37,4 +56,102 @@ namespace crt
 			simpleMutex.unlock();
 		}
 	};
+
+	template <class T> class Pool<T, PoolSeqLock>
+	{
+		static_assert(::std::is_trivially_copyable<T>::value, "Pool<T, PoolSeqLock> needs a trivially copyable T");
+
+	private:
+		static const uint32_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+		// Odd while a write is in progress. A read is valid if it is even and unchanged after the read.
+		::std::atomic<uint32_t> sequence;
+		// The data is stored word by word in atomics, such that a read that overlaps with a write is
+		// well defined (and then discarded).
+		::std::atomic<uint32_t> words[WORDS];
+
+	public:
+		Pool() : sequence(0)
+		{
+			T item{};
+			write(item);
+		}
+
+		// To be called by a single writer task.
+		void write(const T& item)
+		{
+			uint32_t buffer[WORDS] = {};
+			memcpy(buffer, &item, sizeof(T));
+
+			uint32_t s = sequence.load(::std::memory_order_relaxed);
+			sequence.store(s + 1, ::std::memory_order_relaxed);
+			::std::atomic_thread_fence(::std::memory_order_release);
+			for (uint32_t i = 0; i < WORDS; i++)
+			{
+				words[i].store(buffer[i], ::std::memory_order_relaxed);
+			}
+			sequence.store(s + 2, ::std::memory_order_release);
+		}
+
+		// Can be called by any task. Retries while it overlaps with a write.
+		void read(T& item)
+		{
+			uint32_t buffer[WORDS];
+			for (uint32_t tries = 1; ; tries++)
+			{
+				uint32_t before = sequence.load(::std::memory_order_acquire);
+				if ((before & 1) == 0)
+				{
+					for (uint32_t i = 0; i < WORDS; i++)
+					{
+						buffer[i] = words[i].load(::std::memory_order_relaxed);
+					}
+					::std::atomic_thread_fence(::std::memory_order_acquire);
+					if (sequence.load(::std::memory_order_relaxed) == before) break;
+				}
+				// A writer of lower priority may have been preempted halfway: let it finish.
+				backOff(tries);
+			}
+			memcpy(&item, buffer, sizeof(T));
+		}
+	};
+
+	template <class T> class Pool<T, PoolTripleBuffer>
+	{
+	private:
+		static const uint8_t FRESH = 4;	// Set in middle when it holds a write that was not read yet.
+
+		T buffers[3];
+		uint8_t back;					// The copy that the writer fills. Owned by the writer.
+		uint8_t front;					// The copy that the reader reads. Owned by the reader.
+		::std::atomic<uint8_t> middle;	// The copy in between, swapped by both.
+
+	public:
+		Pool() : back(0), front(1), middle(2)
+		{}
+
+		// To be called by the writer task only.
+		void write(const T& item)
+		{
+			buffers[back] = item;
+			back = middle.exchange(back | FRESH, ::std::memory_order_acq_rel) & 3;
+		}
+
+		// To be called by the reader task only.
+		void read(T& item)
+		{
+			item = readInPlace();
+		}
+
+		// To be called by the reader task only.
+		// Returns the latest write without copying it. It stays valid until the next read.
+		const T& readInPlace()
+		{
+			if (middle.load(::std::memory_order_relaxed) & FRESH)
+			{
+				front = middle.exchange(front, ::std::memory_order_acq_rel) & 3;
+			}
+			return buffers[front];
+		}
+	};
 };
@@ -2,6 +2,10 @@
 
 // A Queue is a waitable. It is meant for inter task communications.
 // The task that owns the queue should wait for another task to put something into it.
+// Besides read(), it offers a timed read(), tryRead(), and readMany()/writeMany() for batches,
+// which update the event bit once per batch instead of once per message.
+// A FreeRTOS queue copies the messages in and out; to fill large messages in place, use an
+// SpscQueue or MpscQueue instead.
 // (see the Queue example in the examples folder)
 
 #pragma once
@@ -21,6 +25,28 @@ namespace crt
         TickType_t writeDelay;
 		TYPE dummy;
 
+		// Sets the event bit if the queue holds messages, and clears it otherwise.
+		// A write that lands between the count and the clear has already set the bit, which
+		// the clear then undoes. Hence the second count.
+		void updateEventBit()
+		{
+			if (uxQueueMessagesWaiting(qh) > 0)
+			{
+				// The queue is not empty yet,
+				// Make sure that the corresponding eventbit gets set again,
+				// Such that a wait for the queue will fire.
+				pTask->setEventBits(Waitable::getBitMask());
+			}
+			else
+			{
+				pTask->clearEventBits(Waitable::getBitMask());
+				if (uxQueueMessagesWaiting(qh) > 0)
+				{
+					pTask->setEventBits(Waitable::getBitMask());
+				}
+			}
+		}
+
 	public:
 		Queue(Task* pTask,bool bWriteWaitIfQueueFull=false):Waitable(WaitableType::wt_Queue),pTask(pTask),
             writeDelay(bWriteWaitIfQueueFull ? portMAX_DELAY : 0)
@@ -34,21 +60,40 @@ namespace crt
 		void read(TYPE& returnVariable) 
 		{
 			BaseType_t rc = xQueueReceive(qh, &returnVariable, portMAX_DELAY);
-            if (uxQueueMessagesWaiting(qh) > 0)
-            {
-                // The queue is not empty yet,
-                // Make sure that the corresponding eventbit gets set again,
-                // Such that a wait for the queue will fire.
-                pTask->setEventBits(Waitable::getBitMask());
-            }
-            else
-            {
-                pTask->clearEventBits(Waitable::getBitMask());
-            }
+			updateEventBit();
 			assert(rc == pdPASS);
 		}
 
-		bool write(TYPE& variableToCopy)
+		// Like read(), but gives up after timeoutMs. Returns false if nothing was read.
+		bool read(TYPE& returnVariable, uint32_t timeoutMs)
+		{
+			BaseType_t rc = xQueueReceive(qh, &returnVariable, pdMS_TO_TICKS(timeoutMs));
+			updateEventBit();
+			return (rc == pdPASS);
+		}
+
+		// Reads a message if there is one. Returns false if the queue is empty.
+		bool tryRead(TYPE& returnVariable)
+		{
+			return read(returnVariable, 0);
+		}
+
+		// Reads up to maxCount messages, without waiting, and returns how many it read.
+		// The event bit is only updated once, after the batch.
+		uint32_t readMany(TYPE* buffer, uint32_t maxCount)
+		{
+			uint32_t count = uxQueueMessagesWaiting(qh);
+			if (count > maxCount) count = maxCount;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				// Only the owner reads, so the messages that were counted are still there.
+				xQueueReceive(qh, &buffer[i], 0);
+			}
+			updateEventBit();
+			return count;
+		}
+
+		bool write(const TYPE& variableToCopy)
 		{
 			BaseType_t rc = xQueueSend(qh, &variableToCopy, writeDelay);
             if (rc != pdPASS)
@@ -60,6 +105,30 @@ namespace crt
             return true;
 		}
 
+		// Writes count messages, and returns how many it wrote (less than count if the queue
+		// got full, which cannot happen if bWriteWaitIfQueueFull==true).
+		// The event bit is only set once, after the batch.
+		uint32_t writeMany(const TYPE* items, uint32_t count)
+		{
+			uint32_t written = 0;
+			for (; written < count; written++)
+			{
+				if (xQueueSend(qh, &items[written], 0) != pdPASS)
+				{
+					if (writeDelay == 0) break;
+
+					// Full: wake the owner before waiting for it to make room.
+					pTask->setEventBits(Waitable::getBitMask());
+					xQueueSend(qh, &items[written], writeDelay);
+				}
+			}
+			if (written > 0)
+			{
+				pTask->setEventBits(Waitable::getBitMask());
+			}
+			return written;
+		}
+
 		int getNofMessagesWaiting()
 		{
 			return uxQueueMessagesWaiting(qh);
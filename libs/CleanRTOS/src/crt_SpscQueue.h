@@ -0,0 +1,202 @@
+// by Marius Versteegen, 2025
+
+// An SpscQueue is a Queue for a single producer task and a single consumer task
+// (the task that owns it). It is a lock-free ring buffer, so a write does not call
+// the kernel, unless it makes the queue non-empty: only then does it set the event
+// bit that wakes the owner. Likewise, the owner only clears the bit when a read
+// empties the queue. At a high message rate, that saves the xQueueSend, the
+// uxQueueMessagesWaiting and the event bit update that a Queue does per message.
+//
+// Use it like a Queue: wait for it (or waitAny/hasFired), then read() or
+// tryRead() until it is empty. COUNT must be a power of two.
+// For large messages, beginWrite()/endWrite() and beginRead()/endRead() hand out the
+// slot itself, so the message is not copied into and out of the queue.
+// writeMany() and readMany() move a batch of messages with a single head or tail update.
+// With more than one producer, use an MpscQueue instead.
+// (see the QueueBench example in the examples folder)
+
+#pragma once
+#include <atomic>
+#include "internals/crt_FreeRTOS.h"
+#include "internals/crt_Backoff.h"
+#include "crt_Waitable.h"
+#include "crt_Task.h"
+
+namespace crt
+{
+	template<typename TYPE, uint32_t COUNT> class SpscQueue : public Waitable
+	{
+		static_assert(COUNT > 0 && (COUNT & (COUNT - 1)) == 0, "COUNT must be a power of two");
+
+	private:
+		Task* pTask;
+		bool bWriteWaitIfQueueFull;
+
+		// Free-running indices: tail - head is the number of messages.
+		// Each on a cache line of its own, as they are written by different tasks.
+		alignas(64) ::std::atomic<uint32_t> head;	// written by the consumer only
+		alignas(64) ::std::atomic<uint32_t> tail;	// written by the producer only
+		TYPE buffer[COUNT];
+
+		// Makes the n messages from position t on available to the owner.
+		void publish(uint32_t t, uint32_t n)
+		{
+			tail.store(t + n, ::std::memory_order_seq_cst);
+
+			if (head.load(::std::memory_order_seq_cst) == t)
+			{
+				// The queue was empty: wake the owner.
+				pTask->setEventBits(Waitable::getBitMask());
+			}
+		}
+
+		// Frees the n messages from position h on.
+		void consume(uint32_t h, uint32_t n)
+		{
+			head.store(h + n, ::std::memory_order_seq_cst);
+
+			if (tail.load(::std::memory_order_seq_cst) == h + n)
+			{
+				// That was the last one. A write that lands between the check above and
+				// the clear sets the bit before it is cleared, so check again afterwards.
+				pTask->clearEventBits(Waitable::getBitMask());
+				if (tail.load(::std::memory_order_seq_cst) != h + n)
+				{
+					pTask->setEventBits(Waitable::getBitMask());
+				}
+			}
+		}
+
+	public:
+		SpscQueue(Task* pTask, bool bWriteWaitIfQueueFull = false) : Waitable(WaitableType::wt_Queue), pTask(pTask),
+			bWriteWaitIfQueueFull(bWriteWaitIfQueueFull), head(0), tail(0)
+		{
+			Waitable::init(pTask->queryBitNumber(this));
+		}
+
+		// To be called by the producer task only.
+		// Returns false if the queue is full (which cannot happen if bWriteWaitIfQueueFull==true).
+		bool write(const TYPE& variableToCopy)
+		{
+			TYPE* pSlot = beginWrite();
+			if (pSlot == nullptr) return false;
+			*pSlot = variableToCopy;
+			endWrite();
+			return true;
+		}
+
+		// To be called by the producer task only.
+		// Hands out the next free slot, such that the message can be filled in place,
+		// without a copy. Publish it with endWrite().
+		// Returns nullptr if the queue is full (which cannot happen if bWriteWaitIfQueueFull==true).
+		TYPE* beginWrite()
+		{
+			uint32_t t = tail.load(::std::memory_order_relaxed);
+			for (uint32_t tries = 1; (t - head.load(::std::memory_order_acquire)) == COUNT; tries++)
+			{
+				if (!bWriteWaitIfQueueFull) return nullptr;
+				backOff(tries);
+			}
+			return &buffer[t % COUNT];
+		}
+
+		// To be called by the producer task only, after beginWrite().
+		void endWrite()
+		{
+			publish(tail.load(::std::memory_order_relaxed), 1);
+		}
+
+		// To be called by the producer task only.
+		// Writes count messages, and returns how many it wrote (less than count if the queue
+		// got full, which cannot happen if bWriteWaitIfQueueFull==true).
+		// The owner is woken at most once per batch.
+		uint32_t writeMany(const TYPE* items, uint32_t count)
+		{
+			uint32_t written = 0;
+			while (written < count)
+			{
+				uint32_t t = tail.load(::std::memory_order_relaxed);
+				uint32_t room = COUNT - (t - head.load(::std::memory_order_acquire));
+				if (room == 0)
+				{
+					if (!bWriteWaitIfQueueFull) break;
+					// Wait for a single free slot, then fill as many as there are.
+					beginWrite();
+					continue;
+				}
+				uint32_t n = (count - written < room) ? count - written : room;
+				for (uint32_t i = 0; i < n; i++)
+				{
+					buffer[(t + i) % COUNT] = items[written + i];
+				}
+				publish(t, n);
+				written += n;
+			}
+			return written;
+		}
+
+		// To be called by the owner only. Waits if the queue is empty.
+		void read(TYPE& returnVariable)
+		{
+			while (!tryRead(returnVariable))
+			{
+				pTask->wait(*this);
+			}
+		}
+
+		// To be called by the owner only. Returns false if the queue is empty.
+		bool tryRead(TYPE& returnVariable)
+		{
+			TYPE* pMessage = beginRead();
+			if (pMessage == nullptr) return false;
+			returnVariable = *pMessage;
+			endRead();
+			return true;
+		}
+
+		// To be called by the owner only.
+		// Hands out the oldest message, such that it can be used in place, without a copy.
+		// It stays valid until endRead(). Returns nullptr if the queue is empty.
+		TYPE* beginRead()
+		{
+			uint32_t h = head.load(::std::memory_order_relaxed);
+			if (tail.load(::std::memory_order_acquire) == h) return nullptr;
+			return &buffer[h % COUNT];
+		}
+
+		// To be called by the owner only, after beginRead() returned a message.
+		void endRead()
+		{
+			consume(head.load(::std::memory_order_relaxed), 1);
+		}
+
+		// To be called by the owner only.
+		// Reads up to maxCount messages, without waiting, and returns how many it read.
+		// The event bit is updated at most once per batch.
+		uint32_t readMany(TYPE* items, uint32_t maxCount)
+		{
+			uint32_t h = head.load(::std::memory_order_relaxed);
+			uint32_t count = tail.load(::std::memory_order_acquire) - h;
+			if (count > maxCount) count = maxCount;
+			if (count == 0) return 0;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				items[i] = buffer[(h + i) % COUNT];
+			}
+			consume(h, count);
+			return count;
+		}
+
+		int getNofMessagesWaiting()
+		{
+			return tail.load(::std::memory_order_acquire) - head.load(::std::memory_order_acquire);
+		}
+
+		// To be called by the owner only.
+		void clear()
+		{
+			TYPE dummy;
+			while (tryRead(dummy)) {}
+		}
+	};
+};
@@ -6,10 +6,15 @@
 #include "crt_Config.h"
 #include "crt_ILogger.h"
 #include "crt_Waitable.h"
+#include "crt_WaitableSet.h"
 
 // After a class has inherited from Task, every instantiated object of that
 // class will run in its own thread. Within the main function of a such object, 
-// it is possible to wait for Waitables.
+// it is possible to wait for Waitables, with or without a timeout.
+// A task can have up to 23 + 24 * (MAX_EVENTGROUPS - 1) waitables (see crt_Waitable.h).
+// NOTE: the first event group used to hold 24 waitables. Since its last bit became the summary
+// bit, the 24th waitable of a task is in the second event group. A single bitmask that combines
+// it with waitables of the first group is no longer valid: use a WaitableSet for that.
 // (see the examples HelloWorld, TwoTasks and TenTasks in the examples folder)
 
 namespace crt
@@ -22,8 +27,10 @@ namespace crt
 		UBaseType_t prev_stack_hwm = 0;
 
 	private:
-		EventGroupHandle_t hEventGroup;
-		uint32_t latestResult = 0;
+		static const uint32_t summaryBit = 1 << Waitable::firstGroupSize;	// Set with any bit of a next event group.
+
+		EventGroupHandle_t hEventGroups[MAX_EVENTGROUPS] = {};		// The next ones are created when needed.
+		uint32_t latestResults[MAX_EVENTGROUPS] = {};
 
 	public:
 		const char *taskName;
@@ -33,34 +40,42 @@ namespace crt
 		TaskHandle_t taskHandle;
 
 		uint32_t nofWaitables;
-        uint32_t queuesMask;        // Every bit in this mask belongs to a queue.
-        uint32_t flagsMask;         // Every bit in this mask belongs to a flag.
-        uint32_t timersMask;        // Every bit in this mask belongs to a timer.
+        uint32_t queuesMasks[MAX_EVENTGROUPS] = {};    // Every bit in these masks belongs to a queue.
+        uint32_t flagsMasks[MAX_EVENTGROUPS] = {};     // Every bit in these masks belongs to a flag.
+        uint32_t timersMasks[MAX_EVENTGROUPS] = {};    // Every bit in these masks belongs to a timer.
 
         std::Stack<uint32_t, MAX_MUTEXNESTING> mutexIdStack;
 
 	public:
         Task(const char *taskName, unsigned int taskPriority, unsigned int taskStackSizeBytes, unsigned int taskCoreNumber)
             : taskName(taskName), taskPriority(taskPriority), taskStackSizeBytes(taskStackSizeBytes), taskCoreNumber(taskCoreNumber),
-            nofWaitables(0), queuesMask(0), flagsMask(0), timersMask(0), mutexIdStack(0)  // The value 0 is reserved for "empty stack".
+            nofWaitables(0), mutexIdStack(0)  // The value 0 is reserved for "empty stack".
 		{
-			hEventGroup = xEventGroupCreate();
-			assert(hEventGroup != NULL); // If failed, not enough heap memory.
+			hEventGroups[0] = xEventGroupCreate();
+			assert(hEventGroups[0] != NULL); // If failed, not enough heap memory.
 		}
 
         uint32_t queryBitNumber(Waitable* pWaitable)
         {
-            assert(nofWaitables < 24);
+            uint32_t bitMask = Waitable::toBitMask(nofWaitables);
+            uint32_t group = bitMask >> Waitable::groupShift;
+            uint32_t bits = bitMask & Waitable::bitsMask;
+            assert(group < MAX_EVENTGROUPS);	// Too many waitables: increase MAX_EVENTGROUPS in crt_Config.h
+            if (hEventGroups[group] == NULL)
+            {
+                hEventGroups[group] = xEventGroupCreate();
+                assert(hEventGroups[group] != NULL); // If failed, not enough heap memory.
+            }
             switch (pWaitable->getType())
             {
             case WaitableType::wt_Queue:
-                queuesMask |= (1 << nofWaitables);
+                queuesMasks[group] |= bits;
                 break;
             case WaitableType::wt_Timer:
-                timersMask |= (1 << nofWaitables);
+                timersMasks[group] |= bits;
                 break;
             case WaitableType::wt_Flag:
-                flagsMask |= (1 << nofWaitables);
+                flagsMasks[group] |= bits;
                 break;
             default:
                 break;
@@ -71,17 +86,23 @@ namespace crt
         // obsolete.. niet gebruikt..
         EventGroupHandle_t* getEventGroup()
         {
-            return &hEventGroup;
+            return &hEventGroups[0];
         }
 
+        // The bits may only be of waitables in the same event group (see crt_Waitable.h).
         inline void setEventBits(const EventBits_t uxBitsToSet)
         {
-            xEventGroupSetBits(hEventGroup,uxBitsToSet);
+            uint32_t group = uxBitsToSet >> Waitable::groupShift;
+            xEventGroupSetBits(hEventGroups[group], uxBitsToSet & Waitable::bitsMask);
+            if (group > 0)
+            {
+                xEventGroupSetBits(hEventGroups[0], summaryBit);	// Wakes waitAny() of a WaitableSet.
+            }
         }
 
         inline void clearEventBits(const EventBits_t uxBitsToClear)
         {
-            xEventGroupClearBits(hEventGroup, uxBitsToClear);
+            xEventGroupClearBits(hEventGroups[uxBitsToClear >> Waitable::groupShift], uxBitsToClear & Waitable::bitsMask);
         }
 
 		// Next function starts the thread.
@@ -144,20 +165,25 @@ namespace crt
             waitAll(waitable.getBitMask());
         }
 
+        // Like wait(), but gives up after timeoutMs. Returns false if the waitable did not fire.
+        inline bool wait(Waitable& waitable, uint32_t timeoutMs)
+        {
+            return waitAll(waitable.getBitMask(), timeoutMs);
+        }
+
         // Waitll waits till ALL the specified waitables have fired.
         // It automatically clears the event-bits, apart from the queue bits.
         // So there's no need to check with hasFired.
 		inline void waitAll(uint32_t bitsToWaitFor)
 		{
-			latestResult = xEventGroupWaitBits(
-				hEventGroup,
-				bitsToWaitFor,
-				pdTRUE, // xClearOnExit, We'd like to set it to false, but that would create a race condition, right after this function returns, another thread could set another flag. .  Waiting for all, all bits can be cleared!.. except for the queue bits - they can only become cleared after reading from the queue has emptied it..
-				pdTRUE, // xWaitForAllBits
-				portMAX_DELAY); // xTicksToWait)
-
-            // Actually, we didn't want to clear the queue bits, so let's repair that:
-            setEventBits(queuesMask & latestResult);
+			waitBits(bitsToWaitFor, true, portMAX_DELAY);
+		}
+
+		// Like waitAll(), but gives up after timeoutMs. Returns false if not all waitables fired.
+		// Then, no event-bits are cleared.
+		inline bool waitAll(uint32_t bitsToWaitFor, uint32_t timeoutMs)
+		{
+			return waitBits(bitsToWaitFor, true, pdMS_TO_TICKS(timeoutMs));
 		}
 
 		// return value: the bits that were set at the time of firing.
@@ -168,24 +194,130 @@ namespace crt
         // Thus, it is advised always to process only the actions on a single event after a waitAny.
 		inline void waitAny(uint32_t bitsToWaitFor)
 		{
-			latestResult = xEventGroupWaitBits(
-				hEventGroup,
-				bitsToWaitFor,
-				pdFALSE, // xClearOnExit,  Waiting for any: individual "hasFired" checks are needed. They will clear/consume the corresponding event.
-				pdFALSE, // xWaitForAllBits,
-				portMAX_DELAY); // xTicksToWait)
+			waitBits(bitsToWaitFor, false, portMAX_DELAY);
+		}
+
+		// Like waitAny(), but gives up after timeoutMs. Returns false if none of the waitables fired.
+		inline bool waitAny(uint32_t bitsToWaitFor, uint32_t timeoutMs)
+		{
+			return waitBits(bitsToWaitFor, false, pdMS_TO_TICKS(timeoutMs));
+		}
+
+		// Waits for any waitable of the set, which may span several event groups.
+		// Use hasFired() to determine which one.
+		inline void waitAny(const WaitableSet& waitableSet)
+		{
+			waitSet(waitableSet, portMAX_DELAY);
+		}
+
+		// Like waitAny(waitableSet), but gives up after timeoutMs. Returns false if none of the waitables fired.
+		inline bool waitAny(const WaitableSet& waitableSet, uint32_t timeoutMs)
+		{
+			return waitSet(waitableSet, pdMS_TO_TICKS(timeoutMs));
 		}
 
 		inline bool hasFired(Waitable& waitable)
 		{
             uint32_t bitmask = waitable.getBitMask();
-			bool result = ((latestResult & bitmask) != 0);
+			bool result = ((latestResults[waitable.getGroup()] & bitmask & Waitable::bitsMask) != 0);
             if (result)
             {
                 // "Manually" Clear, except if a queue is involved for a queue, only a read() may consume the event that signals that there's someting in the queue.
-                clearEventBits((~queuesMask) & bitmask);
+                clearEventBits(bitmask & ~queuesMasks[waitable.getGroup()]);
             }
             return result;
 		}
+
+	private:
+		void clearLatestResults()
+		{
+			for (uint32_t group = 0; group < MAX_EVENTGROUPS; group++)
+			{
+				latestResults[group] = 0;
+			}
+		}
+
+		bool waitBits(uint32_t bitsToWaitFor, bool bWaitForAll, TickType_t ticksToWait)
+		{
+			uint32_t group = bitsToWaitFor >> Waitable::groupShift;
+			uint32_t bits = bitsToWaitFor & Waitable::bitsMask;
+			assert(group < MAX_EVENTGROUPS);
+			assert(hEventGroups[group] != NULL);	// Not a bitmask of waitables of this task.
+			clearLatestResults();
+
+			// When waiting for all, all bits can be cleared on exit. When waiting for any, they can't:
+			// right after this function returns, another thread could set another flag. Individual
+			// "hasFired" checks will clear/consume the corresponding events instead.
+			EventBits_t result = xEventGroupWaitBits(
+				hEventGroups[group],
+				bits,
+				bWaitForAll ? pdTRUE : pdFALSE,	// xClearOnExit
+				bWaitForAll ? pdTRUE : pdFALSE,	// xWaitForAllBits
+				ticksToWait);
+
+			bool bFired = bWaitForAll ? ((result & bits) == bits) : ((result & bits) != 0);
+			if (!bFired) return false;		// Timed out.
+
+			latestResults[group] = result;
+			if (bWaitForAll)
+			{
+				// Actually, we didn't want to clear the queue bits (they can only become cleared after
+				// reading from the queue has emptied it), so let's repair that:
+				uint32_t queueBits = queuesMasks[group] & result & bits;
+				if (queueBits != 0)
+				{
+					xEventGroupSetBits(hEventGroups[group], queueBits);
+				}
+			}
+			return true;
+		}
+
+		// Looks whether any waitable of the set beyond the first event group has fired.
+		bool pollNextGroups(const WaitableSet& waitableSet)
+		{
+			bool bFired = false;
+			for (uint32_t group = 1; group < MAX_EVENTGROUPS; group++)
+			{
+				if (waitableSet.getMask(group) == 0) continue;
+				latestResults[group] = xEventGroupGetBits(hEventGroups[group]);
+				if ((latestResults[group] & waitableSet.getMask(group)) != 0) bFired = true;
+			}
+			return bFired;
+		}
+
+		bool waitSet(const WaitableSet& waitableSet, TickType_t ticksToWait)
+		{
+			clearLatestResults();
+			bool bHierarchical = waitableSet.isHierarchical();
+			uint32_t bits = waitableSet.getMask(0) | (bHierarchical ? summaryBit : 0);
+			assert(bits != 0);	// An empty set.
+			TickType_t startTick = xTaskGetTickCount();
+
+			while (true)
+			{
+				if (bHierarchical)
+				{
+					// Clear the summary bit before looking in the next groups, such that a bit
+					// that is set after the look sets it again, and wakes the wait below.
+					xEventGroupClearBits(hEventGroups[0], summaryBit);
+					if (pollNextGroups(waitableSet)) return true;
+				}
+
+				TickType_t remainingTicks = portMAX_DELAY;
+				if (ticksToWait != portMAX_DELAY)
+				{
+					TickType_t elapsedTicks = xTaskGetTickCount() - startTick;
+					remainingTicks = (elapsedTicks < ticksToWait) ? ticksToWait - elapsedTicks : 0;
+				}
+				EventBits_t result = xEventGroupWaitBits(hEventGroups[0], bits, pdFALSE, pdFALSE, remainingTicks);
+				if ((result & waitableSet.getMask(0)) != 0)
+				{
+					latestResults[0] = result & ~summaryBit;
+					return true;
+				}
+				if ((result & summaryBit) == 0) return false;	// Timed out.
+				// else: a waitable of a next group fired: find it.
+			}
+		}
 	};
 };
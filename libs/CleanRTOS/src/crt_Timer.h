@@ -8,7 +8,8 @@
 // A Timer is a microsecond timer. It can be fire once (20 us or more) or periodic(50 us or more).
 // The timer is also a waitable. It can be waited for by the task that owns it.
 // If waits of longer than 1000 us are needed, it is better to use vTaskDelay instead (to avoid
-// running out of hardware timers).
+// running out of hardware timers). For many timers, use SoftTimers on a TimerService
+// (see crt_TimerService.h): they share a single hardware timer.
 
 namespace crt
 {
@@ -0,0 +1,411 @@
+// by Marius Versteegen, 2025
+
+// A TimerService runs any number of SoftTimers on a single esp_timer.
+//
+// A SoftTimer is used like a Timer: it is a waitable of the task that owns it, and it can
+// fire once or periodically. But it has no esp_timer of its own, so creating one costs
+// nothing, and there is no limit on how many there are.
+//
+// The TimerService keeps its SoftTimers in a hierarchical timing wheel: LEVELS levels of
+// SLOTS slots each. A slot of level 0 spans one tick of resolutionUs, a slot of level 1 spans
+// SLOTS ticks, and so on. A SoftTimer is put in the slot of the lowest level that reaches its
+// deadline, in a doubly-linked list, so start() and stop() take the same time, however many
+// SoftTimers run. When the wheel reaches a slot of a higher level, its SoftTimers are moved
+// down (cascaded) to the level below.
+//
+// The esp_timer is armed once, for the next slot that holds a SoftTimer. Empty slots are
+// skipped, so an idle TimerService costs nothing either.
+//
+// A SoftTimer fires at the first tick at or after its deadline, so it is up to resolutionUs
+// late, plus the wake-up time of the esp_timer. The default resolution of 100 us suits
+// timers of a millisecond or more. For shorter, accurate waits, use a Timer.
+// (see the TimerServiceBench example in the examples folder)
+
+#pragma once
+#include "internals/crt_FreeRTOS.h"
+#include "crt_Waitable.h"
+#include "crt_Task.h"
+
+namespace crt
+{
+	// The part of a SoftTimer that the TimerService works with.
+	struct TimerNode
+	{
+		TimerNode* pNext;
+		TimerNode* pPrev;
+		int64_t dueUs;
+		uint64_t periodUs;			// 0 for a one-shot timer.
+		Task* pTask;
+		uint32_t bitMask;
+		uint8_t level;
+		uint8_t slot;
+		bool bActive;
+
+		TimerNode() : pNext(nullptr), pPrev(nullptr), dueUs(0), periodUs(0), pTask(nullptr), bitMask(0),
+			level(0), slot(0), bActive(false)
+		{}
+	};
+
+	struct TimerServiceStats
+	{
+		uint32_t wakeUps;			// Calls of the esp_timer callback.
+		uint32_t fired;
+		uint32_t cascaded;			// Moves of a SoftTimer to a lower level.
+		uint32_t overruns;			// Periods of periodic SoftTimers that were skipped, because they had passed.
+		int64_t totalLatenessUs;	// The time from the deadline to the firing.
+		int64_t maxLatenessUs;
+		int64_t activeUs;			// The time spent in the esp_timer callback.
+		int64_t elapsedUs;
+	};
+
+	class TimerService
+	{
+	public:
+		static const uint32_t LEVELS = 4;
+		static const uint32_t SLOT_BITS = 6;
+		static const uint32_t SLOTS = 1 << SLOT_BITS;
+
+	private:
+		static const uint64_t noTick = UINT64_MAX;
+
+		uint32_t resolutionUs;
+		int64_t baseUs;				// The time of tick 0.
+		uint64_t currentTick;		// The last tick that was handled.
+		uint64_t armedTick;			// The tick that the esp_timer is armed for.
+		uint32_t nofActive;
+		TimerNode* slots[LEVELS][SLOTS] = {};
+		uint64_t occupied[LEVELS] = {};	// A bit per slot that holds a SoftTimer.
+		portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;	// Guards the wheel.
+		esp_timer_create_args_t timer_args;
+		esp_timer_handle_t hTimer;
+		TimerServiceStats stats;
+		int64_t statsStartUs;
+
+	public:
+		TimerService(uint32_t resolutionUs = 100) : resolutionUs(resolutionUs), baseUs(0), currentTick(0), armedTick(noTick),
+			nofActive(0), hTimer(nullptr), stats(), statsStartUs(0)
+		{
+			assert(resolutionUs > 0);
+			timer_args.callback = static_timer_callback;
+			timer_args.name = "timerService"; // name for debug purposes.
+			timer_args.arg = this;
+		}
+
+		// Starts the node, or restarts it if it is running already.
+		// periodUs : 0 for a one-shot timer.
+		void start(TimerNode& node, uint64_t durationUs, uint64_t periodUs)
+		{
+			createIfNeeded();
+			taskENTER_CRITICAL(&mux);
+			if (node.bActive)
+			{
+				remove(node);
+			}
+			int64_t nowUs = esp_timer_get_time();
+			if (nofActive == 0)
+			{
+				// Nothing is pending, so the wheel can skip to now.
+				uint64_t nowTick = toTick(nowUs);
+				if (nowTick > currentTick) currentTick = nowTick;
+			}
+			node.dueUs = nowUs + durationUs;
+			node.periodUs = periodUs;
+			insert(node);
+			if (nextEventTick() < armedTick)
+			{
+				arm();
+			}
+			taskEXIT_CRITICAL(&mux);
+		}
+
+		void stop(TimerNode& node)
+		{
+			taskENTER_CRITICAL(&mux);
+			if (node.bActive)
+			{
+				remove(node);
+			}
+			taskEXIT_CRITICAL(&mux);
+			// The esp_timer may still fire for it. Then it finds nothing to do.
+		}
+
+		uint32_t getResolutionUs()
+		{
+			return resolutionUs;
+		}
+
+		// The time of tick 0, set by the first start(). A deadline of baseUs + n * resolutionUs is on tick n.
+		int64_t getBaseUs()
+		{
+			return baseUs;
+		}
+
+		// Can be called by any task. The numbers may be a firing behind.
+		TimerServiceStats getStats()
+		{
+			TimerServiceStats result = stats;
+			result.elapsedUs = esp_timer_get_time() - statsStartUs;
+			return result;
+		}
+
+		void resetStats()
+		{
+			taskENTER_CRITICAL(&mux);
+			stats = TimerServiceStats();
+			statsStartUs = esp_timer_get_time();
+			taskEXIT_CRITICAL(&mux);
+		}
+
+	private:
+		void createIfNeeded()
+		{
+			if (hTimer != nullptr) return; // already created
+			esp_err_t err = esp_timer_create(&timer_args, &hTimer);
+			if (err != ESP_OK)
+			{
+				ESP_LOGE("Error:", "TimerService could not create its esp_timer");
+				assert(false);
+			}
+			baseUs = esp_timer_get_time();
+			statsStartUs = baseUs;
+		}
+
+		// The first tick at or after timeUs.
+		uint64_t toTick(int64_t timeUs)
+		{
+			if (timeUs <= baseUs) return 0;
+			return (uint64_t)(timeUs - baseUs + resolutionUs - 1) / resolutionUs;
+		}
+
+		// bCascading : the node is moved down from the slot that is reached at currentTick. Then
+		//              the current slot of level 0 is looked at again, so it may be due at currentTick.
+		// To be called within the critical section of mux.
+		void insert(TimerNode& node, bool bCascading = false)
+		{
+			uint64_t dueTick = toTick(node.dueUs);
+			if (dueTick < currentTick || (dueTick == currentTick && !bCascading))
+			{
+				dueTick = currentTick + 1;	// The current tick has been handled already.
+			}
+
+			uint64_t delta = dueTick - currentTick;
+			uint32_t level = 0;
+			while (level < LEVELS - 1 && delta >= ((uint64_t)1 << (SLOT_BITS * (level + 1))))
+			{
+				level++;
+			}
+			if (delta >= ((uint64_t)1 << (SLOT_BITS * LEVELS)))
+			{
+				// Beyond the wheel: park it in the last slot that it reaches. It is put back
+				// in the wheel from there, as often as needed.
+				dueTick = currentTick + ((uint64_t)1 << (SLOT_BITS * LEVELS)) - 1;
+			}
+
+			uint32_t slot = (dueTick >> (SLOT_BITS * level)) & (SLOTS - 1);
+			node.level = level;
+			node.slot = slot;
+			node.pPrev = nullptr;
+			node.pNext = slots[level][slot];
+			if (node.pNext != nullptr) node.pNext->pPrev = &node;
+			slots[level][slot] = &node;
+			occupied[level] |= ((uint64_t)1 << slot);
+			if (!node.bActive)
+			{
+				node.bActive = true;
+				nofActive++;
+			}
+		}
+
+		// To be called within the critical section of mux.
+		void remove(TimerNode& node)
+		{
+			if (node.pPrev != nullptr)
+			{
+				node.pPrev->pNext = node.pNext;
+			}
+			else
+			{
+				slots[node.level][node.slot] = node.pNext;
+				if (node.pNext == nullptr) occupied[node.level] &= ~((uint64_t)1 << node.slot);
+			}
+			if (node.pNext != nullptr) node.pNext->pPrev = node.pPrev;
+			node.bActive = false;
+			nofActive--;
+		}
+
+		// The next tick at which a slot of level 0 fires, or a slot of a higher level cascades.
+		// To be called within the critical section of mux.
+		uint64_t nextEventTick()
+		{
+			uint64_t result = noTick;
+			for (uint32_t level = 0; level < LEVELS; level++)
+			{
+				if (occupied[level] == 0) continue;
+
+				// The nearest occupied slot after the current one (the current one counts as the farthest).
+				uint64_t base = currentTick >> (SLOT_BITS * level);
+				uint32_t shift = (base + 1) & (SLOTS - 1);
+				uint64_t rotated = (shift == 0) ? occupied[level] : ((occupied[level] >> shift) | (occupied[level] << (SLOTS - shift)));
+				uint64_t distance = __builtin_ctzll(rotated) + 1;
+
+				uint64_t tick = (base + distance) << (SLOT_BITS * level);
+				if (tick < result) result = tick;
+			}
+			return result;
+		}
+
+		// Moves the SoftTimers of the slot of the given level that is reached at currentTick one or more levels down.
+		// To be called within the critical section of mux.
+		void cascade(uint32_t level)
+		{
+			uint32_t slot = (currentTick >> (SLOT_BITS * level)) & (SLOTS - 1);
+			TimerNode* pNode = slots[level][slot];
+			slots[level][slot] = nullptr;
+			occupied[level] &= ~((uint64_t)1 << slot);
+			while (pNode != nullptr)
+			{
+				TimerNode* pNext = pNode->pNext;
+				insert(*pNode, true);
+				stats.cascaded++;
+				pNode = pNext;
+			}
+		}
+
+		// Takes a SoftTimer that is due at or before nowTick, after advancing the wheel as far as needed.
+		// Returns nullptr if none is.
+		// To be called within the critical section of mux.
+		TimerNode* takeDue(uint64_t nowTick)
+		{
+			while (true)
+			{
+				uint32_t slot = currentTick & (SLOTS - 1);
+				TimerNode* pNode = slots[0][slot];
+				if (pNode != nullptr)
+				{
+					remove(*pNode);
+					return pNode;
+				}
+
+				uint64_t tick = nextEventTick();
+				if (tick > nowTick) return nullptr;
+				currentTick = tick;
+				for (uint32_t level = LEVELS - 1; level > 0; level--)
+				{
+					if ((currentTick & (((uint64_t)1 << (SLOT_BITS * level)) - 1)) == 0)
+					{
+						cascade(level);
+					}
+				}
+			}
+		}
+
+		// Arms the esp_timer for the next event, if any.
+		// To be called within the critical section of mux.
+		void arm()
+		{
+			if (armedTick != noTick)
+			{
+				esp_timer_stop(hTimer);
+				armedTick = noTick;
+			}
+			uint64_t tick = nextEventTick();
+			if (tick == noTick) return;
+
+			int64_t delayUs = baseUs + (int64_t)(tick * resolutionUs) - esp_timer_get_time();
+			if (delayUs < 1) delayUs = 1;
+			esp_timer_start_once(hTimer, delayUs);
+			armedTick = tick;
+		}
+
+		static void static_timer_callback(void* arg)
+		{
+			((TimerService*)arg)->timer_callback();
+		}
+
+		// Runs in the esp_timer task. Fires the due SoftTimers one by one, such that the event
+		// bits are set outside the critical section.
+		void timer_callback()
+		{
+			int64_t wakeUs = esp_timer_get_time();
+			taskENTER_CRITICAL(&mux);
+			armedTick = noTick;		// It fired.
+			stats.wakeUps++;
+			uint64_t nowTick = toTick(wakeUs);
+			while (true)
+			{
+				TimerNode* pNode = takeDue(nowTick);
+				if (pNode == nullptr) break;
+
+				int64_t nowUs = esp_timer_get_time();
+				int64_t latenessUs = nowUs - pNode->dueUs;
+				if (latenessUs < 0) latenessUs = 0;	// Fired in the tick of its deadline.
+				stats.fired++;
+				stats.totalLatenessUs += latenessUs;
+				if (latenessUs > stats.maxLatenessUs) stats.maxLatenessUs = latenessUs;
+
+				if (pNode->periodUs > 0)
+				{
+					// The next deadline. Skip the ones that have already passed.
+					pNode->dueUs += pNode->periodUs;
+					if (pNode->dueUs <= nowUs)
+					{
+						uint64_t missed = (nowUs - pNode->dueUs) / pNode->periodUs + 1;
+						stats.overruns += missed;
+						pNode->dueUs += missed * pNode->periodUs;
+					}
+					insert(*pNode);
+				}
+				Task* pTask = pNode->pTask;
+				uint32_t bitMask = pNode->bitMask;
+
+				taskEXIT_CRITICAL(&mux);
+				pTask->setEventBits(bitMask);
+				taskENTER_CRITICAL(&mux);
+			}
+			arm();
+			stats.activeUs += esp_timer_get_time() - wakeUs;
+			taskEXIT_CRITICAL(&mux);
+		}
+	}; // end class TimerService
+
+	// A SoftTimer is a timer that runs on a TimerService. It can fire once or periodically.
+	// The timer is a waitable. It can be waited for by the task that owns it.
+	class SoftTimer : public Waitable
+	{
+	private:
+		TimerNode node;
+		TimerService& timerService;
+		Task* pTask;
+
+	public:
+		SoftTimer(Task* pTask, TimerService& timerService) : Waitable(WaitableType::wt_Timer), timerService(timerService), pTask(pTask)
+		{
+			Waitable::init(pTask->queryBitNumber(this));	// This will cause the bitmask of Waitable to be set properly.
+			node.pTask = pTask;
+			node.bitMask = Waitable::getBitMask();
+		}
+
+		inline void sleep_us(uint64_t duration_us)
+		{
+			start(duration_us);
+			pTask->wait(*this);
+		}
+
+		// Restarts the timer if it is running already.
+		inline void start(uint64_t duration_us)
+		{
+			timerService.start(node, duration_us, 0);
+		}
+
+		inline void start_periodic(uint64_t period_us)
+		{
+			assert(period_us >= timerService.getResolutionUs());	// assert against bad design
+			timerService.start(node, period_us, period_us);
+		}
+
+		inline void stop()
+		{
+			timerService.stop(node);
+		}
+	};
+};
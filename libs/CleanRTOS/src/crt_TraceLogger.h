@@ -0,0 +1,302 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+#include "internals/crt_FreeRTOS.h"
+#include "crt_Config.h"
+#include "crt_ILogger.h"
+#include "crt_LoggerTask.h"
+
+// crt::TraceLogger
+
+// A TraceLogger is a logger that never loses a log silently, and never stops the tasks that log.
+//
+// A trace is a format string plus up to TRACE_MAXARGS numbers, like a printf:
+//    traceLogger.trace("speed: %d, fraction: %f", speed, fraction);
+// The call only stores a timestamp, the pointer to the format and the numbers, in a lock-free
+// ring buffer of the core it runs on. So the format must be a string literal (or live as long),
+// and %s is not supported. Any task (and any number of them) may trace.
+//
+// The formatting is left to a low-priority drain task, that empties the rings every
+// drainPeriodMs into a sink (see crt_TraceSinks.h):
+//  - TraceTextSink formats the traces and logs them with ESP_LOGI.
+//  - TraceBinarySink writes them as binary frames, to be decoded on the PC by
+//    tools/trace_decode.py. That is far less to send over the UART, so it keeps up with more.
+// If a ring is full, the trace is dropped and counted. The sink reports the count.
+//
+// TraceLogger implements ILogger, so it can replace the Logger:
+// TraceTextSink traceSink;
+// TraceLogger<256> theLogger("TraceLogger", 1 /*priority*/, ARDUINO_RUNNING_CORE, 10 /*drainPeriodMs*/, traceSink);
+// ILogger& logger = theLogger;
+// Note that logText() uses its text as format: write a literal % as %%.
+
+// (see the TraceLoggerBench example in the examples folder)
+
+namespace crt
+{
+	static const uint32_t TRACE_MAXARGS = 4;
+
+	struct TraceEntry
+	{
+		uint32_t timestampUs;		// The lower 32 bits of esp_timer_get_time().
+		const char* format;
+		uint32_t nofArgs;
+		uint32_t args[TRACE_MAXARGS];	// A float is stored as its bits.
+	};
+
+	class ITraceSink
+	{
+	public:
+		// Called by the drain task, with the traces of a core in the order in which they were made.
+		virtual void write(uint32_t core, const TraceEntry& entry) = 0;
+		// count: the traces that were dropped on that core since the previous call.
+		virtual void lost(uint32_t core, uint32_t count) = 0;
+		// Called after every drain.
+		virtual void flush() = 0;
+	};
+
+	struct TraceStats
+	{
+		uint32_t traced;
+		uint32_t dropped;
+	};
+
+	inline uint32_t toTraceArg(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	inline uint32_t toTraceArg(double value)
+	{
+		return toTraceArg((float)value);
+	}
+
+	template<typename T> inline uint32_t toTraceArg(T value)
+	{
+		static_assert(::std::is_integral<T>::value || ::std::is_enum<T>::value, "Only numbers can be traced");
+		return (uint32_t)value;
+	}
+
+	// RECORDS_PER_CORE must be a power of two.
+	template<uint32_t RECORDS_PER_CORE> class TraceLogger : public LoggerTask, public ILogger
+	{
+		static_assert(RECORDS_PER_CORE > 0 && (RECORDS_PER_CORE & (RECORDS_PER_CORE - 1)) == 0, "RECORDS_PER_CORE must be a power of two");
+
+	private:
+		struct Slot
+		{
+			// == position:     free, to be written at that position.
+			// == position + 1: holds the trace of that position.
+			::std::atomic<uint32_t> sequence;
+			TraceEntry entry;
+		};
+
+		// Like an MpscQueue, but a trace is dropped instead of waiting if the ring is full.
+		struct Ring
+		{
+			alignas(64) ::std::atomic<uint32_t> head;	// written by the drain task only
+			alignas(64) ::std::atomic<uint32_t> tail;	// claimed by the tracing tasks
+			::std::atomic<uint32_t> dropped;
+			uint32_t reportedDropped;					// used by the drain task only
+			uint32_t drained;							// idem
+			Slot slots[RECORDS_PER_CORE];
+		};
+
+		Ring rings[portNUM_PROCESSORS];
+		ITraceSink& sink;
+		uint32_t drainPeriodMs;
+
+	public:
+		static void StaticMain(void *pParam)
+		{
+			TraceLogger<RECORDS_PER_CORE>* THIS = (TraceLogger<RECORDS_PER_CORE>*) pParam;
+			THIS->Main();
+		}
+
+		TraceLogger(const char *taskName, unsigned int taskPriority, unsigned int taskCoreNumber, uint32_t drainPeriodMs, ITraceSink& sink) :
+			LoggerTask(taskName, taskPriority, 4000 /*taskSizeBytes*/, taskCoreNumber), sink(sink), drainPeriodMs(drainPeriodMs)
+		{
+			for (uint32_t core = 0; core < portNUM_PROCESSORS; core++)
+			{
+				Ring& ring = rings[core];
+				ring.head.store(0, ::std::memory_order_relaxed);
+				ring.tail.store(0, ::std::memory_order_relaxed);
+				ring.dropped.store(0, ::std::memory_order_relaxed);
+				ring.reportedDropped = 0;
+				ring.drained = 0;
+				for (uint32_t i = 0; i < RECORDS_PER_CORE; i++)
+				{
+					ring.slots[i].sequence.store(i, ::std::memory_order_relaxed);
+				}
+			}
+			start();	// Like the Logger, the TraceLogger starts itself right after construction.
+		}
+
+		inline void trace(const char* format)
+		{
+			record(format, nullptr, 0);
+		}
+
+		template<typename A> inline void trace(const char* format, A a)
+		{
+			uint32_t args[] = { toTraceArg(a) };
+			record(format, args, 1);
+		}
+
+		template<typename A, typename B> inline void trace(const char* format, A a, B b)
+		{
+			uint32_t args[] = { toTraceArg(a), toTraceArg(b) };
+			record(format, args, 2);
+		}
+
+		template<typename A, typename B, typename C> inline void trace(const char* format, A a, B b, C c)
+		{
+			uint32_t args[] = { toTraceArg(a), toTraceArg(b), toTraceArg(c) };
+			record(format, args, 3);
+		}
+
+		template<typename A, typename B, typename C, typename D> inline void trace(const char* format, A a, B b, C c, D d)
+		{
+			uint32_t args[] = { toTraceArg(a), toTraceArg(b), toTraceArg(c), toTraceArg(d) };
+			record(format, args, 4);
+		}
+
+		/*override keyword not supported in current compiler*/
+		void logText(const char *text)
+		{
+			trace(text);
+		}
+
+		/*override keyword not supported in current compiler*/
+		void logInt32(int32_t intNumber)
+		{
+			trace("%" PRId32, intNumber);
+		}
+
+		/*override keyword not supported in current compiler*/
+		void logUint32(uint32_t intNumber)
+		{
+			trace("%" PRIu32, intNumber);
+		}
+
+		/*override keyword not supported in current compiler*/
+		void logFloat(float floatNumber)
+		{
+			trace("%f", floatNumber);
+		}
+
+		// The traces are drained continuously, so there is nothing to dump.
+		/*override keyword not supported in current compiler*/
+		void dumpNow()
+		{}
+
+		// Can be called by any task. traced counts the traces that were drained.
+		TraceStats getStats()
+		{
+			TraceStats stats = {};
+			for (uint32_t core = 0; core < portNUM_PROCESSORS; core++)
+			{
+				stats.traced += rings[core].drained;
+				stats.dropped += rings[core].dropped.load(::std::memory_order_relaxed);
+			}
+			return stats;
+		}
+
+	private:
+		inline void record(const char* format, const uint32_t* args, uint32_t nofArgs)
+		{
+#ifdef CRT_DEBUG_LOGGING
+			Ring& ring = rings[xPortGetCoreID() % portNUM_PROCESSORS];
+			uint32_t position = ring.tail.load(::std::memory_order_relaxed);
+			Slot* pSlot;
+			while (true)
+			{
+				pSlot = &ring.slots[position % RECORDS_PER_CORE];
+				int32_t diff = (int32_t)(pSlot->sequence.load(::std::memory_order_acquire) - position);
+				if (diff == 0)
+				{
+					if (ring.tail.compare_exchange_weak(position, position + 1, ::std::memory_order_relaxed)) break;
+					// else: another task got it; position now holds the new tail.
+				}
+				else if (diff < 0)
+				{
+					// The slot still holds a trace that was not drained: the ring is full.
+					ring.dropped.fetch_add(1, ::std::memory_order_relaxed);
+					return;
+				}
+				else
+				{
+					position = ring.tail.load(::std::memory_order_relaxed);
+				}
+			}
+
+			TraceEntry& entry = pSlot->entry;
+			entry.timestampUs = (uint32_t)esp_timer_get_time();
+			entry.format = format;
+			entry.nofArgs = nofArgs;
+			for (uint32_t i = 0; i < nofArgs; i++)
+			{
+				entry.args[i] = args[i];
+			}
+			pSlot->sequence.store(position + 1, ::std::memory_order_release);
+#endif
+		}
+
+		void drain()
+		{
+			for (uint32_t core = 0; core < portNUM_PROCESSORS; core++)
+			{
+				Ring& ring = rings[core];
+				uint32_t h = ring.head.load(::std::memory_order_relaxed);
+				while (true)
+				{
+					// A trace that is claimed but not yet written holds up the ones behind it, until the next drain.
+					Slot& slot = ring.slots[h % RECORDS_PER_CORE];
+					if (slot.sequence.load(::std::memory_order_acquire) != h + 1) break;
+					sink.write(core, slot.entry);
+					slot.sequence.store(h + RECORDS_PER_CORE, ::std::memory_order_release);	// free for the next round
+					h++;
+					ring.drained++;
+				}
+				ring.head.store(h, ::std::memory_order_relaxed);
+
+				uint32_t dropped = ring.dropped.load(::std::memory_order_relaxed);
+				if (dropped != ring.reportedDropped)
+				{
+					sink.lost(core, dropped - ring.reportedDropped);
+					ring.reportedDropped = dropped;
+				}
+			}
+			sink.flush();
+		}
+
+		// The TraceLogger is started right after construction, like the Logger.
+		/*override keyword not supported in current compiler*/
+		void start()
+		{
+#ifdef CRT_DEBUG_LOGGING
+			xTaskCreatePinnedToCore(
+				StaticMain
+				, taskName            // A name just for humans
+				, taskStackSizeBytes  // This stack size can be checked & adjusted by reading the Stack Highwater
+				, this
+				, taskPriority
+				, &taskHandle
+				, taskCoreNumber);
+#endif
+		}
+
+		void Main()
+		{
+			while (true)
+			{
+				drain();
+				vTaskDelay(drainPeriodMs);
+			}
+		}
+	}; // end class TraceLogger
+}; // end namespace crt
@@ -0,0 +1,305 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include "internals/crt_FreeRTOS.h"
+#ifndef CRT_HOST
+#include "driver/uart.h"
+#endif
+#include "crt_TraceLogger.h"
+
+// The sinks that a TraceLogger can drain into (see crt_TraceLogger.h).
+
+namespace crt
+{
+	// Formats the traces on the device, and logs them with ESP_LOGI.
+	class TraceTextSink : public ITraceSink
+	{
+	public:
+		static const uint32_t MAX_TEXT = 160;
+
+		TraceTextSink()
+		{}
+
+		/*override keyword not supported in current compiler*/
+		void write(uint32_t core, const TraceEntry& entry)
+		{
+			char text[MAX_TEXT];
+			format(text, sizeof(text), entry);
+			ESP_LOGI("trace", "%10" PRIu32 " us  core %" PRIu32 ": %s", entry.timestampUs, core, text);
+		}
+
+		/*override keyword not supported in current compiler*/
+		void lost(uint32_t core, uint32_t count)
+		{
+			ESP_LOGW("trace", "core %" PRIu32 ": %" PRIu32 " traces lost", core, count);
+		}
+
+		/*override keyword not supported in current compiler*/
+		void flush()
+		{}
+
+		// Like snprintf with the format and the numbers of the entry. The length modifiers
+		// in the format (l, h, ...) are ignored: every number is 32 bits.
+		static void format(char* text, uint32_t size, const TraceEntry& entry)
+		{
+			const char* p = entry.format;
+			uint32_t used = 0;
+			uint32_t argIndex = 0;
+			while (*p != '\0' && used + 1 < size)
+			{
+				if (*p != '%')
+				{
+					text[used++] = *p++;
+					continue;
+				}
+
+				// A conversion: copy its flags, width and precision, and skip its length modifiers.
+				char spec[16];
+				uint32_t specLength = 0;
+				spec[specLength++] = *p++;
+				while (*p != '\0' && strchr("-+ #0123456789.", *p) != nullptr && specLength < sizeof(spec) - 4)
+				{
+					spec[specLength++] = *p++;
+				}
+				while (*p != '\0' && strchr("hlLqjzt", *p) != nullptr) p++;
+				if (*p == '\0') break;
+				char conversion = *p++;
+
+				int written = 0;
+				if (conversion == '%')
+				{
+					written = snprintf(text + used, size - used, "%%");
+				}
+				else if (argIndex >= entry.nofArgs || conversion == 's')
+				{
+					written = snprintf(text + used, size - used, "<?>");
+				}
+				else
+				{
+					uint32_t arg = entry.args[argIndex++];
+					if (strchr("fFeEgGaA", conversion) != nullptr)
+					{
+						float value;
+						memcpy(&value, &arg, sizeof(value));
+						spec[specLength++] = conversion;
+						spec[specLength] = '\0';
+						written = snprintf(text + used, size - used, spec, (double)value);
+					}
+					else if (conversion == 'd' || conversion == 'i')
+					{
+						spec[specLength++] = 'l';
+						spec[specLength++] = 'd';
+						spec[specLength] = '\0';
+						written = snprintf(text + used, size - used, spec, (long)(int32_t)arg);
+					}
+					else
+					{
+						spec[specLength++] = 'l';
+						spec[specLength++] = (strchr("uxXoc", conversion) != nullptr) ? conversion : 'u';
+						spec[specLength] = '\0';
+						written = snprintf(text + used, size - used, spec, (unsigned long)arg);
+					}
+				}
+				if (written < 0) break;
+				used += (uint32_t)written;
+				if (used >= size) used = size - 1;	// Truncated.
+			}
+			text[used] = '\0';
+		}
+	};
+
+	// Writes the traces as binary frames, for tools/trace_decode.py. A frame is:
+	//   0xA5 0x5A  type  length  payload[length]  checksum
+	// with the checksum the lower byte of the sum of type, length and payload. The decoder
+	// skips anything between frames, so the frames can share the UART with ESP_LOGI.
+	// Frame types (all numbers little-endian):
+	//   FORMAT (1): id (2 bytes), the format string (without its 0).
+	//   TRACE (2):  core (1), id (2), timestampUs (4), nofArgs (1), args (4 each).
+	//   LOST (3):   core (1), count (4).
+	// A format is sent once, in a FORMAT frame before its first TRACE frame, and again every
+	// ANNOUNCE_PERIOD_US, such that a decoder that starts later gets to know it.
+	// On the ESP32, the frames are written with uart_write_bytes(), not via stdout: the console
+	// VFS translates each LF (0x0A) to CRLF, and a 0x0A byte occurs in many frames. The sink
+	// installs the UART driver if nobody did yet (Arduino's Serial does). The frames can still
+	// interleave with ESP_LOGI output that bypasses the driver; the decoder then skips the frame
+	// on its checksum. On the host, the frames are written to a FILE, without translation.
+	class TraceBinarySink : public ITraceSink
+	{
+	public:
+		static const uint32_t MAX_FORMATS = 128;
+		static const int64_t ANNOUNCE_PERIOD_US = 5000000;
+
+	private:
+		static const uint8_t MAGIC1 = 0xA5;
+		static const uint8_t MAGIC2 = 0x5A;
+		static const uint8_t FRAME_FORMAT = 1;
+		static const uint8_t FRAME_TRACE = 2;
+		static const uint8_t FRAME_LOST = 3;
+		static const uint16_t NO_ID = 0xffff;		// The format table is full: the format precedes every trace.
+		static const uint32_t TABLE_SIZE = 2 * MAX_FORMATS;
+
+#ifdef CRT_HOST
+		FILE* file;
+#else
+		uart_port_t uartPort;
+		bool bDriverChecked;
+#endif
+		const char* formats[MAX_FORMATS] = {};	// By id.
+		uint16_t table[TABLE_SIZE];				// Hash table of ids, on the format pointer.
+		uint32_t nofFormats;
+		int64_t lastAnnounceUs;
+		uint8_t buffer[512];
+		uint32_t used;
+		uint32_t bytesWritten;
+
+	public:
+#ifdef CRT_HOST
+		TraceBinarySink(FILE* file = stdout) : file(file), nofFormats(0), lastAnnounceUs(0), used(0), bytesWritten(0)
+		{
+			for (uint32_t i = 0; i < TABLE_SIZE; i++) table[i] = NO_ID;
+		}
+#else
+		// uartPort : the UART of the serial monitor.
+		TraceBinarySink(uart_port_t uartPort = UART_NUM_0) : uartPort(uartPort), bDriverChecked(false), nofFormats(0), lastAnnounceUs(0), used(0), bytesWritten(0)
+		{
+			for (uint32_t i = 0; i < TABLE_SIZE; i++) table[i] = NO_ID;
+		}
+#endif
+
+		/*override keyword not supported in current compiler*/
+		void write(uint32_t core, const TraceEntry& entry)
+		{
+			uint16_t id = getId(entry.format);
+			uint8_t payload[8 + 4 * TRACE_MAXARGS];
+			uint32_t length = 0;
+			payload[length++] = (uint8_t)core;
+			put16(payload, length, id);
+			put32(payload, length, entry.timestampUs);
+			payload[length++] = (uint8_t)entry.nofArgs;
+			for (uint32_t i = 0; i < entry.nofArgs; i++)
+			{
+				put32(payload, length, entry.args[i]);
+			}
+			writeFrame(FRAME_TRACE, payload, length);
+		}
+
+		/*override keyword not supported in current compiler*/
+		void lost(uint32_t core, uint32_t count)
+		{
+			uint8_t payload[5];
+			uint32_t length = 0;
+			payload[length++] = (uint8_t)core;
+			put32(payload, length, count);
+			writeFrame(FRAME_LOST, payload, length);
+		}
+
+		/*override keyword not supported in current compiler*/
+		void flush()
+		{
+			int64_t nowUs = esp_timer_get_time();
+			if (nowUs - lastAnnounceUs > ANNOUNCE_PERIOD_US)
+			{
+				for (uint16_t id = 0; id < nofFormats; id++)
+				{
+					writeFormat(id, formats[id]);
+				}
+				lastAnnounceUs = nowUs;
+			}
+			writeBuffer();
+#ifdef CRT_HOST
+			fflush(file);
+#endif
+		}
+
+		uint32_t getBytesWritten()
+		{
+			return bytesWritten;
+		}
+
+	private:
+		static void put16(uint8_t* payload, uint32_t& length, uint16_t value)
+		{
+			payload[length++] = (uint8_t)value;
+			payload[length++] = (uint8_t)(value >> 8);
+		}
+
+		static void put32(uint8_t* payload, uint32_t& length, uint32_t value)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				payload[length++] = (uint8_t)(value >> (8 * i));
+			}
+		}
+
+		// Returns the id of the format, and announces it the first time.
+		uint16_t getId(const char* format)
+		{
+			uint32_t index = (uint32_t)(((uintptr_t)format * 2654435761u) >> 8) % TABLE_SIZE;
+			while (table[index] != NO_ID)
+			{
+				if (formats[table[index]] == format) return table[index];
+				index = (index + 1) % TABLE_SIZE;
+			}
+			if (nofFormats == MAX_FORMATS)
+			{
+				writeFormat(NO_ID, format);
+				return NO_ID;
+			}
+			uint16_t id = (uint16_t)nofFormats++;
+			formats[id] = format;
+			table[index] = id;
+			writeFormat(id, format);
+			return id;
+		}
+
+		void writeFormat(uint16_t id, const char* format)
+		{
+			uint8_t payload[255];
+			uint32_t length = 0;
+			put16(payload, length, id);
+			uint32_t textLength = strlen(format);
+			if (textLength > sizeof(payload) - length) textLength = sizeof(payload) - length;	// Truncated.
+			memcpy(payload + length, format, textLength);
+			writeFrame(FRAME_FORMAT, payload, length + textLength);
+		}
+
+		void writeFrame(uint8_t type, const uint8_t* payload, uint32_t length)
+		{
+			if (used + length + 5 > sizeof(buffer)) writeBuffer();
+			uint8_t checksum = type + (uint8_t)length;
+			buffer[used++] = MAGIC1;
+			buffer[used++] = MAGIC2;
+			buffer[used++] = type;
+			buffer[used++] = (uint8_t)length;
+			for (uint32_t i = 0; i < length; i++)
+			{
+				buffer[used++] = payload[i];
+				checksum += payload[i];
+			}
+			buffer[used++] = checksum;
+		}
+
+		void writeBuffer()
+		{
+			if (used == 0) return;
+#ifdef CRT_HOST
+			fwrite(buffer, 1, used, file);
+#else
+			if (!bDriverChecked)
+			{
+				// Not from the constructor: a global sink is constructed before the UART can be set up.
+				if (!uart_is_driver_installed(uartPort))
+				{
+					ESP_ERROR_CHECK(uart_driver_install(uartPort, 256 /*rxBufferSize*/, 0 /*txBufferSize: blocking*/, 0, nullptr, 0));
+				}
+				bDriverChecked = true;
+			}
+			uart_write_bytes(uartPort, buffer, used);
+#endif
+			bytesWritten += used;
+			used = 0;
+		}
+	};
+}; // end namespace crt
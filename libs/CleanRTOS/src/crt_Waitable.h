@@ -6,6 +6,15 @@
 // Waitable is the base class of anything that a task can wait for.
 // It is the base class of Flag, Queueand Timer.
 // You don't need to use it directly yourself.
+//
+// A task has an event group of 24 bits for its first 23 waitables (the last bit is used as
+// a summary bit, see crt_WaitableSet.h), and more event groups for its next waitables,
+// 24 each. The index of the event group is kept in the top byte of the bitmask, which
+// FreeRTOS reserves for itself. Bitmasks can thus only be combined (with + or |) for
+// waitables in the same event group. To wait for waitables in different groups, use a
+// WaitableSet.
+// Combining with + ORs the bits and keeps the group byte, also in a chain such as
+// flagA + flagB + flagC (see the operator+ below the class).
 
 namespace crt 
 {
@@ -17,6 +26,13 @@ namespace crt
 		uint32_t		bitNumber;
 		uint32_t		bitMask;
 		static const uint32_t	bitMaskUndefined = 0x0fffffff;
+
+	public:
+		static const uint32_t	groupShift = 24;		// The bits above hold the index of the event group.
+		static const uint32_t	bitsMask = (1 << groupShift) - 1;
+		static const uint32_t	firstGroupSize = 23;	// The last bit of the first group is the summary bit.
+
+	protected:
 		WaitableType    waitableType = WaitableType::wt_None;
 
 	public:
@@ -28,9 +44,18 @@ namespace crt
 		// Make next function virtual, and.. crash!
 		inline WaitableType getType() const {return waitableType;}
 
-		void init(uint32_t nBitNumber) { this->bitNumber = nBitNumber; this->bitMask = 1 << nBitNumber; }
+		void init(uint32_t nBitNumber) { this->bitNumber = nBitNumber; this->bitMask = toBitMask(nBitNumber); }
 		inline uint32_t getBitNumber() const {return bitNumber;}
 		inline uint32_t getBitMask() const { return bitMask; }
+		inline uint32_t getGroup() const { return bitMask >> groupShift; }
+
+		// The bitmask of the waitable with the given number within its task.
+		static uint32_t toBitMask(uint32_t bitNumber)
+		{
+			if (bitNumber < firstGroupSize) return 1 << bitNumber;
+			uint32_t group = 1 + (bitNumber - firstGroupSize) / groupShift;
+			return (group << groupShift) | (1 << ((bitNumber - firstGroupSize) % groupShift));
+		}
 
 		operator uint32_t()
 		{
@@ -39,12 +64,21 @@ namespace crt
 
 		uint32_t operator+(uint32_t other)
 		{
+			assert((other >> groupShift) == getGroup());	// Use a WaitableSet for different event groups.
 			return bitMask | other;
 		}
 
         uint32_t operator+(Waitable& other)
         {
+            assert(other.getGroup() == getGroup());	// Use a WaitableSet for different event groups.
             return bitMask | other.getBitMask();
         }
 	};
+
+	// For the third and next waitable of a chain like flagA + flagB + flagC. Without it, the
+	// built-in + would add the group bytes of the bitmasks.
+	inline uint32_t operator+(uint32_t bitMask, Waitable& waitable)
+	{
+		return waitable + bitMask;
+	}
 };
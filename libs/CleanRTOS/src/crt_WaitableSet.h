@@ -0,0 +1,56 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include "crt_Config.h"
+#include "crt_Waitable.h"
+
+// A WaitableSet is a set of waitables of a task that it can wait for with waitAny(), also
+// if they are in different event groups (which they are if the task has more than 23).
+//
+// The event groups form a hierarchy: setting a bit in any but the first event group also
+// sets the summary bit of the first one. waitAny() of a set waits on the first event group
+// for its waitables there and for the summary bit, and then looks in the other groups.
+// A waitable in the first group thus wakes the task as fast as with a bitmask; one in a
+// next group costs a few kernel calls more.
+// Use hasFired() afterwards, as after a waitAny() with a bitmask.
+// (see the WaitBench example in the examples folder)
+
+namespace crt
+{
+	class WaitableSet
+	{
+	private:
+		uint32_t masks[MAX_EVENTGROUPS] = {};	// The bits per event group.
+
+	public:
+		WaitableSet()
+		{}
+
+		WaitableSet& add(Waitable& waitable)
+		{
+			masks[waitable.getGroup()] |= waitable.getBitMask() & Waitable::bitsMask;
+			return *this;
+		}
+
+		WaitableSet& remove(Waitable& waitable)
+		{
+			masks[waitable.getGroup()] &= ~(waitable.getBitMask() & Waitable::bitsMask);
+			return *this;
+		}
+
+		inline uint32_t getMask(uint32_t group) const
+		{
+			return masks[group];
+		}
+
+		// Whether it holds waitables beyond the first event group.
+		bool isHierarchical() const
+		{
+			for (uint32_t group = 1; group < MAX_EVENTGROUPS; group++)
+			{
+				if (masks[group] != 0) return true;
+			}
+			return false;
+		}
+	};
+};
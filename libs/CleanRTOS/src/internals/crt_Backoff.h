@@ -0,0 +1,23 @@
+// by Marius Versteegen, 2025
+
+#pragma once
+#include "crt_FreeRTOS.h"
+
+namespace crt
+{
+	// To be called in a loop that waits for another task without a waitable to wait for,
+	// like a write to a full lock-free queue. The first tries just yield, which lets a task
+	// of the same priority run. After that, it sleeps a tick per try, such that a task of
+	// a lower priority gets to run as well.
+	inline void backOff(uint32_t tries)
+	{
+		if (tries < 64)
+		{
+			taskYIELD();
+		}
+		else
+		{
+			vTaskDelay(1);
+		}
+	}
+};
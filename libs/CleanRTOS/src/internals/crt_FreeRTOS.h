@@ -1,5 +1,10 @@
 // by Marius Versteegen, 2023
 
+// With CRT_HOST defined, CleanRTOS is built on a pthread implementation of the
+// FreeRTOS and ESP-IDF API instead, to run on a Linux host (see host/crt_HostFreeRTOS.h).
+#ifdef CRT_HOST
+#include "host/crt_HostFreeRTOS.h"
+#else
 #include <stdio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -12,3 +17,4 @@
 #include "esp_log.h"
 //#include "esp_heap_trace.h"
 #include "esp_heap_caps.h"
+#endif
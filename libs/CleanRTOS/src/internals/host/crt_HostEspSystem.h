@@ -0,0 +1,145 @@
+// by Marius Versteegen, 2025
+
+// Host backend (see crt_HostFreeRTOS.h): error codes, ESP_LOGx, heap queries and GPIO.
+//
+// The log lines have the format of the ESP-IDF ("I (1234) tag: text"), written to
+// stdout in one piece, such that the lines of concurrent tasks do not interleave.
+// GPIO pins are simulated: an input reads the level that gpio_set_level() last gave
+// it, or its pull-up (1) or pull-down (0) otherwise. Tests can "press" an
+// active-low button that way, for instance the dump button of the Logger.
+
+#pragma once
+#include <atomic>
+#include <cstdarg>
+#include <unistd.h>
+
+// --- esp_err.h ---
+typedef int esp_err_t;
+
+#define ESP_OK					0
+#define ESP_FAIL				-1
+#define ESP_ERR_NO_MEM			0x101
+#define ESP_ERR_INVALID_ARG		0x102
+#define ESP_ERR_INVALID_STATE	0x103
+#define ESP_ERR_TIMEOUT			0x107
+
+// --- esp_log.h ---
+typedef enum
+{
+	ESP_LOG_NONE,
+	ESP_LOG_ERROR,
+	ESP_LOG_WARN,
+	ESP_LOG_INFO,
+	ESP_LOG_DEBUG,
+	ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+namespace crt_host
+{
+	__attribute__((format(printf, 3, 4)))
+	inline void log(esp_log_level_t level, const char* tag, const char* format, ...)
+	{
+		if (level > CONFIG_LOG_DEFAULT_LEVEL) return;
+
+		static const char letters[] = "-EWIDV";
+		char line[512];
+		int length = snprintf(line, sizeof(line), "%c (%lu) %s: ", letters[level],
+							  (unsigned long)(sinceBootUs() / 1000), tag);
+		va_list args;
+		va_start(args, format);
+		length += vsnprintf(line + length, sizeof(line) - length, format, args);
+		va_end(args);
+		if (length > (int)sizeof(line) - 2) length = sizeof(line) - 2;
+		line[length++] = '\n';
+		fwrite(line, 1, length, stdout);
+		fflush(stdout);
+	}
+};
+
+#define ESP_LOGE(tag, format, ...) crt_host::log(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) crt_host::log(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) crt_host::log(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) crt_host::log(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) crt_host::log(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+// --- heap ---
+// The free physical memory of the host, capped at 2 GB (as it is printed with %d).
+inline uint32_t esp_get_free_heap_size()
+{
+	uint64_t bytes = (uint64_t)sysconf(_SC_AVPHYS_PAGES) * (uint64_t)sysconf(_SC_PAGESIZE);
+	return bytes > 0x7fffffffULL ? 0x7fffffffUL : (uint32_t)bytes;
+}
+
+inline uint32_t xPortGetFreeHeapSize()
+{
+	return esp_get_free_heap_size();
+}
+
+// --- driver/gpio.h ---
+typedef int gpio_num_t;
+
+typedef enum
+{
+	GPIO_MODE_DISABLE,
+	GPIO_MODE_INPUT,
+	GPIO_MODE_OUTPUT,
+	GPIO_MODE_INPUT_OUTPUT
+} gpio_mode_t;
+
+typedef enum
+{
+	GPIO_PULLUP_ONLY,
+	GPIO_PULLDOWN_ONLY,
+	GPIO_PULLUP_PULLDOWN,
+	GPIO_FLOATING
+} gpio_pull_mode_t;
+
+#define GPIO_NUM_MAX 64
+
+namespace crt_host
+{
+	enum PinState : uint8_t { PIN_PULLED_UP, PIN_PULLED_DOWN, PIN_DRIVEN_LOW, PIN_DRIVEN_HIGH };
+
+	inline std::atomic<uint8_t> pinStates[GPIO_NUM_MAX];	// zero: PIN_PULLED_UP
+};
+
+inline void esp_rom_gpio_pad_select_gpio(uint32_t /*pin*/)
+{
+}
+
+inline esp_err_t gpio_reset_pin(gpio_num_t pin)
+{
+	if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+	crt_host::pinStates[pin] = crt_host::PIN_PULLED_UP;
+	return ESP_OK;
+}
+
+inline esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t /*mode*/)
+{
+	return (pin < 0 || pin >= GPIO_NUM_MAX) ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+inline esp_err_t gpio_set_pull_mode(gpio_num_t pin, gpio_pull_mode_t pull)
+{
+	if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+	uint8_t state = crt_host::pinStates[pin];
+	if (state == crt_host::PIN_PULLED_UP || state == crt_host::PIN_PULLED_DOWN)
+	{
+		crt_host::pinStates[pin] = (pull == GPIO_PULLDOWN_ONLY) ? crt_host::PIN_PULLED_DOWN : crt_host::PIN_PULLED_UP;
+	}
+	return ESP_OK;
+}
+
+inline esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+	if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+	crt_host::pinStates[pin] = level ? crt_host::PIN_DRIVEN_HIGH : crt_host::PIN_DRIVEN_LOW;
+	return ESP_OK;
+}
+
+inline int gpio_get_level(gpio_num_t pin)
+{
+	if (pin < 0 || pin >= GPIO_NUM_MAX) return 0;
+	uint8_t state = crt_host::pinStates[pin];
+	return (state == crt_host::PIN_PULLED_UP || state == crt_host::PIN_DRIVEN_HIGH) ? 1 : 0;
+}
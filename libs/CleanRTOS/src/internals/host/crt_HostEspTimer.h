@@ -0,0 +1,172 @@
+// by Marius Versteegen, 2025
+
+// Host backend (see crt_HostFreeRTOS.h): esp_timer.
+//
+// Every timer is a timerfd on CLOCK_MONOTONIC. A single dispatcher thread
+// ("esp_timer", started with the first timer) waits on all of them with epoll and
+// calls the callbacks, one at a time, like the esp_timer task of the ESP-IDF does.
+// If a periodic timer expired several times before the dispatcher got to it, its
+// callback is called once (as with skip_unhandled_events).
+
+#pragma once
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum
+{
+	ESP_TIMER_TASK,
+	ESP_TIMER_ISR
+} esp_timer_dispatch_t;
+
+typedef struct
+{
+	esp_timer_cb_t callback;
+	void* arg;
+	esp_timer_dispatch_t dispatch_method;
+	const char* name;
+	bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+struct esp_timer
+{
+	int fd;
+	esp_timer_cb_t callback;
+	void* arg;
+	const char* name;
+	std::atomic<bool> active;
+	std::atomic<bool> periodic;
+};
+typedef esp_timer* esp_timer_handle_t;
+
+namespace crt_host
+{
+	inline void* timerDispatcher(void* parameter)
+	{
+		int epollFd = (int)(intptr_t)parameter;
+		pthread_setname_np(pthread_self(), "esp_timer");
+		epoll_event events[16];
+		for (;;)
+		{
+			int count = epoll_wait(epollFd, events, 16, -1);
+			for (int i = 0; i < count; i++)
+			{
+				esp_timer_handle_t timer = (esp_timer_handle_t)events[i].data.ptr;
+				uint64_t expirations = 0;
+				if (read(timer->fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+				{
+					continue;	// stopped or restarted after it expired
+				}
+				if (!timer->periodic) timer->active = false;
+				timer->callback(timer->arg);
+			}
+		}
+		return nullptr;
+	}
+
+	// The epoll instance that the dispatcher waits on, created with the dispatcher.
+	inline int timerEpollFd()
+	{
+		static const int epollFd = []
+		{
+			int fd = epoll_create1(EPOLL_CLOEXEC);
+			pthread_t dispatcher;
+			pthread_create(&dispatcher, nullptr, timerDispatcher, (void*)(intptr_t)fd);
+			pthread_detach(dispatcher);
+			return fd;
+		}();
+		return epollFd;
+	}
+
+	inline esp_err_t armTimer(esp_timer_handle_t timer, uint64_t timeoutUs, bool periodic)
+	{
+		if (timer == nullptr) return ESP_ERR_INVALID_ARG;
+		if (timer->active) return ESP_ERR_INVALID_STATE;
+
+		uint64_t ns = timeoutUs * 1000;
+		if (ns == 0) ns = 1;	// zero would disarm the timerfd
+		itimerspec spec = {};
+		spec.it_value.tv_sec = ns / 1000000000;
+		spec.it_value.tv_nsec = ns % 1000000000;
+		if (periodic) spec.it_interval = spec.it_value;
+
+		timer->periodic = periodic;
+		timer->active = true;
+		timerfd_settime(timer->fd, 0, &spec, nullptr);
+		return ESP_OK;
+	}
+};
+
+inline esp_err_t esp_timer_init()
+{
+	crt_host::timerEpollFd();
+	return ESP_OK;
+}
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle)
+{
+	if (args == nullptr || args->callback == nullptr || handle == nullptr) return ESP_ERR_INVALID_ARG;
+
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) return ESP_ERR_NO_MEM;
+
+	esp_timer_handle_t timer = new esp_timer();
+	timer->fd = fd;
+	timer->callback = args->callback;
+	timer->arg = args->arg;
+	timer->name = args->name;
+	timer->active = false;
+	timer->periodic = false;
+
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.ptr = timer;
+	epoll_ctl(crt_host::timerEpollFd(), EPOLL_CTL_ADD, fd, &event);
+
+	*handle = timer;
+	return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+	return crt_host::armTimer(timer, timeout_us, false);
+}
+
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+	return crt_host::armTimer(timer, period_us, true);
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+	if (timer == nullptr) return ESP_ERR_INVALID_ARG;
+	if (!timer->active) return ESP_ERR_INVALID_STATE;
+
+	itimerspec disarmed = {};
+	timerfd_settime(timer->fd, 0, &disarmed, nullptr);
+	timer->active = false;
+	return ESP_OK;
+}
+
+inline bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+	return timer != nullptr && timer->active;
+}
+
+// The timer must be stopped, and its callback must not be running.
+inline esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+	if (timer == nullptr) return ESP_ERR_INVALID_ARG;
+	if (timer->active) return ESP_ERR_INVALID_STATE;
+
+	epoll_ctl(crt_host::timerEpollFd(), EPOLL_CTL_DEL, timer->fd, nullptr);
+	close(timer->fd);
+	delete timer;
+	return ESP_OK;
+}
+
+inline int64_t esp_timer_get_time()
+{
+	return crt_host::sinceBootUs();
+}
@@ -0,0 +1,113 @@
+// by Marius Versteegen, 2025
+
+// The host backend of CleanRTOS: the part of the FreeRTOS, esp_timer and
+// ESP-IDF API that CleanRTOS is built on, implemented with pthreads,
+// condition variables and timerfd. With it, CleanRTOS tasks, queues, flags,
+// timers and mutexes run on Linux, such that application logic can be
+// unit-tested, profiled or fuzzed on a workstation.
+//
+// It is selected at build time by defining CRT_HOST (see crt_FreeRTOS.h).
+// "extras/for building on a Linux host" contains a CMake project that builds
+// the CleanRTOS examples this way, and lists the differences with the ESP32.
+//
+// As CleanRTOS assumes, one tick is 1 ms (CONFIG_FREERTOS_HZ=1000).
+
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <time.h>
+
+// --- sdkconfig ---
+#ifndef ARDUINO_RUNNING_CORE
+#define ARDUINO_RUNNING_CORE 1
+#endif
+#ifndef CONFIG_LOG_DEFAULT_LEVEL
+#define CONFIG_LOG_DEFAULT_LEVEL 3	// info
+#endif
+#define CONFIG_FREERTOS_HZ 1000
+
+// --- FreeRTOS base types ---
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE			((BaseType_t)0)
+#define pdTRUE			((BaseType_t)1)
+#define pdFAIL			pdFALSE
+#define pdPASS			pdTRUE
+#define portMAX_DELAY	((TickType_t)0xffffffffUL)
+
+#define configTICK_RATE_HZ	CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS	((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)	((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+namespace crt_host
+{
+	// The number of event group and queue calls so far. On the ESP32, each of them is a
+	// critical section, so benchmarks on the host report it as a measure of kernel traffic.
+	inline std::atomic<uint32_t> kernelCalls;
+
+	inline void countKernelCall()
+	{
+		kernelCalls.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline int64_t monotonicUs()
+	{
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+	}
+
+	// The time since "boot": the first time that anyone asked for it.
+	inline int64_t sinceBootUs()
+	{
+		static const int64_t bootUs = monotonicUs();
+		return monotonicUs() - bootUs;
+	}
+
+	// The CLOCK_MONOTONIC time at which a wait of ticks (not portMAX_DELAY) times out.
+	inline timespec deadlineAfter(TickType_t ticks)
+	{
+		timespec deadline;
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		uint64_t ns = (uint64_t)deadline.tv_nsec + (uint64_t)ticks * (1000000000 / configTICK_RATE_HZ);
+		deadline.tv_sec += ns / 1000000000;
+		deadline.tv_nsec = ns % 1000000000;
+		return deadline;
+	}
+
+	// Waits on condition until it is signalled or the deadline passes (if ticks is not
+	// portMAX_DELAY). Returns false on a timeout. The caller re-checks its predicate.
+	inline bool waitFor(pthread_cond_t* condition, pthread_mutex_t* mutex, TickType_t ticks, const timespec& deadline)
+	{
+		if (ticks == portMAX_DELAY)
+		{
+			pthread_cond_wait(condition, mutex);
+			return true;
+		}
+		return pthread_cond_timedwait(condition, mutex, &deadline) == 0;
+	}
+
+	// A condition variable that times out on CLOCK_MONOTONIC, such that waits are not
+	// disturbed by changes of the wall clock.
+	inline void initCondition(pthread_cond_t* condition)
+	{
+		pthread_condattr_t attr;
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(condition, &attr);
+		pthread_condattr_destroy(&attr);
+	}
+};
+
+#include "crt_HostEspSystem.h"
+#include "crt_HostTask.h"
+#include "crt_HostSync.h"
+#include "crt_HostEspTimer.h"
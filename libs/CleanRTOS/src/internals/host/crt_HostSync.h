@@ -0,0 +1,380 @@
+// by Marius Versteegen, 2025
+
+// Host backend (see crt_HostFreeRTOS.h): event groups, queues and semaphores.
+//
+// Event groups follow FreeRTOS closely, as Task::waitAll(), waitAny() and
+// hasFired() depend on it: a waiting task is released by the xEventGroupSetBits()
+// call that satisfies it, which also clears the waited-for bits if it asked for
+// that (xClearOnExit), before any other task can clear them. The value it returns
+// is the one at that moment. As in FreeRTOS, the top 8 bits are reserved, so an
+// event group has 24 usable bits.
+//
+// A mutex (xSemaphoreCreateMutex) is a priority-inheriting pthread mutex, which
+// can only be given back by the task that took it.
+
+#pragma once
+
+// --- event groups ---
+typedef uint32_t EventBits_t;
+
+#define eventEVENT_BITS_CONTROL_BYTES 0xff000000UL
+
+namespace crt_host
+{
+	struct EventWaiter
+	{
+		EventBits_t bitsToWaitFor;
+		bool clearOnExit;
+		bool waitForAllBits;
+		bool satisfied;
+		EventBits_t result;		// the bits at the moment it was satisfied
+		EventWaiter* next;
+	};
+
+	inline bool isSatisfied(EventBits_t bits, EventBits_t bitsToWaitFor, bool waitForAllBits)
+	{
+		return waitForAllBits ? ((bits & bitsToWaitFor) == bitsToWaitFor) : ((bits & bitsToWaitFor) != 0);
+	}
+};
+
+struct EventGroupDef_t
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t changed;
+	EventBits_t bits;
+	crt_host::EventWaiter* waiters;
+};
+typedef EventGroupDef_t* EventGroupHandle_t;
+
+inline EventGroupHandle_t xEventGroupCreate()
+{
+	EventGroupHandle_t group = new EventGroupDef_t();
+	pthread_mutex_init(&group->mutex, nullptr);
+	crt_host::initCondition(&group->changed);
+	group->bits = 0;
+	group->waiters = nullptr;
+	return group;
+}
+
+inline void vEventGroupDelete(EventGroupHandle_t group)
+{
+	pthread_cond_destroy(&group->changed);
+	pthread_mutex_destroy(&group->mutex);
+	delete group;
+}
+
+inline EventBits_t xEventGroupSetBits(EventGroupHandle_t group, const EventBits_t bitsToSet)
+{
+	crt_host::countKernelCall();
+	assert((bitsToSet & eventEVENT_BITS_CONTROL_BYTES) == 0);
+	pthread_mutex_lock(&group->mutex);
+	group->bits |= bitsToSet;
+
+	EventBits_t bitsToClear = 0;
+	bool anyReleased = false;
+	for (crt_host::EventWaiter* waiter = group->waiters; waiter != nullptr; waiter = waiter->next)
+	{
+		if (!waiter->satisfied && crt_host::isSatisfied(group->bits, waiter->bitsToWaitFor, waiter->waitForAllBits))
+		{
+			waiter->satisfied = true;
+			waiter->result = group->bits;
+			if (waiter->clearOnExit) bitsToClear |= waiter->bitsToWaitFor;
+			anyReleased = true;
+		}
+	}
+	group->bits &= ~bitsToClear;
+	EventBits_t result = group->bits;
+	pthread_mutex_unlock(&group->mutex);
+
+	if (anyReleased) pthread_cond_broadcast(&group->changed);
+	return result;
+}
+
+inline EventBits_t xEventGroupSetBitsFromISR(EventGroupHandle_t group, const EventBits_t bitsToSet, BaseType_t* higherPriorityTaskWoken)
+{
+	if (higherPriorityTaskWoken != nullptr) *higherPriorityTaskWoken = pdFALSE;
+	xEventGroupSetBits(group, bitsToSet);
+	return pdPASS;
+}
+
+// Returns the bits before they were cleared.
+inline EventBits_t xEventGroupClearBits(EventGroupHandle_t group, const EventBits_t bitsToClear)
+{
+	crt_host::countKernelCall();
+	pthread_mutex_lock(&group->mutex);
+	EventBits_t result = group->bits;
+	group->bits &= ~bitsToClear;
+	pthread_mutex_unlock(&group->mutex);
+	return result;
+}
+
+#define xEventGroupGetBits(group) xEventGroupClearBits(group, 0)
+
+// Returns the bits at the moment the wait was satisfied, or the current bits after a timeout.
+inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, const EventBits_t bitsToWaitFor,
+									   const BaseType_t clearOnExit, const BaseType_t waitForAllBits, TickType_t ticksToWait)
+{
+	crt_host::countKernelCall();
+	assert(bitsToWaitFor != 0 && (bitsToWaitFor & eventEVENT_BITS_CONTROL_BYTES) == 0);
+	pthread_mutex_lock(&group->mutex);
+
+	EventBits_t result = group->bits;
+	if (crt_host::isSatisfied(group->bits, bitsToWaitFor, waitForAllBits))
+	{
+		if (clearOnExit) group->bits &= ~bitsToWaitFor;
+	}
+	else if (ticksToWait != 0)
+	{
+		crt_host::EventWaiter waiter = { bitsToWaitFor, clearOnExit != pdFALSE, waitForAllBits != pdFALSE, false, 0, group->waiters };
+		group->waiters = &waiter;
+
+		timespec deadline = {};
+		if (ticksToWait != portMAX_DELAY) deadline = crt_host::deadlineAfter(ticksToWait);
+		while (!waiter.satisfied)
+		{
+			if (!crt_host::waitFor(&group->changed, &group->mutex, ticksToWait, deadline)) break;
+		}
+
+		crt_host::EventWaiter** link = &group->waiters;
+		while (*link != &waiter) link = &(*link)->next;
+		*link = waiter.next;
+
+		result = waiter.satisfied ? waiter.result : group->bits;
+	}
+	pthread_mutex_unlock(&group->mutex);
+	return result;
+}
+
+// --- queues ---
+struct QueueDefinition
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t notEmpty;
+	pthread_cond_t notFull;
+	uint8_t* storage;
+	UBaseType_t length;
+	UBaseType_t itemSize;
+	UBaseType_t head;		// index of the oldest item
+	UBaseType_t count;
+};
+typedef QueueDefinition* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+	QueueHandle_t queue = new QueueDefinition();
+	pthread_mutex_init(&queue->mutex, nullptr);
+	crt_host::initCondition(&queue->notEmpty);
+	crt_host::initCondition(&queue->notFull);
+	queue->storage = new uint8_t[(size_t)length * itemSize];
+	queue->length = length;
+	queue->itemSize = itemSize;
+	queue->head = 0;
+	queue->count = 0;
+	return queue;
+}
+
+inline void vQueueDelete(QueueHandle_t queue)
+{
+	pthread_cond_destroy(&queue->notFull);
+	pthread_cond_destroy(&queue->notEmpty);
+	pthread_mutex_destroy(&queue->mutex);
+	delete[] queue->storage;
+	delete queue;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait)
+{
+	crt_host::countKernelCall();
+	pthread_mutex_lock(&queue->mutex);
+	timespec deadline = {};
+	if (ticksToWait != 0 && ticksToWait != portMAX_DELAY) deadline = crt_host::deadlineAfter(ticksToWait);
+	while (queue->count == queue->length)
+	{
+		if (ticksToWait == 0 || !crt_host::waitFor(&queue->notFull, &queue->mutex, ticksToWait, deadline))
+		{
+			if (queue->count < queue->length) break;	// room was made just as the wait timed out
+			pthread_mutex_unlock(&queue->mutex);
+			return pdFAIL;	// errQUEUE_FULL
+		}
+	}
+	UBaseType_t tail = (queue->head + queue->count) % queue->length;
+	memcpy(queue->storage + (size_t)tail * queue->itemSize, item, queue->itemSize);
+	queue->count++;
+	pthread_mutex_unlock(&queue->mutex);
+	pthread_cond_signal(&queue->notEmpty);
+	return pdPASS;
+}
+
+#define xQueueSendToBack(queue, item, ticksToWait) xQueueSend(queue, item, ticksToWait)
+
+inline BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higherPriorityTaskWoken)
+{
+	if (higherPriorityTaskWoken != nullptr) *higherPriorityTaskWoken = pdFALSE;
+	return xQueueSend(queue, item, 0);
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait)
+{
+	crt_host::countKernelCall();
+	pthread_mutex_lock(&queue->mutex);
+	timespec deadline = {};
+	if (ticksToWait != 0 && ticksToWait != portMAX_DELAY) deadline = crt_host::deadlineAfter(ticksToWait);
+	while (queue->count == 0)
+	{
+		if (ticksToWait == 0 || !crt_host::waitFor(&queue->notEmpty, &queue->mutex, ticksToWait, deadline))
+		{
+			if (queue->count > 0) break;	// an item arrived just as the wait timed out
+			pthread_mutex_unlock(&queue->mutex);
+			return pdFAIL;	// errQUEUE_EMPTY
+		}
+	}
+	memcpy(buffer, queue->storage + (size_t)queue->head * queue->itemSize, queue->itemSize);
+	queue->head = (queue->head + 1) % queue->length;
+	queue->count--;
+	pthread_mutex_unlock(&queue->mutex);
+	pthread_cond_signal(&queue->notFull);
+	return pdPASS;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t queue)
+{
+	crt_host::countKernelCall();
+	pthread_mutex_lock(&queue->mutex);
+	UBaseType_t count = queue->count;
+	pthread_mutex_unlock(&queue->mutex);
+	return count;
+}
+
+inline UBaseType_t uxQueueSpacesAvailable(const QueueHandle_t queue)
+{
+	crt_host::countKernelCall();
+	pthread_mutex_lock(&queue->mutex);
+	UBaseType_t spaces = queue->length - queue->count;
+	pthread_mutex_unlock(&queue->mutex);
+	return spaces;
+}
+
+inline BaseType_t xQueueReset(QueueHandle_t queue)
+{
+	pthread_mutex_lock(&queue->mutex);
+	queue->head = 0;
+	queue->count = 0;
+	pthread_mutex_unlock(&queue->mutex);
+	pthread_cond_broadcast(&queue->notFull);
+	return pdPASS;
+}
+
+// --- semaphores ---
+struct SemaphoreDefinition
+{
+	bool isMutex;
+	pthread_mutex_t mutex;		// the mutex itself, or the guard of count
+	pthread_cond_t available;	// counting semaphores only
+	UBaseType_t count;
+	UBaseType_t maxCount;
+};
+typedef SemaphoreDefinition* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+	SemaphoreHandle_t semaphore = new SemaphoreDefinition();
+	semaphore->isMutex = true;
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);	// only the owner can give it back
+	pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+	pthread_mutex_init(&semaphore->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	return semaphore;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount)
+{
+	SemaphoreHandle_t semaphore = new SemaphoreDefinition();
+	semaphore->isMutex = false;
+	pthread_mutex_init(&semaphore->mutex, nullptr);
+	crt_host::initCondition(&semaphore->available);
+	semaphore->count = initialCount;
+	semaphore->maxCount = maxCount;
+	return semaphore;
+}
+
+// Like in FreeRTOS, a binary semaphore starts empty: give it before it can be taken.
+inline SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+	return xSemaphoreCreateCounting(1, 0);
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+	if (!semaphore->isMutex) pthread_cond_destroy(&semaphore->available);
+	pthread_mutex_destroy(&semaphore->mutex);
+	delete semaphore;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait)
+{
+	if (semaphore->isMutex)
+	{
+		int rc;
+		if (ticksToWait == 0) rc = pthread_mutex_trylock(&semaphore->mutex);
+		else if (ticksToWait == portMAX_DELAY) rc = pthread_mutex_lock(&semaphore->mutex);
+		else
+		{
+			timespec deadline = crt_host::deadlineAfter(ticksToWait);
+			rc = pthread_mutex_clocklock(&semaphore->mutex, CLOCK_MONOTONIC, &deadline);
+		}
+		return rc == 0 ? pdPASS : pdFAIL;
+	}
+
+	pthread_mutex_lock(&semaphore->mutex);
+	timespec deadline = {};
+	if (ticksToWait != 0 && ticksToWait != portMAX_DELAY) deadline = crt_host::deadlineAfter(ticksToWait);
+	while (semaphore->count == 0)
+	{
+		if (ticksToWait == 0 || !crt_host::waitFor(&semaphore->available, &semaphore->mutex, ticksToWait, deadline))
+		{
+			if (semaphore->count > 0) break;
+			pthread_mutex_unlock(&semaphore->mutex);
+			return pdFAIL;
+		}
+	}
+	semaphore->count--;
+	pthread_mutex_unlock(&semaphore->mutex);
+	return pdPASS;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+	if (semaphore->isMutex)
+	{
+		return pthread_mutex_unlock(&semaphore->mutex) == 0 ? pdPASS : pdFAIL;
+	}
+
+	pthread_mutex_lock(&semaphore->mutex);
+	bool given = semaphore->count < semaphore->maxCount;
+	if (given) semaphore->count++;
+	pthread_mutex_unlock(&semaphore->mutex);
+	if (given) pthread_cond_signal(&semaphore->available);
+	return given ? pdPASS : pdFAIL;
+}
+
+inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higherPriorityTaskWoken)
+{
+	if (higherPriorityTaskWoken != nullptr) *higherPriorityTaskWoken = pdFALSE;
+	return xSemaphoreGive(semaphore);
+}
+
+inline UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore)
+{
+	if (semaphore->isMutex)
+	{
+		if (pthread_mutex_trylock(&semaphore->mutex) != 0) return 0;
+		pthread_mutex_unlock(&semaphore->mutex);
+		return 1;
+	}
+	pthread_mutex_lock(&semaphore->mutex);
+	UBaseType_t count = semaphore->count;
+	pthread_mutex_unlock(&semaphore->mutex);
+	return count;
+}
@@ -0,0 +1,166 @@
+// by Marius Versteegen, 2025
+
+// Host backend (see crt_HostFreeRTOS.h): tasks and critical sections.
+//
+// Every task is a detached pthread. A task pinned to a core is pinned to host CPU
+// (core % number of CPUs); tskNO_AFFINITY leaves it to the Linux scheduler.
+// Task priorities are kept, but not applied: Linux schedules the threads fairly
+// (SCHED_OTHER), so a busy task does not starve a lower-priority one as it would
+// on the ESP32. The stack is at least MIN_STACK_BYTES, as the C library on the
+// host needs more than the stack sizes that are tuned for the ESP32.
+//
+// As on the ESP32, where the global Task objects are constructed before the
+// scheduler runs, tasks that are created before startScheduler() is called wait
+// for it. That way, a task never sees a global object that is not constructed yet.
+//
+// A critical section (taskENTER_CRITICAL) is a recursive mutex: it excludes the
+// other critical sections on the same portMUX_TYPE, but not the other tasks.
+
+#pragma once
+#include <sched.h>
+#include <unistd.h>
+
+typedef void (*TaskFunction_t)(void*);
+
+struct tskTaskControlBlock
+{
+	pthread_t thread;
+	const char* name;
+	UBaseType_t priority;
+	uint32_t stackBytes;
+	BaseType_t core;
+	TaskFunction_t function;
+	void* parameter;
+};
+typedef tskTaskControlBlock* TaskHandle_t;
+
+#define tskNO_AFFINITY ((BaseType_t)0x7fffffff)
+#define portNUM_PROCESSORS 2		// Like the dual-core ESP32 parts.
+
+namespace crt_host
+{
+	static const uint32_t MIN_STACK_BYTES = 256 * 1024;
+
+	inline thread_local TaskHandle_t currentTask = nullptr;
+
+	inline pthread_mutex_t schedulerMutex = PTHREAD_MUTEX_INITIALIZER;
+	inline pthread_cond_t schedulerStarted = PTHREAD_COND_INITIALIZER;
+	inline bool bSchedulerStarted = false;
+
+	// Lets the tasks run. Call it at the start of main(), after the static initialisation.
+	inline void startScheduler()
+	{
+		pthread_mutex_lock(&schedulerMutex);
+		bSchedulerStarted = true;
+		pthread_mutex_unlock(&schedulerMutex);
+		pthread_cond_broadcast(&schedulerStarted);
+	}
+
+	inline void* taskEntry(void* parameter)
+	{
+		TaskHandle_t task = (TaskHandle_t)parameter;
+		currentTask = task;
+
+		pthread_mutex_lock(&schedulerMutex);
+		while (!bSchedulerStarted) pthread_cond_wait(&schedulerStarted, &schedulerMutex);
+		pthread_mutex_unlock(&schedulerMutex);
+
+		char threadName[16];	// Linux limits thread names to 15 characters.
+		snprintf(threadName, sizeof(threadName), "%s", task->name != nullptr ? task->name : "task");
+		pthread_setname_np(pthread_self(), threadName);
+
+		task->function(task->parameter);
+		return nullptr;
+	}
+};
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackBytes,
+										  void* parameter, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core)
+{
+	TaskHandle_t task = new tskTaskControlBlock{ {}, name, priority, stackBytes, core, function, parameter };
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_attr_setstacksize(&attr, stackBytes > crt_host::MIN_STACK_BYTES ? stackBytes : crt_host::MIN_STACK_BYTES);
+	if (core != tskNO_AFFINITY)
+	{
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(core % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	}
+	int rc = pthread_create(&task->thread, &attr, crt_host::taskEntry, task);
+	pthread_attr_destroy(&attr);
+
+	if (rc != 0)
+	{
+		delete task;
+		return pdFAIL;
+	}
+	if (handle != nullptr) *handle = task;
+	return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackBytes,
+							  void* parameter, UBaseType_t priority, TaskHandle_t* handle)
+{
+	return xTaskCreatePinnedToCore(function, name, stackBytes, parameter, priority, handle, tskNO_AFFINITY);
+}
+
+inline void vTaskDelay(TickType_t ticks)
+{
+	if (ticks == 0)
+	{
+		sched_yield();
+		return;
+	}
+	timespec deadline = crt_host::deadlineAfter(ticks);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) != 0)
+	{
+		// Interrupted by a signal: sleep on until the deadline.
+	}
+}
+
+#define taskYIELD() sched_yield()
+
+inline TickType_t xTaskGetTickCount()
+{
+	return (TickType_t)(crt_host::sinceBootUs() / (1000000 / configTICK_RATE_HZ));
+}
+
+// nullptr on the main thread, which is not a task.
+inline TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+	return crt_host::currentTask;
+}
+
+inline const char* pcTaskGetName(TaskHandle_t task)
+{
+	if (task == nullptr) task = crt_host::currentTask;
+	return task != nullptr ? task->name : "main";
+}
+
+// Not measured on the host: reports the stack size the task was created with.
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+	if (task == nullptr) task = crt_host::currentTask;
+	return task != nullptr ? task->stackBytes : crt_host::MIN_STACK_BYTES;
+}
+
+inline BaseType_t xPortGetCoreID()
+{
+	int cpu = sched_getcpu();
+	return cpu < 0 ? 0 : cpu;
+}
+
+// --- critical sections ---
+struct portMUX_TYPE
+{
+	pthread_mutex_t mutex;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+
+#define taskENTER_CRITICAL(mux) pthread_mutex_lock(&(mux)->mutex)
+#define taskEXIT_CRITICAL(mux) pthread_mutex_unlock(&(mux)->mutex)
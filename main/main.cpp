@@ -41,6 +41,15 @@ namespace crt
 //#include <Pool.ino>
 //#include <HasFired.ino>
 //#include <AllWaitables.ino>					// 5.1 test ok op c6/zigbee
+//#include <QueueBench.ino>						// Queue vs SpscQueue vs MpscQueue
+//#include <QueueBatchBench.ino>					// batch and in-place queue reads/writes, 4-256 byte messages
+//#include <PoolBench.ino>						// Pool mutex vs seqlock vs triple buffer, 1-4 readers
+//#include <MutexBench.ino>						// spinning vs blocking mutex, 2-8 tasks
+//#include <HandlerBench.ino>					// one Handler, listeners of 5-250 ms: CPU use and jitter
+//#include <ParallelHandlerBench.ino>			// ParallelHandler vs Handler, 10-100 listeners: updates/s and lateness
+//#include <TimerServiceBench.ino>				// 1000 SoftTimers on one TimerService: accuracy and CPU use
+//#include <WaitBench.ino>						// wake latency of a WaitableSet over 3 event groups, and of timeouts
+//#include <TraceLoggerBench.ino>				// TraceLogger: ns per trace, flood of 4 tasks, counted loss
 
 // **** CleanRTOS Tools Tests ****
 //#include <Logger.ino>
@@ -100,6 +109,21 @@ namespace crt
 //#include <sensor_v4.ino>
 //#include <client_v4.ino>
 
+// **** Sensor Grid tests (sensorgrid_v4) ****
+//#include <ApiRouterBench.ino>
+//#include <DeltaSyncBench.ino>
+//#include <MeasurementCacheBench.ino>
+//#include <FecLossSweep.ino>
+//#include <CapabilityMixSimulation.ino>
+//#include <FrameHandlingBench.ino>
+//#include <PacketCodecBench.ino>
+//#include <MeasurementLogBench.ino>
+//#include <ExportStreamTest.ino>
+//#include <ChannelScaleSimulation.ino>
+//#include <ShardScaleSimulation.ino>
+//#include <RelaySimulation.ino>
+//#include <DutyCycleSimulation.ino>
+
 //------------------------------------
 // Above, you can copy or include the contents of .ino examples from the arduino IDE.
 // The only thing is: you may have to forward declare functions or change the order
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Measure the frame time of the sensorgrid_v4 Grid View page in a headless browser.
+
+Extracts GRID_HTML from server_v4/src/crt_GridHtml.h, serves it on localhost
+as /grid, and opens /grid?bench=<sensors>, in which the page feeds itself
+synthetic /api/allmeasurements responses (one per animation frame) and
+measures applying and drawing them.
+
+Every sensor count is run twice: as the page works (only the widgets on
+screen are drawn, which is what the frame budget applies to), and with
+&all=1, which draws every widget each frame, for reference.
+
+Usage:
+    python3 grid_render_bench.py                      # 4, 64 and 256 sensors
+    python3 grid_render_bench.py --sensors 256 --change 25
+    python3 grid_render_bench.py --chrome /path/to/chrome-headless-shell
+
+Requires the playwright package (pip install playwright). Uses playwright's
+own Chromium unless --chrome (or $CHROME) points to another executable.
+"""
+
+import argparse
+import http.server
+import os
+import re
+import sys
+import threading
+
+PROJECT_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+GRID_HTML_H = os.path.join(PROJECT_ROOT, "apps", "sensorgrid_v4", "server_v4", "src", "crt_GridHtml.h")
+FRAME_BUDGET_MS = 16.0
+
+
+def extract_page(header_path: str) -> bytes:
+    """Return the raw string literal GRID_HTML from the header."""
+    with open(header_path, "r", encoding="utf-8") as f:
+        source = f.read()
+    match = re.search(r'GRID_HTML\[\]\s*=\s*R"rawliteral\((.*?)\)rawliteral"', source, re.DOTALL)
+    if not match:
+        sys.exit(f"GRID_HTML not found in {header_path}")
+    return match.group(1).encode("utf-8")
+
+
+def serve(page: bytes) -> http.server.ThreadingHTTPServer:
+    class Handler(http.server.BaseHTTPRequestHandler):
+        def do_GET(self):
+            if self.path.split("?")[0] != "/grid":
+                self.send_error(404)
+                return
+            self.send_response(200)
+            self.send_header("Content-Type", "text/html")
+            self.send_header("Content-Length", str(len(page)))
+            self.end_headers()
+            self.wfile.write(page)
+
+        def log_message(self, *args):
+            pass
+
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def run(browser, port: int, sensors: int, change: float, draw_all: bool, viewport) -> dict:
+    page = browser.new_page(viewport={"width": viewport[0], "height": viewport[1]})
+    url = f"http://127.0.0.1:{port}/grid?bench={sensors}&change={change:g}" + ("&all=1" if draw_all else "")
+    page.goto(url)
+    page.wait_for_function("window.gridBench !== undefined", timeout=120000)
+    result = page.evaluate("window.gridBench")
+    page.close()
+    return result
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--sensors", type=int, nargs="*", default=[4, 64, 256])
+    parser.add_argument("--change", type=float, default=100, help="percent of the values that change per frame")
+    parser.add_argument("--chrome", default=os.environ.get("CHROME"), help="browser executable")
+    args = parser.parse_args()
+
+    from playwright.sync_api import sync_playwright
+
+    server = serve(extract_page(GRID_HTML_H))
+    port = server.server_address[1]
+    print(f"{'sensors':>7} {'drawn':>6} {'change':>6} | {'first':>7} {'mean':>7} {'p95':>7} {'max':>7} | {'frame p95':>9} | <= {FRAME_BUDGET_MS:g} ms")
+    failed = False
+    with sync_playwright() as p:
+        launch = {"args": ["--no-sandbox"]}
+        if args.chrome:
+            launch["executable_path"] = args.chrome
+        browser = p.chromium.launch(**launch)
+        for sensors in args.sensors:
+            for draw_all in (False, True):
+                r = run(browser, port, sensors, args.change, draw_all, (1280, 800))
+                ok = r["p95Ms"] <= FRAME_BUDGET_MS
+                drawn = "all" if draw_all else "screen"
+                if draw_all:
+                    verdict = "(reference)"
+                else:
+                    verdict = "OK" if ok else "TOO SLOW"
+                    failed |= not ok
+                print(f"{sensors:>7} {drawn:>6} {r['changePercent']:>5g}% | {r['firstMs']:>7.2f} {r['meanMs']:>7.2f} "
+                      f"{r['p95Ms']:>7.2f} {r['maxMs']:>7.2f} | {r['frameP95Ms']:>9.2f} | {verdict}")
+                if sensors <= 4:
+                    break  # all of them are on screen anyway
+        browser.close()
+    server.shutdown()
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+"""Decode the binary traces of a CleanRTOS TraceLogger with a TraceBinarySink.
+
+The TraceBinarySink (libs/CleanRTOS/src/crt_TraceSinks.h) writes frames of
+    0xA5 0x5A  type  length  payload[length]  checksum
+between the other output of the device. A FORMAT frame gives the format
+string of an id, a TRACE frame the core, id, timestamp and numbers of a trace,
+and a LOST frame the number of traces that a core dropped. Every trace is
+printed as
+    [   12.345678] core 1: <the formatted trace>
+Frames with a wrong checksum or a length that does not fit their type are
+skipped and counted, as are traces of which the format has not been announced
+yet (the sink repeats the formats every 5 s).
+
+Usage:
+    python3 trace_decode.py capture.bin               # a captured stream
+    cat /dev/ttyUSB0 | python3 trace_decode.py        # live, from stdin
+    python3 trace_decode.py capture.bin --passthrough # also print the other output
+
+Configure the serial port raw (e.g. stty -F /dev/ttyUSB0 115200 raw) when
+reading it directly. Any translation of line endings corrupts the frames that
+contain a 0x0A byte: on the ESP32 the sink therefore writes with
+uart_write_bytes() instead of via stdout, and a capture must not be made with a
+terminal that maps LF to CRLF.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+MAGIC = b"\xa5\x5a"
+FRAME_FORMAT = 1
+FRAME_TRACE = 2
+FRAME_LOST = 3
+NO_ID = 0xFFFF
+MAX_ARGS = 4  # TRACE_MAXARGS of crt_TraceLogger.h
+
+# A C conversion: flags, width, precision, length modifiers (ignored: all numbers are 32 bits), conversion.
+SPEC = re.compile(r"%([-+ #0]*[0-9]*(?:\.[0-9]*)?)(?:hh|h|ll|l|L|q|j|z|t)?([a-zA-Z%])")
+
+
+def format_trace(fmt: str, args: list) -> str:
+    """Format the 32-bit numbers of a trace like the TraceTextSink does."""
+    remaining = list(args)
+
+    def convert(match: re.Match) -> str:
+        flags, conversion = match.group(1), match.group(2)
+        if conversion == "%":
+            return "%"
+        if conversion == "s" or not remaining:
+            return "<?>"
+        arg = remaining.pop(0)
+        if conversion in "fFeEgGaA":
+            value = struct.unpack("<f", struct.pack("<I", arg))[0]
+            return ("%" + flags + ("g" if conversion in "aA" else conversion)) % value
+        if conversion in "di":
+            return ("%" + flags + "d") % (arg - (1 << 32) if arg & 0x80000000 else arg)
+        if conversion == "c":
+            return chr(arg & 0xFF)
+        return ("%" + flags + (conversion if conversion in "xXo" else "d")) % arg
+
+    return SPEC.sub(convert, fmt)
+
+
+class Decoder:
+    def __init__(self, out, passthrough: bool):
+        self.out = out
+        self.passthrough = passthrough
+        self.buffer = b""
+        self.formats = {}
+        self.last_timestamp = None
+        self.timestamp_high = 0
+        self.inline_format = None
+        self.traces = 0
+        self.lost = 0
+        self.bad_frames = 0
+        self.unknown_formats = 0
+
+    def feed(self, data: bytes) -> None:
+        self.buffer += data
+        while True:
+            start = self.buffer.find(MAGIC)
+            if start < 0:
+                # Keep a last 0xA5, which may be the start of a frame.
+                keep = 1 if self.buffer.endswith(MAGIC[:1]) else 0
+                self.text(self.buffer[:len(self.buffer) - keep])
+                self.buffer = self.buffer[len(self.buffer) - keep:]
+                return
+            self.text(self.buffer[:start])
+            self.buffer = self.buffer[start:]
+            if len(self.buffer) < 5:
+                return
+            length = self.buffer[3]
+            if len(self.buffer) < 5 + length:
+                return
+            frame = self.buffer[2:4 + length]
+            # A damaged frame passes the 8-bit checksum once in 256 times, so check its length as well.
+            if sum(frame) & 0xFF != self.buffer[4 + length] or not self.frame(frame[0], frame[2:]):
+                # Not a frame after all (or a damaged one): skip the magic.
+                self.bad_frames += 1
+                self.text(self.buffer[:2])
+                self.buffer = self.buffer[2:]
+                continue
+            self.buffer = self.buffer[5 + length:]
+
+    def text(self, data: bytes) -> None:
+        if self.passthrough and data:
+            self.out.write(data.decode("utf-8", errors="replace"))
+
+    def frame(self, frame_type: int, payload: bytes) -> bool:
+        """Handles a frame with a valid checksum. Returns False if its type or length is not valid."""
+        if frame_type == FRAME_FORMAT:
+            if len(payload) < 2 or b"\0" in payload[2:]:
+                return False  # The sink writes the format without its 0.
+            format_id = struct.unpack_from("<H", payload)[0]
+            fmt = payload[2:].decode("utf-8", errors="replace")
+            if format_id == NO_ID:
+                self.inline_format = fmt  # The format table of the sink is full.
+            else:
+                self.formats[format_id] = fmt
+        elif frame_type == FRAME_TRACE:
+            if len(payload) < 8:
+                return False
+            core, format_id, timestamp, nof_args = struct.unpack_from("<BHIB", payload)
+            if nof_args > MAX_ARGS or len(payload) != 8 + 4 * nof_args:
+                return False
+            args = list(struct.unpack_from("<%dI" % nof_args, payload, 8))
+            fmt = self.inline_format if format_id == NO_ID else self.formats.get(format_id)
+            self.traces += 1
+            if fmt is None:
+                self.unknown_formats += 1
+                return True
+            self.out.write("[%12.6f] core %d: %s\n" % (self.unwrap(timestamp) / 1e6, core, format_trace(fmt, args)))
+        elif frame_type == FRAME_LOST:
+            if len(payload) != 5:
+                return False
+            core, count = struct.unpack_from("<BI", payload)
+            self.lost += count
+            self.out.write("[%12s] core %d: %d traces lost\n" % ("", core, count))
+        else:
+            return False
+        return True
+
+    def unwrap(self, timestamp: int) -> int:
+        """The timestamps are the lower 32 bits of the microseconds since boot."""
+        if self.last_timestamp is not None and timestamp < self.last_timestamp - (1 << 31):
+            self.timestamp_high += 1 << 32
+        self.last_timestamp = timestamp
+        return self.timestamp_high + timestamp
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", help="captured stream (default: stdin)")
+    parser.add_argument("--passthrough", action="store_true", help="also print the output between the frames")
+    args = parser.parse_args()
+
+    decoder = Decoder(sys.stdout, args.passthrough)
+    stream = open(args.input, "rb") if args.input else sys.stdin.buffer
+    try:
+        while True:
+            data = stream.read1(4096) if hasattr(stream, "read1") else stream.read(4096)
+            if not data:
+                break
+            decoder.feed(data)
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if args.input:
+            stream.close()
+    decoder.text(decoder.buffer)
+    print("%d traces, %d lost, %d without a known format, %d bad frames"
+          % (decoder.traces, decoder.lost, decoder.unknown_formats, decoder.bad_frames), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())